@@ -1,3 +1,5 @@
+#include <dirent.h>
+#include <fcntl.h>
 #include <pwd.h>
 #include <stdbool.h>
 #include <stdio.h>
@@ -5,7 +7,6 @@
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
-#include <sys/sysctl.h>
 
 #define PS_DISPLAY_ALL      0x01
 #define PS_DISPLAY_ALL_TTYS 0x02
@@ -13,6 +14,19 @@
 #define PS_FORMAT_JOB_CTL   0x08
 #define PS_FORMAT(options) ((options) & 0xC)
 
+/* what /proc/<pid>/stat says about a process */
+struct ps_entry {
+    pid_t   pid;
+    pid_t   ppid;
+    pid_t   pgid;
+    pid_t   sid;
+    uid_t   uid;
+    gid_t   gid;
+    time_t  stime;
+    char    cmd[256];
+    char    tty[32];
+};
+
 static void
 get_time_string(char *buf, size_t buf_size, time_t stime)
 {
@@ -30,13 +44,13 @@ get_time_string(char *buf, size_t buf_size, time_t stime)
 }
 
 static void
-ps_print_basic(struct kinfo_proc *entry)
+ps_print_basic(struct ps_entry *entry)
 {
     printf("%5d %-10s %s\n", entry->pid, entry->tty, entry->cmd);
 }
 
 static void
-ps_print_extended(struct kinfo_proc *entry)
+ps_print_extended(struct ps_entry *entry)
 {
     char time_buf[10];
 
@@ -56,13 +70,13 @@ ps_print_extended(struct kinfo_proc *entry)
 }
 
 static void
-ps_print_job_ctl(struct kinfo_proc *entry)
+ps_print_job_ctl(struct ps_entry *entry)
 {
     printf("%5d %5d %5d %-10s %s\n", entry->pid, entry->pgid, entry->sid, entry->tty, entry->cmd);
 }
 
 static void
-ps_print_procs(int options, struct kinfo_proc *procs, int nprocs)
+ps_print_procs(int options, struct ps_entry *procs, int nprocs)
 {
     bool show_all;
     int i;
@@ -84,7 +98,7 @@ ps_print_procs(int options, struct kinfo_proc *procs, int nprocs)
     show_all = (options & PS_DISPLAY_ALL) != 0;
 
     for (i = 0; i < nprocs; i++) {
-        struct kinfo_proc *entry;
+        struct ps_entry *entry;
         
         entry = &procs[i];
 
@@ -106,17 +120,131 @@ ps_print_procs(int options, struct kinfo_proc *procs, int nprocs)
     }
 }
 
+/*
+ * pid (cmd) state ppid pgid sid uid gid stime nthreads tty
+ *
+ * cmd may contain anything, so it ends at the last ')'
+ */
+static int
+ps_read_entry(pid_t pid, struct ps_entry *entry)
+{
+    char buf[512];
+    char path[32];
+    char *cmd_end;
+    char *cmd_start;
+    int fd;
+    int len;
+    int ids[5];
+    unsigned long stime;
+
+    sprintf(path, "/proc/%d/stat", pid);
+
+    fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    len = read(fd, buf, sizeof(buf) - 1);
+
+    close(fd);
+
+    if (len <= 0) {
+        return -1;
+    }
+
+    buf[len] = 0;
+
+    cmd_start = strchr(buf, '(');
+    cmd_end = strrchr(buf, ')');
+
+    if (!cmd_start || !cmd_end || cmd_end < cmd_start) {
+        return -1;
+    }
+
+    *cmd_end = 0;
+
+    strncpy(entry->cmd, cmd_start + 1, sizeof(entry->cmd) - 1);
+    entry->cmd[sizeof(entry->cmd) - 1] = 0;
+
+    if (sscanf(cmd_end + 1, " %*c %d %d %d %d %d %lu %*d %31s", &ids[0], &ids[1], &ids[2],
+                &ids[3], &ids[4], &stime, entry->tty) != 7) {
+        return -1;
+    }
+
+    if (strcmp(entry->tty, "-") == 0) {
+        entry->tty[0] = 0;
+    }
+
+    entry->pid = pid;
+    entry->ppid = ids[0];
+    entry->pgid = ids[1];
+    entry->sid = ids[2];
+    entry->uid = ids[3];
+    entry->gid = ids[4];
+    entry->stime = stime;
+
+    return 0;
+}
+
+/* every process /proc lists; returns how many there are */
+static int
+ps_read_procs(struct ps_entry **procs)
+{
+    int maxprocs;
+    int nprocs;
+    pid_t pid;
+    DIR *dirp;
+    struct dirent *dirent;
+    struct ps_entry *grown;
+
+    dirp = opendir("/proc");
+
+    if (!dirp) {
+        return -1;
+    }
+
+    maxprocs = 32;
+    nprocs = 0;
+    *procs = calloc(maxprocs, sizeof(struct ps_entry));
+
+    while ((dirent = readdir(dirp))) {
+        pid = atoi(dirent->d_name);
+
+        if (pid <= 0) {
+            continue;
+        }
+
+        if (nprocs == maxprocs) {
+            maxprocs *= 2;
+            grown = realloc(*procs, maxprocs*sizeof(struct ps_entry));
+
+            if (!grown) {
+                break;
+            }
+
+            *procs = grown;
+        }
+
+        /* it may have exited since the directory was read */
+        if (ps_read_entry(pid, &(*procs)[nprocs]) == 0) {
+            nprocs++;
+        }
+    }
+
+    closedir(dirp);
+
+    return nprocs;
+}
+
 int
 main(int argc, char *argv[])
 {
     int c;
     int options;
     int nprocs;
-    size_t bufsize;
 
-    struct kinfo_proc *procs;
-
-    int oid[3];
+    struct ps_entry *procs;
 
     options = 0;
 
@@ -142,26 +270,13 @@ main(int argc, char *argv[])
         }
     }
 
-    oid[0] = CTL_KERN;
-    oid[1] = KERN_PROC;
-    oid[2] = KERN_PROC_ALL;
-
-    bufsize = 0;
+    nprocs = ps_read_procs(&procs);
 
-    if (sysctl(oid, 3, NULL, &bufsize, NULL, 0)) {
-        perror("sysctl");
+    if (nprocs < 0) {
+        perror("/proc");
         return -1;
     }
 
-    procs = calloc(1, bufsize);
-
-    if (sysctl(oid, 3, procs, &bufsize, NULL, 0)) {
-        perror("sysctl");
-        return -1;
-    }
-
-    nprocs = bufsize / sizeof(struct kinfo_proc);
-
     ps_print_procs(options, procs, nprocs);
 
     free(procs);
@@ -0,0 +1,49 @@
+#!/bin/sh
+#
+# kbench_compare.sh - compares two runs of usr.bin/kbench
+#
+# usage: kbench_compare.sh BEFORE AFTER
+#
+# BEFORE and AFTER hold what kbench printed, for example captured from the
+# serial console of two QEMU runs. Prints every result of both runs and how
+# much it changed; a positive change is always an improvement, whichever way
+# the unit goes
+#
+
+if [ $# -ne 2 ]; then
+    echo "usage: $0 BEFORE AFTER" >&2
+    exit 1
+fi
+
+awk '
+/^#/ || NF != 3 { next }
+
+NR == FNR {
+    before[$1] = $2
+    next
+}
+
+{
+    if (!($1 in before)) {
+        printf "%-28s %12s %12s %-6s %8s\n", $1, "-", $2, $3, "new"
+        next
+    }
+
+    old = before[$1]
+    new = $2
+
+    if (old == "failed" || new == "failed" || old == 0) {
+        printf "%-28s %12s %12s %-6s %8s\n", $1, old, new, $3, "-"
+        next
+    }
+
+    # rates get better as they grow, times as they shrink
+    if ($3 ~ /\/s$/) {
+        change = (new - old) * 100 / old
+    } else {
+        change = (old - new) * 100 / old
+    }
+
+    printf "%-28s %12.2f %12.2f %-6s %+7.1f%%\n", $1, old, new, $3, change
+}
+' "$1" "$2"
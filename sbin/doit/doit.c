@@ -10,6 +10,7 @@
 #include <unistd.h>
 #include <collections/dict.h>
 #include <sys/socket.h>
+#include <sys/sysctl.h>
 #include <sys/un.h>
 
 typedef enum {
@@ -248,6 +249,19 @@ do_directory(const char *directory)
     closedir(dirp);
 }
 
+/* adds a stage to the kernel's record of booting, which bootchart prints */
+static void
+mark_boot_stage(const char *name)
+{
+    int mib[3];
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_BOOT;
+    mib[2] = KERN_BOOT_STAGES;
+
+    sysctl(mib, 3, NULL, NULL, (void*)name, strlen(name));
+}
+
 /* set the system time */
 static void
 set_system_time()
@@ -284,6 +298,8 @@ start_daemon(int argc, const char *argv[])
 
     char runlevel_str[8];
 
+    mark_boot_stage("doit");
+
     for (int i = 0; i < 3; i++) {
         open(console, O_RDWR);
     }
@@ -311,8 +327,13 @@ start_daemon(int argc, const char *argv[])
 
     do_directory("/etc/doit.d");
 
+    mark_boot_stage("services");
+
+    /* services are forked and left to start side by side; none is waited for */
     change_runlevel(target);
 
+    mark_boot_stage("ready");
+
     int fd = socket(AF_UNIX, SOCK_STREAM, 0);
 
     struct sockaddr_un  addr;
@@ -3,3 +3,11 @@
 ###
 ARCH=i686
 USE_BOOTLOADER_GRAPHICS=true
+
+# count acquisitions, contention and hold times of spinlocks per lock class
+# and export them as lock.* kstats; costs a few TSC reads per lock
+#LOCK_STATS=true
+
+# charge every kernel heap block to the code that allocated it, so the
+# kmemstat tool can show who owns the heap
+#MALLOC_PROFILE=true
@@ -30,26 +30,31 @@
 #include <sys/string.h>
 #include <sys/systm.h>
 #include <sys/termios.h>
+#include <sys/tty.h>
 #include <sys/vnode.h>
 
-#define PTY_LINEBUF_SIZE    4096
-
 static int ptm_close(struct file *);
 static int ptm_getdev(struct file *, struct cdev **);
 static int ptm_ioctl(struct file *, uint64_t, void *);
 static int ptm_read(struct file *, void *, size_t);
+static int ptm_readv(struct file *, const struct iovec *, int, off_t);
 static int ptm_stat(struct file *, struct stat *);
 static int ptm_write(struct file *, const void *, size_t);
 static int pts_ioctl(struct cdev *, uint64_t, uintptr_t);
 static int pts_isatty(struct cdev *);
 static int pts_read(struct cdev *, char *, size_t, uint64_t);
+static int pts_readv(struct cdev *, const struct iovec *, int, uint64_t);
 static int pts_write(struct cdev *, const char *, size_t, uint64_t);
+static int pts_writev(struct cdev *, const struct iovec *, int, uint64_t);
+static int pty_output(struct tty *, const struct iovec *, int, int);
 
 struct cdev_ops pts_cdevops = {
     .ioctl = pts_ioctl,
     .isatty = pts_isatty,
     .read = pts_read,
-    .write = pts_write
+    .readv = pts_readv,
+    .write = pts_write,
+    .writev = pts_writev
 };
 
 struct fops ptm_ops = {
@@ -57,19 +62,20 @@ struct fops ptm_ops = {
     .getdev     = ptm_getdev,
     .ioctl      = ptm_ioctl,
     .read       = ptm_read,
+    .readv      = ptm_readv,
     .stat       = ptm_stat,
     .write      = ptm_write
 };
 
+/*
+ * input written to the master goes through the line discipline and is queued
+ * in the tty; processed output from the slave is sent to the master through
+ * output_pipe
+ */
 struct pty {
-    struct file *   input_pipe[2];
+    struct tty      tty;
     struct file *   output_pipe[2];
     struct cdev *   slave;
-    struct termios  termios;
-    int             line_buf_pos;
-    char            line_buf[PTY_LINEBUF_SIZE];
-    struct winsize  winsize;
-    pid_t           foreground;
 };
 
 static int pty_counter = 0;
@@ -102,15 +108,12 @@ mkpty()
 
     pty = calloc(1, sizeof(struct pty));
     
-    pty->winsize.ws_row = 50;
-    pty->winsize.ws_col = 100;
-    pty->termios.c_lflag = ECHO | ICANON;
-    pty->termios.c_oflag = OPOST;
+    tty_init(&pty->tty, pty_output, NULL, pty);
 
-    create_pipe(pty->input_pipe, NULL);
     create_pipe(pty->output_pipe, NULL);
 
     pty->slave = mkpty_slave(pty);
+    pty->tty.cdev = pty->slave;
 
     res = file_new(&ptm_ops, NULL);
 
@@ -120,129 +123,14 @@ mkpty()
     return res;
 }
 
-static void
-pty_flush_buf(struct pty *pty)
-{
-    FOP_WRITE(pty->input_pipe[1], pty->line_buf, pty->line_buf_pos);
-
-    pty->line_buf_pos = 0;
-}
-
-static int
-pty_ioctl(struct pty *pty, uint64_t request, uintptr_t argp)
-{
-    pid_t pgid;
-    struct pgrp *pgrp;
-    struct session *session;
-
-    switch (request) {
-    case TCGETS:
-        memcpy((void*)argp, &pty->termios, sizeof(struct termios));
-        break;
-    case TCSETS:
-        memcpy(&pty->termios, (void*)argp, sizeof(struct termios));
-        break;
-    case TCSETSW:
-        memcpy(&pty->termios, (void*)argp, sizeof(struct termios));
-        break;
-    case TCSETSF:
-        pty_flush_buf(pty);
-        memcpy(&pty->termios, (void*)argp, sizeof(struct termios));
-        break;
-    case TIOCSWINSZ:
-        memcpy(&pty->winsize, (void*)argp, sizeof(struct winsize));
-        break;
-    case TIOCGWINSZ:
-        memcpy((void*)argp, &pty->winsize, sizeof(struct winsize));
-        break; 
-    case TIOCSCTTY: {
-        session = PROC_GET_SESSION(current_proc);
-    
-        if (!session->ctty) {
-            session->ctty = pty->slave;
-            return 0;
-        }
-
-        return -1;
-    }
-    case TIOCSPGRP: {
-        pgid = *((pid_t*)argp);
-        pgrp = pgrp_find(pgid);
-
-        if (pgrp) {
-            pty->foreground = pgid;
-            return 0;
-        }
-
-        return -(ESRCH);
-    }
-    case TIOCGPGRP: {
-        *((pid_t*)argp) = pty->foreground;
-        
-        return 0;
-    }
-    default:
-        printf("got unknown IOCTL %d!\n", request);
-        break;
-    }
-
-    return 0;
-}
-
 static int
-pty_inprocess(struct pty *pty, const char *buf, size_t nbyte)
+pty_output(struct tty *tty, const struct iovec *iov, int iovcnt, int flags)
 {
-    int i;
-    int last_chunk_pos;
-
-    const char *last_chunk;
-
-    last_chunk = buf;
-    last_chunk_pos = 0;
-
-    for (i = 0; i < nbyte; i++) {
-        if (buf[i] == '\r' && (pty->termios.c_iflag & ONLCR)) {
-            if (i != last_chunk_pos) FOP_WRITE(pty->input_pipe[1], last_chunk, i - last_chunk_pos);
-            FOP_WRITE(pty->input_pipe[1], "\r\n", 2);
-            last_chunk = &buf[i + 1];
-            last_chunk_pos = i + 1;
-        } else if (buf[i] == '\r') {
-            if (i != last_chunk_pos) FOP_WRITE(pty->input_pipe[1], last_chunk, i - last_chunk_pos);
-            FOP_WRITE(pty->input_pipe[1], "\n", 1);
-            last_chunk = &buf[i + 1];
-            last_chunk_pos = i + 1;    
-        }
-    }
-
-    if(last_chunk_pos < nbyte) {
-        FOP_WRITE(pty->input_pipe[1], last_chunk, nbyte - last_chunk_pos);
-    }
-
-    return nbyte;
-}
+    struct pty *pty;
 
-static void
-pty_outprocess(struct pty *pty, const char *buf, size_t nbyte)
-{
-    int i;
-    int last_chunk_pos;
-    const char *last_chunk;
-
-    last_chunk = buf;
-    last_chunk_pos = 0;
-
-    for (i = 0; i < nbyte; i++) {
-        if (buf[i] == '\n') {
-            if (i != last_chunk_pos) FOP_WRITE(pty->output_pipe[1], last_chunk, i - last_chunk_pos);
-            FOP_WRITE(pty->output_pipe[1], "\r\n", 2);
-            last_chunk = &buf[i + 1];
-            last_chunk_pos = i + 1;
-        }
-    }
+    pty = tty->state;
 
-    if(last_chunk_pos < nbyte) {
-        FOP_WRITE(pty->output_pipe[1], last_chunk, nbyte - last_chunk_pos);
-    }
+    return pipe_writev(pty->output_pipe[1], iov, iovcnt, flags);
 }
 
 static int
@@ -266,7 +154,19 @@ ptm_getdev(struct file *fp, struct cdev **result)
 static int
 ptm_ioctl(struct file *fp, uint64_t request, void *argp)
 {
-    return pty_ioctl(fp->state, request, (uintptr_t)argp);
+    struct pty *pty;
+
+    pty = (struct pty*)fp->state;
+
+    switch (request) {
+        case FIONREAD:
+            return FOP_IOCTL(pty->output_pipe[0], request, argp);
+        case FIONSPACE:
+            *((uint32_t*)argp) = TTY_INQ_SPACE(&pty->tty);
+            return 0;
+    }
+
+    return tty_ioctl(&pty->tty, request, (uintptr_t)argp);
 }
 
 
@@ -280,12 +180,23 @@ ptm_destroy(struct vnode *node)
 
 static int
 ptm_read(struct file *fp, void *buf, size_t nbyte)
+{
+    struct iovec iov;
+
+    iov.iov_base = buf;
+    iov.iov_len = nbyte;
+
+    return ptm_readv(fp, &iov, 1, 0);
+}
+
+static int
+ptm_readv(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
 {
     struct pty *pty;
 
     pty = (struct pty*)fp->state;
 
-    return FOP_READ(pty->output_pipe[0], buf, nbyte);
+    return pipe_readv(pty->output_pipe[0], iov, iovcnt, fp->flags);
 }
 
 static int
@@ -296,48 +207,49 @@ ptm_stat(struct file *fp, struct stat *stat)
     return 0;
 }
 
+/* waits for room in the input queue unless the master is non-blocking */
 static int
 ptm_write(struct file *fp, const void *buf, size_t nbyte)
 {
-    int i;
-    uint8_t *buf8;
+    size_t written;
     struct pty *pty;
 
     pty = (struct pty*)fp->state;
-    buf8 = (uint8_t*)buf;
+    written = 0;
+
+    while (written < nbyte) {
+        written += tty_input(&pty->tty, (const char*)buf + written, nbyte - written);
 
-    if (pty->termios.c_lflag & ECHO) {
-        if (pty->termios.c_oflag & OPOST) {
-            pty_outprocess(pty, buf, nbyte);
-        } else {
-            FOP_WRITE(pty->output_pipe[1], buf, nbyte);
+        if (written == nbyte) {
+            break;
         }
-    }
 
-    if (!(pty->termios.c_lflag & ICANON)) {
-        return pty_inprocess(pty, buf, nbyte);
-    }
+        if (FILE_NONBLOCK(fp)) {
+            return written > 0 ? written : -(EAGAIN);
+        }
+
+        thread_yield();
 
-    for (i = 0; i < nbyte; i++) {
-        if (buf8[i] == '\b' && pty->line_buf_pos > 0) {
-            pty->line_buf[pty->line_buf_pos - 1] = 0;
-            pty->line_buf_pos--;
-        } else if (buf8[i] == '\r' || pty->line_buf_pos > PTY_LINEBUF_SIZE) {
-            pty->line_buf[pty->line_buf_pos++] = '\n';
-            FOP_WRITE(pty->output_pipe[1], "\r\n", 2);
-            pty_flush_buf(pty);
-        } else {
-            pty->line_buf[pty->line_buf_pos++] = buf8[i];
+        if (thread_exit_requested()) {
+            return written > 0 ? written : -(EINTR);
         }
     }
-    
-    return nbyte;
+
+    return written;
 }
 
 static int
 pts_ioctl(struct cdev *dev, uint64_t request, uintptr_t argp)
 {
-    return pty_ioctl(dev->state, request, argp);
+    struct pty *pty;
+
+    pty = (struct pty*)dev->state;
+
+    if (request == FIONSPACE) {
+        return FOP_IOCTL(pty->output_pipe[1], request, (void*)argp);
+    }
+
+    return tty_ioctl(&pty->tty, request, argp);
 }
 
 static int
@@ -348,26 +260,42 @@ pts_isatty(struct cdev *dev)
 
 static int
 pts_read(struct cdev *dev, char *buf, size_t nbyte, uint64_t pos)
+{
+    struct iovec iov;
+
+    iov.iov_base = buf;
+    iov.iov_len = nbyte;
+
+    return pts_readv(dev, &iov, 1, pos);
+}
+
+static int
+pts_readv(struct cdev *dev, const struct iovec *iov, int iovcnt, uint64_t pos)
 {
     struct pty *pty;
 
     pty = (struct pty*)dev->state;
 
-    return FOP_READ(pty->input_pipe[0], buf, nbyte);
+    return tty_read(&pty->tty, iov, iovcnt);
 }
 
 static int
 pts_write(struct cdev *dev, const char *buf, size_t nbyte, uint64_t pos)
 {
-    struct pty *pty;
+    struct iovec iov;
 
-    pty = (struct pty*)dev->state;
+    iov.iov_base = (void*)buf;
+    iov.iov_len = nbyte;
 
-    if (!(pty->termios.c_oflag & OPOST)) {
-        return FOP_WRITE(pty->output_pipe[1], buf, nbyte);
-    }
+    return pts_writev(dev, &iov, 1, pos);
+}
 
-    pty_outprocess(pty, buf, nbyte);
+static int
+pts_writev(struct cdev *dev, const struct iovec *iov, int iovcnt, uint64_t pos)
+{
+    struct pty *pty;
+
+    pty = (struct pty*)dev->state;
 
-    return nbyte;
+    return tty_write(&pty->tty, iov, iovcnt);
 }
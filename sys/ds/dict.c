@@ -51,9 +51,12 @@ dict_clear(struct dict *dict)
         if (entry) {
             list_destroy(&entry->values, true);
             free(entry);
+            dict->entries[i] = NULL;
         }
     }
-    /* TODO: implement... */
+
+    /* the keys live in the pairs freed above */
+    list_destroy(&dict->keys, false);
 }
 
 int
@@ -88,7 +91,10 @@ dict_clear_f(struct dict *dict, dict_free_t free_func)
 
         list_destroy(&entry->values, true);
         free(entry); 
+        dict->entries[i] = NULL;
     }
+
+    list_destroy(&dict->keys, false);
 }
 
 bool
@@ -104,7 +110,8 @@ dict_get(struct dict *dict, const char *key, void **result)
     hash = dict_hash(key);
     entry = dict->entries[hash];
 
-    if (!entry) {
+    /* an entry stays behind when the last key in it is removed */
+    if (!entry || LIST_SIZE(&entry->values) == 0) {
         return false;
     }
 
@@ -195,6 +202,11 @@ dict_remove(struct dict *dict, const char *key)
     */
 
     entry = dict->entries[hash];
+
+    if (!entry) {
+        return false;
+    }
+
     listp = &entry->values;
 
     if (LIST_SIZE(listp) == 0) {
@@ -229,6 +241,8 @@ dict_remove(struct dict *dict, const char *key)
 void
 dict_set(struct dict *dict, const char *key, void *value)
 {
+    bool found;
+    list_iter_t iter;
     uint32_t hash;
     struct dict_entry *entry;
     struct key_value_pair *kvp;
@@ -237,11 +251,30 @@ dict_set(struct dict *dict, const char *key, void *value)
     entry = dict->entries[hash];
 
     if (!entry) {
-        entry = (struct dict_entry*)calloc(1, sizeof(struct dict_entry));
+        entry = (struct dict_entry*)calloc_at(1, sizeof(struct dict_entry), MALLOC_CALLER());
         dict->entries[hash] = entry;
     }
 
-    kvp = (struct key_value_pair*)calloc(1, sizeof(struct key_value_pair));
+    /* setting a key that is already present replaces its value */
+    found = false;
+
+    list_get_iter(&entry->values, &iter);
+
+    while (iter_move_next(&iter, (void**)&kvp)) {
+        if (strcmp(key, kvp->key) == 0) {
+            kvp->value = value;
+            found = true;
+            break;
+        }
+    }
+
+    iter_close(&iter);
+
+    if (found) {
+        return;
+    }
+
+    kvp = (struct key_value_pair*)calloc_at(1, sizeof(struct key_value_pair), MALLOC_CALLER());
     
     strncpy(kvp->key, key, 128);
 
@@ -24,8 +24,8 @@ fifo_new(size_t maxsize)
 {
     struct fifo *fifo;
 
-    fifo = calloc(1, sizeof(struct fifo));
-    fifo->buf = calloc(1, maxsize);
+    fifo = calloc_at(1, sizeof(struct fifo), MALLOC_CALLER());
+    fifo->buf = calloc_at(1, maxsize, MALLOC_CALLER());
     fifo->buf_size = maxsize;
 
     return fifo;
@@ -46,11 +46,11 @@ fifo_read(struct fifo *fifo, void *buf, size_t nbyte)
     }
 
     for (i = 0; i < nbyte; i++) {
-        buf8[i] = fifo->buf[i % fifo->buf_size + fifo->head_pos];
+        buf8[i] = fifo->buf[(i + fifo->head_pos) % fifo->buf_size];
     }
 
     fifo->size -= nbyte;
-    fifo->head_pos += nbyte;
+    fifo->head_pos = (fifo->head_pos + nbyte) % fifo->buf_size;
 
     if (fifo->size == 0) {
         fifo->head_pos = 0;
@@ -62,6 +62,7 @@ fifo_read(struct fifo *fifo, void *buf, size_t nbyte)
     return nbyte;
 }
 
+/* stores as much of buf as there is room for and returns how much that was */
 size_t
 fifo_write(struct fifo *fifo, void *buf, size_t nbyte)
 {
@@ -72,14 +73,18 @@ fifo_write(struct fifo *fifo, void *buf, size_t nbyte)
     
     spinlock_lock(&fifo->lock);
 
+    if (nbyte > fifo->buf_size - fifo->size) {
+        nbyte = fifo->buf_size - fifo->size;
+    }
+
     for (i = 0; i < nbyte; i++) {
         fifo->buf[(i + fifo->tail_pos) % fifo->buf_size] = buf8[i];
     }
 
-    fifo->tail_pos += nbyte;
+    fifo->tail_pos = (fifo->tail_pos + nbyte) % fifo->buf_size;
     fifo->size += nbyte;
 
     spinlock_unlock(&fifo->lock);
   
-    return 0;
+    return nbyte;
 }
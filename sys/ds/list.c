@@ -25,15 +25,25 @@
  */
 int list_elem_count = 0;
 
+LOCK_CLASS(list_lock_class, "list");
+
+/* lists have no constructor, so their lock learns its class here */
+static inline void
+list_lock(struct list *listp)
+{
+    spinlock_set_class(&listp->lock, &list_lock_class);
+    spinlock_lock(&listp->lock);
+}
+
 void
 list_append(struct list *listp, void *ptr)
 {
     struct list_elem *elem;
     struct list_elem *tail;
 
-    elem = (struct list_elem*)calloc(1, sizeof(struct list_elem));
+    elem = (struct list_elem*)calloc_at(1, sizeof(struct list_elem), MALLOC_CALLER());
 
-    spinlock_lock(&listp->lock);
+    list_lock(listp);
 
     elem->data = ptr;
     elem->next_elem = NULL;
@@ -63,7 +73,7 @@ list_destroy(struct list *listp, bool free_children)
     struct list_elem *cur;
     struct list_elem *next;
     
-    spinlock_lock(&listp->lock);
+    list_lock(listp);
 
     cur = listp->head;
 
@@ -88,7 +98,7 @@ list_destroy(struct list *listp, bool free_children)
 void
 list_get_iter(struct list *listp, list_iter_t *iterp)
 {
-    spinlock_lock(&listp->lock);
+    list_lock(listp);
 
     iterp->listp = listp;
     iterp->current_item = listp->head;
@@ -103,7 +113,7 @@ list_peek_back(struct list *listp)
 
     ret = NULL;
 
-    spinlock_lock(&listp->lock);
+    list_lock(listp);
 
     tail = listp->tail;
 
@@ -122,7 +132,7 @@ list_remove_front(struct list *listp, void **item)
     bool res;
     struct list_elem *head;
 
-    spinlock_lock(&listp->lock);
+    list_lock(listp);
 
     res = false;
     head = listp->head;
@@ -162,7 +172,7 @@ list_remove(struct list *listp, void *item)
     struct list_elem *prev;
     struct list_elem *next;
     
-    spinlock_lock(&listp->lock);
+    list_lock(listp);
     
     iter = listp->head;
     prev = NULL;
@@ -207,7 +217,7 @@ list_remove_back(struct list *listp, void **item)
     bool res;
     struct list_elem *tail;
 
-    spinlock_lock(&listp->lock);
+    list_lock(listp);
 
     res = false;
     tail = listp->tail;
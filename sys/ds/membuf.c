@@ -15,71 +15,100 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
-#include <ds/list.h>
 #include <ds/membuf.h>
 #include <sys/malloc.h>
 #include <sys/mutex.h>
 #include <sys/string.h>
 #include <sys/systm.h>
 
-void
-membuf_expand(struct membuf *mb, size_t newsize)
+/*
+ * appends the blocks still missing to hold newsize bytes. Everything is
+ * charged to site, which is whoever is writing to the membuf
+ */
+static void
+membuf_expand_at(struct membuf *mb, size_t newsize, uintptr_t site)
 {
-    int i;
+    int max_blocks;
     int requested_blocks;
-    void *newbuf;
+    void **newblocks;
 
-    requested_blocks = (newsize / MEMBUF_BLOCK_SIZE) + 1; 
+    requested_blocks = (newsize + MEMBUF_BLOCK_SIZE - 1) / MEMBUF_BLOCK_SIZE;
 
-    for (i = 0; i < requested_blocks; i++) {
-        newbuf = calloc(1, MEMBUF_BLOCK_SIZE);
+    if (requested_blocks > mb->max_blocks) {
+        /* doubling keeps a file that grows a little at a time linear to build */
+        max_blocks = mb->max_blocks * 2;
+
+        if (max_blocks < requested_blocks) {
+            max_blocks = requested_blocks;
+        }
+
+        newblocks = calloc_at(max_blocks, sizeof(void*), site);
+
+        if (mb->blocks) {
+            memcpy(newblocks, mb->blocks, mb->nblocks * sizeof(void*));
+            free(mb->blocks);
+        }
 
-        list_append(&mb->blocks, newbuf);
+        mb->blocks = newblocks;
+        mb->max_blocks = max_blocks;
+    }
+
+    while (mb->nblocks < requested_blocks) {
+        mb->blocks[mb->nblocks++] = calloc_at(1, MEMBUF_BLOCK_SIZE, site);
     }
 
     mb->size = newsize;
 }
 
-static void *
+void
+membuf_expand(struct membuf *mb, size_t newsize)
+{
+    membuf_expand_at(mb, newsize, MALLOC_CALLER());
+}
+
+static inline void *
 get_block_buf(struct membuf *mb, off_t pos)
 {
-    int i;
     int block_index;
-    list_iter_t iter;
-    void *buf;
-    void *ret;
 
     block_index = pos / MEMBUF_BLOCK_SIZE;
 
-    list_get_iter(&mb->blocks, &iter);
+    if (block_index >= mb->nblocks) {
+        return NULL;
+    }
+
+    return mb->blocks[block_index];
+}
 
-    i = 0;
-    ret = NULL;
+static void
+free_blocks(struct membuf *mb)
+{
+    int i;
 
-    while (iter_move_next(&iter, &buf)) {
-        if (i == block_index) {
-            ret = buf;
-            break;
-        }
-        i++;        
+    for (i = 0; i < mb->nblocks; i++) {
+        free(mb->blocks[i]);
     }
 
-    iter_close(&iter);
-
-    return ret;
+    if (mb->blocks) {
+        free(mb->blocks);
+    }
 }
 
 void
 membuf_clear(struct membuf *mb)
 {
-    list_destroy(&mb->blocks, true);
-    memset(&mb->blocks, 0, sizeof(struct list));
+    free_blocks(mb);
+
+    mb->blocks = NULL;
+    mb->nblocks = 0;
+    mb->max_blocks = 0;
+    mb->size = 0;
 }
 
 void
 membuf_destroy(struct membuf *mb)
 {
-    list_destroy(&mb->blocks, true);
+    free_blocks(mb);
     free(mb);
 }
 
@@ -88,7 +117,7 @@ membuf_new()
 {
     struct membuf *new_mb;
 
-    new_mb = calloc(1, sizeof(struct membuf));
+    new_mb = calloc_at(1, sizeof(struct membuf), MALLOC_CALLER());
 
     return new_mb;
 }
@@ -96,38 +125,35 @@ membuf_new()
 size_t
 membuf_read(struct membuf *mb, void *buf, size_t nbyte, off_t pos)
 {
-    int i;
     int byte_count;
     int relative_offset;
-    int required_blocks;
     off_t cur_pos;
     size_t bytes_read;
     void *block;
 
     spinlock_lock(&mb->lock);
-    
-    cur_pos = pos;
 
-    if (pos + nbyte > MEMBUF_SIZE(mb)) {
-        nbyte = MEMBUF_SIZE(mb) - pos;
+    if (pos >= MEMBUF_SIZE(mb)) {
+        spinlock_unlock(&mb->lock);
+        return 0;
     }
 
-    if (nbyte <= 0) {
-        return 0;
+    if (pos + nbyte > MEMBUF_SIZE(mb)) {
+        nbyte = MEMBUF_SIZE(mb) - pos;
     }
 
-    required_blocks = (nbyte / MEMBUF_BLOCK_SIZE) + 1;
+    cur_pos = pos;
     bytes_read = 0;
 
-    for (i = 0; i < required_blocks; i++) {
+    while (bytes_read < nbyte) {
         relative_offset = cur_pos % MEMBUF_BLOCK_SIZE;
-        byte_count = nbyte - (i * MEMBUF_BLOCK_SIZE);
+        byte_count = nbyte - bytes_read;
 
         if (byte_count > (MEMBUF_BLOCK_SIZE - relative_offset)) byte_count = MEMBUF_BLOCK_SIZE - relative_offset;
 
         block = get_block_buf(mb, cur_pos);
 
-        memcpy(buf + (i * MEMBUF_BLOCK_SIZE), block + relative_offset, byte_count);
+        memcpy(buf + bytes_read, block + relative_offset, byte_count);
         bytes_read += byte_count;
         cur_pos += byte_count;
     }
@@ -140,10 +166,8 @@ membuf_read(struct membuf *mb, void *buf, size_t nbyte, off_t pos)
 void
 membuf_write(struct membuf *mb, const void *buf, size_t nbyte, off_t pos)
 {
-    int i;
     int byte_count;
     int relative_offset;
-    int required_blocks;
     off_t cur_pos;
     size_t written;
     size_t requested_size;
@@ -156,22 +180,21 @@ membuf_write(struct membuf *mb, const void *buf, size_t nbyte, off_t pos)
     requested_size = pos + nbyte;
 
     if (requested_size > MEMBUF_ACTUAL_SIZE(mb)) {
-        membuf_expand(mb, requested_size);
+        membuf_expand_at(mb, requested_size, MALLOC_CALLER());
     }
     
-    required_blocks = (nbyte / MEMBUF_BLOCK_SIZE) + 1;
     written = 0;
 
-    for (i = 0; i < required_blocks; i++) {
+    while (written < nbyte) {
         relative_offset = cur_pos % MEMBUF_BLOCK_SIZE;
-        byte_count = nbyte - (i * MEMBUF_BLOCK_SIZE);
+        byte_count = nbyte - written;
         if (byte_count > (MEMBUF_BLOCK_SIZE - relative_offset)) byte_count = MEMBUF_BLOCK_SIZE - relative_offset;
 
         block = get_block_buf(mb, cur_pos);
 
         KASSERT(block != NULL, "get_block_buf should not equal NULL");
 
-        memcpy(block + relative_offset, buf + (i * MEMBUF_BLOCK_SIZE), byte_count);
+        memcpy(block + relative_offset, buf + written, byte_count);
         written += byte_count;
         cur_pos += byte_count;
     }
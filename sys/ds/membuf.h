@@ -1,19 +1,20 @@
 #ifndef _DS_MEMBUF_H
 #define _DS_MEMBUF_H
 
-#include <ds/list.h>
 #include <sys/mutex.h>
 #include <sys/types.h>
 
 #define MEMBUF_BLOCK_SIZE   2048
 
-#define MEMBUF_ACTUAL_SIZE(p)   (LIST_SIZE(&p->blocks)*MEMBUF_BLOCK_SIZE)
+#define MEMBUF_ACTUAL_SIZE(p)   ((p)->nblocks*MEMBUF_BLOCK_SIZE)
 #define MEMBUF_SIZE(p)          (p->size)
 
 struct membuf {
     spinlock_t  lock;
     size_t      size;    
-    struct list blocks;
+    void **     blocks;     /* block n holds bytes n*MEMBUF_BLOCK_SIZE onwards */
+    int         nblocks;
+    int         max_blocks; /* room in blocks before it has to grow */
 };
 
 void membuf_clear(struct membuf *mb);
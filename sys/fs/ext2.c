@@ -204,6 +204,8 @@ struct ext2fs {
     spinlock_t              lock;
 };
 
+LOCK_CLASS(ext2fs_lock_class, "ext2fs");
+
 __attribute__((always_inline))
 static inline void
 ext2fs_lock(struct ext2fs *fs)
@@ -1198,6 +1200,9 @@ ext2_mount(struct vnode *parent, struct file *dev_fp, struct vnode **root)
     }
 
     fs = calloc(1, sizeof(struct ext2fs));
+
+    spinlock_set_class(&fs->lock, &ext2fs_lock_class);
+    lock_class_register(&ext2fs_lock_class);
     
     memcpy(&fs->superblock, &superblock, sizeof(superblock));
 
@@ -0,0 +1,889 @@
+/*
+ * procfs.c - process and kernel state as a filesystem
+ *
+ * Nothing is stored; every read generates the file's text straight from the
+ * kernel structures. Text is generated front to back and copied only where
+ * it overlaps the caller's buffer, and generation stops once that buffer is
+ * full, so a read costs what it returns plus whatever precedes it in the
+ * file rather than the whole file.
+ *
+ * Every node remembers what it shows (a pid, a fd, which file) rather than
+ * pointing at the structure itself, so a node outliving its process is
+ * harmless and simply fails with ESRCH
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <ds/dict.h>
+#include <ds/list.h>
+#include <machine/vm.h>
+#include <sys/cpu.h>
+#include <sys/dirent.h>
+#include <sys/errno.h>
+#include <sys/file.h>
+#include <sys/interrupt.h>
+#include <sys/limits.h>
+#include <sys/malloc.h>
+#include <sys/mount.h>
+#include <sys/proc.h>
+#include <sys/stat.h>
+#include <sys/string.h>
+#include <sys/sysctl.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/vm.h>
+#include <sys/vnode.h>
+#include <sys/world.h>
+
+#define PROCFS_ROOT         0
+#define PROCFS_MEMINFO      1
+#define PROCFS_INTERRUPTS   2
+#define PROCFS_STAT         3
+#define PROCFS_PID          4
+#define PROCFS_PID_STAT     5
+#define PROCFS_PID_STATUS   6
+#define PROCFS_PID_MAPS     7
+#define PROCFS_PID_FD       8
+#define PROCFS_PID_FD_ENTRY 9
+
+#define PROCFS_IS_DIR(t)    ((t) == PROCFS_ROOT || (t) == PROCFS_PID || (t) == PROCFS_PID_FD)
+
+/* cached children of dead processes and closed files dropped per readdir */
+#define PROCFS_PRUNE_MAX    16
+
+struct procfs_node {
+    int         type;
+    pid_t       pid;
+    int         fd;
+    /* where the last readdir of a fd/ directory left off */
+    uint64_t    dir_entry;
+    int         dir_fd;
+};
+
+/* the part of a file a read wants; see procfs_put() */
+struct procfs_buf {
+    char *      buf;
+    size_t      nbyte;
+    uint64_t    pos;
+    uint64_t    off;    /* how much of the file was generated so far */
+    size_t      copied;
+};
+
+struct procfs_entry {
+    const char *    name;
+    int             type;
+};
+
+static const struct procfs_entry procfs_root_entries[] = {
+    { "meminfo",    PROCFS_MEMINFO },
+    { "interrupts", PROCFS_INTERRUPTS },
+    { "stat",       PROCFS_STAT },
+};
+
+static const struct procfs_entry procfs_pid_entries[] = {
+    { "stat",       PROCFS_PID_STAT },
+    { "status",     PROCFS_PID_STATUS },
+    { "maps",       PROCFS_PID_MAPS },
+    { "fd",         PROCFS_PID_FD },
+};
+
+#define PROCFS_NROOT    (sizeof(procfs_root_entries) / sizeof(procfs_root_entries[0]))
+#define PROCFS_NPID     (sizeof(procfs_pid_entries) / sizeof(procfs_pid_entries[0]))
+
+static int procfs_destroy(struct vnode *);
+static int procfs_lookup(struct vnode *, struct vnode **, const char *);
+static int procfs_mount(struct vnode *, struct file *, struct vnode **);
+static int procfs_read(struct vnode *, void *, size_t, uint64_t);
+static int procfs_readdirent(struct vnode *, struct dirent *, uint64_t);
+static int procfs_stat(struct vnode *, struct stat *);
+
+struct vops procfs_file_ops = {
+    .destroy    = procfs_destroy,
+    .lookup     = procfs_lookup,
+    .read       = procfs_read,
+    .readdirent = procfs_readdirent,
+    .stat       = procfs_stat,
+};
+
+struct fs_ops procfs_ops = {
+    .mount      = procfs_mount,
+};
+
+/*
+ * defined in kern/proc.c
+ */
+extern struct list process_list;
+
+static inline bool
+procfs_full(struct procfs_buf *pb)
+{
+    return pb->off >= pb->pos + pb->nbyte;
+}
+
+/* appends text to the file, copying whatever of it the caller asked for */
+static void
+procfs_put(struct procfs_buf *pb, const char *str, size_t len)
+{
+    size_t skip;
+    size_t count;
+
+    if (pb->off + len > pb->pos && !procfs_full(pb)) {
+        skip = pb->pos > pb->off ? pb->pos - pb->off : 0;
+        count = len - skip;
+
+        if (count > pb->nbyte - pb->copied) {
+            count = pb->nbyte - pb->copied;
+        }
+
+        memcpy(pb->buf + pb->copied, str + skip, count);
+        pb->copied += count;
+    }
+
+    pb->off += len;
+}
+
+static void
+procfs_puts(struct procfs_buf *pb, const char *str)
+{
+    procfs_put(pb, str, strlen(str));
+}
+
+static void
+procfs_putd(struct procfs_buf *pb, int val)
+{
+    char buf[16];
+
+    procfs_puts(pb, itoa(val, buf, 10));
+}
+
+static void
+procfs_putu(struct procfs_buf *pb, unsigned int val)
+{
+    char buf[16];
+
+    procfs_puts(pb, itoa_u(val, buf, 10));
+}
+
+static void
+procfs_puto(struct procfs_buf *pb, unsigned int val)
+{
+    char buf[16];
+
+    procfs_puts(pb, itoa_u(val, buf, 8));
+}
+
+/* zero padded and lowercase, unlike itoa_u() */
+static void
+procfs_putx(struct procfs_buf *pb, uint32_t val)
+{
+    int i;
+    char buf[8];
+
+    for (i = 7; i >= 0; i--, val >>= 4) {
+        buf[i] = "0123456789abcdef"[val & 0xF];
+    }
+
+    procfs_put(pb, buf, 8);
+}
+
+/* "name:\tvalue\n", as /proc/meminfo and status files are made of */
+static void
+procfs_putfield(struct procfs_buf *pb, const char *name, unsigned int val, const char *unit)
+{
+    procfs_puts(pb, name);
+    procfs_puts(pb, ":\t");
+    procfs_putu(pb, val);
+    procfs_puts(pb, unit);
+    procfs_puts(pb, "\n");
+}
+
+static struct vnode *
+procfs_node_new(struct vnode *parent, int type, pid_t pid, int fd)
+{
+    struct procfs_node *pn;
+    struct vnode *node;
+
+    pn = calloc(1, sizeof(struct procfs_node));
+
+    if (!pn) {
+        return NULL;
+    }
+
+    pn->type = type;
+    pn->pid = pid;
+    pn->fd = fd;
+    pn->dir_fd = -1;
+
+    node = vn_new(parent, NULL, &procfs_file_ops);
+    node->state = pn;
+    node->inode = (pid << 16) | (fd << 4) | type;
+    node->uid = 0;
+    node->gid = 0;
+
+    if (PROCFS_IS_DIR(type)) {
+        node->mode = 0555 | S_IFDIR;
+    } else {
+        node->mode = 0444 | S_IFREG;
+    }
+
+    return node;
+}
+
+/* the process a node belongs to, if it still exists and may be looked at */
+static struct proc *
+procfs_proc(struct procfs_node *pn)
+{
+    struct proc *proc;
+
+    proc = proc_find(pn->pid);
+
+    if (!proc || !WORLD_CAN_SEE_PROC(current_proc->world, proc)) {
+        return NULL;
+    }
+
+    return proc;
+}
+
+static int
+procfs_parse_num(const char *name)
+{
+    int val;
+
+    if (*name == 0) {
+        return -1;
+    }
+
+    for (val = 0; *name; name++) {
+        if (*name < '0' || *name > '9' || val > 0x7FFFFFF) {
+            return -1;
+        }
+
+        val = val*10 + (*name - '0');
+    }
+
+    return val;
+}
+
+static char
+procfs_proc_state(struct proc *proc)
+{
+    if (proc->exited) {
+        return 'Z';
+    }
+
+    switch (proc->thread ? proc->thread->state : SRUN) {
+        case SSLEEP:
+        case SWAIT:
+        case SLOCK:
+            return 'S';
+        case SSTOP:
+            return 'T';
+        case SZOMB:
+        case SDEAD:
+            return 'Z';
+        default:
+            return 'R';
+    }
+}
+
+static void
+procfs_gen_meminfo(struct procfs_buf *pb)
+{
+    /* defined in kern/malloc.c */
+    extern intptr_t kernel_break;
+    extern intptr_t kernel_heap_start;
+    extern intptr_t kernel_heap_end;
+    extern int kernel_heap_allocated_blocks;
+    extern int kernel_heap_free_blocks;
+
+    procfs_putfield(pb, "FramesUsed", vm_stat.frame_count*(PAGE_SIZE/1024), " kB");
+    procfs_putfield(pb, "Pages", vm_stat.page_count, "");
+    procfs_putfield(pb, "PageTables", vm_stat.page_table_count, "");
+    procfs_putfield(pb, "AddressSpaces", vm_stat.vmspace_count, "");
+    procfs_putfield(pb, "HeapTotal", (kernel_heap_end - kernel_heap_start) / 1024, " kB");
+    procfs_putfield(pb, "HeapUsed", (kernel_break - kernel_heap_start) / 1024, " kB");
+    procfs_putfield(pb, "HeapBlocks", kernel_heap_allocated_blocks, "");
+    procfs_putfield(pb, "HeapFreeBlocks", kernel_heap_free_blocks, "");
+}
+
+/* the machine dependent code already knows how to list vectors for sysctl */
+static int
+procfs_gen_interrupts(struct procfs_buf *pb)
+{
+    int i;
+    int nentries;
+    size_t len;
+    struct kinfo_intr *entries;
+
+    if (intr_sysctl(NULL, 0, NULL, &len, NULL, 0) != 0) {
+        return -(EIO);
+    }
+
+    entries = malloc(len);
+
+    if (!entries) {
+        return -(ENOMEM);
+    }
+
+    if (intr_sysctl(NULL, 0, entries, &len, NULL, 0) != 0) {
+        free(entries);
+        return -(EIO);
+    }
+
+    nentries = len / sizeof(struct kinfo_intr);
+
+    procfs_puts(pb, "vector count handlers\n");
+
+    for (i = 0; i < nentries && !procfs_full(pb); i++) {
+        procfs_putd(pb, entries[i].vector);
+        procfs_puts(pb, " ");
+        procfs_putu(pb, entries[i].count);
+        procfs_puts(pb, " ");
+        procfs_putd(pb, entries[i].nhandlers);
+        procfs_puts(pb, "\n");
+    }
+
+    free(entries);
+
+    return 0;
+}
+
+/* one "cpuN" line per CPU, then system wide totals */
+static void
+procfs_gen_stat(struct procfs_buf *pb)
+{
+    int i;
+    uint32_t switches;
+    struct cpu *ci;
+
+    switches = 0;
+
+    for (i = 0; i < ncpus; i++) {
+        ci = &cpus[i];
+        switches += ci->ci_switches;
+
+        procfs_puts(pb, "cpu");
+        procfs_putd(pb, ci->ci_id);
+        procfs_puts(pb, " ");
+        procfs_putd(pb, ci->ci_running);
+        procfs_puts(pb, " ");
+        procfs_putu(pb, LIST_SIZE(&ci->ci_runq));
+        procfs_puts(pb, " ");
+        procfs_putu(pb, ci->ci_switches);
+        procfs_puts(pb, " ");
+        procfs_putu(pb, ci->ci_steals);
+        procfs_puts(pb, " ");
+        procfs_putu(pb, ci->ci_migrations);
+        procfs_puts(pb, "\n");
+    }
+
+    procfs_puts(pb, "ctxt ");
+    procfs_putu(pb, switches);
+    procfs_puts(pb, "\nprocesses ");
+    procfs_putu(pb, LIST_SIZE(&process_list));
+    procfs_puts(pb, "\n");
+}
+
+/*
+ * pid (name) state ppid pgid sid uid gid stime nthreads tty
+ *
+ * the name may contain anything, so it's parsed up to the last ')'
+ */
+static void
+procfs_gen_pid_stat(struct procfs_buf *pb, struct proc *proc)
+{
+    char state[2];
+    char *tty;
+
+    state[0] = procfs_proc_state(proc);
+    state[1] = 0;
+
+    tty = proc_getctty(proc);
+
+    procfs_putd(pb, proc->pid);
+    procfs_puts(pb, " (");
+    procfs_puts(pb, proc->name);
+    procfs_puts(pb, ") ");
+    procfs_puts(pb, state);
+    procfs_puts(pb, " ");
+    procfs_putd(pb, proc->parent ? proc->parent->pid : 0);
+    procfs_puts(pb, " ");
+    procfs_putd(pb, PROC_PGID(proc));
+    procfs_puts(pb, " ");
+    procfs_putd(pb, PROC_SID(proc));
+    procfs_puts(pb, " ");
+    procfs_putd(pb, proc->creds.uid);
+    procfs_puts(pb, " ");
+    procfs_putd(pb, proc->creds.gid);
+    procfs_puts(pb, " ");
+    procfs_putu(pb, proc->start_time + time_delta.tv_sec);
+    procfs_puts(pb, " ");
+    procfs_putu(pb, LIST_SIZE(&proc->threads));
+    procfs_puts(pb, " ");
+    procfs_puts(pb, tty ? tty : "-");
+    procfs_puts(pb, "\n");
+}
+
+static void
+procfs_gen_pid_status(struct procfs_buf *pb, struct proc *proc)
+{
+    char state[2];
+
+    state[0] = procfs_proc_state(proc);
+    state[1] = 0;
+
+    procfs_puts(pb, "Name:\t");
+    procfs_puts(pb, proc->name);
+    procfs_puts(pb, "\nState:\t");
+    procfs_puts(pb, state);
+    procfs_puts(pb, "\n");
+    procfs_putfield(pb, "Pid", proc->pid, "");
+    procfs_putfield(pb, "PPid", proc->parent ? proc->parent->pid : 0, "");
+    procfs_putfield(pb, "Uid", proc->creds.uid, "");
+    procfs_putfield(pb, "Euid", proc->creds.euid, "");
+    procfs_putfield(pb, "Gid", proc->creds.gid, "");
+    procfs_putfield(pb, "Egid", proc->creds.egid, "");
+    procfs_putfield(pb, "Threads", LIST_SIZE(&proc->threads), "");
+    procfs_puts(pb, "Umask:\t0");
+    procfs_puto(pb, proc->umask);
+    procfs_puts(pb, "\n");
+    procfs_putfield(pb, "Brk", proc->brk, "");
+    procfs_putfield(pb, "Traced", proc->traced, "");
+}
+
+static void
+procfs_put_map(struct procfs_buf *pb, uintptr_t start, uintptr_t end, int prot)
+{
+    procfs_putx(pb, start);
+    procfs_puts(pb, "-");
+    procfs_putx(pb, end);
+    procfs_puts(pb, (prot & VM_READ) ? " r" : " -");
+    procfs_puts(pb, (prot & VM_WRITE) ? "w" : "-");
+    procfs_puts(pb, (prot & VM_EXEC) ? "x\n" : "-\n");
+}
+
+/* "start-end rwx" for every run of adjacent user mappings with the same protection */
+static int
+procfs_gen_pid_maps(struct procfs_buf *pb, struct proc *proc)
+{
+    int prot;
+    list_iter_t iter;
+    uintptr_t start;
+    uintptr_t end;
+    struct vm_block *block;
+
+    if (proc->exited || !proc->thread || !proc->thread->address_space) {
+        return 0;
+    }
+
+    start = 0;
+    end = 0;
+    prot = 0;
+
+    list_get_iter(&proc->thread->address_space->map, &iter);
+
+    while (iter_move_next(&iter, (void**)&block) && !procfs_full(pb)) {
+        if (VM_IS_KERN(block->prot)) {
+            continue;
+        }
+
+        if (end == block->start_virtual && prot == block->prot) {
+            end += block->size;
+            continue;
+        }
+
+        if (end) {
+            procfs_put_map(pb, start, end, prot);
+        }
+
+        start = block->start_virtual;
+        end = start + block->size;
+        prot = block->prot;
+    }
+
+    iter_close(&iter);
+
+    if (end) {
+        procfs_put_map(pb, start, end, prot);
+    }
+
+    return 0;
+}
+
+/* mode dev path */
+static int
+procfs_gen_pid_fd(struct procfs_buf *pb, struct proc *proc, int fd)
+{
+    char path[PATH_MAX];
+    struct file *fp;
+    struct stat sb;
+    struct vnode *vn;
+
+    fp = proc->files[fd];
+
+    if (!fp) {
+        return -(EBADF);
+    }
+
+    memset(&sb, 0, sizeof(sb));
+    FOP_STAT(fp, &sb);
+
+    path[0] = 0;
+
+    if (FOP_GETVN(fp, &vn) == 0) {
+        vn_resolve_name(vn, path, sizeof(path));
+    }
+
+    procfs_puto(pb, sb.st_mode);
+    procfs_puts(pb, " ");
+    procfs_putd(pb, sb.st_dev);
+    procfs_puts(pb, " ");
+    procfs_puts(pb, path);
+    procfs_puts(pb, "\n");
+
+    return 0;
+}
+
+static int
+procfs_destroy(struct vnode *node)
+{
+    free(node->state);
+
+    return 0;
+}
+
+static int
+procfs_lookup(struct vnode *parent, struct vnode **result, const char *name)
+{
+    int i;
+    int num;
+    struct proc *proc;
+    struct procfs_node *pn;
+    struct vnode *node;
+
+    pn = parent->state;
+    node = NULL;
+    proc = NULL;
+
+    switch (pn->type) {
+        case PROCFS_ROOT:
+            for (i = 0; i < PROCFS_NROOT; i++) {
+                if (strcmp(name, procfs_root_entries[i].name) == 0) {
+                    node = procfs_node_new(parent, procfs_root_entries[i].type, 0, 0);
+                    break;
+                }
+            }
+
+            num = procfs_parse_num(name);
+            proc = num > 0 ? proc_find(num) : NULL;
+
+            if (!node && proc && WORLD_CAN_SEE_PROC(current_proc->world, proc)) {
+                node = procfs_node_new(parent, PROCFS_PID, num, 0);
+            }
+            break;
+        case PROCFS_PID:
+            for (i = 0; i < PROCFS_NPID; i++) {
+                if (strcmp(name, procfs_pid_entries[i].name) == 0) {
+                    node = procfs_node_new(parent, procfs_pid_entries[i].type, pn->pid, 0);
+                    break;
+                }
+            }
+            break;
+        case PROCFS_PID_FD:
+            num = procfs_parse_num(name);
+            proc = procfs_proc(pn);
+
+            if (proc && num >= 0 && num < 4096 && proc->files[num]) {
+                node = procfs_node_new(parent, PROCFS_PID_FD_ENTRY, pn->pid, num);
+            }
+            break;
+        default:
+            return -(ENOTDIR);
+    }
+
+    if (!node) {
+        return -(ENOENT);
+    }
+
+    if (pn->type != PROCFS_ROOT) {
+        node->uid = parent->uid;
+        node->gid = parent->gid;
+    } else if (proc) {
+        node->uid = proc->creds.uid;
+        node->gid = proc->creds.gid;
+    }
+
+    *result = node;
+
+    return 0;
+}
+
+static int
+procfs_mount(struct vnode *parent, struct file *dev_fp, struct vnode **root)
+{
+    struct vnode *node;
+
+    node = procfs_node_new(parent, PROCFS_ROOT, 0, 0);
+
+    if (!node) {
+        return -(ENOMEM);
+    }
+
+    *root = node;
+
+    return 0;
+}
+
+static int
+procfs_read(struct vnode *node, void *buf, size_t nbyte, uint64_t pos)
+{
+    int res;
+    struct proc *proc;
+    struct procfs_buf pb;
+    struct procfs_node *pn;
+
+    pn = node->state;
+
+    pb.buf = buf;
+    pb.nbyte = nbyte;
+    pb.pos = pos;
+    pb.off = 0;
+    pb.copied = 0;
+
+    proc = NULL;
+    res = 0;
+
+    if (pn->type >= PROCFS_PID) {
+        proc = procfs_proc(pn);
+
+        if (!proc) {
+            return -(ESRCH);
+        }
+    }
+
+    switch (pn->type) {
+        case PROCFS_MEMINFO:
+            procfs_gen_meminfo(&pb);
+            break;
+        case PROCFS_INTERRUPTS:
+            res = procfs_gen_interrupts(&pb);
+            break;
+        case PROCFS_STAT:
+            procfs_gen_stat(&pb);
+            break;
+        case PROCFS_PID_STAT:
+            procfs_gen_pid_stat(&pb, proc);
+            break;
+        case PROCFS_PID_STATUS:
+            procfs_gen_pid_status(&pb, proc);
+            break;
+        case PROCFS_PID_MAPS:
+            res = procfs_gen_pid_maps(&pb, proc);
+            break;
+        case PROCFS_PID_FD_ENTRY:
+            res = procfs_gen_pid_fd(&pb, proc, pn->fd);
+            break;
+        default:
+            return -(EISDIR);
+    }
+
+    if (res != 0) {
+        return res;
+    }
+
+    return pb.copied;
+}
+
+/*
+ * lookups are cached by the VFS forever, so /proc would otherwise collect a
+ * node for every process ever looked at
+ */
+static void
+procfs_prune(struct vnode *dir)
+{
+    int i;
+    int nstale;
+    list_iter_t iter;
+    char *key;
+    char stale[PROCFS_PRUNE_MAX][16];
+    struct proc *proc;
+    struct procfs_node *pn;
+    struct vnode *child;
+
+    nstale = 0;
+
+    dict_get_keys(&dir->children, &iter);
+
+    while (iter_move_next(&iter, (void**)&key) && nstale < PROCFS_PRUNE_MAX) {
+        if (!dict_get(&dir->children, key, (void**)&child)) {
+            continue;
+        }
+
+        pn = child->state;
+
+        if (pn->type != PROCFS_PID && pn->type != PROCFS_PID_FD_ENTRY) {
+            continue;
+        }
+
+        proc = proc_find(pn->pid);
+
+        if (proc && (pn->type == PROCFS_PID || proc->files[pn->fd])) {
+            continue;
+        }
+
+        strncpy(stale[nstale++], key, sizeof(stale[0]) - 1);
+        stale[nstale - 1][sizeof(stale[0]) - 1] = 0;
+    }
+
+    iter_close(&iter);
+
+    for (i = 0; i < nstale; i++) {
+        if (dict_get(&dir->children, stale[i], (void**)&child)) {
+            dict_remove(&dir->children, stale[i]);
+            VN_DEC_REF(child);
+        }
+    }
+}
+
+static int
+procfs_readdirent_root(struct dirent *dirent, uint64_t entry)
+{
+    int i;
+    int res;
+    list_iter_t iter;
+    struct proc *proc;
+
+    if (entry < PROCFS_NROOT) {
+        strncpy(dirent->name, procfs_root_entries[entry].name, PATH_MAX);
+        dirent->type = DT_REG;
+        return 0;
+    }
+
+    entry -= PROCFS_NROOT;
+    res = -1;
+    i = 0;
+
+    list_get_iter(&process_list, &iter);
+
+    while (iter_move_next(&iter, (void**)&proc)) {
+        if (!WORLD_CAN_SEE_PROC(current_proc->world, proc)) {
+            continue;
+        }
+
+        if (i++ == entry) {
+            itoa(proc->pid, dirent->name, 10);
+            dirent->type = DT_DIR;
+            res = 0;
+            break;
+        }
+    }
+
+    iter_close(&iter);
+
+    return res;
+}
+
+/*
+ * the fd table is mostly empty, so a sequential listing picks up where the
+ * previous entry was found instead of counting open files from 0 each time
+ */
+static int
+procfs_readdirent_fd(struct procfs_node *pn, struct dirent *dirent, uint64_t entry)
+{
+    int fd;
+    uint64_t i;
+    struct proc *proc;
+
+    proc = procfs_proc(pn);
+
+    if (!proc) {
+        return -(ESRCH);
+    }
+
+    if (pn->dir_fd >= 0 && entry == pn->dir_entry + 1) {
+        i = entry;
+        fd = pn->dir_fd + 1;
+    } else {
+        i = 0;
+        fd = 0;
+    }
+
+    for (; fd < 4096; fd++) {
+        if (!proc->files[fd]) {
+            continue;
+        }
+
+        if (i++ == entry) {
+            pn->dir_entry = entry;
+            pn->dir_fd = fd;
+
+            itoa(fd, dirent->name, 10);
+            dirent->type = DT_REG;
+
+            return 0;
+        }
+    }
+
+    return -1;
+}
+
+static int
+procfs_readdirent(struct vnode *node, struct dirent *dirent, uint64_t entry)
+{
+    struct procfs_node *pn;
+
+    pn = node->state;
+
+    switch (pn->type) {
+        case PROCFS_ROOT:
+            if (entry == 0) {
+                procfs_prune(node);
+            }
+            return procfs_readdirent_root(dirent, entry);
+        case PROCFS_PID:
+            if (entry >= PROCFS_NPID || !procfs_proc(pn)) {
+                return -1;
+            }
+
+            strncpy(dirent->name, procfs_pid_entries[entry].name, PATH_MAX);
+            dirent->type = procfs_pid_entries[entry].type == PROCFS_PID_FD ? DT_DIR : DT_REG;
+            return 0;
+        case PROCFS_PID_FD:
+            if (entry == 0) {
+                procfs_prune(node);
+            }
+            return procfs_readdirent_fd(pn, dirent, entry);
+        default:
+            return -(ENOTDIR);
+    }
+}
+
+static int
+procfs_stat(struct vnode *node, struct stat *stat)
+{
+    memset(stat, 0, sizeof(struct stat));
+
+    stat->st_ino = node->inode;
+    stat->st_mode = node->mode;
+    stat->st_uid = node->uid;
+    stat->st_gid = node->gid;
+
+    return 0;
+}
+
+void
+procfs_init()
+{
+    fs_register("procfs", &procfs_ops);
+}
@@ -6,6 +6,9 @@ AFLAGS= -f elf32
 CFLAGS = -c -std=gnu99 --freestanding -g -Wall -Werror -nostartfiles -nodefaultlibs -DELYSIUM_TARGET="\"i686\""
 CFLAGS += -I "$(shell realpath ./i686/include)"
 
+# FPU state is switched lazily and only for userland; the kernel must not touch it
+CFLAGS += -mno-mmx -mno-sse -mno-sse2
+
 ifdef USE_BOOTLOADER_GRAPHICS
     AFLAGS += -DUSE_BOOTLOADER_GRAPHICS
     CFLAGS += -DUSE_BOOTLOADER_GRAPHICS
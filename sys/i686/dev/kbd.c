@@ -24,6 +24,7 @@
 #include <sys/interrupt.h>
 #include <sys/ioctl.h>
 #include <sys/proc.h>
+#include <sys/softirq.h>
 #include <sys/types.h>
 
 static int keyboard_attach(struct driver *, struct device *);
@@ -36,8 +37,28 @@ struct driver kbd_driver = {
     .probe      =   NULL
 };
 
+/* scancodes the IRQ handler read but the softirq hasn't passed on yet */
+#define KBD_RING_SIZE   64
+
 static struct fifo *keyboard_buf;
 
+static uint8_t          keyboard_ring[KBD_RING_SIZE];
+static volatile int     keyboard_ring_head;
+static volatile int     keyboard_ring_tail;
+
+static void
+keyboard_softirq()
+{
+    uint8_t scancode;
+
+    while (keyboard_ring_tail != keyboard_ring_head) {
+        scancode = keyboard_ring[keyboard_ring_tail % KBD_RING_SIZE];
+        keyboard_ring_tail++;
+
+        fifo_write(keyboard_buf, &scancode, 1);
+    }
+}
+
 static int
 keyboard_irq_handler(struct device *dev, int inum)
 {
@@ -47,7 +68,13 @@ keyboard_irq_handler(struct device *dev, int inum)
 
     scancode = io_read8(0x60);
 
-    fifo_write(keyboard_buf, &scancode, 1);
+    /* drop it rather than overwrite one that wasn't delivered yet */
+    if (keyboard_ring_head - keyboard_ring_tail < KBD_RING_SIZE) {
+        keyboard_ring[keyboard_ring_head % KBD_RING_SIZE] = scancode;
+        keyboard_ring_head++;
+    }
+
+    softirq_raise(SOFTIRQ_TTY);
 
     return 0;
 }
@@ -71,6 +98,7 @@ keyboard_attach(struct driver *driver, struct device *dev)
     };
 
     keyboard_buf = fifo_new(4096);
+    softirq_register(SOFTIRQ_TTY, keyboard_softirq);
     irq_register(dev, 1, keyboard_irq_handler);
 
     cdev = cdev_new("kbd", 0666, DEV_MAJOR_KBD, 0, &kbd_ops, NULL);
@@ -88,10 +116,10 @@ keyboard_ioctl(struct cdev *dev, uint64_t request, uintptr_t argp)
     switch (request) {
         case FIONREAD:
             *((uint32_t*)argp) = FIFO_SIZE(keyboard_buf);
-            return -1;
+            return 0;
     }
 
-    return -1;
+    return -(ENOTSUP);
 }
 
 static int
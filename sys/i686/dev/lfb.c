@@ -72,6 +72,8 @@ static int default_color_palette[] = {
   0x102015
 };
 
+LOCK_CLASS(lfb_lock_class, "lfb");
+
 static int lfb_attach(struct driver *, struct device *);
 static int lfb_ioctl(struct cdev *, uint64_t, uintptr_t);
 static int lfb_mmap(struct cdev *, uintptr_t, size_t, int, off_t);
@@ -252,6 +254,9 @@ lfb_attach(struct driver *driver, struct device *dev)
         .write  = lfb_write
     };
 
+    spinlock_set_class(&state.lock, &lfb_lock_class);
+    lock_class_register(&lfb_lock_class);
+
     state.vbe = (vbe_info_t*)(0xC0000000 + multiboot_header->vbe_mode_info);
     state.pitch = state.vbe->pitch;
     state.depth = state.vbe->pitch / state.vbe->Xres;
@@ -295,7 +300,8 @@ lfb_ioctl(struct cdev *dev, uint64_t request, uintptr_t argp)
     switch (request) {
     case TXIOCLRSCR:
         state->position = 0;
-        memset(state->foreground, 0xFF, state->buffer_size);
+        fast_memset(state->foreground, state->background_color, state->buffer_size);
+        fast_memset(state->framebuffer, state->background_color, state->buffer_size);
         break;
     case TXIODEFBG:
         state->background_color = default_color_palette[0x10];
@@ -347,7 +353,6 @@ lfb_mmap(struct cdev *dev, uintptr_t addr, size_t size, int prot, off_t offset)
 {
     /* defined in sys/i686/kern/preinit.c */
     extern multiboot_info_t *multiboot_header;
-    extern struct vm_space *sched_curr_address_space;
 
     void *buf;
     vbe_info_t *info;
@@ -19,10 +19,13 @@
 #include <sys/cdev.h>
 #include <sys/device.h>
 #include <sys/devno.h>
+#include <sys/errno.h>
 #include <sys/interrupt.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
 
 static int mouse_attach(struct driver *driver, struct device *dev);
+static int mouse_ioctl(struct cdev *dev, uint64_t request, uintptr_t argp);
 static int mouse_read(struct cdev *dev, char *buf, size_t nbyte, uint64_t pos);
 
 struct driver mouse_driver = {
@@ -138,7 +141,7 @@ mouse_attach(struct driver *driver, struct device *dev)
     mouse_ops = (struct cdev_ops) {
         .close  = NULL,
         .init   = NULL,
-        .ioctl  = NULL,
+        .ioctl  = mouse_ioctl,
         .isatty = NULL,
         .mmap   = NULL,
         .open   = NULL,
@@ -148,8 +151,6 @@ mouse_attach(struct driver *driver, struct device *dev)
 
     cdev = cdev_new("mouse", 0666, DEV_MAJOR_MOUSE, 0, &mouse_ops, NULL);
 
-    irq_register(dev, 12, mouse_irq_handler);
-
     if (cdev && cdev_register(cdev) == 0) {
         return 0;
     }
@@ -157,6 +158,18 @@ mouse_attach(struct driver *driver, struct device *dev)
     return -1;
 }
 
+static int
+mouse_ioctl(struct cdev *dev, uint64_t request, uintptr_t argp)
+{
+    switch (request) {
+        case FIONREAD:
+            *((uint32_t*)argp) = mouse_packet_ready ? 3 : 0;
+            return 0;
+    }
+
+    return -(ENOTSUP);
+}
+
 static int
 mouse_read(struct cdev *dev, char *buf, size_t nbyte, uint64_t pos)
 {
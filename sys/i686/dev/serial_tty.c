@@ -19,6 +19,9 @@
 #include <sys/cdev.h>
 #include <sys/device.h>
 #include <sys/devno.h>
+#include <sys/errno.h>
+#include <sys/ioctl.h>
+#include <sys/tty.h>
 #include <sys/types.h>
 
 #define PORT0   0x3F8
@@ -27,7 +30,8 @@
 #define PORT3   0x2E8
 
 struct serial_state {
-    int     port;
+    int         port;
+    struct tty  tty;
 };
 
 static int serial_attach(struct driver *driver, struct device *dev);
@@ -35,23 +39,39 @@ static int serial_close(struct cdev *dev);
 static int serial_ioctl(struct cdev *dev, uint64_t request, uintptr_t argp);
 static int serial_isatty(struct cdev *dev);
 static int serial_open(struct cdev *dev);
+static int serial_output(struct tty *tty, const struct iovec *iov, int iovcnt, int flags);
+static void serial_poll(struct tty *tty);
 static int serial_read(struct cdev *dev, char *buf, size_t nbyte, uint64_t pos);
+static int serial_readv(struct cdev *dev, const struct iovec *iov, int iovcnt, uint64_t pos);
 static int serial_write(struct cdev *dev, const char *buf, size_t nbyte, uint64_t pos);
+static int serial_writev(struct cdev *dev, const struct iovec *iov, int iovcnt, uint64_t pos);
 
 struct serial_state serial0_state = {
-    .port   =   PORT0
+    .port       =   PORT0,
+    .tty.output =   serial_output,
+    .tty.poll   =   serial_poll,
+    .tty.state  =   &serial0_state
 };
 
 struct serial_state serial1_state = {
-    .port   =   PORT1
+    .port       =   PORT1,
+    .tty.output =   serial_output,
+    .tty.poll   =   serial_poll,
+    .tty.state  =   &serial1_state
 };
 
 struct serial_state serial2_state = {
-    .port   =   PORT2
+    .port       =   PORT2,
+    .tty.output =   serial_output,
+    .tty.poll   =   serial_poll,
+    .tty.state  =   &serial2_state
 };
 
 struct serial_state serial3_state = {
-    .port   =   PORT3
+    .port       =   PORT3,
+    .tty.output =   serial_output,
+    .tty.poll   =   serial_poll,
+    .tty.state  =   &serial3_state
 };
 
 
@@ -68,7 +88,9 @@ struct cdev_ops serial_cdevops = {
     .isatty     =   serial_isatty,
     .open       =   serial_open,
     .read       =   serial_read,
-    .write      =   serial_write
+    .readv      =   serial_readv,
+    .write      =   serial_write,
+    .writev     =   serial_writev
 };
 */
 
@@ -83,7 +105,9 @@ struct cdev serial0_device = {
     .ops.isatty =   serial_isatty,
     .ops.open   =   serial_open,
     .ops.read   =   serial_read,
+    .ops.readv  =   serial_readv,
     .ops.write  =   serial_write,
+    .ops.writev =   serial_writev,
     .state      =   &serial0_state
 };
 
@@ -98,7 +122,9 @@ struct cdev serial1_device = {
     .ops.isatty =   serial_isatty,
     .ops.open   =   serial_open,
     .ops.read   =   serial_read,
+    .ops.readv  =   serial_readv,
     .ops.write  =   serial_write,
+    .ops.writev =   serial_writev,
     .state      =   &serial1_state
 };
 
@@ -113,7 +139,9 @@ struct cdev serial2_device = {
     .ops.isatty =   serial_isatty,
     .ops.open   =   serial_open,
     .ops.read   =   serial_read,
+    .ops.readv  =   serial_readv,
     .ops.write  =   serial_write,
+    .ops.writev =   serial_writev,
     .state      =   &serial2_state
 };
 
@@ -128,7 +156,9 @@ struct cdev serial3_device = {
     .ops.isatty =   serial_isatty,
     .ops.open   =   serial_open,
     .ops.read   =   serial_read,
+    .ops.readv  =   serial_readv,
     .ops.write  =   serial_write,
+    .ops.writev =   serial_writev,
     .state      =   &serial3_state
 };
 
@@ -149,28 +179,6 @@ echo_char(struct serial_state *state, char ch)
     io_write8(port, ch);
 }
 
-static char
-read_char(struct serial_state *state)
-{
-    char ch;
-    int port;
-    
-    port = state->port;
-
-    while ((io_read8(port + 5) & 0x1) == 0);
-
-    ch = io_read8(port);
-    
-    switch (ch) {
-        case 0x0D:
-            return '\n';
-        case 0x7F:
-            return 0x08;
-        default:
-            return ch;
-    }
-}
-
 static int
 serial_close(struct cdev *dev)
 {
@@ -193,6 +201,15 @@ serial_init_device(struct cdev *cdev)
     io_write8(port + 3, 0x03);
     io_write8(port + 2, 0xC7);
     io_write8(port + 4, 0x0B);
+
+    /*
+     * the kernel console is written to before the device is attached, so
+     * output processing stays off to keep its output byte-for-byte
+     */
+    tty_init(&state->tty, serial_output, serial_poll, state);
+
+    state->tty.termios.c_oflag = 0;
+    state->tty.cdev = cdev;
     
     cdev_register(cdev);
 }
@@ -211,7 +228,11 @@ serial_attach(struct driver *driver, struct device *dev)
 static int
 serial_ioctl(struct cdev *dev, uint64_t request, uintptr_t argp)
 {
-    return 0;
+    struct serial_state *state;
+
+    state = dev->state;
+
+    return tty_ioctl(&state->tty, request, argp);
 }
 
 static int
@@ -226,42 +247,86 @@ serial_open(struct cdev *dev)
     return 0;
 }
 
+/* transmits processed output; the UART is always written synchronously */
 static int
-serial_read(struct cdev *dev, char *buf, size_t nbyte, uint64_t pos)
+serial_output(struct tty *tty, const struct iovec *iov, int iovcnt, int flags)
 {
-    char ch;
     int i;
-
+    int total;
+    size_t j;
+    const char *buf;
     struct serial_state *state;
-    
-    state = dev->state;
 
-    for (i = 0; i < nbyte; i++) {
-        ch = read_char(state);
+    state = tty->state;
 
-        echo_char(state, ch);
+    for (i = 0, total = 0; i < iovcnt; i++) {
+        buf = iov[i].iov_base;
 
-        buf[i] = ch;
-        
-        if (ch == '\n') {
-            return i + 1;
+        for (j = 0; j < iov[i].iov_len; j++) {
+            echo_char(state, buf[j]);
         }
+
+        total += iov[i].iov_len;
     }
 
-    return nbyte;
+    return total;
+}
+
+/* the UART is not interrupt driven; drain its receive buffer into the tty */
+static void
+serial_poll(struct tty *tty)
+{
+    int port;
+    char ch;
+    struct serial_state *state;
+
+    state = tty->state;
+    port = state->port;
+
+    while ((io_read8(port + 5) & 0x1) && TTY_INQ_SPACE(tty) > 0) {
+        ch = io_read8(port);
+        tty_input(tty, &ch, 1);
+    }
 }
 
 static int
-serial_write(struct cdev *dev, const char *buf, size_t nbyte, uint64_t pos)
+serial_read(struct cdev *dev, char *buf, size_t nbyte, uint64_t pos)
+{
+    struct iovec iov;
+
+    iov.iov_base = buf;
+    iov.iov_len = nbyte;
+
+    return serial_readv(dev, &iov, 1, pos);
+}
+
+static int
+serial_readv(struct cdev *dev, const struct iovec *iov, int iovcnt, uint64_t pos)
 {
-    int i;
     struct serial_state *state;
     
     state = dev->state;
 
-    for (i = 0; i < nbyte; i++) {
-        echo_char(state, buf[i]);
-    }
+    return tty_read(&state->tty, iov, iovcnt);
+}
+
+static int
+serial_write(struct cdev *dev, const char *buf, size_t nbyte, uint64_t pos)
+{
+    struct iovec iov;
+
+    iov.iov_base = (void*)buf;
+    iov.iov_len = nbyte;
+
+    return serial_writev(dev, &iov, 1, pos);
+}
+
+static int
+serial_writev(struct cdev *dev, const struct iovec *iov, int iovcnt, uint64_t pos)
+{
+    struct serial_state *state;
+    
+    state = dev->state;
 
-    return nbyte;
+    return tty_write(&state->tty, iov, iovcnt);
 }
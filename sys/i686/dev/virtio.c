@@ -22,6 +22,7 @@
 #include <sys/device.h>
 #include <sys/interrupt.h>
 #include <sys/malloc.h>
+#include <sys/softirq.h>
 #include <sys/string.h>
 #include <sys/systm.h>
 #include <sys/types.h>
@@ -29,6 +30,8 @@
 
 #define ALIGN(x) (((x) + 4096) & 0xFFFFF000) 
 
+static struct virtio_dev *virtio_devices;
+
 static inline unsigned virtq_size(unsigned int qsz) 
 { 
      return ALIGN(sizeof(struct virtq_desc)*qsz + sizeof(uint16_t)*(3 + qsz)) 
@@ -54,6 +57,7 @@ virtq_init(struct virtio_dev *vdev, uint16_t addr, int nelems)
     vdev->queues[addr].available = (struct virtq_avail*)&buf[bufsize];
     vdev->queues[addr].used = (struct virtq_used*)(&buf[(bufsize + avail_size + 0xFFF) &~0xFFF]);
     vdev->queues[addr].size = nelems;
+    vdev->queues[addr].completed = calloc(1, nelems);
 
     memset(buf, 0, total_size);
 
@@ -66,6 +70,22 @@ virtq_init(struct virtio_dev *vdev, uint16_t addr, int nelems)
 }
 
 
+/* marks the chains the device is done with as completed */
+static void
+virtq_reap(struct virtq *queue)
+{
+    uint16_t used_idx;
+    struct virtq_used_elem *elem;
+
+    used_idx = *(volatile uint16_t*)&queue->used->index;
+
+    while (queue->last_used != used_idx) {
+        elem = &queue->used->rings[queue->last_used % queue->size];
+        queue->completed[elem->index % queue->size] = 1;
+        queue->last_used++;
+    }
+}
+
 int
 virtq_send(struct device *dev, int queue_idx, struct virtq_buffer *buffers, int nbuffers)
 {
@@ -74,6 +94,7 @@ virtq_send(struct device *dev, int queue_idx, struct virtq_buffer *buffers, int
     int buffer_idx;
     int i;
     int start_idx;
+    int enabled;
 
     struct virtio_dev *vdev;
     struct virtq *queue;
@@ -102,25 +123,45 @@ virtq_send(struct device *dev, int queue_idx, struct virtq_buffer *buffers, int
         queue->buffer_idx++;
     }
 
+    queue->completed[start_idx] = 0;
     queue->available->index++;
 
     io_write8(vdev->iobase + 0x10, 0);
 
-    acknowledged = false;    
+    /*
+     * normally the block softirq reaps the completion, but callers may have
+     * interrupts disabled, so it's looked for here too
+     */
+    acknowledged = false;
 
     while (!acknowledged) {
-        for (i = 0; i < queue->size; i++) {
-            if (queue->used->rings[i].length != 0 && queue->used->rings[i].index == start_idx) {
-                queue->used->rings[i].length = 0;
-                acknowledged = true;
-                break;
-            }
-        }
+        enabled = intr_save();
+
+        virtq_reap(queue);
+        acknowledged = queue->completed[start_idx];
+
+        intr_restore(enabled);
     }
 
     return 0;
 }
 
+static void
+virtio_softirq()
+{
+    int i;
+    struct virtio_dev *vdev;
+
+    for (vdev = virtio_devices; vdev; vdev = vdev->next) {
+        for (i = 0; i < 16; i++) {
+            if (vdev->queues[i].size > 0) {
+                virtq_reap(&vdev->queues[i]);
+            }
+        }
+    }
+}
+
+/* reading the ISR status acknowledges the interrupt; the rest waits for the softirq */
 static int
 virtio_irq_handler(struct device *dev, int inum)
 {
@@ -130,9 +171,58 @@ virtio_irq_handler(struct device *dev, int inum)
 
     io_read8(vdev->iobase+0x13);
 
+    softirq_raise(SOFTIRQ_BLOCK);
+
+    return 0;
+}
+
+/* the queue has an MSI-X vector to itself, so there's no status to read */
+static int
+virtio_msix_handler(struct device *dev, int inum)
+{
+    softirq_raise(SOFTIRQ_BLOCK);
+
     return 0;
 }
 
+/*
+ * gives the queue its own message signalled vector so it doesn't share a
+ * line with other devices. Configuration changes aren't interesting, so they
+ * get no vector at all
+ */
+static bool
+virtio_setup_msix(struct device *dev, struct virtio_dev *vdev, uint16_t queue)
+{
+    int vector;
+
+    vector = intr_alloc_vector();
+
+    if (vector < 0) {
+        return false;
+    }
+
+    if (pci_enable_msix(dev, 1, &vector) != 0) {
+        intr_release_vector(vector);
+        return false;
+    }
+
+    io_write16(vdev->iobase+0x14, VIRTIO_MSI_NO_VECTOR);
+    io_write16(vdev->iobase+0x0E, queue);
+
+    /* MSI-X table entry 0 */
+    io_write16(vdev->iobase+0x16, 0);
+
+    if (io_read16(vdev->iobase+0x16) == VIRTIO_MSI_NO_VECTOR) {
+        pci_disable_msix(dev);
+        intr_release_vector(vector);
+        return false;
+    }
+
+    intr_register(dev, vector, virtio_msix_handler);
+
+    return true;
+}
+
 int
 virtio_attach(struct device *dev)
 {
@@ -145,6 +235,7 @@ virtio_attach(struct device *dev)
     
     vdev = calloc(1, sizeof(struct virtio_dev));
     vdev->iobase = PCI_IO_BASE(pci_get_config32(dev, PCI_CONFIG_BAR0));
+    vdev->config_base = VIRTIO_CONFIG_LEGACY;
 
     io_write8(vdev->iobase+0x12, 0);
     io_write8(vdev->iobase+0x12, VIRTIO_ACKNOWLEDGE);
@@ -181,11 +272,20 @@ virtio_attach(struct device *dev)
         addr++;
     } while (size != 0);
 
-    irq = pci_get_config8(dev, PCI_CONFIG_IRQLINE);
-
     dev->state = vdev;
 
-    irq_register(dev, irq, virtio_irq_handler);
+    vdev->next = virtio_devices;
+    virtio_devices = vdev;
+
+    softirq_register(SOFTIRQ_BLOCK, virtio_softirq);
+
+    if (size > 0 && virtio_setup_msix(dev, vdev, addr)) {
+        vdev->config_base = VIRTIO_CONFIG_MSIX;
+    } else {
+        irq = pci_get_config8(dev, PCI_CONFIG_IRQLINE);
+        irq_register(dev, irq, virtio_irq_handler);
+    }
+
     io_write8(vdev->iobase+0x12, VIRTIO_DRIVER_OK | VIRTIO_FEATURES_OK | VIRTIO_DRIVER | VIRTIO_ACKNOWLEDGE);
 
     return 0;
@@ -29,6 +29,11 @@ extern "C" {
 #define VIRTIO_FEATURES_OK      8
 #define VIRTIO_DRIVER_OK        4
 
+/* device specific registers start here, or further along once MSI-X is on */
+#define VIRTIO_CONFIG_LEGACY    0x14
+#define VIRTIO_CONFIG_MSIX      0x18
+#define VIRTIO_MSI_NO_VECTOR    0xFFFF
+
 #define VIRTIO_BLK_F_SIZE_MAX   (1<<1)
 #define VIRTIO_BLK_F_SEG_MAX    (1<<2)
 #define VIRTIO_BLK_F_GEOMETRY   (1<<4)
@@ -70,11 +75,15 @@ struct virtq {
     struct virtq_used   *   used;
     int                     buffer_idx;
     int                     size;
+    uint16_t                last_used;  /* used ring entries already reaped */
+    volatile uint8_t    *   completed;  /* indexed by the head descriptor of a chain */
 };
 
 struct virtio_dev {
-    uint32_t        iobase;
-    struct virtq    queues[16];
+    uint32_t            iobase;
+    uint32_t            config_base;    /* offset of the device specific registers */
+    struct virtq        queues[16];
+    struct virtio_dev * next;       /* all devices, for the block softirq */
 };
 
 struct virtq_buffer {
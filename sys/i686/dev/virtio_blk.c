@@ -27,6 +27,7 @@
 #include <sys/malloc.h>
 #include <sys/string.h>
 #include <sys/systm.h>
+#include <sys/trace.h>
 #include <sys/types.h>
 #include "virtio.h"
 
@@ -89,11 +90,15 @@ vblk_write_sector(struct device *dev, uint64_t sector, void *data)
         }
     };
 
+    TRACE(TRACE_BLOCK_SUBMIT, sector, 1, 0);
+
     virtq_send(dev, 0, buffers, 3);
 
     status_p = &status;
     while (*status_p == 0xFF);
 
+    TRACE(TRACE_BLOCK_COMPLETE, sector, 1, status);
+
     if (status != 0) {
         printf("virtio_blk: write_sector() error: sector=%d status=%d\n\r", sector, status);
         return -1;
@@ -137,12 +142,16 @@ vblk_read_sector(struct device *dev, uint64_t sector, void *data)
         }
     };
 
+    TRACE(TRACE_BLOCK_SUBMIT, sector, 0, 0);
+
     virtq_send(dev, 0, buffers, 3);
 
     status_p = &status;
 
     while (*status_p == 0xFF);
 
+    TRACE(TRACE_BLOCK_COMPLETE, sector, 0, status);
+
     if (status != 0) {
         panic("virtio_blk: read_sector() error: sector=%x status=%d\n\r", sector, status);
         return -1;
@@ -155,9 +164,11 @@ vblk_ioctl(struct cdev *cdev, uint64_t request, uintptr_t argp)
 {
     uint64_t total_size;
     struct device *dev;
+    struct virtio_dev *vdev;
     
     dev = cdev->state;
-    total_size = (uint64_t)virtio_read32(dev, 0x14)*512;
+    vdev = dev->state;
+    total_size = (uint64_t)virtio_read32(dev, vdev->config_base)*512;
 
     switch (request) {
         case BLKGETSIZE:
@@ -0,0 +1,116 @@
+/*
+ * cpu.h - machine dependent per-CPU state
+ *
+ * Every CPU has its own GDT, and in it a segment whose base is that CPU's
+ * struct cpu. The kernel keeps the selector of that segment in FS, so
+ * curcpu() is a single load, and since the selector is the same on every
+ * CPU a thread's saved FS stays valid when it migrates
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _MACHINE_CPU_H
+#define _MACHINE_CPU_H
+
+#include <sys/types.h>
+
+/* null, kernel code, kernel data, user code, user data, TSS, per-CPU */
+#define GDT_ENTRIES     7
+#define GDT_PERCPU_SEL  0x30
+
+struct gdt_entry {
+    uint16_t    limit_low;
+    uint16_t    base_low;
+    uint8_t     base_middle;
+    uint8_t     access;
+    uint8_t     granularity;
+    uint8_t     base_high;
+} __attribute__((packed));
+
+struct tss_entry {
+    uint32_t    prev_tss;
+    uint32_t    esp0;
+    uint32_t    ss0;
+    uint32_t    esp1;
+    uint32_t    ss1;
+    uint32_t    esp2;
+    uint32_t    ss2;
+    uint32_t    cr3;
+    uint32_t    eip;
+    uint32_t    eflags;
+    uint32_t    eax;
+    uint32_t    ecx;
+    uint32_t    edx;
+    uint32_t    ebx;
+    uint32_t    esp;
+    uint32_t    ebp;
+    uint32_t    esi;
+    uint32_t    edi;
+    uint32_t    es;
+    uint32_t    cs;
+    uint32_t    ss;
+    uint32_t    ds;
+    uint32_t    fs;
+    uint32_t    gs;
+    uint32_t    ldt;
+    uint16_t    trap;
+    uint16_t    iomap_base;
+} __attribute__((packed));
+
+struct cpu_md {
+    uint8_t             cm_apic_id;
+    struct gdt_entry    cm_gdt[GDT_ENTRIES];
+    struct tss_entry    cm_tss;
+};
+
+struct cpu;
+
+static inline struct cpu *
+curcpu()
+{
+    struct cpu *ci;
+
+    /* volatile; a thread may have moved to another CPU since the last call */
+    asm volatile("movl %%fs:0, %0" : "=r"(ci));
+
+    return ci;
+}
+
+/*
+ * reads or writes a 32-bit field of the current CPU's struct cpu in one
+ * instruction, so it can't be torn by the thread migrating half way through
+ */
+#define CPU_LOAD(field) ({ \
+    __typeof__(((struct cpu*)0)->field) __val; \
+    asm volatile("movl %%fs:%c1, %0" \
+                 : "=r"(__val) \
+                 : "i"(__builtin_offsetof(struct cpu, field))); \
+    __val; \
+})
+
+#define CPU_STORE(field, val) do { \
+    __typeof__(((struct cpu*)0)->field) __val = (val); \
+    asm volatile("movl %0, %%fs:%c1" \
+                 : \
+                 : "r"(__val), "i"(__builtin_offsetof(struct cpu, field)) \
+                 : "memory"); \
+} while (0)
+
+static inline void
+cpu_pause()
+{
+    asm volatile("pause" ::: "memory");
+}
+
+#endif
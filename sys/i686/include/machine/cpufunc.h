@@ -0,0 +1,119 @@
+/*
+ * cpufunc.h - wrappers for privileged and identification instructions
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _MACHINE_CPUFUNC_H
+#define _MACHINE_CPUFUNC_H
+
+#include <sys/types.h>
+
+/* CPUID leaf 1, EDX */
+#define CPUID_FPU           0x00000001
+#define CPUID_TSC           0x00000010
+#define CPUID_MSR           0x00000020
+#define CPUID_SEP           0x00000800
+#define CPUID_FXSR          0x01000000
+#define CPUID_SSE           0x02000000
+
+#define CPUID_STEPPING(eax) ((eax) & 0x0F)
+#define CPUID_MODEL(eax)    (((eax) >> 4) & 0x0F)
+#define CPUID_FAMILY(eax)   (((eax) >> 8) & 0x0F)
+
+#define MSR_SYSENTER_CS     0x174
+#define MSR_SYSENTER_ESP    0x175
+#define MSR_SYSENTER_EIP    0x176
+
+#define EFLAGS_IF           0x00000200
+
+static inline void
+cpuid(uint32_t leaf, uint32_t *eax, uint32_t *ebx, uint32_t *ecx, uint32_t *edx)
+{
+    asm volatile("cpuid"
+                 : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                 : "a"(leaf), "c"(0));
+}
+
+static inline uint64_t
+rdmsr(uint32_t msr)
+{
+    uint32_t lo;
+    uint32_t hi;
+
+    asm volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static inline void
+wrmsr(uint32_t msr, uint64_t val)
+{
+    asm volatile("wrmsr" : : "c"(msr), "a"((uint32_t)val), "d"((uint32_t)(val >> 32)));
+}
+
+static inline uint32_t
+read_cr0()
+{
+    uint32_t cr0;
+
+    asm volatile("mov %%cr0, %0" : "=r"(cr0));
+
+    return cr0;
+}
+
+static inline void
+write_cr0(uint32_t cr0)
+{
+    asm volatile("mov %0, %%cr0" : : "r"(cr0) : "memory");
+}
+
+static inline uint32_t
+read_cr4()
+{
+    uint32_t cr4;
+
+    asm volatile("mov %%cr4, %0" : "=r"(cr4));
+
+    return cr4;
+}
+
+static inline void
+write_cr4(uint32_t cr4)
+{
+    asm volatile("mov %0, %%cr4" : : "r"(cr4) : "memory");
+}
+
+static inline uint32_t
+read_eflags()
+{
+    uint32_t flags;
+
+    asm volatile("pushf ; pop %0" : "=rm"(flags) :: "memory");
+
+    return flags;
+}
+
+static inline uint64_t
+rdtsc()
+{
+    uint32_t lo;
+    uint32_t hi;
+
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+
+    return ((uint64_t)hi << 32) | lo;
+}
+
+#endif
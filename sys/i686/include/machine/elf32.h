@@ -111,7 +111,9 @@ enum SHT_TYPES {
 enum STT_TYPES {
     STT_NOTYPE              = 0,    // No type
     STT_OBJECT              = 1,    // Variables, arrays, etc.
-    STT_FUNC                = 2     // Methods or functions
+    STT_FUNC                = 2,    // Methods or functions
+    STT_SECTION             = 3,    // Sections
+    STT_FILE                = 4     // Source files
 };
 
 enum SHT_ATTRIBUTES {
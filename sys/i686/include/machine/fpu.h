@@ -0,0 +1,47 @@
+/*
+ * fpu.h - lazily switched x87/SSE state
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _MACHINE_FPU_H
+#define _MACHINE_FPU_H
+
+#include <sys/types.h>
+
+#define CR0_MP          0x00000002
+#define CR0_EM          0x00000004
+#define CR0_TS          0x00000008
+#define CR0_NE          0x00000020
+
+#define CR4_OSFXSR      0x00000200
+#define CR4_OSXMMEXCPT  0x00000400
+
+/* what FXSAVE writes; FNSAVE uses the first 108 bytes on older processors */
+struct fpu_state {
+    uint8_t     fs_area[512];
+} __attribute__((aligned(16)));
+
+struct cpu;
+struct thread;
+
+void    fpu_copy(struct thread *, struct thread *);
+void    fpu_enable();
+void    fpu_init();
+void    fpu_release(struct thread *);
+void    fpu_save(struct thread *);
+void    fpu_switch(struct cpu *, struct thread *);
+void    fpu_trap();
+
+#endif
@@ -3,6 +3,10 @@
 
 #define DEVICE_PCI  0x01    /* identifies that device is attached to PCI bus */
 
+/* vectors above the ISA IRQs left for message signalled interrupts */
+#define INTR_MSI_FIRST  48
+#define INTR_MSI_LAST   63
+
 extern int interrupts_enabled;
 
 static inline void
@@ -19,4 +23,25 @@ bus_interrupts_on()
     interrupts_enabled = 1;
 }
 
+void    irq_eoi(int);
+
+/* disables interrupts and returns whether they were enabled, for intr_restore() */
+static inline int
+intr_save()
+{
+    unsigned int eflags;
+
+    asm volatile("pushf ; pop %0 ; cli" : "=rm"(eflags) : : "memory");
+
+    return (eflags & 0x200) != 0;
+}
+
+static inline void
+intr_restore(int enabled)
+{
+    if (enabled) {
+        asm volatile("sti");
+    }
+}
+
 #endif
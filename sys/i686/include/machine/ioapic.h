@@ -0,0 +1,50 @@
+/*
+ * ioapic.h - I/O APIC interrupt routing
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _MACHINE_IOAPIC_H
+#define _MACHINE_IOAPIC_H
+
+#include <sys/types.h>
+
+#define MAXIOAPIC           4
+
+/* indirect register access through a select and a window register */
+#define IOAPIC_REGSEL       0x00
+#define IOAPIC_WINDOW       0x10
+
+#define IOAPIC_REG_VERSION  0x01
+#define IOAPIC_REG_REDTBL(n) (0x10 + 2 * (n))
+
+/* redirection table entry, low dword */
+#define IOAPIC_REDIR_ACTIVE_LOW 0x02000
+#define IOAPIC_REDIR_LEVEL      0x08000
+#define IOAPIC_REDIR_MASKED     0x10000
+
+/* MPS INTI flags of an interrupt source override */
+#define MPS_POLARITY_MASK   0x03
+#define MPS_POLARITY_LOW    0x03
+#define MPS_TRIGGER_MASK    0x0C
+#define MPS_TRIGGER_LEVEL   0x0C
+
+/* set once the ISA interrupts are routed through the I/O APIC instead of the PICs */
+extern bool ioapic_enabled;
+
+void    ioapic_add(uint8_t, uintptr_t, uint32_t);
+bool    ioapic_init(uint8_t);
+void    ioapic_override(uint8_t, uint32_t, uint16_t);
+
+#endif
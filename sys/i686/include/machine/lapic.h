@@ -0,0 +1,91 @@
+/*
+ * lapic.h - local APIC registers and interrupt vectors
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _MACHINE_LAPIC_H
+#define _MACHINE_LAPIC_H
+
+#include <sys/types.h>
+
+#define LAPIC_DEFAULT_BASE  0xFEE00000
+
+/* register offsets */
+#define LAPIC_ID            0x020
+#define LAPIC_VERSION       0x030
+#define LAPIC_TPR           0x080
+#define LAPIC_EOI           0x0B0
+#define LAPIC_SVR           0x0F0
+#define LAPIC_ESR           0x280
+#define LAPIC_ICR_LOW       0x300
+#define LAPIC_ICR_HIGH      0x310
+#define LAPIC_LVT_TIMER     0x320
+#define LAPIC_LVT_LINT0     0x350
+#define LAPIC_LVT_LINT1     0x360
+#define LAPIC_LVT_ERROR     0x370
+#define LAPIC_TIMER_INIT    0x380
+#define LAPIC_TIMER_COUNT   0x390
+#define LAPIC_TIMER_DIV     0x3E0
+
+#define LAPIC_SVR_ENABLE    0x100
+#define LAPIC_LVT_MASKED    0x10000
+#define LAPIC_TIMER_PERIODIC 0x20000
+#define LAPIC_TIMER_DIV_16  0x03
+
+/* interrupt command register */
+#define LAPIC_ICR_INIT      0x00500
+#define LAPIC_ICR_STARTUP   0x00600
+#define LAPIC_ICR_PENDING   0x01000
+#define LAPIC_ICR_ASSERT    0x04000
+#define LAPIC_ICR_LEVEL     0x08000
+
+/* vectors above the remapped PICs that are delivered through the local APIC */
+#define LAPIC_VEC_TIMER     0xF0
+#define LAPIC_VEC_RESCHED   0xF1
+#define LAPIC_VEC_TLB       0xF2
+#define LAPIC_VEC_SPURIOUS  0xFF
+
+/* mapped at the same address in every address space */
+extern uintptr_t lapic_base;
+
+static inline uint32_t
+lapic_read(uint32_t reg)
+{
+    return *(volatile uint32_t*)(lapic_base + reg);
+}
+
+static inline void
+lapic_write(uint32_t reg, uint32_t val)
+{
+    *(volatile uint32_t*)(lapic_base + reg) = val;
+}
+
+static inline void
+lapic_eoi()
+{
+    lapic_write(LAPIC_EOI, 0);
+}
+
+static inline uint8_t
+lapic_id()
+{
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+void    lapic_init(bool);
+void    lapic_ipi(uint8_t, uint32_t);
+void    lapic_timer_calibrate();
+
+#endif
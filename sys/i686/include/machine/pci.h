@@ -31,9 +31,29 @@ extern "C" {
 #define PCI_CONFIG_BAR3		0x1C
 #define PCI_CONFIG_BAR4		0x20
 #define PCI_CONFIG_BAR5		0x24
+#define PCI_CONFIG_STATUS   0x06
+#define PCI_CONFIG_CAPPTR   0x34
 #define PCI_CONFIG_IRQLINE  0x3C
 
+#define PCI_STATUS_CAPLIST  0x10
+
+/* capability IDs */
+#define PCI_CAP_MSI         0x05
+#define PCI_CAP_MSIX        0x11
+
+/* message control of the MSI capability */
+#define PCI_MSI_ENABLE      0x0001
+#define PCI_MSI_MME_MASK    0x0070
+#define PCI_MSI_64BIT       0x0080
+
+/* message control of the MSI-X capability */
+#define PCI_MSIX_TABLE_SIZE 0x07FF
+#define PCI_MSIX_MASK       0x4000
+#define PCI_MSIX_ENABLE     0x8000
+#define PCI_MSIX_BIR        0x7
+
 #define PCI_IO_BASE(bar)    ((bar) & 0xFFFFFFFC)
+#define PCI_MEM_BASE(bar)   ((bar) & 0xFFFFFFF0)
 
 int     pci_config_read(struct device *dev, int offset);
 int     pci_get_device_id(struct device *dev);
@@ -46,6 +66,14 @@ uint8_t     pci_get_config8(struct device *dev, int offset);
 uint16_t 	pci_get_config16(struct device *dev, int offset);
 uint32_t	pci_get_config32(struct device *dev, int offset);
 
+void    pci_set_config16(struct device *dev, int offset, uint16_t val);
+void    pci_set_config32(struct device *dev, int offset, uint32_t val);
+
+int     pci_find_capability(struct device *dev, int id);
+int     pci_enable_msi(struct device *dev, int vector);
+int     pci_enable_msix(struct device *dev, int nvec, int *vectors);
+void    pci_disable_msix(struct device *dev);
+
 void    pci_init();
 
 #endif /* __KERNEL__ */
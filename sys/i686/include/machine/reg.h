@@ -22,4 +22,23 @@ struct regs {
     uint32_t    ss;
 };
 
+/* what SWITCH_CONTEXT in context_switch.asm leaves on the stack */
+struct switch_regs {
+    uint32_t    gs;
+    uint32_t    fs;
+    uint32_t    es;
+    uint32_t    ds;
+    uint32_t    edi;
+    uint32_t    esi;
+    uint32_t    ebp;
+    uint32_t    esp;
+    uint32_t    ebx;
+    uint32_t    edx;
+    uint32_t    ecx;
+    uint32_t    eax;
+    uint32_t    eip;
+    uint32_t    cs;
+    uint32_t    eflags;
+};
+
 #endif
@@ -6,6 +6,12 @@
 #define KERNEL_VIRTUAL_BASE 0xC0000000
 #define PAGE_SIZE           0x1000
 
+/* physical memory below this is mapped at KERNEL_VIRTUAL_BASE */
+#define KERNEL_DIRECT_MAP_SIZE  0x1FC00000
+
+/* devices above this are identity mapped into every address space */
+#define VM_DEVICE_BASE      0xEA000000
+
 #define ALIGN_ADDRESS(addr) (((uintptr_t)(addr)) & 0xFFFFF000)
 #define PAGE_COUNT(amount) ((((amount) - 1) >> 12) + 1)
 #define PAGE_INDEX(addr) ((addr) >> 12)
@@ -17,4 +23,10 @@
 /* higher half virtual address to physical address */
 #define KVATOP(addr) (((uintptr_t)(addr)) - KERNEL_VIRTUAL_BASE)
 
+struct vm_space;
+
+void    vm_map_bootstrap(struct vm_space *, bool);
+int     vm_map_device(uintptr_t, size_t);
+void    vm_map_devices(struct vm_space *);
+
 #endif
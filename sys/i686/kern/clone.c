@@ -26,6 +26,7 @@
 #include <sys/string.h>
 #include <sys/systm.h>
 #include <sys/types.h>
+#include <sys/vdso.h>
 #include <sys/vnode.h>
 #include <sys/vm.h>
 
@@ -40,12 +41,6 @@ struct clone_state {
 static int
 init_child_proc(void *statep)
 {
-    /* defined in sys/i686/kern/sched.c */
-    extern struct thread *sched_curr_thread;
-
-    /* defined in sys/i686/kern/sched.c */
-    extern struct thread *sched_curr_thread;
-
     /* defined in sys/i686/kern/usermode.asm */
     extern void return_to_usermode(uintptr_t target, uintptr_t stack, uintptr_t bp, uintptr_t ret);
 
@@ -60,7 +55,7 @@ init_child_proc(void *statep)
     sched_curr_thread->u_stack_top = state->u_stack_top;
     sched_curr_thread->tid = proc_get_new_pid();
 
-    current_proc = state->proc;
+    CPU_STORE(ci_proc, state->proc);
 
     list_append(&current_proc->threads, sched_curr_thread);
 
@@ -82,8 +77,6 @@ init_child_proc(void *statep)
 int
 proc_clone(void *func, void *stack, int flags, void *arg)
 {
-    extern struct vm_space *sched_curr_address_space;
-
     struct clone_state *state;
 
     if (flags != (CLONE_VM | CLONE_FILES)) {
@@ -100,6 +93,9 @@ proc_clone(void *func, void *stack, int flags, void *arg)
     state->u_stack_top = (uintptr_t)stack;
     state->u_stack_bottom = (uintptr_t)stack - 65535;
 
+    /* userland can't tell threads sharing an address space apart */
+    vdso_setids(sched_curr_address_space, current_proc->pid, 0);
+
     thread_run(init_child_proc, sched_curr_address_space, (void*)state);
 
     thread_yield();
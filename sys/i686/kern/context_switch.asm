@@ -21,13 +21,28 @@
 ; with this program; if not, write to the Free Software Foundation, Inc.,
 ; 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
 
+; offsetof(struct cpu, ci_page_dir) in sys/sys/cpu.h
+%define CPU_PAGE_DIR    4
+
 ; defined in sys/i686/sched.c
-extern sched_curr_page_dir
 extern sched_get_next_proc
+extern sched_lapic_tick
+extern sched_resched
+
+; defined in sys/i686/kern/crit.c
+extern giant_exit
+
+; defined in sys/i686/kern/lapic.c
+extern lapic_base
 
 global sched_switch_context
+global sched_switch_lapic
+global sched_switch_lapic_timer
 
-sched_switch_context:
+; saves the interrupted thread, lets %1 pick the next one and switches to its
+; stack and address space. The giant lock taken by %1 is only dropped once
+; nothing runs on the old stack anymore, as another CPU may pick it up next
+%macro SWITCH_CONTEXT 1
     cli
     pushad
     push ds
@@ -37,30 +52,54 @@ sched_switch_context:
     mov ax, 0x10
     mov ds, ax
     mov es, ax
-    mov fs, ax
     mov gs, ax
+    mov ax, 0x30
+    mov fs, ax
 
     mov ebx, cr3
     mov eax, esp
 
     push eax
 
-    call sched_get_next_proc
+    call %1
 
     mov esp, eax
 
-    mov eax, [sched_curr_page_dir]
+    mov eax, [fs:CPU_PAGE_DIR]
     cmp eax, 0
+    jz %%same_space
 
-    jz .no_page_dir
-    mov cr3, eax
-    mov eax, cr3
+    ; reloading CR3 throws away the TLB; don't unless the address space changed
+    cmp eax, ebx
+    je %%same_space
     mov cr3, eax
 
-.no_page_dir:
-    mov al, 0x20
-    out 0x20, al
+%%same_space:
+    call giant_exit
+%endmacro
+
+; timer interrupt from the PIT, bootstrap processor only. sched_get_next_proc
+; acknowledges the PIC itself
+sched_switch_context:
+    SWITCH_CONTEXT sched_get_next_proc
+
+    jmp switch_return
+
+; local APIC timer, application processors only
+sched_switch_lapic_timer:
+    SWITCH_CONTEXT sched_lapic_tick
+
+    jmp lapic_return
+
+; reschedule IPIs
+sched_switch_lapic:
+    SWITCH_CONTEXT sched_resched
+
+lapic_return:
+    mov eax, [lapic_base]
+    mov dword [eax + 0xB0], 0
 
+switch_return:
     pop gs
     pop fs
     pop es
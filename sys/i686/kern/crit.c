@@ -15,6 +15,8 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
+#include <machine/cpu.h>
+#include <sys/cpu.h>
 #include <sys/types.h>
 #include <sys/mutex.h>
 
@@ -28,12 +30,15 @@ get_eflags()
     return flags;
 }
 
-static bool prev_if;
-static spinlock_t crit_lock = 0;
+static spinlock_t   crit_lock;
+static spinlock_t   giant_lock;
+static volatile int giant_owner = -1;
 
 void
 critical_enter()
 {
+    bool prev_if;
+
     prev_if = (get_eflags() & 0x200) != 0;
 
     if (prev_if) {
@@ -41,14 +46,98 @@ critical_enter()
     }
 
     spinlock_lock(&crit_lock);
+
+    curcpu()->ci_crit_if = prev_if;
 }
 
 void
 critical_exit()
 {
+    bool prev_if;
+
+    prev_if = curcpu()->ci_crit_if;
+
     spinlock_unlock(&crit_lock);
 
     if (prev_if) {
         asm volatile("sti");
     }
 }
+
+void
+giant_enter()
+{
+    bool prev_if;
+    uint16_t ticket;
+    struct cpu *ci;
+
+    prev_if = (get_eflags() & 0x200) != 0;
+
+    asm volatile("cli");
+
+    ci = curcpu();
+
+    if (giant_owner != ci->ci_id) {
+        ticket = __sync_fetch_and_add(&giant_lock.next, 1);
+
+        while (giant_lock.owner != ticket) {
+            /* the holder may be waiting on us to drop a stale mapping */
+            smp_tlb_flush();
+            cpu_pause();
+        }
+
+        giant_owner = ci->ci_id;
+    }
+
+    ci->ci_giant_depth++;
+
+    if (prev_if) {
+        asm volatile("sti");
+    }
+}
+
+/* must be called with interrupts disabled */
+void
+giant_exit()
+{
+    struct cpu *ci;
+
+    ci = curcpu();
+
+    if (--ci->ci_giant_depth == 0) {
+        giant_owner = -1;
+        __sync_fetch_and_add(&giant_lock.owner, 1);
+    }
+}
+
+/* takes the lock back after giant_release_all(); interrupts must be disabled */
+void
+giant_reacquire(int depth)
+{
+    if (depth > 0) {
+        giant_enter();
+        curcpu()->ci_giant_depth = depth;
+    }
+}
+
+/*
+ * lets go of the lock completely, returning how often it was held. Used before
+ * waiting and before leaving for userland. Interrupts must be disabled
+ */
+int
+giant_release_all()
+{
+    int depth;
+    struct cpu *ci;
+
+    ci = curcpu();
+    depth = ci->ci_giant_depth;
+
+    if (depth > 0) {
+        ci->ci_giant_depth = 0;
+        giant_owner = -1;
+        __sync_fetch_and_add(&giant_lock.owner, 1);
+    }
+
+    return depth;
+}
@@ -19,6 +19,7 @@
  */
 #include <ds/list.h>
 #include <machine/elf32.h>
+#include <machine/fpu.h>
 #include <machine/vm.h>
 #include <sys/errno.h>
 #include <sys/fcntl.h>
@@ -28,6 +29,7 @@
 #include <sys/malloc.h>
 #include <sys/string.h>
 #include <sys/types.h>
+#include <sys/vdso.h>
 #include <sys/vnode.h>
 #include <sys/vm.h>
 
@@ -171,7 +173,7 @@ unload_userspace(struct vm_space *space)
     list_get_iter(&space->map, &iter);
 
     while (iter_move_next(&iter, (void**)&block)) {
-        if (!(block->prot & VM_KERN)) {
+        if (!(block->prot & VM_KERN) && !VDSO_CONTAINS(block->start_virtual, PAGE_SIZE)) {
             list_append(&to_remove, block);
         }
     }
@@ -193,9 +195,6 @@ proc_execve(const char *path, const char **argv, const char **envp)
     /* defined in sys/i686/kern/usermode.asm */
     extern void return_to_usermode(uintptr_t, uintptr_t, uintptr_t, uintptr_t);
 
-     /* defined in sys/i686/kern/sched.c */
-    extern struct thread *sched_curr_thread;
-
     int argc;
     int envc;
     int i;
@@ -248,6 +247,9 @@ proc_execve(const char *path, const char **argv, const char **envp)
 
     unload_userspace(space);
 
+    /* the new image starts out with a freshly initialized FPU */
+    fpu_release(sched_curr_thread);
+
     elf_get_dimensions(elf, &prog_low, &prog_high);
 
     prog_size = prog_high - prog_low;
@@ -266,13 +268,17 @@ proc_execve(const char *path, const char **argv, const char **envp)
     proc->root = root;
     proc->thread = sched_curr_thread;
 
+    /* a forked process already has its thread on the list */
+    list_remove(&proc->threads, sched_curr_thread);
     list_append(&proc->threads, sched_curr_thread);
 
+    vdso_setids(space, proc->pid, LIST_SIZE(&proc->threads) == 1 ? sched_curr_thread->tid : 0);
+
     sched_curr_thread->u_stack_top = KERNEL_VIRTUAL_BASE - 1;
 
     for (stack_bottom = 0xBFFFF000; stack_bottom > 0xBFFFA000; stack_bottom -= 0x1000) {
         vm_map(space, (void*)stack_bottom, 0x1000, VM_READ | VM_WRITE);
-        memset((void*)stack_bottom, 0, 0x1000);
+        page_zero((void*)stack_bottom);
     }
 
     sched_curr_thread->u_stack_bottom = stack_bottom + 0x1000;
@@ -15,6 +15,7 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
+#include <machine/fpu.h>
 #include <machine/reg.h>
 #include <sys/file.h>
 #include <sys/interrupt.h>
@@ -23,12 +24,14 @@
 #include <sys/string.h>
 #include <sys/systm.h>
 #include <sys/types.h>
+#include <sys/vdso.h>
 #include <sys/vnode.h>
 #include <sys/vm.h>
 #include <sys/world.h>
 
 struct fork_state {
     struct proc *   proc;
+    struct thread * parent;
     uintptr_t       u_stack_top;
     uintptr_t       u_stack_bottom;
     bool            initialized;
@@ -87,9 +90,6 @@ copy_stack(struct thread *thread, struct vm_space *new_space)
 static int
 init_child_proc(void *statep)
 {
-    /* defined in sys/i686/kern/sched.c */
-    extern struct thread *sched_curr_thread;
-
     /* defined in sys/i686/kern/usermode.asm */
     extern void return_to_usermode(uintptr_t, uintptr_t, uintptr_t, uintptr_t);
 
@@ -114,7 +114,10 @@ init_child_proc(void *statep)
 
     list_append(&proc->threads, sched_curr_thread);
 
-    current_proc = proc;
+    /* the parent is waiting for us, so its saved FPU state can't change */
+    fpu_copy(sched_curr_thread, state->parent);
+
+    CPU_STORE(ci_proc, proc);
 
     eip = state->regs.eip;
     esp = state->regs.uesp;
@@ -169,8 +172,14 @@ proc_fork(struct regs *regs)
     copy_image(proc, new_space);
     copy_fildes(proc, new_proc);
 
+    /* init_child_proc() gives the child's thread the process ID */
+    vdso_setids(new_space, new_proc->pid, new_proc->pid);
+
+    fpu_save(sched_curr_thread);
+
     memset(&state, 0, sizeof(state));
     state.proc = new_proc;
+    state.parent = sched_curr_thread;
     state.u_stack_top = proc->thread->u_stack_top;
     state.u_stack_bottom = proc->thread->u_stack_bottom;
 
@@ -0,0 +1,225 @@
+/*
+ * fpu.c - lazy x87/SSE context switching
+ *
+ * Switching threads sets CR0.TS, so the first FPU or SSE instruction a thread
+ * executes afterwards raises a device not available trap. Only then is its
+ * state loaded, and it's saved again when the thread is switched out after
+ * having used the FPU. Threads that never touch it never pay for either.
+ *
+ * Each CPU remembers whose state is in its registers. A thread switched back
+ * in on the CPU it last used the FPU on finds its registers untouched and
+ * only has CR0.TS cleared
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <machine/cpufunc.h>
+#include <machine/fpu.h>
+#include <sys/cpu.h>
+#include <sys/pool.h>
+#include <sys/proc.h>
+#include <sys/string.h>
+#include <sys/types.h>
+
+/* all SSE exceptions masked, round to nearest */
+#define MXCSR_DEFAULT   0x1F80
+
+static struct pool          fpu_pool;
+static bool                 fpu_have_fxsr;
+static bool                 fpu_have_sse;
+
+/* what a thread's FPU looks like the first time it uses it */
+static struct fpu_state     fpu_initial_state;
+
+static inline void
+fpu_clts()
+{
+    asm volatile("clts");
+}
+
+static inline void
+fpu_stts()
+{
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+static inline void
+fpu_save_area(struct fpu_state *state)
+{
+    if (fpu_have_fxsr) {
+        asm volatile("fxsave %0" : "=m"(*state));
+    } else {
+        /* FNSAVE reinitializes the FPU, which would lose what's in it */
+        asm volatile("fnsave %0 ; frstor %0" : "+m"(*state));
+    }
+}
+
+static inline void
+fpu_restore_area(struct fpu_state *state)
+{
+    if (fpu_have_fxsr) {
+        asm volatile("fxrstor %0" : : "m"(*state));
+    } else {
+        asm volatile("frstor %0" : : "m"(*state));
+    }
+}
+
+/* called on every CPU before it runs any thread */
+void
+fpu_enable()
+{
+    uint32_t cr0;
+    uint32_t cr4;
+
+    /* report x87 errors through #MF rather than the PIC, and trap on WAIT too */
+    cr0 = read_cr0();
+    cr0 &= ~CR0_EM;
+    cr0 |= CR0_MP | CR0_NE;
+    write_cr0(cr0);
+
+    cr4 = read_cr4();
+
+    if (fpu_have_fxsr) {
+        cr4 |= CR4_OSFXSR;
+    }
+
+    if (fpu_have_sse) {
+        cr4 |= CR4_OSXMMEXCPT;
+    }
+
+    write_cr4(cr4);
+
+    fpu_stts();
+}
+
+void
+fpu_init()
+{
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+    uint32_t mxcsr;
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+
+    fpu_have_fxsr = (edx & CPUID_FXSR) != 0;
+    fpu_have_sse = (edx & CPUID_SSE) != 0;
+
+    pool_init(&fpu_pool, sizeof(struct fpu_state), 16);
+
+    fpu_enable();
+    fpu_clts();
+
+    asm volatile("fninit");
+
+    if (fpu_have_sse) {
+        mxcsr = MXCSR_DEFAULT;
+        asm volatile("ldmxcsr %0" : : "m"(mxcsr));
+    }
+
+    fpu_save_area(&fpu_initial_state);
+    fpu_stts();
+}
+
+/* the running thread used the FPU for the first time since it was switched in */
+void
+fpu_trap()
+{
+    struct cpu *ci;
+    struct thread *thread;
+
+    ci = curcpu();
+    thread = ci->ci_thread;
+
+    fpu_clts();
+
+    if (ci->ci_fpu_owner == thread && thread->fpu_cpu == ci) {
+        return;
+    }
+
+    if (!thread->fpu) {
+        thread->fpu = pool_get(&fpu_pool);
+        memcpy(thread->fpu, &fpu_initial_state, sizeof(struct fpu_state));
+    }
+
+    fpu_restore_area(thread->fpu);
+
+    ci->ci_fpu_owner = thread;
+    thread->fpu_cpu = ci;
+}
+
+/* called by the scheduler before it switches away from prev */
+void
+fpu_switch(struct cpu *ci, struct thread *prev)
+{
+    /* TS is only clear if prev took the trap since it was switched in */
+    if (prev && ci->ci_fpu_owner == prev && !(read_cr0() & CR0_TS)) {
+        fpu_save_area(prev->fpu);
+    }
+
+    fpu_stts();
+}
+
+/* writes the running thread's registers back to memory, if they're in use */
+void
+fpu_save(struct thread *thread)
+{
+    struct cpu *ci;
+
+    ci = curcpu();
+
+    if (ci->ci_fpu_owner == thread && thread->fpu_cpu == ci && !(read_cr0() & CR0_TS)) {
+        fpu_save_area(thread->fpu);
+    }
+}
+
+/* gives a forked thread the state its parent saved with fpu_save() */
+void
+fpu_copy(struct thread *dst, struct thread *src)
+{
+    if (!src->fpu) {
+        return;
+    }
+
+    if (!dst->fpu) {
+        dst->fpu = pool_get(&fpu_pool);
+    }
+
+    memcpy(dst->fpu, src->fpu, sizeof(struct fpu_state));
+}
+
+/* forgets a thread's state, because it exec'd or is about to be freed */
+void
+fpu_release(struct thread *thread)
+{
+    int i;
+
+    for (i = 0; i < ncpus; i++) {
+        if (cpus[i].ci_fpu_owner == thread) {
+            cpus[i].ci_fpu_owner = NULL;
+        }
+    }
+
+    if (thread == sched_curr_thread) {
+        fpu_stts();
+    }
+
+    if (thread->fpu) {
+        pool_put(&fpu_pool, thread->fpu);
+    }
+
+    thread->fpu = NULL;
+    thread->fpu_cpu = NULL;
+}
@@ -17,12 +17,20 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
+#include <machine/cpu.h>
+#include <machine/ioapic.h>
+#include <machine/lapic.h>
 #include <machine/portio.h>
 #include <machine/reg.h>
+#include <sys/cpu.h>
 #include <sys/device.h>
+#include <sys/errno.h>
 #include <sys/interrupt.h>
+#include <sys/malloc.h>
 #include <sys/proc.h>
+#include <sys/softirq.h>
 #include <sys/string.h>
+#include <sys/sysctl.h>
 #include <sys/systm.h>
 #include <sys/types.h>
 
@@ -35,6 +43,7 @@ struct intr_handler {
     struct device   *   dev; /* IRQs only, not for software interrupts! */
     intr_type           type;
     void            *   handler;
+    struct intr_handler *next;  /* another device sharing the vector */
 };
 
 struct dt_ptr {
@@ -42,15 +51,6 @@ struct dt_ptr {
     uint32_t    base;
 } __attribute__((packed));
 
-struct gdt_entry {
-    uint16_t    limit_low;
-    uint16_t    base_low;
-    uint8_t     base_middle;
-    uint8_t     access;
-    uint8_t     granularity;
-    uint8_t     base_high;
-} __attribute__((packed));
-
 struct idt_entry {
     uint16_t    offset_1;
     uint16_t    selector;
@@ -59,51 +59,24 @@ struct idt_entry {
     uint16_t    offset_2;
 } __attribute__((packed));
 
-struct tss_entry {
-    uint32_t    prev_tss;
-    uint32_t    esp0;
-    uint32_t    ss0;
-    uint32_t    esp1;
-    uint32_t    ss1;
-    uint32_t    esp2;
-    uint32_t    ss2;
-    uint32_t    cr3;
-    uint32_t    eip;
-    uint32_t    eflags;
-    uint32_t    eax;
-    uint32_t    ecx;
-    uint32_t    edx;
-    uint32_t    ebx;
-    uint32_t    esp;
-    uint32_t    ebp;
-    uint32_t    esi;
-    uint32_t    edi;
-    uint32_t    es;
-    uint32_t    cs;
-    uint32_t    ss;
-    uint32_t    ds;
-    uint32_t    fs;
-    uint32_t    gs;
-    uint32_t    ldt;
-    uint16_t    trap;
-    uint16_t    iomap_base;
-} __attribute__((packed));
+int interrupts_enabled = 0;
 
+struct intr_handler *intr_handlers[256];
 
-int interrupts_enabled = 0;
+/* how often each vector was taken, for KERN_INTR */
+uint32_t            intr_counts[256];
 
-struct intr_handler intr_handlers[256];
+/* vectors handed out by intr_alloc_vector() */
+static bool         intr_vector_used[INTR_MSI_LAST - INTR_MSI_FIRST + 1];
 
-struct gdt_entry    global_descriptor_table[6];
 struct idt_entry    interrupt_table[256];
-struct tss_entry    task_state_segment;
 
 void
-gdt_set_gate(uint8_t num, uint32_t base, uint32_t limit, uint8_t access, uint8_t granularity)
+gdt_set_gate(struct gdt_entry *gdt, uint8_t num, uint32_t base, uint32_t limit, uint8_t access, uint8_t granularity)
 {
     struct gdt_entry *entry;
     
-    entry = &global_descriptor_table[num];
+    entry = &gdt[num];
 
     entry->base_low = (base & 0xFFFF);
     entry->base_middle = (base >> 16) & 0xFF;
@@ -131,57 +104,146 @@ idt_set_gate(uint8_t inum, uint32_t base, uint16_t selector, uint8_t flags)
 void
 set_tss_esp0(uint32_t esp0)
 {
-    task_state_segment.esp0 = esp0;
+    curcpu()->ci_md.cm_tss.esp0 = esp0;
+}
+
+/* where the kernel stack pointer of the current thread can always be found */
+uintptr_t
+get_tss_esp0_ptr()
+{
+    return (uintptr_t)&curcpu()->ci_md.cm_tss + __builtin_offsetof(struct tss_entry, esp0);
 }
 
 void
-set_task_segment(uint32_t num, uint16_t ss0, uint32_t esp0)
+set_task_segment(struct cpu_md *md, uint32_t num, uint16_t ss0, uint32_t esp0)
 {
     uint32_t base;
     uint32_t limit;
+    struct tss_entry *tss;
 
-    base = (uint32_t)&task_state_segment;
+    tss = &md->cm_tss;
+    base = (uint32_t)tss;
     limit = base + sizeof(struct tss_entry);
 
-    gdt_set_gate(num, base, limit, 0xE9, 0x00);
+    gdt_set_gate(md->cm_gdt, num, base, limit, 0xE9, 0x00);
 
-    memset(&task_state_segment, 0, sizeof(struct tss_entry));
+    memset(tss, 0, sizeof(struct tss_entry));
 
-    task_state_segment.ss0 = ss0;
-    task_state_segment.esp0 = esp0;
+    tss->ss0 = ss0;
+    tss->esp0 = esp0;
 
-    task_state_segment.cs = 0x0B;
-    task_state_segment.ds = 0x13;
-    task_state_segment.es = 0x13;
-    task_state_segment.fs = 0x13;
-    task_state_segment.gs = 0x13;
-    task_state_segment.ss = 0x13;
+    tss->cs = 0x0B;
+    tss->ds = 0x13;
+    tss->es = 0x13;
+    tss->fs = 0x13;
+    tss->gs = 0x13;
+    tss->ss = 0x13;
 }
 
+/*
+ * loads the calling CPU's own GDT and TSS, and points FS at its struct cpu.
+ * This has to come before anything that takes a lock
+ */
 void
-dispatch_intr(struct regs *regs)
+gdt_init(struct cpu *ci)
 {
-    extern struct thread * sched_curr_thread;
+    /* defined in sys/i686/kern/gdt.asm */
+    extern void gdt_flush_ptr(struct dt_ptr *ptr);
 
-    uint8_t inum;
-    struct intr_handler *handler;
+    struct dt_ptr gdt_ptr;
+    struct gdt_entry *gdt;
 
-    if (sched_curr_thread) {
-        __sync_lock_test_and_set(&sched_curr_thread->interrupt_in_progress, 1);
-        thread_interrupt_enter(sched_curr_thread, regs);
-    }
+    gdt = ci->ci_md.cm_gdt;
+    ci->ci_self = ci;
 
-    inum = regs->inum;
+    memset(gdt, 0, sizeof(struct gdt_entry) * GDT_ENTRIES);
+
+    gdt_ptr.limit = sizeof(struct gdt_entry) * GDT_ENTRIES;
+    gdt_ptr.base = (uint32_t)gdt;
+
+    gdt_set_gate(gdt, 0, 0, 0, 0, 0); // null segment
+    gdt_set_gate(gdt, 1, 0, 0xFFFFFFFF, 0x9A, 0xCF); // code segment
+    gdt_set_gate(gdt, 2, 0, 0xFFFFFFFF, 0x92, 0xCF); // data segment
+    gdt_set_gate(gdt, 3, 0, 0xFFFFFFFF, 0xFA, 0xCF); // usermode code segment
+    gdt_set_gate(gdt, 4, 0, 0xFFFFFFFF, 0xF2, 0xCF); // usermode data segment
+
+    set_task_segment(&ci->ci_md, 5, 0x10, 0xFFFFFFFF);
+
+    gdt_set_gate(gdt, 6, (uint32_t)ci, sizeof(struct cpu) - 1, 0x92, 0x40); // per-CPU segment
+
+    gdt_flush_ptr(&gdt_ptr);
+
+    asm volatile (
+        ".Intel_syntax noprefix;"
+        "mov ax, 0x2B;"
+        "ltr ax;"
+        ".att_syntax noprefix;"
+    );
+
+    asm volatile("movw %w0, %%fs" : : "r"(GDT_PERCPU_SEL));
+}
+
+/* the IDT is shared; application processors only need to load it */
+void
+idt_load()
+{
+    struct dt_ptr idt_ptr;
+
+    idt_ptr.limit = 2047;
+    idt_ptr.base = (uint32_t)&interrupt_table;
+
+    asm volatile("lidt (%0)" : : "p"(&idt_ptr));
+}
+
+/* acknowledges a device interrupt at whichever controller delivered it */
+void
+irq_eoi(int inum)
+{
+    if (ioapic_enabled || inum >= INTR_MSI_FIRST) {
+        lapic_eoi();
+        return;
+    }
 
     if (inum >= 40) {
         io_write8(0xA0, 0x20);
     }
-    
+
     io_write8(0x20, 0x20);
+}
+
+void
+dispatch_intr(struct regs *regs)
+{
+    uint8_t inum;
+    struct intr_handler *handler;
+
+    inum = regs->inum;
+
+    __sync_fetch_and_add(&intr_counts[inum], 1);
+
+    /*
+     * a shootdown is answered without the giant lock, since the CPU holding
+     * it is the one waiting for the answer. Spurious interrupts are dropped
+     */
+    if (inum == LAPIC_VEC_TLB) {
+        smp_tlb_flush();
+        lapic_eoi();
+        return;
+    }
+
+    if (inum == LAPIC_VEC_SPURIOUS) {
+        return;
+    }
 
-    handler = &intr_handlers[inum];
+    giant_enter();
+
+    if (sched_curr_thread) {
+        __sync_lock_test_and_set(&sched_curr_thread->interrupt_in_progress, 1);
+        thread_interrupt_enter(sched_curr_thread, regs);
+    }
 
-    if (handler->handler) {
+    /* every device on a shared line is asked, since any of them may have raised it */
+    for (handler = intr_handlers[inum]; handler; handler = handler->next) {
         switch (handler->type) {
             case INTR_IRQ:
                 ((dev_intr_t)handler->handler)((struct device*)handler->dev, inum);
@@ -194,35 +256,160 @@ dispatch_intr(struct regs *regs)
         }
     }
 
+    /*
+     * only IRQs are acknowledged; traps and software interrupts never reached
+     * an interrupt controller. Level triggered lines are quiet by now
+     */
+    if (inum >= 32 && inum <= INTR_MSI_LAST) {
+        irq_eoi(inum);
+    }
+
+    /* softirqs can be interrupted */
+    bus_interrupts_off();
+    softirq_run();
+
     if (sched_curr_thread) {
         thread_interrupt_leave(sched_curr_thread, regs);
         __sync_lock_test_and_set(&sched_curr_thread->interrupt_in_progress, 0);
     }
+
+    giant_exit();
 }
 
+static int
+intr_chain(int inum, intr_type type, struct device *dev, void *func)
+{
+    struct intr_handler *handler;
+    struct intr_handler **tail;
+
+    for (tail = &intr_handlers[inum]; *tail; tail = &(*tail)->next) {
+        /* some drivers register the same handler twice */
+        if ((*tail)->handler == func && (*tail)->dev == dev) {
+            return 0;
+        }
+    }
+
+    handler = calloc(1, sizeof(struct intr_handler));
+    handler->dev = dev;
+    handler->type = type;
+    handler->handler = func;
+
+    *tail = handler;
+
+    return 0;
+}
+
+/* adds a handler to an ISA or PCI interrupt line, which others may share */
 int
 irq_register(struct device *dev, int inum, dev_intr_t handler)
 {
-    intr_handlers[32+inum].handler = handler;
-    intr_handlers[32+inum].type = INTR_IRQ;
-    intr_handlers[32+inum].dev = dev;
-    return 0;
+    return intr_chain(32+inum, INTR_IRQ, dev, handler);
+}
+
+/* for vectors from intr_alloc_vector(), which are the device's own */
+int
+intr_register(struct device *dev, int vector, dev_intr_t handler)
+{
+    return intr_chain(vector, INTR_IRQ, dev, handler);
+}
+
+/* a vector for a message signalled interrupt, or -1 once they ran out */
+int
+intr_alloc_vector()
+{
+    int i;
+
+    for (i = 0; i <= INTR_MSI_LAST - INTR_MSI_FIRST; i++) {
+        if (!intr_vector_used[i]) {
+            intr_vector_used[i] = true;
+            return INTR_MSI_FIRST + i;
+        }
+    }
+
+    return -1;
+}
+
+/* gives back a vector that was never registered, e.g. when MSI-X setup fails */
+void
+intr_release_vector(int vector)
+{
+    if (vector >= INTR_MSI_FIRST && vector <= INTR_MSI_LAST) {
+        intr_vector_used[vector - INTR_MSI_FIRST] = false;
+    }
 }
 
+/* traps and software interrupts have a single handler, which replaces the last */
 int
 swi_register(int inum, intr_handler_t handler)
 {
-    intr_handlers[inum].handler = handler;
-    intr_handlers[inum].type = INTR_SWI;
-    intr_handlers[inum].dev = NULL;
+    if (!intr_handlers[inum]) {
+        intr_handlers[inum] = calloc(1, sizeof(struct intr_handler));
+    }
+
+    intr_handlers[inum]->handler = handler;
+    intr_handlers[inum]->type = INTR_SWI;
+    intr_handlers[inum]->dev = NULL;
+
+    return 0;
+}
+
+int
+intr_sysctl(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    int i;
+    int nentries;
+    int maxentries;
+    struct intr_handler *handler;
+    struct kinfo_intr *entries;
+
+    if (!oldlenp) {
+        return -(EINVAL);
+    }
+
+    nentries = 0;
+
+    for (i = 0; i < 256; i++) {
+        if (intr_counts[i] || intr_handlers[i]) {
+            nentries++;
+        }
+    }
+
+    if (!oldp) {
+        *oldlenp = nentries*sizeof(struct kinfo_intr);
+        return 0;
+    }
+
+    maxentries = *oldlenp / sizeof(struct kinfo_intr);
+    entries = oldp;
+    nentries = 0;
+
+    for (i = 0; i < 256 && nentries < maxentries; i++) {
+        if (!intr_counts[i] && !intr_handlers[i]) {
+            continue;
+        }
+
+        entries[nentries].vector = i;
+        entries[nentries].count = intr_counts[i];
+        entries[nentries].nhandlers = 0;
+
+        for (handler = intr_handlers[i]; handler; handler = handler->next) {
+            entries[nentries].nhandlers++;
+        }
+
+        nentries++;
+    }
+
+    *oldlenp = nentries*sizeof(struct kinfo_intr);
+
     return 0;
 }
 
 void
 intr_init()
 {
-    /* defined in sys/i686/kern/gdt.asm */
-    extern void gdt_flush_ptr(struct dt_ptr *ptr);
+    /* defined in sys/i686/kern/context_switch.asm */
+    extern void sched_switch_lapic();
+    extern void sched_switch_lapic_timer();
 
     /*
      * defined in interrupt_handlers.asm
@@ -261,6 +448,8 @@ intr_init()
     extern void isr31(struct regs *regs);
     
     extern void isr128(struct regs *regs);
+    extern void isr242(struct regs *regs);
+    extern void isr255(struct regs *regs);
 
     extern void irq0(struct regs *regs);
     extern void irq1(struct regs *regs);
@@ -278,40 +467,29 @@ intr_init()
     extern void irq13(struct regs *regs);
     extern void irq14(struct regs *regs);
     extern void irq15(struct regs *regs);
+    extern void irq16(struct regs *regs);
+    extern void irq17(struct regs *regs);
+    extern void irq18(struct regs *regs);
+    extern void irq19(struct regs *regs);
+    extern void irq20(struct regs *regs);
+    extern void irq21(struct regs *regs);
+    extern void irq22(struct regs *regs);
+    extern void irq23(struct regs *regs);
+    extern void irq24(struct regs *regs);
+    extern void irq25(struct regs *regs);
+    extern void irq26(struct regs *regs);
+    extern void irq27(struct regs *regs);
+    extern void irq28(struct regs *regs);
+    extern void irq29(struct regs *regs);
+    extern void irq30(struct regs *regs);
+    extern void irq31(struct regs *regs);
 
 
     int i;
     uint32_t *handler_pointers;
-    struct dt_ptr gdt_ptr;
-    struct dt_ptr idt_ptr;
-
-    memset(&global_descriptor_table, 0, sizeof(struct gdt_entry) * 6);
-    
-    gdt_ptr.limit = sizeof(struct gdt_entry) * 6;
-    gdt_ptr.base = (uint32_t)&global_descriptor_table;
-
-    gdt_set_gate(0, 0, 0, 0, 0); // null segment
-    gdt_set_gate(1, 0, 0xFFFFFFFF, 0x9A, 0xCF); // code segment
-    gdt_set_gate(2, 0, 0xFFFFFFFF, 0x92, 0xCF); // data segment
-    gdt_set_gate(3, 0, 0xFFFFFFFF, 0xFA, 0xCF); // usermode code segment
-    gdt_set_gate(4, 0, 0xFFFFFFFF, 0xF2, 0xCF); // usermode data segment
-
-    set_task_segment(5, 0x10, 0xFFFFFFFF);
-
-    gdt_flush_ptr(&gdt_ptr);
-
-    asm volatile (
-        ".Intel_syntax noprefix;"
-        "mov ax, 0x2B;"
-        "ltr ax;"
-        ".att_syntax noprefix;"
-    );
 
     memset(&interrupt_table, 0, sizeof(struct idt_entry) * 256);
 
-    idt_ptr.limit = 2047;
-    idt_ptr.base = (uint32_t)&interrupt_table;
-    
     io_write8(0x20, 0x11);
     io_write8(0xA0, 0x11);
     io_write8(0x21, 0x20);
@@ -348,6 +526,14 @@ intr_init()
         (uint32_t)irq10, (uint32_t)irq11,
         (uint32_t)irq12, (uint32_t)irq13,
         (uint32_t)irq14, (uint32_t)irq15,
+        (uint32_t)irq16, (uint32_t)irq17,
+        (uint32_t)irq18, (uint32_t)irq19,
+        (uint32_t)irq20, (uint32_t)irq21,
+        (uint32_t)irq22, (uint32_t)irq23,
+        (uint32_t)irq24, (uint32_t)irq25,
+        (uint32_t)irq26, (uint32_t)irq27,
+        (uint32_t)irq28, (uint32_t)irq29,
+        (uint32_t)irq30, (uint32_t)irq31,
         NULL
     };
 
@@ -357,5 +543,10 @@ intr_init()
 
     idt_set_gate(128, (uint32_t)isr128, 0x08, 0xEE);
 
-    asm volatile("lidt (%0)" : : "p"(&idt_ptr));
+    idt_set_gate(LAPIC_VEC_TIMER, (uint32_t)sched_switch_lapic_timer, 0x08, 0x8E);
+    idt_set_gate(LAPIC_VEC_RESCHED, (uint32_t)sched_switch_lapic, 0x08, 0x8E);
+    idt_set_gate(LAPIC_VEC_TLB, (uint32_t)isr242, 0x08, 0x8E);
+    idt_set_gate(LAPIC_VEC_SPURIOUS, (uint32_t)isr255, 0x08, 0x8E);
+
+    idt_load();
 }
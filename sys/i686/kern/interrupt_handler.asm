@@ -78,6 +78,8 @@ ISR_NOERRCODE 30
 ISR_NOERRCODE 31
 
 ISR_NOERRCODE 128
+ISR_NOERRCODE 242
+ISR_NOERRCODE 255
 ; defined in i686/kern/context_switch.asm
 extern sched_switch_context
 
@@ -102,6 +104,24 @@ IRQ 13, 45
 IRQ 14, 46
 IRQ 15, 47
 
+; message signalled interrupts; see INTR_MSI_FIRST in machine/interrupt.h
+IRQ 16, 48
+IRQ 17, 49
+IRQ 18, 50
+IRQ 19, 51
+IRQ 20, 52
+IRQ 21, 53
+IRQ 22, 54
+IRQ 23, 55
+IRQ 24, 56
+IRQ 25, 57
+IRQ 26, 58
+IRQ 27, 59
+IRQ 28, 60
+IRQ 29, 61
+IRQ 30, 62
+IRQ 31, 63
+
 global isr_handler
 global irq_handler
 
@@ -117,8 +137,9 @@ isr_handler:
     mov ax, 0x10
     mov ds, ax
     mov es, ax
-    mov fs, ax
     mov gs, ax
+    mov ax, 0x30
+    mov fs, ax
 
     push esp
 
@@ -129,9 +150,15 @@ isr_handler:
     pop ebx
     mov ds, bx
     mov es, bx
-    mov fs, bx
     mov gs, bx
 
+    ; kernel mode code keeps FS pointed at its per-CPU segment
+    cmp bx, 0x10
+    jne .restore_fs
+    mov bx, 0x30
+.restore_fs:
+    mov fs, bx
+
     popa
     add esp, 8
 
@@ -149,8 +176,9 @@ irq_handler:
    mov ax, 0x10
    mov ds, ax
    mov es, ax
-   mov fs, ax
    mov gs, ax
+   mov ax, 0x30
+   mov fs, ax
 
    push esp
 
@@ -162,9 +190,14 @@ irq_handler:
 
    mov ds, bx
    mov es, bx
-   mov fs, bx
    mov gs, bx
 
+   cmp bx, 0x10
+   jne .restore_fs
+   mov bx, 0x30
+.restore_fs:
+   mov fs, bx
+
    popa
 
    add esp, 8
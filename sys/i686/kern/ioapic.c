@@ -0,0 +1,201 @@
+/*
+ * ioapic.c - routes device interrupts through the I/O APIC
+ *
+ * The I/O APICs and the way ISA interrupts are wired to them are read from
+ * the MADT by smp_probe(). If there is one, the ISA interrupts are sent to
+ * the bootstrap processor on the same vectors the PICs used, and the PICs
+ * are masked. Handlers don't notice the difference; only the EOI changes
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <machine/ioapic.h>
+#include <machine/portio.h>
+#include <machine/vm.h>
+#include <sys/types.h>
+
+#define ISA_IRQS    16
+
+struct ioapic {
+    uint8_t     id;
+    uintptr_t   base;
+    uint32_t    gsi_base;
+    int         nlines;
+};
+
+/* where an ISA IRQ really arrives; identity unless the MADT overrides it */
+struct isa_route {
+    uint32_t    gsi;
+    uint16_t    flags;
+};
+
+bool ioapic_enabled;
+
+static struct ioapic    ioapics[MAXIOAPIC];
+static int              nioapics;
+
+static struct isa_route isa_routes[ISA_IRQS];
+static bool             isa_overridden[ISA_IRQS];
+
+static uint32_t
+ioapic_read(struct ioapic *ioapic, uint8_t reg)
+{
+    *(volatile uint32_t*)(ioapic->base + IOAPIC_REGSEL) = reg;
+
+    return *(volatile uint32_t*)(ioapic->base + IOAPIC_WINDOW);
+}
+
+static void
+ioapic_write(struct ioapic *ioapic, uint8_t reg, uint32_t val)
+{
+    *(volatile uint32_t*)(ioapic->base + IOAPIC_REGSEL) = reg;
+    *(volatile uint32_t*)(ioapic->base + IOAPIC_WINDOW) = val;
+}
+
+static struct ioapic *
+ioapic_for_gsi(uint32_t gsi)
+{
+    int i;
+    struct ioapic *ioapic;
+
+    for (i = 0; i < nioapics; i++) {
+        ioapic = &ioapics[i];
+
+        if (gsi >= ioapic->gsi_base && gsi < ioapic->gsi_base + ioapic->nlines) {
+            return ioapic;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+ioapic_route(uint32_t gsi, uint8_t vector, uint16_t flags, uint8_t apic_id)
+{
+    int line;
+    uint32_t low;
+    struct ioapic *ioapic;
+
+    ioapic = ioapic_for_gsi(gsi);
+
+    if (!ioapic) {
+        return;
+    }
+
+    line = gsi - ioapic->gsi_base;
+    low = vector;
+
+    if ((flags & MPS_POLARITY_MASK) == MPS_POLARITY_LOW) {
+        low |= IOAPIC_REDIR_ACTIVE_LOW;
+    }
+
+    if ((flags & MPS_TRIGGER_MASK) == MPS_TRIGGER_LEVEL) {
+        low |= IOAPIC_REDIR_LEVEL;
+    }
+
+    /* fixed delivery to one physical destination */
+    ioapic_write(ioapic, IOAPIC_REG_REDTBL(line) + 1, (uint32_t)apic_id << 24);
+    ioapic_write(ioapic, IOAPIC_REG_REDTBL(line), low);
+}
+
+/* whether some other ISA IRQ was moved onto this GSI, like IRQ 0 usually is onto 2 */
+static bool
+ioapic_gsi_overridden(uint32_t gsi)
+{
+    int i;
+
+    for (i = 0; i < ISA_IRQS; i++) {
+        if (isa_overridden[i] && isa_routes[i].gsi == gsi) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/* called by smp_probe() for every I/O APIC in the MADT */
+void
+ioapic_add(uint8_t id, uintptr_t base, uint32_t gsi_base)
+{
+    struct ioapic *ioapic;
+
+    if (nioapics == MAXIOAPIC) {
+        return;
+    }
+
+    ioapic = &ioapics[nioapics++];
+    ioapic->id = id;
+    ioapic->base = base;
+    ioapic->gsi_base = gsi_base;
+}
+
+/* called by smp_probe() for every interrupt source override in the MADT */
+void
+ioapic_override(uint8_t irq, uint32_t gsi, uint16_t flags)
+{
+    if (irq < ISA_IRQS) {
+        isa_routes[irq].gsi = gsi;
+        isa_routes[irq].flags = flags;
+        isa_overridden[irq] = true;
+    }
+}
+
+/* takes over from the PICs; returns false if there is no I/O APIC to do so */
+bool
+ioapic_init(uint8_t bsp_apic_id)
+{
+    int i;
+    int line;
+    struct ioapic *ioapic;
+
+    if (nioapics == 0) {
+        return false;
+    }
+
+    for (i = 0; i < nioapics; i++) {
+        ioapic = &ioapics[i];
+
+        if (vm_map_device(ioapic->base, PAGE_SIZE) != 0) {
+            return false;
+        }
+
+        ioapic->nlines = ((ioapic_read(ioapic, IOAPIC_REG_VERSION) >> 16) & 0xFF) + 1;
+
+        for (line = 0; line < ioapic->nlines; line++) {
+            ioapic_write(ioapic, IOAPIC_REG_REDTBL(line), IOAPIC_REDIR_MASKED);
+        }
+    }
+
+    /* ISA interrupts are edge triggered and active high unless overridden */
+    for (i = 0; i < ISA_IRQS; i++) {
+        if (!isa_overridden[i]) {
+            if (ioapic_gsi_overridden(i)) {
+                continue;
+            }
+
+            isa_routes[i].gsi = i;
+            isa_routes[i].flags = 0;
+        }
+
+        ioapic_route(isa_routes[i].gsi, 32 + i, isa_routes[i].flags, bsp_apic_id);
+    }
+
+    /* mask everything on both PICs */
+    io_write8(0xA1, 0xFF);
+    io_write8(0x21, 0xFF);
+
+    ioapic_enabled = true;
+
+    return true;
+}
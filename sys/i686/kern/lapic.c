@@ -0,0 +1,128 @@
+/*
+ * lapic.c - local APIC setup, timer and inter-processor interrupts
+ *
+ * The bootstrap processor keeps taking its ticks from the PIT, so only the
+ * application processors run the local APIC timer. Its rate is unknown, so
+ * it's measured once against PIT channel 2
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <machine/cpu.h>
+#include <machine/cpufunc.h>
+#include <machine/lapic.h>
+#include <machine/portio.h>
+#include <sys/bootstage.h>
+#include <sys/sched.h>
+#include <sys/types.h>
+
+#define PIT_FREQUENCY       1193180
+#define PIT_CALIBRATE_HZ    100
+
+uintptr_t lapic_base;
+
+/* initial count that makes the timer fire sched_hz times a second */
+static uint32_t lapic_timer_count;
+
+void
+lapic_init(bool bsp)
+{
+    if (!lapic_base) {
+        return;
+    }
+
+    lapic_write(LAPIC_TPR, 0);
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | LAPIC_VEC_SPURIOUS);
+    lapic_write(LAPIC_LVT_ERROR, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+
+    if (bsp) {
+        /* the PICs still reach this CPU through LINT0 */
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+        return;
+    }
+
+    lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_LVT_LINT1, LAPIC_LVT_MASKED);
+
+    if (lapic_timer_count) {
+        lapic_write(LAPIC_LVT_TIMER, LAPIC_TIMER_PERIODIC | LAPIC_VEC_TIMER);
+        lapic_write(LAPIC_TIMER_INIT, lapic_timer_count);
+    }
+}
+
+void
+lapic_ipi(uint8_t apic_id, uint32_t icr)
+{
+    uint32_t eflags;
+
+    /* an interrupt sending its own IPI in between would clobber ICR_HIGH */
+    eflags = read_eflags();
+
+    asm volatile("cli");
+
+    while (lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING) {
+        cpu_pause();
+    }
+
+    lapic_write(LAPIC_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, icr);
+
+    if (eflags & EFLAGS_IF) {
+        asm volatile("sti");
+    }
+}
+
+/* the TSC is calibrated along with the timer, since waiting for the PIT is what takes long */
+void
+lapic_timer_calibrate()
+{
+    uint16_t count;
+    uint32_t elapsed;
+    uint64_t tsc;
+    uint8_t gate;
+
+    count = PIT_FREQUENCY / PIT_CALIBRATE_HZ;
+
+    /* channel 2 gate low and speaker off until the count is loaded */
+    gate = io_read8(0x61) & ~0x03;
+    io_write8(0x61, gate);
+
+    /* channel 2, lobyte/hibyte, interrupt on terminal count */
+    io_write8(0x43, 0xB0);
+    io_write8(0x42, count & 0xFF);
+    io_write8(0x42, count >> 8);
+
+    lapic_write(LAPIC_LVT_TIMER, LAPIC_LVT_MASKED);
+    lapic_write(LAPIC_TIMER_DIV, LAPIC_TIMER_DIV_16);
+
+    io_write8(0x61, gate | 0x01);
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    tsc = rdtsc();
+
+    /* OUT2 goes high once channel 2 reaches zero */
+    while (!(io_read8(0x61) & 0x20)) {
+        cpu_pause();
+    }
+
+    elapsed = 0xFFFFFFFF - lapic_read(LAPIC_TIMER_COUNT);
+    tsc = rdtsc() - tsc;
+
+    lapic_write(LAPIC_TIMER_INIT, 0);
+    io_write8(0x61, gate);
+
+    lapic_timer_count = elapsed * PIT_CALIBRATE_HZ / sched_hz;
+
+    bootstage_calibrate(tsc, 1000000 / PIT_CALIBRATE_HZ);
+}
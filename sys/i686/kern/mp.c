@@ -0,0 +1,488 @@
+/*
+ * mp.c - multiprocessor bring-up and inter-processor interrupts
+ *
+ * Processors are discovered through the ACPI MADT. Each application processor
+ * is woken with the INIT-SIPI-SIPI sequence and starts in the real mode
+ * trampoline from mp_boot.asm, which switches to protected mode, loads the
+ * kernel's address space and calls smp_ap_main() on that CPU's idle stack.
+ *
+ * Device interrupts are routed to the bootstrap processor, through the I/O
+ * APIC if the MADT lists one and through the 8259 PICs otherwise; the others
+ * take their own timer from the local APIC and otherwise only see IPIs
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <machine/cpu.h>
+#include <machine/fpu.h>
+#include <machine/ioapic.h>
+#include <machine/lapic.h>
+#include <machine/portio.h>
+#include <machine/vm.h>
+#include <sys/cpu.h>
+#include <sys/malloc.h>
+#include <sys/proc.h>
+#include <sys/string.h>
+#include <sys/systm.h>
+#include <sys/types.h>
+#include <sys/vm.h>
+
+#define MP_BOOT_ADDR        0x7000
+#define MP_STACK_SIZE       16384
+
+/* everything below this is reachable through PTOKVA() */
+#define ACPI_DIRECT_LIMIT   0x1FC00000
+
+#define MADT_LAPIC          0
+#define MADT_IOAPIC         1
+#define MADT_OVERRIDE       2
+#define MADT_LAPIC_ENABLED  0x01
+
+struct acpi_rsdp {
+    char        signature[8];
+    uint8_t     checksum;
+    char        oem_id[6];
+    uint8_t     revision;
+    uint32_t    rsdt_addr;
+} __attribute__((packed));
+
+struct acpi_sdt_header {
+    char        signature[4];
+    uint32_t    length;
+    uint8_t     revision;
+    uint8_t     checksum;
+    char        oem_id[6];
+    char        oem_table_id[8];
+    uint32_t    oem_revision;
+    uint32_t    creator_id;
+    uint32_t    creator_revision;
+} __attribute__((packed));
+
+struct acpi_madt {
+    struct acpi_sdt_header  header;
+    uint32_t                lapic_addr;
+    uint32_t                flags;
+} __attribute__((packed));
+
+struct madt_entry {
+    uint8_t     type;
+    uint8_t     length;
+} __attribute__((packed));
+
+struct madt_lapic {
+    struct madt_entry   entry;
+    uint8_t             processor_id;
+    uint8_t             apic_id;
+    uint32_t            flags;
+} __attribute__((packed));
+
+struct madt_ioapic {
+    struct madt_entry   entry;
+    uint8_t             ioapic_id;
+    uint8_t             reserved;
+    uint32_t            ioapic_addr;
+    uint32_t            gsi_base;
+} __attribute__((packed));
+
+/* an ISA IRQ that isn't wired to the I/O APIC line of the same number */
+struct madt_override {
+    struct madt_entry   entry;
+    uint8_t             bus;
+    uint8_t             source;
+    uint32_t            gsi;
+    uint16_t            flags;
+} __attribute__((packed));
+
+/* filled in by smp_start(), read by the trampoline; see mp_boot.asm */
+struct mp_boot_args {
+    uint32_t    cr3;
+    uint32_t    esp;
+    uint32_t    entry;
+    uint32_t    cpu;
+} __attribute__((packed));
+
+/* defined in sys/i686/kern/sched.c */
+extern struct vm_space *sched_kernel_space;
+
+/* defined in sys/i686/kern/mp_boot.asm */
+extern char mp_boot_start[];
+extern char mp_boot_end[];
+extern char mp_boot_args[];
+
+struct cpu  cpus[MAXCPU];
+int         ncpus = 1;
+
+static uint8_t  mp_apic_ids[MAXCPU];
+static int      mp_napics;
+
+/* port 0x80 is unused and takes about a microsecond to write to */
+static void
+mp_delay(int usec)
+{
+    while (usec-- > 0) {
+        io_write8(0x80, 0);
+    }
+}
+
+static bool
+acpi_checksum(void *table, size_t length)
+{
+    int i;
+    uint8_t sum;
+    uint8_t *bytes;
+
+    sum = 0;
+    bytes = table;
+
+    for (i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+
+    return sum == 0;
+}
+
+static struct acpi_rsdp *
+acpi_scan_rsdp(uintptr_t start, uintptr_t end)
+{
+    uintptr_t addr;
+    struct acpi_rsdp *rsdp;
+
+    for (addr = start & ~15; addr < end; addr += 16) {
+        rsdp = (struct acpi_rsdp*)PTOKVA(addr);
+
+        if (memcmp(rsdp->signature, "RSD PTR ", 8) == 0 && acpi_checksum(rsdp, sizeof(struct acpi_rsdp))) {
+            return rsdp;
+        }
+    }
+
+    return NULL;
+}
+
+static struct acpi_rsdp *
+acpi_find_rsdp()
+{
+    uintptr_t ebda;
+    struct acpi_rsdp *rsdp;
+
+    /* the first KB of the EBDA, then the BIOS ROM */
+    ebda = (uintptr_t)*(uint16_t*)PTOKVA(0x40E) << 4;
+
+    if (ebda && (rsdp = acpi_scan_rsdp(ebda, ebda + 1024))) {
+        return rsdp;
+    }
+
+    return acpi_scan_rsdp(0xE0000, 0x100000);
+}
+
+static struct acpi_sdt_header *
+acpi_table(uintptr_t physical)
+{
+    if (physical + sizeof(struct acpi_sdt_header) > ACPI_DIRECT_LIMIT) {
+        return NULL;
+    }
+
+    return (struct acpi_sdt_header*)PTOKVA(physical);
+}
+
+static struct acpi_madt *
+acpi_find_madt()
+{
+    int i;
+    int nentries;
+    uint32_t *entries;
+    struct acpi_rsdp *rsdp;
+    struct acpi_sdt_header *rsdt;
+    struct acpi_sdt_header *table;
+
+    rsdp = acpi_find_rsdp();
+
+    if (!rsdp || !(rsdt = acpi_table(rsdp->rsdt_addr))) {
+        return NULL;
+    }
+
+    if (rsdp->rsdt_addr + rsdt->length > ACPI_DIRECT_LIMIT || !acpi_checksum(rsdt, rsdt->length)) {
+        return NULL;
+    }
+
+    nentries = (rsdt->length - sizeof(struct acpi_sdt_header)) / sizeof(uint32_t);
+    entries = (uint32_t*)(rsdt + 1);
+
+    for (i = 0; i < nentries; i++) {
+        table = acpi_table(entries[i]);
+
+        if (table && memcmp(table->signature, "APIC", 4) == 0 &&
+            entries[i] + table->length <= ACPI_DIRECT_LIMIT && acpi_checksum(table, table->length))
+        {
+            return (struct acpi_madt*)table;
+        }
+    }
+
+    return NULL;
+}
+
+static bool
+smp_probe()
+{
+    uintptr_t addr;
+    uintptr_t end;
+    struct acpi_madt *madt;
+    struct madt_entry *entry;
+    struct madt_ioapic *ioapic;
+    struct madt_lapic *lapic;
+    struct madt_override *override;
+
+    madt = acpi_find_madt();
+
+    if (!madt) {
+        return false;
+    }
+
+    addr = (uintptr_t)(madt + 1);
+    end = (uintptr_t)madt + madt->header.length;
+
+    while (addr + sizeof(struct madt_entry) <= end) {
+        entry = (struct madt_entry*)addr;
+
+        if (entry->length == 0) {
+            break;
+        }
+
+        if (entry->type == MADT_LAPIC && mp_napics < MAXCPU) {
+            lapic = (struct madt_lapic*)entry;
+
+            if (lapic->flags & MADT_LAPIC_ENABLED) {
+                mp_apic_ids[mp_napics++] = lapic->apic_id;
+            }
+        }
+
+        if (entry->type == MADT_IOAPIC) {
+            ioapic = (struct madt_ioapic*)entry;
+            ioapic_add(ioapic->ioapic_id, ioapic->ioapic_addr, ioapic->gsi_base);
+        }
+
+        if (entry->type == MADT_OVERRIDE) {
+            override = (struct madt_override*)entry;
+            ioapic_override(override->source, override->gsi, override->flags);
+        }
+
+        addr += entry->length;
+    }
+
+    lapic_base = madt->lapic_addr;
+
+    return true;
+}
+
+/* where application processors end up once the trampoline enabled paging */
+static void
+smp_ap_main(struct cpu *ci)
+{
+    /* defined in sys/i686/kern/interrupt.c */
+    extern void gdt_init(struct cpu *);
+    extern void idt_load();
+
+    /* defined in sys/i686/kern/syscall_dispatch.c */
+    extern void sysenter_init();
+
+    gdt_init(ci);
+    idt_load();
+    sysenter_init();
+    fpu_enable();
+    lapic_init(false);
+
+    ci->ci_running = true;
+
+    asm volatile("sti");
+
+    for (;;) {
+        thread_yield();
+    }
+}
+
+static bool
+smp_start_cpu(struct cpu *ci, struct mp_boot_args *args)
+{
+    int i;
+    uint8_t *stack;
+    struct thread *idle;
+
+    stack = calloc(1, MP_STACK_SIZE);
+    idle = sched_idle_thread(ci, (uintptr_t)stack, (uintptr_t)stack + MP_STACK_SIZE);
+
+    args->cr3 = ci->ci_page_dir;
+    args->esp = idle->stack_top;
+    args->entry = (uint32_t)smp_ap_main;
+    args->cpu = (uint32_t)ci;
+
+    lapic_ipi(ci->ci_md.cm_apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT);
+    mp_delay(10000);
+    lapic_ipi(ci->ci_md.cm_apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+    mp_delay(10000);
+
+    for (i = 0; i < 2 && !ci->ci_running; i++) {
+        lapic_ipi(ci->ci_md.cm_apic_id, LAPIC_ICR_STARTUP | (MP_BOOT_ADDR >> 12));
+        mp_delay(200);
+    }
+
+    /* give it 100ms to get through the trampoline */
+    for (i = 0; i < 1000 && !ci->ci_running; i++) {
+        mp_delay(100);
+    }
+
+    if (ci->ci_running) {
+        return true;
+    }
+
+    /* park it in wait-for-SIPI so a late start can't run on the freed stack */
+    lapic_ipi(ci->ci_md.cm_apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT);
+    mp_delay(10000);
+    lapic_ipi(ci->ci_md.cm_apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+
+    ci->ci_idle = NULL;
+    ci->ci_thread = NULL;
+
+    free(idle);
+    free(stack);
+
+    return false;
+}
+
+/* called by _preinit() once the scheduler is initialized */
+void
+smp_init()
+{
+    struct cpu *bsp;
+
+    bsp = curcpu();
+    bsp->ci_running = true;
+
+    if (!smp_probe() || !lapic_base) {
+        return;
+    }
+
+    if (vm_map_device(lapic_base, PAGE_SIZE) != 0) {
+        lapic_base = 0;
+        return;
+    }
+
+    lapic_init(true);
+    lapic_timer_calibrate();
+
+    bsp->ci_md.cm_apic_id = lapic_id();
+
+    /* with the PICs masked, nothing arrives through LINT0 anymore */
+    if (ioapic_init(bsp->ci_md.cm_apic_id)) {
+        lapic_write(LAPIC_LVT_LINT0, LAPIC_LVT_MASKED);
+    }
+}
+
+void
+smp_start(int max)
+{
+    int i;
+    struct cpu *bsp;
+    struct cpu *ci;
+    struct mp_boot_args *args;
+
+    bsp = curcpu();
+
+    if (mp_napics < 2 || max < 2) {
+        return;
+    }
+
+    memcpy((void*)PTOKVA(MP_BOOT_ADDR), mp_boot_start, mp_boot_end - mp_boot_start);
+
+    args = (struct mp_boot_args*)PTOKVA(MP_BOOT_ADDR + (mp_boot_args - mp_boot_start));
+
+    vm_map_bootstrap(sched_kernel_space, true);
+
+    for (i = 0; i < mp_napics && ncpus < max && ncpus < MAXCPU; i++) {
+        if (mp_apic_ids[i] == bsp->ci_md.cm_apic_id) {
+            continue;
+        }
+
+        ci = &cpus[ncpus];
+        ci->ci_id = ncpus;
+        ci->ci_md.cm_apic_id = mp_apic_ids[i];
+
+        if (!smp_start_cpu(ci, args)) {
+            printf("smp: cpu with APIC ID %d did not start\n\r", mp_apic_ids[i]);
+            continue;
+        }
+
+        ncpus++;
+    }
+
+    vm_map_bootstrap(sched_kernel_space, false);
+    smp_tlb_shootdown((uintptr_t)sched_kernel_space->state_physical);
+
+    printf("smp: %d processors running\n\r", ncpus);
+}
+
+void
+smp_resched(struct cpu *ci)
+{
+    if (ci != curcpu() && ci->ci_running) {
+        lapic_ipi(ci->ci_md.cm_apic_id, LAPIC_VEC_RESCHED);
+    }
+}
+
+/* called from the TLB shootdown IPI, and by CPUs waiting for the giant lock */
+void
+smp_tlb_flush()
+{
+    struct cpu *ci;
+
+    ci = curcpu();
+
+    if (ci->ci_tlb_flush) {
+        asm volatile("mov %%cr3, %%eax; mov %%eax, %%cr3" ::: "eax", "memory");
+        ci->ci_tlb_flush = false;
+    }
+}
+
+/*
+ * makes every other CPU using the page directory drop its TLB and waits until
+ * they did. Only called with the giant lock held
+ */
+void
+smp_tlb_shootdown(uintptr_t page_dir)
+{
+    int i;
+    struct cpu *ci;
+    struct cpu *self;
+
+    if (ncpus == 1) {
+        return;
+    }
+
+    self = curcpu();
+
+    for (i = 0; i < ncpus; i++) {
+        ci = &cpus[i];
+
+        if (ci == self || !ci->ci_running || ci->ci_page_dir != page_dir) {
+            continue;
+        }
+
+        ci->ci_tlb_flush = true;
+        lapic_ipi(ci->ci_md.cm_apic_id, LAPIC_VEC_TLB);
+    }
+
+    for (i = 0; i < ncpus; i++) {
+        while (cpus[i].ci_tlb_flush) {
+            cpu_pause();
+        }
+    }
+}
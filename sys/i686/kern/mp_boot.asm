@@ -0,0 +1,98 @@
+; mp_boot.asm - application processor trampoline
+;
+; smp_start() copies everything between mp_boot_start and mp_boot_end to
+; MP_BOOT_ADDR and fills in mp_boot_args before sending the startup IPI, which
+; makes the processor begin here in real mode. Nothing in here may depend on
+; where it was linked, so addresses are computed relative to MP_BOOT_ADDR
+;
+; This program is free software; you can redistribute it and/or modify
+; it under the terms of the GNU General Public License as published by
+; the Free Software Foundation; either version 2 of the License, or
+; (at your option) any later version.
+;
+; This program is distributed in the hope that it will be useful,
+; but WITHOUT ANY WARRANTY; without even the implied warranty of
+; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+; GNU General Public License for more details.
+;
+; You should have received a copy of the GNU General Public License along
+; with this program; if not, write to the Free Software Foundation, Inc.,
+; 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+%define MP_BOOT_ADDR    0x7000
+%define REL(x)          ((x) - mp_boot_start + MP_BOOT_ADDR)
+
+global mp_boot_start
+global mp_boot_end
+global mp_boot_args
+
+section .text
+
+[bits 16]
+mp_boot_start:
+    cli
+    cld
+
+    xor ax, ax
+    mov ds, ax
+
+    lgdt [REL(mp_boot_gdt_ptr)]
+
+    ; protected mode, with caching enabled (CD and NW clear)
+    mov eax, cr0
+    and eax, 0x9FFFFFFF
+    or eax, 0x00000001
+    mov cr0, eax
+
+    jmp dword 0x08:REL(mp_boot_pmode)
+
+[bits 32]
+mp_boot_pmode:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    ; the kernel is mapped with 4MB pages
+    mov eax, cr4
+    or eax, 0x00000010
+    mov cr4, eax
+
+    ; smp_start() identity maps the first 4MB so we survive turning paging on
+    mov eax, [REL(mp_boot_args.cr3)]
+    mov cr3, eax
+
+    mov eax, cr0
+    or eax, 0x80000000
+    mov cr0, eax
+
+    mov esp, [REL(mp_boot_args.esp)]
+
+    push dword [REL(mp_boot_args.cpu)]
+    call [REL(mp_boot_args.entry)]
+
+.halt:
+    cli
+    hlt
+    jmp .halt
+
+align 8
+mp_boot_gdt:
+    dq 0x0000000000000000
+    dq 0x00CF9A000000FFFF   ; kernel code
+    dq 0x00CF92000000FFFF   ; kernel data
+
+mp_boot_gdt_ptr:
+    dw mp_boot_gdt_ptr - mp_boot_gdt - 1
+    dd REL(mp_boot_gdt)
+
+; must match struct mp_boot_args in sys/i686/kern/mp.c
+mp_boot_args:
+.cr3:       dd 0
+.esp:       dd 0
+.entry:     dd 0
+.cpu:       dd 0
+
+mp_boot_end:
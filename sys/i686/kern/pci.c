@@ -1,4 +1,9 @@
+#include <machine/cpu.h>
+#include <machine/lapic.h>
+#include <machine/pci.h>
 #include <machine/portio.h>
+#include <machine/vm.h>
+#include <sys/cpu.h>
 #include <sys/device.h>
 #include <sys/malloc.h>
 #include <sys/systm.h>
@@ -197,6 +202,182 @@ pci_get_config32(struct device *dev, int offset)
     return pci_read_long(pcidev->bus, pcidev->slot, pcidev->func, offset);
 }
 
+void
+pci_set_config16(struct device *dev, int offset, uint16_t val)
+{
+    int shift;
+    uint32_t word;
+    struct pci_device *pcidev;
+
+    if (dev->type != DEVICE_PCI) {
+        return;
+    }
+
+    pcidev = (struct pci_device*)dev;
+
+    /* configuration space is only written a dword at a time */
+    shift = (offset & 2) << 3;
+    word = pci_read_long(pcidev->bus, pcidev->slot, pcidev->func, offset & 0xFC);
+    word = (word & ~(0xFFFF << shift)) | ((uint32_t)val << shift);
+
+    pci_write_long(pcidev->bus, pcidev->slot, pcidev->func, offset, word);
+}
+
+void
+pci_set_config32(struct device *dev, int offset, uint32_t val)
+{
+    struct pci_device *pcidev;
+
+    if (dev->type != DEVICE_PCI) {
+        return;
+    }
+
+    pcidev = (struct pci_device*)dev;
+
+    pci_write_long(pcidev->bus, pcidev->slot, pcidev->func, offset, val);
+}
+
+/* offset of a capability in configuration space, or 0 if there's none */
+int
+pci_find_capability(struct device *dev, int id)
+{
+    int i;
+    int offset;
+
+    if (!(pci_get_config16(dev, PCI_CONFIG_STATUS) & PCI_STATUS_CAPLIST)) {
+        return 0;
+    }
+
+    offset = pci_get_config8(dev, PCI_CONFIG_CAPPTR) & 0xFC;
+
+    /* the list is bounded by the size of configuration space */
+    for (i = 0; i < 48 && offset; i++) {
+        if (pci_get_config8(dev, offset) == id) {
+            return offset;
+        }
+
+        offset = pci_get_config8(dev, offset + 1) & 0xFC;
+    }
+
+    return 0;
+}
+
+/* messages go to the bootstrap processor, same as the I/O APIC's routes */
+static uint32_t
+pci_msi_address()
+{
+    return LAPIC_DEFAULT_BASE | ((uint32_t)cpus[0].ci_md.cm_apic_id << 12);
+}
+
+/*
+ * makes the device signal a single vector by writing to the local APIC
+ * instead of asserting its interrupt line
+ */
+int
+pci_enable_msi(struct device *dev, int vector)
+{
+    int cap;
+    uint16_t control;
+
+    cap = pci_find_capability(dev, PCI_CAP_MSI);
+
+    if (!cap || !lapic_base) {
+        return -1;
+    }
+
+    control = pci_get_config16(dev, cap + 2);
+
+    pci_set_config32(dev, cap + 4, pci_msi_address());
+
+    if (control & PCI_MSI_64BIT) {
+        pci_set_config32(dev, cap + 8, 0);
+        pci_set_config16(dev, cap + 12, vector);
+    } else {
+        pci_set_config16(dev, cap + 8, vector);
+    }
+
+    /* one message only */
+    control &= ~PCI_MSI_MME_MASK;
+    control |= PCI_MSI_ENABLE;
+
+    pci_set_config16(dev, cap + 2, control);
+
+    return 0;
+}
+
+/*
+ * programs the first nvec entries of the device's MSI-X table with the given
+ * vectors. Returns -1 if the device can't do it, in which case it's left
+ * using its interrupt line
+ */
+int
+pci_enable_msix(struct device *dev, int nvec, int *vectors)
+{
+    int bar;
+    int cap;
+    int i;
+    int table_size;
+    uint16_t control;
+    uint32_t table;
+    uintptr_t base;
+    volatile uint32_t *entry;
+
+    cap = pci_find_capability(dev, PCI_CAP_MSIX);
+
+    if (!cap || !lapic_base) {
+        return -1;
+    }
+
+    control = pci_get_config16(dev, cap + 2);
+    table_size = (control & PCI_MSIX_TABLE_SIZE) + 1;
+
+    if (nvec > table_size) {
+        return -1;
+    }
+
+    table = pci_get_config32(dev, cap + 4);
+    bar = table & PCI_MSIX_BIR;
+
+    if (bar > 5) {
+        return -1;
+    }
+
+    base = PCI_MEM_BASE(pci_get_config32(dev, PCI_CONFIG_BAR0 + bar*4));
+    base += table & ~PCI_MSIX_BIR;
+
+    if (vm_map_device(base, table_size*16) != 0) {
+        return -1;
+    }
+
+    /* keep the function masked while the table is filled in */
+    pci_set_config16(dev, cap + 2, control | PCI_MSIX_ENABLE | PCI_MSIX_MASK);
+
+    for (i = 0; i < nvec; i++) {
+        entry = (volatile uint32_t*)(base + i*16);
+        entry[0] = pci_msi_address();
+        entry[1] = 0;
+        entry[2] = vectors[i];
+        entry[3] = 0;
+    }
+
+    pci_set_config16(dev, cap + 2, (control | PCI_MSIX_ENABLE) & ~PCI_MSIX_MASK);
+
+    return 0;
+}
+
+/* back to the interrupt line */
+void
+pci_disable_msix(struct device *dev)
+{
+    int cap;
+
+    cap = pci_find_capability(dev, PCI_CAP_MSIX);
+
+    if (cap) {
+        pci_set_config16(dev, cap + 2, pci_get_config16(dev, cap + 2) & ~PCI_MSIX_ENABLE);
+    }
+}
+
 bool
 pci_enumerate_device(uint8_t bus, uint8_t slot, uint8_t func)
 {
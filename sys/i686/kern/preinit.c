@@ -19,6 +19,7 @@
 #include <machine/elf32.h>
 #include <machine/multiboot.h>
 #include <machine/vm.h>
+#include <sys/bootstage.h>
 #include <sys/cdev.h>
 #include <sys/interrupt.h>
 #include <sys/malloc.h>
@@ -65,11 +66,17 @@ ksym_init()
         sym = &all_syms[i];
         name = &all_strings[sym->st_name];
 
-        if (name) {
-            ksym_declare(name, sym->st_value);
+        /* sections and source files would only get in the way of address lookups */
+        if (!*name || sym->st_shndx == SHN_UNDEF || ELF32_ST_TYPE(sym->st_info) == STT_SECTION ||
+            ELF32_ST_TYPE(sym->st_info) == STT_FILE)
+        {
+            continue;
         }
+
+        ksym_declare(name, sym->st_value);
     }
 
+    ksym_sort();
 }
 
 void
@@ -79,17 +86,22 @@ _preinit(multiboot_info_t *multiboot_hdr)
     extern struct cdev serial0_device;
 
     extern void machine_dev_init();
-    extern void vm_init();
+    extern void vm_init(uintptr_t);
     extern void intr_init();
     extern void syscall_init();
     extern void traps_init();
+    extern void fpu_init();
     extern void sched_init();
+    extern void smp_init();
+    extern void gdt_init(struct cpu *);
 
     int i;
     uint32_t avail_memory;
     uint32_t initrd;
     uint32_t heap;
     uint32_t real_memory;
+    uint64_t end;
+    uintptr_t phys_end;
 
     const char *args;
 
@@ -98,6 +110,12 @@ _preinit(multiboot_info_t *multiboot_hdr)
 
     bus_interrupts_off();
 
+    /* per-CPU data must be reachable before anything takes a lock */
+    gdt_init(&cpus[0]);
+    giant_enter();
+
+    bootstage("preinit");
+
     start_initramfs = (void*)(initrd);
     multiboot_header = multiboot_hdr;
 
@@ -115,6 +133,7 @@ _preinit(multiboot_info_t *multiboot_hdr)
 
     real_memory = 0;
     avail_memory = 0;
+    phys_end = 0;
 
     for (i = 0; i < multiboot_hdr->mmap_length; i+= sizeof(struct multiboot_mmap_entry)) {
         struct multiboot_mmap_entry * entry;
@@ -124,6 +143,13 @@ _preinit(multiboot_info_t *multiboot_hdr)
         if (entry->type == 1) {
             printf("  %p-%p\n\r", (int)entry->addr, (int)(entry->addr+entry->len));
             avail_memory += entry->len;
+
+            end = entry->addr + entry->len;
+
+            /* frames are carved from the region the kernel heap ends in */
+            if (entry->addr <= KVATOP(heap) && end > KVATOP(heap)) {
+                phys_end = end > 0xFFFFF000 ? 0xFFFFF000 : (uintptr_t)end;
+            }
         }
         
         real_memory += entry->len;
@@ -133,9 +159,11 @@ _preinit(multiboot_info_t *multiboot_hdr)
     printf("avail mem = %d KB\n\r", avail_memory / 1024);
 
     /* initialize virtual memory first*/
-    vm_init();
+    bootstage("vm_init");
+    vm_init(phys_end);
 
     /* next comes interrupts */
+    bootstage("intr_init");
     intr_init();
 
     /* now register our syscall dispatcher */
@@ -144,10 +172,19 @@ _preinit(multiboot_info_t *multiboot_hdr)
     /* now exception handlers */
     traps_init();
 
+    /* the FPU traps on first use, so it needs its handler first */
+    fpu_init();
+
     /* finally, the scheduler */
+    bootstage("sched_init");
     sched_init();
 
+    /* find the other processors; they're started once kmain() is running */
+    bootstage("smp_init");
+    smp_init();
+
     /* I should move this somewhere else */
+    bootstage("devices");
     machine_dev_init();
 
     args = (const char *)PTOKVA(multiboot_header->cmdline);
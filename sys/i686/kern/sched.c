@@ -16,90 +16,446 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <ds/list.h>
+#include <machine/fpu.h>
 #include <machine/portio.h>
 #include <machine/reg.h>
+#include <sys/cpu.h>
+#include <sys/errno.h>
 #include <sys/interrupt.h>
 #include <sys/malloc.h>
 #include <sys/proc.h>
+#include <sys/prof.h>
+#include <sys/softirq.h>
 #include <sys/string.h>
+#include <sys/sysctl.h>
+#include <sys/systm.h>
 #include <sys/timer.h>
+#include <sys/trace.h>
+#include <sys/vdso.h>
 #include <sys/vm.h>
 
-// list of processes to run
-struct list         run_queue;
+/* defined in sys/i686/kern/interrupt.c */
+extern void set_tss_esp0(uint32_t esp0);
+extern uint32_t intr_counts[];
+
+/* how often the bootstrap processor evens out the run queues */
+#define SCHED_BALANCE_HZ    10
+
+#define SCHED_ALLOWED(thread, ci)   (((thread)->affinity >> (ci)->ci_id) & 1)
+
 struct list         dead_threads;
 
-struct proc *       current_proc;
-struct vm_space *   sched_curr_address_space;
-struct thread *     sched_curr_thread;
+/* address space of the idle threads */
+struct vm_space *   sched_kernel_space;
 
-uintptr_t           sched_curr_page_dir;
+static struct work  sched_reap_work;
 
 uint32_t            sched_ticks     = 0;
 uint32_t            sched_hz        = 1000;
 
+/* frees threads that died; runs from a worker rather than inside the switch */
 static void
-sched_reap_threads()
+sched_reap_threads(struct work *work, void *argp)
 {
+    int enabled;
     list_iter_t iter;
+    struct list reaped;
     struct thread *thread;
 
+    /* threads die from interrupt context, which must not find the list locked */
+    enabled = intr_save();
+
+    memset(&reaped, 0, sizeof(struct list));
+
     list_get_iter(&dead_threads, &iter);
 
     while (iter_move_next(&iter, (void**)&thread)) {
+        /* another CPU may still be on its way out of it */
+        if (!thread->cpu) {
+            list_append(&reaped, thread);
+        }
+    }
+
+    iter_close(&iter);
+
+    list_get_iter(&reaped, &iter);
+
+    while (iter_move_next(&iter, (void**)&thread)) {
+        list_remove(&dead_threads, thread);
+        fpu_release(thread);
         thread_destroy(thread);
     }
 
     iter_close(&iter);
-    list_destroy(&dead_threads, false);
+    list_destroy(&reaped, false);
+
+    intr_restore(enabled);
 }
 
-int
-sched_get_next_proc(uintptr_t prev_esp)
+/* queued threads plus the one running, unless it's the idle thread */
+static int
+sched_load(struct cpu *ci)
+{
+    return LIST_SIZE(&ci->ci_runq) + (ci->ci_thread != ci->ci_idle);
+}
+
+static void
+sched_enqueue(struct cpu *ci, struct thread *thread)
+{
+    if (thread->runq) {
+        return;
+    }
+
+    thread->runq = ci;
+    list_append(&ci->ci_runq, thread);
+
+    /* an idle CPU would otherwise sit on it until its next tick */
+    if (ci->ci_thread == ci->ci_idle) {
+        smp_resched(ci);
+    }
+}
+
+static void
+sched_dequeue(struct thread *thread)
+{
+    if (thread->runq) {
+        list_remove(&thread->runq->ci_runq, thread);
+        thread->runq = NULL;
+    }
+}
+
+/*
+ * picks the run queue for a thread that became runnable. The CPU it last ran
+ * on is preferred as long as it isn't noticeably busier than the least loaded
+ * one, since its cache probably still holds some of the thread's working set
+ */
+static struct cpu *
+sched_place(struct thread *thread)
+{
+    int i;
+    struct cpu *best;
+    struct cpu *ci;
+    struct cpu *last;
+
+    /* still on its way out of another CPU, which must be the one to requeue it */
+    if (thread->cpu) {
+        return thread->cpu;
+    }
+
+    best = NULL;
+
+    for (i = 0; i < ncpus; i++) {
+        ci = &cpus[i];
+
+        if (!ci->ci_running || !SCHED_ALLOWED(thread, ci)) {
+            continue;
+        }
+
+        if (!best || sched_load(ci) < sched_load(best)) {
+            best = ci;
+        }
+    }
+
+    if (!best) {
+        return curcpu();
+    }
+
+    last = thread->last_cpu;
+
+    if (last && last->ci_running && SCHED_ALLOWED(thread, last) &&
+        sched_load(last) <= sched_load(best) + 1)
+    {
+        return last;
+    }
+
+    return best;
+}
+
+/*
+ * takes the queued thread that most recently ran elsewhere from the CPU with
+ * the longest queue. Queues of idle CPUs are left alone, they're about to run
+ */
+static struct thread *
+sched_steal(struct cpu *ci)
+{
+    int i;
+    struct cpu *victim;
+    struct cpu *other;
+    struct list_elem *elem;
+    struct thread *thread;
+
+    victim = NULL;
+
+    for (i = 0; i < ncpus; i++) {
+        other = &cpus[i];
+
+        if (other == ci || !other->ci_running || other->ci_thread == other->ci_idle) {
+            continue;
+        }
+
+        if (LIST_SIZE(&other->ci_runq) > 0 &&
+            (!victim || LIST_SIZE(&other->ci_runq) > LIST_SIZE(&victim->ci_runq)))
+        {
+            victim = other;
+        }
+    }
+
+    if (!victim) {
+        return NULL;
+    }
+
+    /* the tail was queued last and is the least likely to be cache hot */
+    for (elem = victim->ci_runq.tail; elem; elem = elem->prev_elem) {
+        thread = elem->data;
+
+        if (!thread->cpu && SCHED_ALLOWED(thread, ci)) {
+            sched_dequeue(thread);
+            ci->ci_steals++;
+            return thread;
+        }
+    }
+
+    return NULL;
+}
+
+/* moves a thread from the busiest to the least busy CPU if they differ by two */
+static void
+sched_balance()
+{
+    int i;
+    struct cpu *busiest;
+    struct cpu *idlest;
+    struct cpu *ci;
+    struct list_elem *elem;
+    struct thread *thread;
+
+    busiest = NULL;
+    idlest = NULL;
+
+    for (i = 0; i < ncpus; i++) {
+        ci = &cpus[i];
+
+        if (!ci->ci_running) {
+            continue;
+        }
+
+        if (!busiest || sched_load(ci) > sched_load(busiest)) {
+            busiest = ci;
+        }
+
+        if (!idlest || sched_load(ci) < sched_load(idlest)) {
+            idlest = ci;
+        }
+    }
+
+    if (!busiest || sched_load(busiest) - sched_load(idlest) < 2) {
+        return;
+    }
+
+    for (elem = busiest->ci_runq.tail; elem; elem = elem->prev_elem) {
+        thread = elem->data;
+
+        if (!thread->cpu && SCHED_ALLOWED(thread, idlest)) {
+            sched_dequeue(thread);
+            sched_enqueue(idlest, thread);
+            idlest->ci_migrations++;
+            return;
+        }
+    }
+}
+
+static struct thread *
+sched_pick(struct cpu *ci)
 {
-    /* defined in sys/i686/kern/interrupt.c */
-    extern void set_tss_esp0(uint32_t esp0);
+    struct thread *thread;
+
+    if (list_remove_front(&ci->ci_runq, (void**)&thread)) {
+        thread->runq = NULL;
+        return thread;
+    }
+
+    return sched_steal(ci);
+}
 
+/* called with the giant lock held; the caller drops it once on the new stack */
+static int
+sched_switch(struct cpu *ci, uintptr_t prev_esp)
+{
     struct thread *next_thread;
+    struct thread *prev_thread;
 
-    timer_tick();
+    /* a tick arriving while softirqs run only gets counted */
+    if (ci->ci_softirq_active) {
+        return prev_esp;
+    }
 
-    sched_ticks++;
+    prev_thread = ci->ci_thread;
+    next_thread = sched_pick(ci);
+
+    /*
+     * a thread that went to sleep, or may no longer run here, is only kept on
+     * when there is no idle thread to switch to
+     */
+    if (!next_thread && prev_thread && ci->ci_idle &&
+        (prev_thread->state != SRUN || !SCHED_ALLOWED(prev_thread, ci)))
+    {
+        next_thread = ci->ci_idle;
+    }
+
+    if (next_thread && next_thread != prev_thread) {
+        TRACE(TRACE_SCHED_SWITCH, prev_thread ? prev_thread->tid : 0, next_thread->tid,
+                prev_thread ? prev_thread->state : 0);
 
-    if (list_remove_front(&run_queue, (void**)&next_thread) && next_thread != sched_curr_thread) {
-        
-        if (sched_curr_thread) {
-            sched_curr_thread->stack = prev_esp;
+        fpu_switch(ci, prev_thread);
 
-            if (sched_curr_thread->state == SRUN) {
-                
-                if (LIST_SIZE(&dead_threads) > 0) {
-                    sched_reap_threads();
-                }
+        if (prev_thread) {
+            prev_thread->stack = prev_esp;
+            prev_thread->giant_depth = ci->ci_giant_depth - 1;
+            prev_thread->cpu = NULL;
 
-                list_append(&run_queue, sched_curr_thread);
+            if (prev_thread->state == SDEAD) {
+                /* now that nothing runs on its stack anymore */
+                work_queue(&sched_reap_work);
+            } else if (prev_thread->state == SRUN && prev_thread != ci->ci_idle) {
+                sched_enqueue(SCHED_ALLOWED(prev_thread, ci) ? ci : sched_place(prev_thread), prev_thread);
             }
         }
 
-        sched_curr_address_space = next_thread->address_space;
-        sched_curr_thread = next_thread;
-        sched_curr_page_dir = (uintptr_t)next_thread->address_space->state_physical;
+        /* whatever share of the giant lock the thread had when it was switched out */
+        ci->ci_giant_depth = next_thread->giant_depth + 1;
+        ci->ci_switches++;
 
-        current_proc = next_thread->proc;
+        next_thread->cpu = ci;
+
+        if (next_thread != ci->ci_idle) {
+            next_thread->last_cpu = ci;
+        }
+
+        ci->ci_thread = next_thread;
+        ci->ci_space = next_thread->address_space;
+        ci->ci_page_dir = (uintptr_t)next_thread->address_space->state_physical;
+        ci->ci_proc = next_thread->proc;
 
         set_tss_esp0(next_thread->stack_top);
 
         return next_thread->stack;
     }
 
-    if (sched_curr_thread) {
-        current_proc = sched_curr_thread->proc;
-        set_tss_esp0(sched_curr_thread->stack_top);
+    if (prev_thread) {
+        ci->ci_proc = prev_thread->proc;
+        set_tss_esp0(prev_thread->stack_top);
     }
 
     return prev_esp;
 }
 
+/* hands the profiler where the timer found this CPU */
+static void
+sched_profile(struct cpu *ci, uintptr_t prev_esp)
+{
+    int depth;
+    uintptr_t pcs[KPROF_DEPTH];
+    struct switch_regs *regs;
+    struct thread *thread;
+
+    regs = (struct switch_regs*)prev_esp;
+    thread = ci->ci_thread;
+
+    pcs[0] = regs->eip;
+
+    /* user stacks can't be trusted to have frame pointers in them */
+    if (regs->cs & 3) {
+        prof_record(ci, pcs, 1, true);
+        return;
+    }
+
+    depth = 1;
+
+    if (thread) {
+        depth += stack_unwind(regs->ebp, thread->stack_base, thread->stack_top, &pcs[1], KPROF_DEPTH - 1);
+    }
+
+    prof_record(ci, pcs, depth, false);
+}
+
+/* the timer interrupt; see sched_switch_context in context_switch.asm */
+int
+sched_get_next_proc(uintptr_t prev_esp)
+{
+    giant_enter();
+
+    if (prof_enabled) {
+        sched_profile(curcpu(), prev_esp);
+    }
+
+    intr_counts[32]++;
+
+    /* acknowledged here rather than on the way out, so softirqs can be interrupted */
+    irq_eoi(32);
+
+    sched_ticks++;
+
+    vdso_tick();
+
+    if (ncpus > 1 && sched_ticks % (sched_hz / SCHED_BALANCE_HZ) == 0) {
+        sched_balance();
+    }
+
+    softirq_raise(SOFTIRQ_TIMER);
+    softirq_run();
+
+    return sched_switch(curcpu(), prev_esp);
+}
+
+/* local APIC timer of the application processors; time is only kept by the PIT */
+int
+sched_lapic_tick(uintptr_t prev_esp)
+{
+    giant_enter();
+
+    if (prof_enabled) {
+        sched_profile(curcpu(), prev_esp);
+    }
+
+    return sched_switch(curcpu(), prev_esp);
+}
+
+/* reschedule IPIs */
+int
+sched_resched(uintptr_t prev_esp)
+{
+    giant_enter();
+
+    return sched_switch(curcpu(), prev_esp);
+}
+
+/*
+ * makes the calling context the idle thread of a CPU. The bootstrap processor
+ * turns its boot stack into one; the others start out on theirs
+ */
+struct thread *
+sched_idle_thread(struct cpu *ci, uintptr_t stack_base, uintptr_t stack_top)
+{
+    struct thread *thread;
+
+    thread = calloc(1, sizeof(struct thread));
+
+    thread->affinity = CPU_MASK_ALL;
+    thread->address_space = sched_kernel_space;
+    thread->state = SRUN;
+    thread->cpu = ci;
+    thread->stack_base = stack_base;
+    thread->stack_top = stack_top;
+
+    ci->ci_idle = thread;
+    ci->ci_thread = thread;
+    ci->ci_space = sched_kernel_space;
+    ci->ci_page_dir = (uintptr_t)sched_kernel_space->state_physical;
+    ci->ci_proc = NULL;
+
+    return thread;
+}
+
 void
 thread_interrupt_enter(struct thread *thread, struct regs *regs)
 {
@@ -156,6 +512,10 @@ thread_run(kthread_entry_t entrypoint, struct vm_space *space, void *arg)
     }
 
     thread->state = SRUN;
+    thread->affinity = sched_curr_thread->affinity;
+
+    /* kernel code runs under the giant lock, so the thread starts out holding it */
+    thread->giant_depth = 1;
 
     stack_base = calloc(1, 65536);
     stack_top = &stack_base[16380];
@@ -174,23 +534,33 @@ thread_run(kthread_entry_t entrypoint, struct vm_space *space, void *arg)
     *--stack = 0;       /* EBP */
     *--stack = 0;       /* ESI */
     *--stack = 0;       /* EDI */
-    *--stack = 0x10;    /* GS */
+    *--stack = 0x10;    /* DS */
     *--stack = 0x10;    /* ES */
-    *--stack = 0x10;    /* FS */
+    *--stack = 0x30;    /* FS, the per-CPU segment */
     *--stack = 0x10;    /* GS  */
 
     thread->stack = (uintptr_t)stack;
     thread->stack_top = (uintptr_t)stack_top;
     thread->stack_base = (uintptr_t)stack_base;
 
-    list_append(&run_queue, thread);
+    sched_enqueue(sched_place(thread), thread);
 }
 
 void
 thread_yield()
 {
+    int depth;
+
+    /* other CPUs can have the kernel while this one waits */
+    bus_interrupts_off();
+    depth = giant_release_all();
+
     bus_interrupts_on();
     asm volatile("hlt");
+
+    bus_interrupts_off();
+    giant_reacquire(depth);
+    bus_interrupts_on();
 }
 
 void
@@ -200,16 +570,102 @@ thread_schedule(int state, struct thread *thread)
         return;
     }
 
+    if (state == SRUN) {
+        TRACE(TRACE_SCHED_WAKEUP, thread->tid, thread->state, 0);
+    }
+
     thread->state = state;
 
     switch (state) {
         case SRUN:
-            list_append(&run_queue, thread);
+            sched_enqueue(sched_place(thread), thread);
             break;
         case SDEAD:
+            sched_dequeue(thread);
             list_append(&dead_threads, thread);
             break;
+        default:
+            sched_dequeue(thread);
+            break;
+    }
+}
+
+/* the thread moves off a CPU it may no longer use the next time it's switched out */
+int
+sched_setaffinity(struct thread *thread, uint32_t mask)
+{
+    int i;
+    uint32_t usable;
+
+    usable = 0;
+
+    for (i = 0; i < ncpus; i++) {
+        if (cpus[i].ci_running) {
+            usable |= (1 << i);
+        }
+    }
+
+    if (!(mask & usable)) {
+        return -(EINVAL);
+    }
+
+    thread->affinity = mask;
+
+    if (thread->runq && !SCHED_ALLOWED(thread, thread->runq)) {
+        sched_dequeue(thread);
+        sched_enqueue(sched_place(thread), thread);
+    }
+
+    return 0;
+}
+
+static int
+sched_sysctl_cpus(void *buf, size_t *lenp)
+{
+    int i;
+    int maxentries;
+    struct cpu *ci;
+    struct kinfo_cpu *entries;
+
+    if (!buf && lenp) {
+        *lenp = ncpus*sizeof(struct kinfo_cpu);
+        return 0;
+    }
+
+    if (!lenp) {
+        return -(EINVAL);
+    }
+
+    maxentries = *lenp / sizeof(struct kinfo_cpu);
+    entries = buf;
+
+    for (i = 0; i < ncpus && i < maxentries; i++) {
+        ci = &cpus[i];
+
+        entries[i].id = ci->ci_id;
+        entries[i].running = ci->ci_running;
+        entries[i].runq_len = LIST_SIZE(&ci->ci_runq);
+        entries[i].switches = ci->ci_switches;
+        entries[i].steals = ci->ci_steals;
+        entries[i].migrations = ci->ci_migrations;
+    }
+
+    *lenp = i*sizeof(struct kinfo_cpu);
+
+    return 0;
+}
+
+int
+sched_sysctl(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    switch (name[0]) {
+        case KERN_SCHED_CPUS:
+            return sched_sysctl_cpus(oldp, oldlenp);
+        default:
+            break;
     }
+
+    return -1;
 }
 
 void
@@ -223,10 +679,14 @@ sched_init()
     io_write8(0x40, divisor & 0xFF);
     io_write8(0x40, (divisor >> 8) & 0xFF);
 
-    sched_curr_address_space = vm_space_new();
+    sched_kernel_space = vm_space_new();
+
+    work_init(&sched_reap_work, sched_reap_threads, NULL);
+    softirq_register(SOFTIRQ_TIMER, timer_tick);
 
-    memset(&run_queue, 0, sizeof(struct list));
+    /* whatever called us becomes the bootstrap processor's idle thread */
+    sched_idle_thread(curcpu(), 0, 0);
 
-    asm volatile("mov %0, %%cr3" :: "r"((uint32_t)sched_curr_address_space->state_physical));
+    asm volatile("mov %0, %%cr3" :: "r"((uint32_t)sched_kernel_space->state_physical));
     asm volatile("mov %cr3, %eax; mov %eax, %cr3;");
 }
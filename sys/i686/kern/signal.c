@@ -49,8 +49,6 @@ struct irq_regs {
 static uintptr_t *
 open_stack(struct thread *thread, uintptr_t esp)
 {
-    extern struct vm_space *sched_curr_address_space;
-
     uintptr_t stackp = (uintptr_t)vm_share(sched_curr_address_space,
             thread->address_space, NULL,
             (void*)(esp & 0xFFFFF000), 0x1000,
@@ -66,8 +64,6 @@ open_stack(struct thread *thread, uintptr_t esp)
 void
 thread_call_sa_handler(struct thread *thread, struct sigcontext *ctx)
 {
-    extern struct vm_space *sched_curr_address_space;
-
     struct irq_regs *regs;
 
     ctx->invoked = true;
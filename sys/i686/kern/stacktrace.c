@@ -44,3 +44,37 @@ stacktrace(int max_frames)
         frame = frame->prev;
     }
 }
+
+/*
+ * collects up to max return addresses by following saved frame pointers,
+ * starting at ebp. Frames outside of [stack_base, stack_top) end the walk, as
+ * whatever was interrupted may not have set its frame up yet
+ */
+int
+stack_unwind(uintptr_t ebp, uintptr_t stack_base, uintptr_t stack_top, uintptr_t *pcs, int max)
+{
+    int i;
+    struct stackframe *frame;
+
+    frame = (struct stackframe*)ebp;
+
+    for (i = 0; i < max; i++) {
+        if ((uintptr_t)frame < stack_base || (uintptr_t)frame + sizeof(*frame) > stack_top ||
+            ((uintptr_t)frame & 3) || !frame->eip)
+        {
+            break;
+        }
+
+        pcs[i] = frame->eip;
+
+        /* the stack grows down, so callers' frames are further up */
+        if ((uintptr_t)frame->prev <= (uintptr_t)frame) {
+            i++;
+            break;
+        }
+
+        frame = frame->prev;
+    }
+
+    return i;
+}
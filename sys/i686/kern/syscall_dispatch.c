@@ -15,14 +15,25 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
+#include <machine/cpufunc.h>
 #include <machine/reg.h>
+#include <sys/errno.h>
 #include <sys/interrupt.h>
+#include <sys/ktrace.h>
 #include <sys/proc.h>
 #include <sys/malloc.h>
 #include <sys/syscall.h>
+#include <sys/syscallstat.h>
+#include <sys/trace.h>
 #include <sys/types.h>
+#include <sys/vm.h>
 
-struct syscall *syscall_table[256];
+#define SYSCALL_TABLE_SIZE  256
+
+struct syscall *syscall_table[SYSCALL_TABLE_SIZE];
+
+/* without one, every call takes 0 cycles */
+static bool syscall_have_tsc;
 
 int
 register_syscall(int num, int argc, syscall_t handler)
@@ -40,17 +51,46 @@ register_syscall(int num, int argc, syscall_t handler)
     return 0;
 }
 
+static inline uint64_t
+syscall_clock()
+{
+    return syscall_have_tsc ? rdtsc() : 0;
+}
+
+/* runs a call and accounts for it; shared by both ways into the kernel */
+static inline int
+syscall_invoke(struct thread *th, struct syscall *syscall, int num, struct syscall_args *args)
+{
+    int ret;
+    uint64_t entry;
+    uint64_t exit;
+
+    TRACE(TRACE_SYSCALL_ENTER, num, args->args[0], args->args[1]);
+
+    entry = syscall_clock();
+    ret = syscall->handler(th, args);
+    exit = syscall_clock();
+
+    TRACE(TRACE_SYSCALL_EXIT, num, ret, 0);
+
+    syscall_stat_account(th->proc, num, ret, exit - entry);
+
+    if (__builtin_expect(th->proc->traced, 0)) {
+        ktrace_record(th, syscall, num, args, ret, entry, exit);
+    }
+
+    return ret;
+}
+
 int
 syscall_handler(int inum, struct regs *regs)
 {
-    extern struct thread *sched_curr_thread;
- 
     int syscall_num;
     int res;
     struct syscall *syscall;
 
     syscall_num = regs->eax;    
-    syscall = syscall_table[syscall_num];
+    syscall = (unsigned)syscall_num < SYSCALL_TABLE_SIZE ? syscall_table[syscall_num] : NULL;
 
     if (syscall) {
         uintptr_t arguments[16];
@@ -65,7 +105,7 @@ syscall_handler(int inum, struct regs *regs)
         args.args = (uintptr_t*)&arguments;
         args.state = regs;
 
-        res = syscall->handler(sched_curr_thread, &args);
+        res = syscall_invoke(sched_curr_thread, syscall, syscall_num, &args);
 
         regs->eax = res;
 
@@ -77,8 +117,107 @@ syscall_handler(int inum, struct regs *regs)
     return -1;
 }
 
+/*
+ * called from sysenter_entry in sys/i686/kern/sysenter.asm. This bypasses
+ * dispatch_intr() entirely; there is no PIC to acknowledge and no handler to
+ * look up. Userland passes the syscall number in EAX and the arguments in
+ * EBX, EBP, [ESP], ESI and EDI because ECX and EDX are taken by the user
+ * stack pointer and return address
+ */
+void
+syscall_fast_handler(struct regs *regs)
+{
+    uintptr_t arguments[5];
+    struct syscall *syscall;
+    struct syscall_args args;
+    struct thread *th;
+
+    giant_enter();
+
+    th = sched_curr_thread;
+
+    __sync_lock_test_and_set(&th->interrupt_in_progress, 1);
+    thread_interrupt_enter(th, regs);
+
+    syscall = regs->eax < SYSCALL_TABLE_SIZE ? syscall_table[regs->eax] : NULL;
+
+    if (!syscall) {
+        regs->eax = -1;
+        goto done;
+    }
+
+    arguments[0] = (uintptr_t)regs->ebx;
+    arguments[1] = (uintptr_t)regs->ebp;
+    arguments[2] = 0;
+    arguments[3] = (uintptr_t)regs->esi;
+    arguments[4] = (uintptr_t)regs->edi;
+
+    /* the third argument is the only one that costs a memory access */
+    if (syscall->argc >= 3) {
+        if (vm_access(th->address_space, (void*)regs->uesp, sizeof(uintptr_t), VM_READ)) {
+            regs->eax = -(EFAULT);
+            goto done;
+        }
+
+        arguments[2] = *(uintptr_t*)regs->uesp;
+    }
+
+    args.args = arguments;
+    args.state = regs;
+
+    regs->eax = syscall_invoke(th, syscall, regs->eax, &args);
+
+done:
+    thread_interrupt_leave(th, regs);
+    __sync_lock_test_and_set(&th->interrupt_in_progress, 0);
+
+    giant_exit();
+}
+
+/* called on every CPU, since each has its own TSS */
+void
+sysenter_init()
+{
+    /* defined in sys/i686/kern/interrupt.c */
+    extern uintptr_t get_tss_esp0_ptr();
+
+    /* defined in sys/i686/kern/sysenter.asm */
+    extern void sysenter_entry();
+
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+
+    if (!(edx & CPUID_SEP)) {
+        return;
+    }
+
+    /* the Pentium Pro sets SEP without actually implementing SYSENTER */
+    if (CPUID_FAMILY(eax) == 6 && CPUID_MODEL(eax) < 3 && CPUID_STEPPING(eax) < 3) {
+        return;
+    }
+
+    /* SS, and the user CS and SS for SYSEXIT, are implied by the GDT layout */
+    wrmsr(MSR_SYSENTER_CS, 0x08);
+    wrmsr(MSR_SYSENTER_ESP, get_tss_esp0_ptr());
+    wrmsr(MSR_SYSENTER_EIP, (uintptr_t)sysenter_entry);
+}
+
 void
 syscall_init()
 {
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+
+    syscall_have_tsc = (edx & CPUID_TSC) != 0;
+
     swi_register(0x80, syscall_handler);
+    sysenter_init();
 }
@@ -0,0 +1,92 @@
+; sysenter.asm - SYSENTER fast system call entry
+;
+; SYSENTER loads nothing but CS, SS, ESP and EIP, so userland hands us its
+; stack pointer in ECX and its return address in EDX. The first thing done
+; here is to build the same struct regs frame that int 0x80 would have built,
+; so everything past the entry (fork, signal delivery, sigrestore) keeps
+; working unchanged. On the way out SYSEXIT is used unless the frame was
+; redirected somewhere EDX and ECX can't describe, in which case the frame is
+; simply IRET'd like any other interrupt
+;
+; This program is free software; you can redistribute it and/or modify
+; it under the terms of the GNU General Public License as published by
+; the Free Software Foundation; either version 2 of the License, or
+; (at your option) any later version.
+;
+; This program is distributed in the hope that it will be useful,
+; but WITHOUT ANY WARRANTY; without even the implied warranty of
+; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+; GNU General Public License for more details.
+;
+; You should have received a copy of the GNU General Public License along
+; with this program; if not, write to the Free Software Foundation, Inc.,
+; 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+
+; offsets into struct regs once DS has been popped
+%define REGS_EDX    20
+%define REGS_ECX    24
+%define REGS_EIP    40
+%define REGS_UESP   52
+
+global sysenter_entry
+
+; defined in sys/i686/kern/syscall_dispatch.c
+extern syscall_fast_handler
+
+sysenter_entry:
+    ; MSR_SYSENTER_ESP points at esp0 in the TSS, which the scheduler keeps
+    ; pointed at the top of the current thread's kernel stack
+    mov esp, [esp]
+
+    push 0x23               ; ss
+    push ecx                ; user esp
+    pushfd
+    or dword [esp], 0x200   ; SYSENTER cleared IF
+    push 0x1B               ; cs
+    push edx                ; eip
+    push 0                  ; error code
+    push 0x80               ; inum
+    pusha
+
+    mov ax, ds
+    push eax
+
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov gs, ax
+    mov ax, 0x30
+    mov fs, ax
+
+    push esp
+
+    call syscall_fast_handler
+
+    add esp, 4
+
+    pop ebx
+    mov ds, bx
+    mov es, bx
+    mov fs, bx
+    mov gs, bx
+
+    ; SYSEXIT resumes at EDX with ESP = ECX
+    mov eax, [esp + REGS_EIP]
+    cmp eax, [esp + REGS_EDX]
+    jne .iret
+    mov eax, [esp + REGS_UESP]
+    cmp eax, [esp + REGS_ECX]
+    jne .iret
+
+    popa
+
+    ; STI only takes effect after the next instruction, so no interrupt can
+    ; arrive on the kernel stack between the two
+    sti
+    sysexit
+
+.iret:
+    popa
+    add esp, 8
+
+    iret
@@ -15,10 +15,12 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
+#include <machine/fpu.h>
 #include <machine/reg.h>
 #include <sys/interrupt.h>
 #include <sys/proc.h>
 #include <sys/systm.h>
+#include <sys/trace.h>
 
 #define DIVIDE_BY_ZERO              0x00
 #define DEBUG                       0x01
@@ -37,6 +39,7 @@
 #define FLOATING_POINT_EXCEPTION    0x10
 #define ALIGNMENT_CHECK             0x11
 #define MACHINE_CHECK               0x12
+#define SIMD_FP_EXCEPTION           0x13
 #define VIRTUALIZATION_EXCEPTION    0x14
 
 static const char *exceptions[] = {
@@ -104,10 +107,10 @@ handle_page_fault(int inum, struct regs *regs)
 
     asm volatile("movl %%cr2, %%edx": "=d"(fault_addr));
 
+    TRACE(TRACE_PAGE_FAULT, fault_addr, err, regs->eip);
+
     if (user) {
         /* send SIGSEGV to program */
-        extern struct proc *current_proc;
-
         printf("%s[%d] segfault at %p ip: %p sp %p\n\r", current_proc->name,
                 current_proc->pid, fault_addr, regs->eip, regs->uesp);
 
@@ -138,6 +141,28 @@ handle_page_fault(int inum, struct regs *regs)
     
     return 0;
 }
+static int
+handle_device_not_avail(int inum, struct regs *regs)
+{
+    fpu_trap();
+
+    return 0;
+}
+
+/* unmasked x87 and SIMD exceptions */
+static int
+handle_fpu_exception(int inum, struct regs *regs)
+{
+    if ((regs->cs & 0x03) != 0x03) {
+        panic("floating point exception in kernel mode");
+    }
+
+    /* SIGFPE */
+    proc_kill(current_proc, 8);
+
+    return 0;
+}
+
 static void
 print_stack(struct regs *regs, int max_fames)
 {
@@ -191,5 +216,8 @@ traps_init()
         swi_register(i, handle_generic_exception);
     }
 
-    swi_register(14, handle_page_fault);
+    swi_register(DEVICE_NOT_AVAIL, handle_device_not_avail);
+    swi_register(PAGE_FAULT, handle_page_fault);
+    swi_register(FLOATING_POINT_EXCEPTION, handle_fpu_exception);
+    swi_register(SIMD_FP_EXCEPTION, handle_fpu_exception);
 }
@@ -16,9 +16,17 @@
 
 global return_to_usermode
 
+; defined in sys/i686/kern/crit.c
+extern giant_release_all
+
 return_to_usermode:
     push ebp
     mov ebp, esp
+
+    ; we never come back here, so nothing is left to release the giant lock
+    cli
+    call giant_release_all
+
     mov ebx, [ebp + 0x08]
     mov ecx, [ebp + 0x0C]
     mov edx, [ebp + 0x10]
@@ -32,6 +40,7 @@ return_to_usermode:
     push 0x23
     push ecx
     pushf
+    or dword [esp], 0x200   ; cleared above
     push 0x1B;
     push ebx
     mov ebp, edx
@@ -0,0 +1,146 @@
+/*
+ * vdso.c - pages shared read-only with userland
+ *
+ * Every address space gets two pages at VDSO_BASE: one holding the clock,
+ * which is the same physical page everywhere, and one holding the process
+ * and thread IDs of that address space. The clock is published as the tick
+ * count along with the TSC value of the last tick, which lets userland
+ * interpolate between ticks. The TSC rate is calibrated against the timer
+ * once a second
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <machine/cpufunc.h>
+#include <sys/sched.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/vdso.h>
+#include <sys/vm.h>
+
+#define VDSO_BARRIER() asm volatile("" ::: "memory")
+
+static void *               vdso_time_page;
+static struct vdso_time *   vdso_time;
+
+static bool                 vdso_have_tsc;
+static uint64_t             vdso_calib_tsc;
+static uint32_t             vdso_calib_ticks;
+
+static void
+vdso_init()
+{
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+
+    vdso_have_tsc = (edx & CPUID_TSC) != 0;
+    vdso_time_page = vm_page_alloc_kernel();
+    vdso_time = vm_page_kva(vdso_time_page);
+    vdso_time->vt_hz = sched_hz;
+}
+
+/* called after time_delta was changed by adjtime() */
+void
+vdso_adjtime()
+{
+    if (!vdso_time) {
+        return;
+    }
+
+    vdso_time->vt_seq++;
+    VDSO_BARRIER();
+
+    vdso_time->vt_delta_sec = time_delta.tv_sec;
+    vdso_time->vt_delta_usec = time_delta.tv_usec;
+
+    VDSO_BARRIER();
+    vdso_time->vt_seq++;
+}
+
+/* called from the timer interrupt, after sched_ticks was advanced */
+void
+vdso_tick()
+{
+    uint32_t elapsed;
+    uint64_t cycles;
+    uint64_t now;
+
+    if (!vdso_time) {
+        return;
+    }
+
+    now = vdso_have_tsc ? rdtsc() : 0;
+    elapsed = sched_ticks - vdso_calib_ticks;
+
+    vdso_time->vt_seq++;
+    VDSO_BARRIER();
+
+    if (vdso_have_tsc && elapsed >= sched_hz) {
+        cycles = now - vdso_calib_tsc;
+
+        /* the first interval started before the TSC was ever sampled */
+        if (vdso_calib_tsc && cycles > 0) {
+            vdso_time->vt_tsc_mult = (((uint64_t)elapsed * 1000000 / sched_hz) << 32) / cycles;
+        }
+
+        vdso_calib_tsc = now;
+        vdso_calib_ticks = sched_ticks;
+    }
+
+    vdso_time->vt_ticks = sched_ticks;
+    vdso_time->vt_tsc = now;
+
+    VDSO_BARRIER();
+    vdso_time->vt_seq++;
+}
+
+void
+vdso_map(struct vm_space *space)
+{
+    void *pages[2];
+
+    if (!vdso_time_page) {
+        vdso_init();
+    }
+
+    space->vdso = vm_page_alloc_kernel();
+
+    pages[0] = vdso_time_page;
+    pages[1] = space->vdso;
+
+    vm_map_pages(space, (void*)VDSO_BASE, pages, 2, VM_READ);
+}
+
+void
+vdso_setids(struct vm_space *space, pid_t pid, pid_t tid)
+{
+    struct vdso_proc *vp;
+
+    vp = vm_page_kva(space->vdso);
+    vp->vp_pid = pid;
+    vp->vp_tid = tid;
+}
+
+/* drops the address space's own page once its mapping is gone */
+void
+vdso_unmap(struct vm_space *space)
+{
+    vm_page_release(space->vdso);
+
+    space->vdso = NULL;
+}
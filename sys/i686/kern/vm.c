@@ -19,12 +19,15 @@
 #include <machine/multiboot.h>
 #include <machine/vm.h>
 #include <machine/vm_private.h>
+#include <sys/cpu.h>
+#include <sys/kstat.h>
 #include <sys/malloc.h>
 #include <sys/mutex.h>
 #include <sys/pool.h>
 #include <sys/string.h>
 #include <sys/systm.h>
 #include <sys/types.h>
+#include <sys/vdso.h>
 #include <sys/vm.h>
 
 /* frame structure; a single block of physical memory that corresponds to a page */
@@ -36,15 +39,35 @@ struct frame {
 struct list frames_allocated;       /* list of frames that have been allocated */
 struct list frames_free;            /* lists of frames that are free and available for re-use */
 uintptr_t   kernel_physical_brk;    /* physical memory highwater mark */
+uintptr_t   kernel_physical_limit;  /* end of the memory frames are carved from */
 
 struct pool         page_table_pool;
 struct pool         page_directory_pool;
 
 static spinlock_t   frame_alloc_lock;
 
+LOCK_CLASS(frame_alloc_lock_class, "frame_alloc");
+
+#define VM_MAX_DEVICE_MAPS  16
+
+struct vm_device_map {
+    uintptr_t   start;
+    uintptr_t   end;
+};
+
+static struct vm_device_map vm_device_maps[VM_MAX_DEVICE_MAPS];
+static int                  vm_ndevice_maps;
+
 /* global statistics for VM structures allocated in kernel space */
 struct vm_statistics vm_stat;
 
+static struct kstat vm_kstats[] = {
+    { "vm.frames",          KSTAT_TYPE_UINT32,  &vm_stat.frame_count },
+    { "vm.pages",           KSTAT_TYPE_UINT32,  &vm_stat.page_count },
+    { "vm.page_tables",     KSTAT_TYPE_UINT32,  &vm_stat.page_table_count },
+    { "vm.spaces",          KSTAT_TYPE_UINT32,  &vm_stat.vmspace_count },
+};
+
 /* find a recycled frame */
 static struct frame *
 get_free_frame()
@@ -58,32 +81,71 @@ get_free_frame()
     return NULL;
 }
 
-/* allocates a new block of physical memory  */
+/* how many frames can still be allocated; the caller must hold frame_alloc_lock */
+static uint32_t
+frames_available()
+{
+    return LIST_SIZE(&frames_free) + (kernel_physical_limit - kernel_physical_brk) / PAGE_SIZE;
+}
+
+/*
+ * allocates a new block of physical memory, unless that would leave fewer
+ * than reserve frames. Recycled frames are zeroed, as new ones come from
+ * memory nothing has used yet. On failure *res is NULL and 0 is returned
+ */
 static uintptr_t
-frame_alloc(struct frame **res)
+frame_alloc_reserve(struct frame **res, uint32_t reserve)
 {
+    bool recycled;
     struct frame *frame;
 
     spinlock_lock(&frame_alloc_lock);
 
+    if (frames_available() <= reserve) {
+        spinlock_unlock(&frame_alloc_lock);
+        *res = NULL;
+        return 0;
+    }
+
     frame = get_free_frame();
+    recycled = frame != NULL;
 
     if (!frame) {
         frame = (struct frame*)calloc(1, sizeof(struct frame));
         frame->addr = kernel_physical_brk;
         kernel_physical_brk += PAGE_SIZE;
-        VMSTAT_INC_FRAME_COUNT(&vm_stat); 
     }
 
+    VMSTAT_INC_FRAME_COUNT(&vm_stat);
+
     list_append(&frames_allocated, frame);
 
     spinlock_unlock(&frame_alloc_lock);
 
+    if (recycled) {
+        page_zero((void*)PTOKVA(frame->addr));
+    }
+
     *res = frame;
 
     return frame->addr;
 }
 
+/* the kernel's own page tables and mappings may use the last frames */
+static uintptr_t
+frame_alloc(struct frame **res)
+{
+    uintptr_t addr;
+
+    addr = frame_alloc_reserve(res, 0);
+
+    if (!*res) {
+        panic("vm: out of physical memory");
+    }
+
+    return addr;
+}
+
 /* marks a block of physical memory as free */
 static void
 frame_free(void *addr)
@@ -111,7 +173,9 @@ frame_free(void *addr)
     if (to_remove) {
         VMSTAT_DEC_FRAME_COUNT(&vm_stat);
         list_remove(&frames_allocated, to_remove);
-        free(to_remove);
+
+        to_remove->ref_count = 0;
+        list_append(&frames_free, to_remove);
     }
 
     spinlock_unlock(&frame_alloc_lock);
@@ -121,6 +185,7 @@ frame_free(void *addr)
 static void
 page_map_entry(struct page_directory *directory, uintptr_t vaddr, uintptr_t paddr, bool write, bool user)
 {
+    bool remapped;
     uint32_t page_table;
     uint32_t page_table_entry;
 
@@ -137,7 +202,6 @@ page_map_entry(struct page_directory *directory, uintptr_t vaddr, uintptr_t padd
     if (!dir_entry->present) {    
         table = pool_get(&page_table_pool);
         VMSTAT_INC_PAGE_TABLE_COUNT(&vm_stat);
-        memset(table, 0, sizeof(struct page_table));
 
         dir_entry->present = 1;
         dir_entry->read_write = 1;
@@ -152,12 +216,19 @@ page_map_entry(struct page_directory *directory, uintptr_t vaddr, uintptr_t padd
 
     page = &table->pages[page_table % 1024];
 
+    /* the TLB never caches a page that wasn't present */
+    remapped = page->present;
+
     page->frame = FRAME_INDEX(paddr);
     page->present = true;
     page->read_write = write;
     page->user = 1;
     
     asm volatile("invlpg (%0)" : : "b"(vaddr) : "memory");
+
+    if (remapped) {
+        smp_tlb_shootdown(KVATOP(directory));
+    }
 }
 
 /* destroy a page directory structure */
@@ -301,6 +372,55 @@ vm_map(struct vm_space *space, void *addr, size_t length, int prot)
     return addr;
 }
 
+/*
+ * maps pages obtained from vm_page_alloc(). Each mapping takes its own
+ * reference, so the pages outlive the owning object while they are mapped
+ */
+void *
+vm_map_pages(struct vm_space *space, void *addr, void **pages, int npages, int prot)
+{
+    bool write;
+    bool user;
+    int i;
+    size_t length;
+
+    struct page_directory *directory;
+
+    length = npages * PAGE_SIZE;
+    write = VM_IS_WRITABLE(prot);
+    user = VM_IS_USER(prot);
+
+    if (user) {
+        addr = (void*)va_alloc_block(space->uva_map, (uintptr_t)addr, length);
+    } else {
+        addr = (void*)va_alloc_block(space->kva_map, (uintptr_t)addr, length);
+    }
+
+    directory = (struct page_directory*)space->state_virtual;
+
+    for (i = 0; i < npages; i++) {
+        struct frame *frame;
+        struct vm_block *block;
+
+        frame = (struct frame*)pages[i];
+        block = vm_block_new();
+
+        block->size = PAGE_SIZE;
+        block->start_physical = frame->addr;
+        block->start_virtual = ALIGN_ADDRESS((uintptr_t)addr + (PAGE_SIZE * i));
+        block->prot = prot;
+        block->state = frame;
+
+        frame->ref_count++;
+
+        list_append(&space->map, block);
+
+        page_map_entry(directory, block->start_virtual, block->start_physical, write, user);
+    }
+
+    return addr;
+}
+
 /* map a physical address to a virtual address */
 void *
 vm_map_physical(struct vm_space *space, void *addr, uintptr_t physical, size_t length, int prot)
@@ -345,6 +465,95 @@ vm_map_physical(struct vm_space *space, void *addr, uintptr_t physical, size_t l
     return addr;
 }
 
+/*
+ * allocates a zeroed page that belongs to a kernel object rather than to an
+ * address space. The caller holds the only reference. These are sized by
+ * userland, so they fail with NULL rather than take the last VM_PAGE_RESERVE
+ * frames, which are left for page tables and process memory
+ */
+void *
+vm_page_alloc()
+{
+    struct frame *frame;
+
+    frame_alloc_reserve(&frame, VM_PAGE_RESERVE);
+
+    if (!frame) {
+        return NULL;
+    }
+
+    frame->ref_count = 1;
+
+    page_zero(vm_page_kva(frame));
+
+    return frame;
+}
+
+/* for the kernel's own fixed size objects, which may use the reserve */
+void *
+vm_page_alloc_kernel()
+{
+    struct frame *frame;
+
+    frame_alloc(&frame);
+
+    frame->ref_count = 1;
+
+    page_zero(vm_page_kva(frame));
+
+    return frame;
+}
+
+/* whether npages more vm_page_alloc() calls can succeed right now */
+bool
+vm_page_available(int npages)
+{
+    bool res;
+
+    spinlock_lock(&frame_alloc_lock);
+    res = frames_available() > VM_PAGE_RESERVE + npages;
+    spinlock_unlock(&frame_alloc_lock);
+
+    return res;
+}
+
+/* takes another reference to a page from vm_page_alloc() */
+void
+vm_page_hold(void *page)
+{
+    struct frame *frame;
+
+    frame = (struct frame*)page;
+
+    frame->ref_count++;
+}
+
+/* kernel virtual address of a page; physical memory is mapped in the higher half */
+void *
+vm_page_kva(void *page)
+{
+    struct frame *frame;
+
+    frame = (struct frame*)page;
+
+    return (void*)PTOKVA(frame->addr);
+}
+
+/* drops a reference obtained from vm_page_alloc() */
+void
+vm_page_release(void *page)
+{
+    struct frame *frame;
+
+    frame = (struct frame*)page;
+
+    frame->ref_count--;
+
+    if (frame->ref_count == 0) {
+        frame_free((void*)frame->addr);
+    }
+}
+
 /* unmaps a contiguous block of pages from an address space */
 void
 vm_unmap(struct vm_space *space, void *addr, size_t length)
@@ -422,6 +631,8 @@ vm_space_destroy(struct vm_space *space)
     list_destroy(&to_remove, false);
     list_destroy(&space->map, false);
 
+    vdso_unmap(space);
+
     page_directory_free((struct page_directory*)space->state_virtual);
     
     free(space->uva_map);
@@ -460,6 +671,73 @@ map_vbe_data(struct page_directory *directory)
 }
 #endif
 
+/*
+ * memory mapped registers of the local APIC, I/O APICs and PCI devices are
+ * reached at their physical address from every address space. Mappings are
+ * made while devices are set up, before there are any processes; later
+ * address spaces pick them up from here
+ */
+int
+vm_map_device(uintptr_t physical, size_t length)
+{
+    /* defined in sys/i686/kern/sched.c */
+    extern struct vm_space *sched_kernel_space;
+
+    uintptr_t addr;
+    struct vm_device_map *map;
+
+    if (physical < VM_DEVICE_BASE || vm_ndevice_maps == VM_MAX_DEVICE_MAPS) {
+        return -1;
+    }
+
+    map = &vm_device_maps[vm_ndevice_maps++];
+    map->start = ALIGN_ADDRESS(physical);
+    map->end = ALIGN_ADDRESS(physical + length - 1) + PAGE_SIZE;
+
+    for (addr = map->start; addr != map->end; addr += PAGE_SIZE) {
+        page_map_entry((struct page_directory*)sched_kernel_space->state_virtual, addr, addr, true, false);
+    }
+
+    return 0;
+}
+
+void
+vm_map_devices(struct vm_space *space)
+{
+    int i;
+    uintptr_t addr;
+    struct vm_device_map *map;
+
+    for (i = 0; i < vm_ndevice_maps; i++) {
+        map = &vm_device_maps[i];
+
+        for (addr = map->start; addr != map->end; addr += PAGE_SIZE) {
+            page_map_entry((struct page_directory*)space->state_virtual, addr, addr, true, false);
+        }
+    }
+}
+
+/*
+ * application processors turn on paging while they still run from low memory,
+ * so the kernel's address space identity maps the first 4MB while they start
+ */
+void
+vm_map_bootstrap(struct vm_space *space, bool map)
+{
+    struct page_directory *directory;
+    struct page_directory_entry *dir_entry;
+
+    directory = (struct page_directory*)space->state_virtual;
+    dir_entry = &directory->tables[0];
+
+    dir_entry->present = map;
+    dir_entry->read_write = map;
+    dir_entry->size = map;
+    dir_entry->address = 0;
+
+    asm volatile("invlpg (%0)" : : "b"(0) : "memory");
+}
+
 /* create a new address space */
 struct vm_space *
 vm_space_new()
@@ -475,8 +753,6 @@ vm_space_new()
 
     VMSTAT_INC_VM_SPACE_COUNT(&vm_stat);
 
-    memset(directory, 0, sizeof(struct page_directory));
-    
     page_start = KERNEL_VIRTUAL_BASE >> 22;
 
     for (i = 0; i < 127; i++) {
@@ -495,15 +771,19 @@ vm_space_new()
 #endif
 
     vm_space->uva_map = va_map_new(0, KERNEL_VIRTUAL_BASE);
-    vm_space->kva_map = va_map_new(KERNEL_VIRTUAL_BASE + 0x1FC00000, 0xEA000000);
+    vm_space->kva_map = va_map_new(KERNEL_VIRTUAL_BASE + KERNEL_DIRECT_MAP_SIZE, 0xEA000000);
     vm_space->state_physical = (void*)KVATOP(directory);
     vm_space->state_virtual = (void*)directory;
 
+    vm_map_devices(vm_space);
+    vdso_map(vm_space);
+
     return vm_space;
 }
 
+/* phys_end is the end of the RAM the kernel was loaded into */
 void
-vm_init()
+vm_init(uintptr_t phys_end)
 {
     /* defined in sys/rtl/malloc.c */
     extern uintptr_t kernel_heap_end;
@@ -511,7 +791,23 @@ vm_init()
     kernel_physical_brk = kernel_heap_end + PAGE_SIZE;
     kernel_physical_brk -= KERNEL_VIRTUAL_BASE;
     kernel_physical_brk &= 0xFFFFF000;
+
+    /* frames are only ever touched through the direct map */
+    if (phys_end == 0 || phys_end > KERNEL_DIRECT_MAP_SIZE) {
+        phys_end = KERNEL_DIRECT_MAP_SIZE;
+    }
+
+    kernel_physical_limit = phys_end & 0xFFFFF000;
+
+    if (kernel_physical_limit < kernel_physical_brk) {
+        kernel_physical_limit = kernel_physical_brk;
+    }
+
+    spinlock_set_class(&frame_alloc_lock, &frame_alloc_lock_class);
+    lock_class_register(&frame_alloc_lock_class);
     
     pool_init(&page_table_pool, sizeof(struct page_table), 4096);
     pool_init(&page_directory_pool, sizeof(struct page_directory), 4096);
+
+    kstat_register(vm_kstats, sizeof(vm_kstats) / sizeof(vm_kstats[0]));
 }
\ No newline at end of file
@@ -0,0 +1,183 @@
+/*
+ * bootstage.c - when the system reached each stage of booting
+ *
+ * Each stage is recorded with the TSC as it starts, from the first thing
+ * _preinit() does to init starting its services; userland adds its own
+ * stages through sysctl. The TSC keeps counting from reset and needs nothing
+ * set up to be read, unlike the timer, which only starts halfway through.
+ * Its rate is only known once the local APIC timer has been calibrated, so
+ * the times are converted when they are reported rather than as they are
+ * taken
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <machine/cpufunc.h>
+#include <sys/bootstage.h>
+#include <sys/errno.h>
+#include <sys/mutex.h>
+#include <sys/proc.h>
+#include <sys/string.h>
+#include <sys/sysctl.h>
+#include <sys/systm.h>
+#include <sys/types.h>
+
+static struct kinfo_bootstage bootstages[BOOTSTAGE_MAX];
+static int nbootstages;
+static spinlock_t bootstage_lock;
+
+/* 0 until the first stage, then 1 if there is a TSC and -1 if there isn't */
+static int bootstage_have_tsc;
+
+/* microseconds per TSC cycle as 0.32 fixed point; 0 until calibrated */
+static uint32_t bootstage_tsc_mult;
+
+/* returns the time between two stages in microseconds, or in thousands of cycles */
+static uint32_t
+bootstage_delta(uint64_t from, uint64_t to)
+{
+    if (bootstage_tsc_mult) {
+        return (uint32_t)(((to - from) * bootstage_tsc_mult) >> 32);
+    }
+
+    return (uint32_t)((to - from) / 1000);
+}
+
+/* records that the stage called name starts now */
+void
+bootstage(const char *name)
+{
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+    struct kinfo_bootstage *stage;
+
+    spinlock_lock(&bootstage_lock);
+
+    if (bootstage_have_tsc == 0) {
+        cpuid(1, &eax, &ebx, &ecx, &edx);
+
+        bootstage_have_tsc = (edx & CPUID_TSC) ? 1 : -1;
+    }
+
+    if (nbootstages < BOOTSTAGE_MAX) {
+        stage = &bootstages[nbootstages++];
+        stage->tsc = bootstage_have_tsc > 0 ? rdtsc() : 0;
+
+        strncpy(stage->name, name, BOOTSTAGE_NAMELEN - 1);
+    }
+
+    spinlock_unlock(&bootstage_lock);
+}
+
+/* gives the TSC's rate as the number of cycles that passed in usec microseconds */
+void
+bootstage_calibrate(uint64_t cycles, uint32_t usec)
+{
+    if (cycles > 0) {
+        bootstage_tsc_mult = ((uint64_t)usec << 32) / cycles;
+    }
+}
+
+/* prints every stage so far with how long it took; the last one is still going */
+void
+bootstage_report()
+{
+    int i;
+    uint64_t end;
+    struct kinfo_bootstage *stage;
+
+    if (nbootstages == 0 || bootstage_have_tsc < 0) {
+        return;
+    }
+
+    printf("boot: %s since %s\n\r", bootstage_tsc_mult ? "microseconds" : "kilocycles",
+            bootstages[0].name);
+
+    for (i = 0; i < nbootstages; i++) {
+        stage = &bootstages[i];
+        end = i + 1 < nbootstages ? bootstages[i + 1].tsc : stage->tsc;
+
+        printf("boot: %d +%d %s\n\r", bootstage_delta(bootstages[0].tsc, stage->tsc),
+                bootstage_delta(stage->tsc, end), stage->name);
+    }
+}
+
+/* copies out every stage; writing a name records a new one, which is root only */
+static int
+bootstage_sysctl_stages(void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    char name[BOOTSTAGE_NAMELEN];
+    int count;
+
+    if (oldlenp) {
+        spinlock_lock(&bootstage_lock);
+
+        count = nbootstages;
+
+        if (oldp) {
+            if (count > *oldlenp / sizeof(struct kinfo_bootstage)) {
+                count = *oldlenp / sizeof(struct kinfo_bootstage);
+            }
+
+            memcpy(oldp, bootstages, count*sizeof(struct kinfo_bootstage));
+        }
+
+        spinlock_unlock(&bootstage_lock);
+
+        *oldlenp = count*sizeof(struct kinfo_bootstage);
+    }
+
+    if (!newp) {
+        return 0;
+    }
+
+    if (newlen == 0 || newlen >= BOOTSTAGE_NAMELEN) {
+        return -(EINVAL);
+    }
+
+    if (current_proc->creds.uid != 0) {
+        return -(EPERM);
+    }
+
+    memset(name, 0, sizeof(name));
+    memcpy(name, newp, newlen);
+
+    bootstage(name);
+
+    /* the kernel's stages were logged all at once before init started */
+    if (bootstage_have_tsc > 0) {
+        printf("boot: %d %s\n\r", bootstage_delta(bootstages[0].tsc, rdtsc()), name);
+    }
+
+    return 0;
+}
+
+int
+bootstage_sysctl(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    if (namelen != 1) {
+        return -(EINVAL);
+    }
+
+    switch (name[0]) {
+        case KERN_BOOT_STAGES:
+            return bootstage_sysctl_stages(oldp, oldlenp, newp, newlen);
+        default:
+            break;
+    }
+
+    return -1;
+}
@@ -24,6 +24,7 @@
 #include <sys/string.h>
 #include <sys/time.h>
 #include <sys/timer.h>
+#include <sys/vdso.h>
 
 time_t          time_second;
 struct timeval  time_delta;
@@ -38,6 +39,7 @@ adjtime(const struct timeval *delta, struct timeval *olddelta)
 
     if (delta) {
         memcpy(&time_delta, delta, sizeof(struct timeval));
+        vdso_adjtime();
     }
 
     return 0;
@@ -24,6 +24,7 @@
 #include <sys/errno.h>
 #include <sys/fcntl.h>
 #include <sys/file.h>
+#include <sys/ioctl.h>
 #include <sys/malloc.h>
 #include <sys/systm.h>
 #include <sys/types.h>
@@ -35,9 +36,11 @@ static int dev_file_getvn(struct file *, struct vnode **);
 static int dev_file_ioctl(struct file *, uint64_t, void *);
 static int dev_file_mmap(struct file *, uintptr_t, size_t, int, off_t);
 static int dev_file_read(struct file *, void *, size_t);
+static int dev_file_readv(struct file *, const struct iovec *, int, off_t);
 static int dev_file_seek(struct file *, off_t *, off_t, int);
 static int dev_file_stat(struct file *, struct stat *);
 static int dev_file_write(struct file *, const void *, size_t);
+static int dev_file_writev(struct file *, const struct iovec *, int, off_t);
 
 struct fops dev_file_ops = {
     .destroy    = dev_file_destroy,
@@ -46,9 +49,11 @@ struct fops dev_file_ops = {
     .ioctl      = dev_file_ioctl,
     .mmap       = dev_file_mmap,
     .read       = dev_file_read,
+    .readv      = dev_file_readv,
     .seek       = dev_file_seek,
     .stat       = dev_file_stat,
-    .write      = dev_file_write
+    .write      = dev_file_write,
+    .writev     = dev_file_writev
 };
 
 struct cdev_file {
@@ -127,16 +132,99 @@ dev_file_mmap(struct file *fp, uintptr_t addr, size_t size, int prot, off_t offs
     return CDEVOPS_MMAP(file->device, addr, size, prot, offset);
 }
 
+/*
+ * O_NONBLOCK is implemented here rather than in each driver: a device that
+ * can block answers FIONREAD/FIONSPACE, and if it reports that nothing can be
+ * transferred we fail with EAGAIN instead of entering the driver. Devices
+ * that never block ignore these ioctls and are always entered
+ */
 static int
 dev_file_read(struct file *fp, void *buf, size_t nbyte)
 {
+    uint32_t avail;
     struct cdev_file *file;
     
     file = fp->state;
 
+    avail = nbyte;
+
+    if (FILE_NONBLOCK(fp) && nbyte > 0 && CDEVOPS_IOCTL(file->device, FIONREAD, (uintptr_t)&avail) == 0) {
+        if (avail == 0) {
+            return -(EAGAIN);
+        }
+
+        if (nbyte > avail) {
+            nbyte = avail;
+        }
+    }
+
     return CDEVOPS_READ(file->device, buf, nbyte, fp->position);
 }
 
+/*
+ * transfers at most limit bytes of an iovec array, one segment at a time. Used
+ * by the non-blocking path where the device has told us how much it can take
+ */
+static int
+dev_file_xfer_limited(struct cdev *dev, const struct iovec *iov, int iovcnt, off_t offset, size_t limit, bool write)
+{
+    int i;
+    int res;
+    size_t total;
+    struct iovec seg;
+
+    for (i = 0, total = 0; i < iovcnt && total < limit; i++) {
+        seg.iov_base = iov[i].iov_base;
+        seg.iov_len = iov[i].iov_len;
+
+        if (seg.iov_len > limit - total) {
+            seg.iov_len = limit - total;
+        }
+
+        if (write) {
+            res = CDEVOPS_WRITEV(dev, &seg, 1, offset + total);
+        } else {
+            res = CDEVOPS_READV(dev, &seg, 1, offset + total);
+        }
+
+        if (res < 0) {
+            return total > 0 ? total : res;
+        }
+
+        total += res;
+
+        if (res < seg.iov_len) {
+            break;
+        }
+    }
+
+    return total;
+}
+
+/*
+ * vectored transfers apply the same non-blocking gate as read and write,
+ * limiting the request to what the device reports it can transfer
+ */
+static int
+dev_file_readv(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    uint32_t avail;
+    struct cdev_file *file;
+    
+    file = fp->state;
+
+    avail = iov_length(iov, iovcnt);
+
+    if (FILE_NONBLOCK(fp) && avail > 0 && CDEVOPS_IOCTL(file->device, FIONREAD, (uintptr_t)&avail) == 0) {
+        if (avail == 0) {
+            return -(EAGAIN);
+        }
+
+        return dev_file_xfer_limited(file->device, iov, iovcnt, offset, avail, false);
+    }
+
+    return CDEVOPS_READV(file->device, iov, iovcnt, offset);
+}
 
 static int
 dev_file_seek(struct file *file, off_t *cur_pos, off_t off, int whence)
@@ -182,9 +270,43 @@ dev_file_stat(struct file *fp, struct stat *stat)
 static int
 dev_file_write(struct file *fp, const void *buf, size_t nbyte)
 {
+    uint32_t space;
     struct cdev_file *file;
     
     file = fp->state;
 
+    space = nbyte;
+
+    if (FILE_NONBLOCK(fp) && nbyte > 0 && CDEVOPS_IOCTL(file->device, FIONSPACE, (uintptr_t)&space) == 0) {
+        if (space == 0) {
+            return -(EAGAIN);
+        }
+
+        if (nbyte > space) {
+            nbyte = space;
+        }
+    }
+
     return CDEVOPS_WRITE(file->device, buf, nbyte, fp->position);
-}
\ No newline at end of file
+}
+
+static int
+dev_file_writev(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    uint32_t space;
+    struct cdev_file *file;
+    
+    file = fp->state;
+
+    space = iov_length(iov, iovcnt);
+
+    if (FILE_NONBLOCK(fp) && space > 0 && CDEVOPS_IOCTL(file->device, FIONSPACE, (uintptr_t)&space) == 0) {
+        if (space == 0) {
+            return -(EAGAIN);
+        }
+
+        return dev_file_xfer_limited(file->device, iov, iovcnt, offset, space, true);
+    }
+
+    return CDEVOPS_WRITEV(file->device, iov, iovcnt, offset);
+}
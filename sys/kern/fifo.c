@@ -18,6 +18,7 @@
 #include <sys/errno.h>
 #include <sys/fcntl.h>
 #include <sys/file.h>
+#include <sys/ioctl.h>
 #include <sys/malloc.h>
 #include <sys/pipe.h>
 #include <sys/systm.h>
@@ -26,17 +27,23 @@
 static int fifo_close(struct file *);
 static int fifo_destroy(struct file *);
 static int fifo_duplicate(struct file *);
+static int fifo_ioctl(struct file *, uint64_t, void *);
 static int fifo_read(struct file *, void *, size_t);
+static int fifo_readv(struct file *, const struct iovec *, int, off_t);
 static int fifo_stat(struct file *, struct stat *);
 static int fifo_write(struct file *, const void *, size_t);
+static int fifo_writev(struct file *, const struct iovec *, int, off_t);
 
 struct fops fifo_ops = {
     .close      = fifo_close,
     .destroy    = fifo_destroy,
     .duplicate  = fifo_duplicate,
+    .ioctl      = fifo_ioctl,
     .read       = fifo_read,
+    .readv      = fifo_readv,
     .stat       = fifo_stat,
-    .write      = fifo_write
+    .write      = fifo_write,
+    .writev     = fifo_writev
 };
 
 struct fifo {
@@ -47,11 +54,16 @@ struct fifo {
 };
 
 static struct file *
-fifo_open_write(struct vnode *vn)
+fifo_open_write(struct vnode *vn, mode_t mode)
 {
     struct fifo *reader;
 
     while (LIST_SIZE(&vn->un.fifo_readers) == 0) {
+        if ((mode & O_NONBLOCK)) {
+            /* POSIX: opening a FIFO for writing without a reader is ENXIO */
+            return NULL;
+        }
+
         thread_yield();
     }
 
@@ -88,7 +100,7 @@ struct file *
 fifo_to_file(struct vnode *vn, mode_t mode)
 {
     if ((mode & O_WRONLY)) {
-        return fifo_open_write(vn);
+        return fifo_open_write(vn, mode);
     }
 
     return fifo_open_read(vn);
@@ -145,14 +157,42 @@ fifo_duplicate(struct file *fp)
     return 0;
 }
 
+static int
+fifo_ioctl(struct file *fp, uint64_t request, void *argp)
+{
+    struct fifo *fifo;
+
+    fifo = fp->state;
+
+    switch (request) {
+        case FIONREAD:
+            return FOP_IOCTL(fifo->pipe[0], request, argp);
+        case FIONSPACE:
+            return FOP_IOCTL(fifo->pipe[1], request, argp);
+    }
+
+    return -(ENOTSUP);
+}
+
 static int
 fifo_read(struct file *fp, void *buf, size_t nbyte)
+{
+    struct iovec iov;
+
+    iov.iov_base = buf;
+    iov.iov_len = nbyte;
+
+    return fifo_readv(fp, &iov, 1, 0);
+}
+
+static int
+fifo_readv(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
 {
     struct fifo *fifo;
     
     fifo = fp->state;
 
-    return FOP_READ(fifo->pipe[0], buf, nbyte);
+    return pipe_readv(fifo->pipe[0], iov, iovcnt, fp->flags);
 }
 
 static int
@@ -175,10 +215,21 @@ fifo_stat(struct file *fp, struct stat *stat)
 
 static int
 fifo_write(struct file *fp, const void *buf, size_t nbyte)
+{
+    struct iovec iov;
+
+    iov.iov_base = (void*)buf;
+    iov.iov_len = nbyte;
+
+    return fifo_writev(fp, &iov, 1, 0);
+}
+
+static int
+fifo_writev(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
 {
     struct fifo *fifo;
     
-    fifo = (struct fifo*)fp->state;
+    fifo = fp->state;
 
-    return FOP_WRITE(fifo->pipe[1], buf, nbyte);
+    return pipe_writev(fifo->pipe[1], iov, iovcnt, fp->flags);
 }
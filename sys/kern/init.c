@@ -16,15 +16,20 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <ds/dict.h>
+#include <sys/bootstage.h>
 #include <sys/cdev.h>
 #include <sys/devno.h>
 #include <sys/file.h>
+#include <sys/kstat.h>
 #include <sys/mount.h>
+#include <sys/mutex.h>
 #include <sys/proc.h>
 #include <sys/socket.h>
+#include <sys/softirq.h>
 #include <sys/string.h>
 #include <sys/syscall.h>
 #include <sys/systm.h>
+#include <sys/trace.h>
 #include <sys/vm.h>
 #include <sys/vnode.h>
 #include <sys/world.h>
@@ -195,6 +200,9 @@ exec_init(const char *args)
         NULL
     };
 
+    bootstage("exec_init");
+    bootstage_report();
+
     printf("kernel: invoke /sbin/doit\n\r");
     current_proc->umask = 0744;
     proc_execve(init_argv[0], init_argv, init_envp);
@@ -206,10 +214,9 @@ exec_init(const char *args)
 static int
 init_thread(void *argp)
 {
-    extern struct thread *sched_curr_thread;
-
     char *runlevel;
     char *rootfs_uuid_str;
+    char *smp_str;
 
     uint8_t rootfs_uuid[16];
 
@@ -221,6 +228,8 @@ init_thread(void *argp)
     struct vnode *root;
     struct world *init_world;
 
+    bootstage("init_thread");
+
     /* setup the first process */    
     init = proc_new();
     init_session = session_new(init);
@@ -232,16 +241,29 @@ init_thread(void *argp)
     init->world = init_world;
 
     sched_curr_thread->proc = init;
-    current_proc = init;
+    CPU_STORE(ci_proc, init);
 
     parse_cmdline(&opts, argp);
 
+    bootstage("smp_start");
+
+    /* smp=1 keeps the application processors parked */
+    if (dict_get(&opts, "smp", (void**)&smp_str)) {
+        smp_start(atoi(smp_str, 10));
+    } else {
+        smp_start(MAXCPU);
+    }
+
+    workers_init();
+
     /* this is ugly and not how I want to do this (Initializing these filesystems
      * here). I'd prefer a more modular approach. We'll fix this some day
      */
+    bootstage("fs_init");
     devfs_init();
     tmpfs_init();
     ext2_init();
+    procfs_init();
 
     /* now mount the ramdisk */
     root = NULL;
@@ -255,10 +277,15 @@ init_thread(void *argp)
         root = rootfs_open(rootfs_uuid);
     }
 
-    if (!root) root = initrd_open();
+    if (!root) {
+        bootstage("extract");
+        root = initrd_open();
+    }
 
     root->mode = 0755;
 
+    bootstage("mount");
+
     if (fs_mount(root, NULL, "devfs", "/dev", 0) != 0) {
         panic("could not mount devfs!");
     }
@@ -268,6 +295,10 @@ init_thread(void *argp)
         panic("could not mount tmpfs!");
     }
 
+    if (fs_mount(root, NULL, "procfs", "/proc", 0) != 0) {
+        printf("kernel: could not mount procfs\n\r");
+    }
+
     if (!dict_get(&opts, "runlevel", (void**)&runlevel)) {
         runlevel = "1";
     }
@@ -280,23 +311,31 @@ init_thread(void *argp)
 int
 kmain(const char *args)
 {
+    extern void inet_init();
     extern void kmsg_device_init();
     extern void pseudo_devices_init();
  
+    bootstage("kmain");
+
     /* initialize various pools for the various subsystems  */
     pool_init(&proc_pool, sizeof(struct proc), 0);
     pool_init(&thread_pool, sizeof(struct thread), 0);
     pool_init(&vn_pool, sizeof(struct vnode), 0);
     pool_init(&file_pool, sizeof(struct file), 0);
 
+    kstat_init();
+    lock_stats_init();
+
     /* initialize the socket subsystem */
     sock_init();
+    inet_init();
 
     /* initialize all system calls*/
     syscalls_init();
 
     kmsg_device_init();
     pseudo_devices_init();
+    trace_init();
 
     thread_run((kthread_entry_t)init_thread, NULL, (void*)args);
 
@@ -0,0 +1,137 @@
+/*
+ * kstat.c - named kernel counters
+ *
+ * Subsystems register tables of the counters they keep when they're
+ * initialized, and KERN_KSTAT reads all of them at once. Nothing is
+ * allocated, so this works before the heap does
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <sys/errno.h>
+#include <sys/kstat.h>
+#include <sys/string.h>
+#include <sys/sysctl.h>
+#include <sys/systm.h>
+#include <sys/types.h>
+
+/* defined in ds/list.c */
+extern int list_elem_count;
+
+/* defined in kern/malloc.c */
+extern intptr_t kernel_break;
+extern intptr_t kernel_heap_start;
+extern intptr_t kernel_heap_end;
+extern int kernel_heap_allocated_blocks;
+extern int kernel_heap_free_blocks;
+
+/* defined in kern/proc.c */
+extern int proc_count;
+
+/* defined in kern/vfs.c */
+extern int vfs_file_count;
+
+/* defined in kern/vnode.c */
+extern int vfs_node_count;
+
+static struct kstat *kstat_table[KSTAT_MAX];
+static int kstat_count;
+
+/* counters of code that has no initialization of its own to register them */
+static struct kstat kern_kstats[] = {
+    { "heap.start",             KSTAT_TYPE_ADDR,    &kernel_heap_start },
+    { "heap.break",             KSTAT_TYPE_ADDR,    &kernel_break },
+    { "heap.end",               KSTAT_TYPE_ADDR,    &kernel_heap_end },
+    { "heap.allocated_blocks",  KSTAT_TYPE_INT,     &kernel_heap_allocated_blocks },
+    { "heap.free_blocks",       KSTAT_TYPE_INT,     &kernel_heap_free_blocks },
+    { "list.elems",             KSTAT_TYPE_INT,     &list_elem_count },
+    { "proc.count",             KSTAT_TYPE_INT,     &proc_count },
+    { "vfs.files",              KSTAT_TYPE_INT,     &vfs_file_count },
+    { "vfs.nodes",              KSTAT_TYPE_INT,     &vfs_node_count },
+};
+
+void
+kstat_init()
+{
+    kstat_register(kern_kstats, sizeof(kern_kstats) / sizeof(kern_kstats[0]));
+}
+
+int
+kstat_register(struct kstat *stats, int nstats)
+{
+    int i;
+
+    if (kstat_count + nstats > KSTAT_MAX) {
+        printf("kstat: table full, dropping %s\n\r", stats[0].name);
+        return -(ENOSPC);
+    }
+
+    for (i = 0; i < nstats; i++) {
+        kstat_table[kstat_count++] = &stats[i];
+    }
+
+    return 0;
+}
+
+static uint64_t
+kstat_read(struct kstat *stat)
+{
+    switch (stat->type) {
+        case KSTAT_TYPE_INT:
+            return (uint64_t)(int64_t)*(const volatile int*)stat->value;
+        case KSTAT_TYPE_UINT32:
+            return *(const volatile uint32_t*)stat->value;
+        case KSTAT_TYPE_UINT64:
+            return *(const volatile uint64_t*)stat->value;
+        case KSTAT_TYPE_ADDR:
+            return *(const volatile uintptr_t*)stat->value;
+        default:
+            return 0;
+    }
+}
+
+int
+kstat_sysctl(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    int i;
+    int nentries;
+    struct kinfo_kstat *entries;
+
+    if (namelen != 0 || !oldlenp) {
+        return -(EINVAL);
+    }
+
+    if (!oldp) {
+        *oldlenp = kstat_count*sizeof(struct kinfo_kstat);
+        return 0;
+    }
+
+    nentries = *oldlenp / sizeof(struct kinfo_kstat);
+    entries = oldp;
+
+    if (nentries > kstat_count) {
+        nentries = kstat_count;
+    }
+
+    for (i = 0; i < nentries; i++) {
+        memset(&entries[i], 0, sizeof(struct kinfo_kstat));
+        strncpy(entries[i].name, kstat_table[i]->name, KSTAT_NAMELEN - 1);
+        entries[i].type = kstat_table[i]->type;
+        entries[i].value = kstat_read(kstat_table[i]);
+    }
+
+    *oldlenp = nentries*sizeof(struct kinfo_kstat);
+
+    return 0;
+}
@@ -4,6 +4,11 @@
  * Handles resolution of kernel symbols. Kernel symbols must be declared by the
  * machine dependent portion of the kernel by calling ksym_declare()
  *
+ * Symbols live in one array sorted by address, so an address is resolved
+ * with a binary search; stack traces and the profiler do a lot of those.
+ * Their names are packed into a single string table, and resolving a name
+ * goes through an open addressed hash of indices into the array
+ *
  * This program is free software; you can redistribute it and/or modify
  * it under the terms of the GNU General Public License as published by
  * the Free Software Foundation; either version 2 of the License, or
@@ -18,88 +23,235 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
-#include <ds/dict.h>
-#include <machine/elf32.h>
-#include <machine/multiboot.h>
-#include <machine/vm.h>
+#include <sys/errno.h>
+#include <sys/malloc.h>
 #include <sys/string.h>
+#include <sys/sysctl.h>
 #include <sys/systm.h>
-#include <sys/malloc.h>
+#include <sys/types.h>
 
 struct ksym {
-    char        name[255];
     uintptr_t   value;
+    uint32_t    name;   /* offset into ksym_names */
 };
 
-struct dict ksym_all;
+static struct ksym *    ksym_table;
+static int              ksym_count;
+static int              ksym_capacity;
+
+/* how many of ksym_table are in order and hashed */
+static int              ksym_sorted;
+
+static char *           ksym_names;
+static size_t           ksym_names_len;
+static size_t           ksym_names_capacity;
+
+/* index+1 into ksym_table, or 0 if the slot is free. Size is a power of 2 */
+static uint32_t *       ksym_hash;
+static uint32_t         ksym_hash_size;
+
+static uint32_t
+ksym_hash_name(const char *name)
+{
+    uint32_t hash;
+
+    /* FNV-1a */
+    for (hash = 2166136261u; *name; name++) {
+        hash = (hash ^ (uint8_t)*name) * 16777619;
+    }
+
+    return hash;
+}
+
+/* copies len bytes into a new buffer of newsize bytes, freeing the old one */
+static void *
+ksym_grow(void *old, size_t len, size_t newsize)
+{
+    void *buf;
+
+    buf = malloc(newsize);
+
+    if (old) {
+        memcpy(buf, old, len);
+        free(old);
+    }
+
+    return buf;
+}
 
 void
 ksym_declare(const char *name, uintptr_t val)
 {
+    size_t len;
     struct ksym *sym;
-    
-    sym = calloc(1, sizeof(struct ksym));
+
+    len = strlen(name) + 1;
+
+    if (ksym_count == ksym_capacity) {
+        ksym_capacity = ksym_capacity ? ksym_capacity * 2 : 1024;
+        ksym_table = ksym_grow(ksym_table, ksym_count*sizeof(struct ksym), ksym_capacity*sizeof(struct ksym));
+    }
+
+    if (ksym_names_len + len > ksym_names_capacity) {
+        while (ksym_names_len + len > ksym_names_capacity) {
+            ksym_names_capacity = ksym_names_capacity ? ksym_names_capacity * 2 : 16384;
+        }
+
+        ksym_names = ksym_grow(ksym_names, ksym_names_len, ksym_names_capacity);
+    }
+
+    memcpy(&ksym_names[ksym_names_len], name, len);
+
+    sym = &ksym_table[ksym_count++];
     sym->value = val;
-    strncpy(sym->name, name, sizeof(sym->name));
-    dict_set(&ksym_all, name, sym);
+    sym->name = ksym_names_len;
+
+    ksym_names_len += len;
 }
 
-int
-ksym_resolve(const char *name, uintptr_t *val)
+static void
+ksym_sift_down(int root, int count)
 {
-    struct ksym *res;
+    int child;
+    struct ksym tmp;
 
-    if (dict_get(&ksym_all, name, (void**)&res)) {
-        *val = res->value;
-        return 0;
+    while ((child = root*2 + 1) < count) {
+        if (child + 1 < count && ksym_table[child + 1].value > ksym_table[child].value) {
+            child++;
+        }
+
+        if (ksym_table[root].value >= ksym_table[child].value) {
+            return;
+        }
+
+        tmp = ksym_table[root];
+        ksym_table[root] = ksym_table[child];
+        ksym_table[child] = tmp;
+
+        root = child;
     }
+}
 
-    return -1;
+static void
+ksym_rehash()
+{
+    int i;
+    uint32_t slot;
+
+    if (ksym_hash_size < ksym_count*2) {
+        if (ksym_hash) {
+            free(ksym_hash);
+        }
+
+        for (ksym_hash_size = 1024; ksym_hash_size < ksym_count*2; ksym_hash_size *= 2);
+
+        ksym_hash = malloc(ksym_hash_size*sizeof(uint32_t));
+    }
+
+    memset(ksym_hash, 0, ksym_hash_size*sizeof(uint32_t));
+
+    for (i = 0; i < ksym_count; i++) {
+        slot = ksym_hash_name(&ksym_names[ksym_table[i].name]) & (ksym_hash_size - 1);
+
+        while (ksym_hash[slot]) {
+            slot = (slot + 1) & (ksym_hash_size - 1);
+        }
+
+        ksym_hash[slot] = i + 1;
+    }
 }
 
+/*
+ * sorts in whatever was declared since it last ran; heapsort needs no
+ * memory. Done by lookups, but the symbol loader calls it too, so nothing
+ * has to allocate later on in a panic
+ */
+void
+ksym_sort()
+{
+    int i;
+    struct ksym tmp;
+
+    if (ksym_sorted == ksym_count) {
+        return;
+    }
+
+    for (i = ksym_count/2 - 1; i >= 0; i--) {
+        ksym_sift_down(i, ksym_count);
+    }
+
+    for (i = ksym_count - 1; i > 0; i--) {
+        tmp = ksym_table[0];
+        ksym_table[0] = ksym_table[i];
+        ksym_table[i] = tmp;
+
+        ksym_sift_down(0, i);
+    }
+
+    ksym_rehash();
+
+    ksym_sorted = ksym_count;
+}
 
 int
-ksym_find_nearest(uintptr_t needle, uintptr_t *offset, char *buf, size_t bufsize)
+ksym_resolve(const char *name, uintptr_t *val)
 {
-    list_iter_t iter;
-    uintptr_t delta;
+    uint32_t slot;
+    struct ksym *sym;
 
-    char *name;
-    struct ksym *closest;
-    struct ksym *ksym;
+    ksym_sort();
 
-    dict_get_keys(&ksym_all, &iter);
+    if (!ksym_hash) {
+        return -1;
+    }
 
-    closest = NULL;
+    slot = ksym_hash_name(name) & (ksym_hash_size - 1);
 
-    while (iter_move_next(&iter, (void**)&name)) {
-        if (!dict_get(&ksym_all, name, (void**)&ksym)) {
-            continue;
-        }
+    while (ksym_hash[slot]) {
+        sym = &ksym_table[ksym_hash[slot] - 1];
 
-        if (ksym->value > needle) {
-            continue;
+        if (strcmp(&ksym_names[sym->name], name) == 0) {
+            *val = sym->value;
+            return 0;
         }
 
-        if (!closest) {
-            closest = ksym;
-            continue;
-        }
+        slot = (slot + 1) & (ksym_hash_size - 1);
+    }
+
+    return -1;
+}
+
+int
+ksym_find_nearest(uintptr_t needle, uintptr_t *offset, char *buf, size_t bufsize)
+{
+    int high;
+    int low;
+    int mid;
+    struct ksym *closest;
+
+    ksym_sort();
+
+    /* the last symbol at or below needle */
+    low = 0;
+    high = ksym_count;
 
-        delta = needle - ksym->value;
+    while (low < high) {
+        mid = low + (high - low) / 2;
 
-        if (delta < needle - closest->value) {
-            closest = ksym;
+        if (ksym_table[mid].value <= needle) {
+            low = mid + 1;
+        } else {
+            high = mid;
         }
     }
 
-    iter_close(&iter);
-
-    if (!closest) {
+    if (low == 0) {
         return -1;
     }
 
-    strncpy(buf, closest->name, bufsize);
+    closest = &ksym_table[low - 1];
+
+    strncpy(buf, &ksym_names[closest->name], bufsize);
 
     if (offset) {
         *offset = needle - closest->value;
@@ -107,3 +259,89 @@ ksym_find_nearest(uintptr_t needle, uintptr_t *offset, char *buf, size_t bufsize
 
     return 0;
 }
+
+static int
+ksym_sysctl_lookup(int *name, int namelen, void *oldp, size_t *oldlenp)
+{
+    struct kinfo_ksym *info;
+
+    if (namelen != 1) {
+        return -(EINVAL);
+    }
+
+    if (!oldp && oldlenp) {
+        *oldlenp = sizeof(struct kinfo_ksym);
+        return 0;
+    }
+
+    if (!oldlenp || *oldlenp < sizeof(struct kinfo_ksym)) {
+        return -(EINVAL);
+    }
+
+    info = oldp;
+
+    if (ksym_find_nearest((uint32_t)name[0], &info->offset, info->name, sizeof(info->name)) != 0) {
+        return -(ENOENT);
+    }
+
+    info->name[sizeof(info->name) - 1] = '\0';
+    info->value = (uint32_t)name[0] - info->offset;
+
+    *oldlenp = sizeof(struct kinfo_ksym);
+
+    return 0;
+}
+
+/* the whole table, in address order, so userland can resolve on its own */
+static int
+ksym_sysctl_all(void *buf, size_t *lenp)
+{
+    int i;
+    int maxentries;
+    struct kinfo_ksym *entries;
+
+    ksym_sort();
+
+    if (!buf && lenp) {
+        *lenp = ksym_count*sizeof(struct kinfo_ksym);
+        return 0;
+    }
+
+    if (!lenp) {
+        return -(EINVAL);
+    }
+
+    maxentries = *lenp / sizeof(struct kinfo_ksym);
+    entries = buf;
+
+    for (i = 0; i < ksym_count && i < maxentries; i++) {
+        entries[i].value = ksym_table[i].value;
+        entries[i].offset = 0;
+
+        strncpy(entries[i].name, &ksym_names[ksym_table[i].name], sizeof(entries[i].name));
+        entries[i].name[sizeof(entries[i].name) - 1] = '\0';
+    }
+
+    *lenp = i*sizeof(struct kinfo_ksym);
+
+    return 0;
+}
+
+int
+ksym_sysctl(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    if (namelen < 1) {
+        return -(EINVAL);
+    }
+
+    switch (name[0]) {
+        case KERN_KSYM_LOOKUP:
+            return ksym_sysctl_lookup(&name[1], namelen - 1, oldp, oldlenp);
+        case KERN_KSYM_ALL:
+            return ksym_sysctl_all(oldp, oldlenp);
+        default:
+            break;
+    }
+
+    return -1;
+}
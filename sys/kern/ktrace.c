@@ -0,0 +1,256 @@
+/*
+ * ktrace.c - per-process system call tracing
+ *
+ * A traced process writes a record into its own ring for every system call
+ * that returns. Writers reserve a slot by bumping the head and publish the
+ * record by setting its sequence number last, so neither they nor the reader
+ * take a lock. The ring never blocks a traced process; when the reader falls
+ * behind, the oldest records are overwritten
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <sys/errno.h>
+#include <sys/ktrace.h>
+#include <sys/malloc.h>
+#include <sys/proc.h>
+#include <sys/string.h>
+#include <sys/syscall.h>
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#include <sys/world.h>
+
+/* called by the syscall dispatcher once a traced process' call returned */
+void
+ktrace_record(struct thread *th, struct syscall *syscall, int num, struct syscall_args *args,
+        int ret, uint64_t entry, uint64_t exit)
+{
+    int i;
+    uint32_t slot;
+    struct ktrace *ktr;
+    struct ktr_syscall *rec;
+
+    ktr = th->proc->ktrace;
+
+    slot = __sync_fetch_and_add(&ktr->head, 1);
+    rec = &ktr->records[slot % KTRACE_NRECORDS];
+
+    /* readers skip the record until it's complete */
+    rec->seq = 0;
+    __sync_synchronize();
+
+    rec->tid = th->tid;
+    rec->num = num;
+    rec->argc = syscall->argc;
+    rec->ret = ret;
+    rec->entry = entry;
+    rec->exit = exit;
+
+    for (i = 0; i < KTR_NARGS; i++) {
+        rec->args[i] = i < syscall->argc ? args->args[i] : 0;
+    }
+
+    __sync_synchronize();
+    rec->seq = slot + 1;
+}
+
+void
+ktrace_free(struct proc *proc)
+{
+    proc->traced = false;
+
+    if (proc->ktrace) {
+        free(proc->ktrace);
+        proc->ktrace = NULL;
+    }
+}
+
+/*
+ * root may trace anything. Anyone else only processes that run with exactly
+ * their privileges: the target's real and effective ids must all be the
+ * caller's, so a process that gained another uid or gid (setuid) is refused
+ */
+static bool
+ktrace_can_trace(struct cred *caller, struct cred *target)
+{
+    if (caller->euid == 0) {
+        return true;
+    }
+
+    return  target->uid == caller->uid && target->euid == caller->uid &&
+            target->gid == caller->gid && target->egid == caller->gid;
+}
+
+static struct proc *
+ktrace_find(int *name, int namelen, int *error)
+{
+    struct proc *proc;
+
+    if (namelen != 1) {
+        *error = -(EINVAL);
+        return NULL;
+    }
+
+    proc = proc_find(name[0]);
+
+    if (!proc || !WORLD_CAN_SEE_PROC(current_proc->world, proc)) {
+        *error = -(ESRCH);
+        return NULL;
+    }
+
+    if (!ktrace_can_trace(&current_proc->creds, &proc->creds)) {
+        *error = -(EPERM);
+        return NULL;
+    }
+
+    return proc;
+}
+
+static int
+ktrace_sysctl_enable(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    int error;
+    struct proc *proc;
+
+    proc = ktrace_find(name, namelen, &error);
+
+    if (!proc) {
+        return error;
+    }
+
+    if (oldp && oldlenp && *oldlenp >= sizeof(int)) {
+        *(int*)oldp = proc->traced;
+        *oldlenp = sizeof(int);
+    }
+
+    if (!newp) {
+        return 0;
+    }
+
+    if (newlen != sizeof(int)) {
+        return -(EINVAL);
+    }
+
+    if (!*(int*)newp) {
+        proc->traced = false;
+        return 0;
+    }
+
+    if (!proc->ktrace) {
+        proc->ktrace = calloc(1, sizeof(struct ktrace));
+
+        if (!proc->ktrace) {
+            return -(ENOMEM);
+        }
+    }
+
+    /* a new reader isn't interested in what an earlier one left behind */
+    proc->ktrace->tail = proc->ktrace->head;
+    proc->traced = true;
+
+    return 0;
+}
+
+static int
+ktrace_sysctl_records(int *name, int namelen, void *buf, size_t *lenp)
+{
+    int error;
+    int maxentries;
+    int nentries;
+    uint32_t head;
+    struct ktr_syscall *entries;
+    struct ktr_syscall *rec;
+    struct ktrace *ktr;
+    struct proc *proc;
+
+    proc = ktrace_find(name, namelen, &error);
+
+    if (!proc) {
+        return error;
+    }
+
+    if (!lenp) {
+        return -(EINVAL);
+    }
+
+    ktr = proc->ktrace;
+
+    if (!ktr) {
+        *lenp = 0;
+        return proc->exited ? -(ESRCH) : 0;
+    }
+
+    head = ktr->head;
+
+    /* lets the reader know it has seen the last record */
+    if (proc->exited && ktr->tail == head) {
+        return -(ESRCH);
+    }
+
+    /* whatever was overwritten is gone; carry on with the oldest that's left */
+    if (head - ktr->tail > KTRACE_NRECORDS) {
+        ktr->tail = head - KTRACE_NRECORDS;
+    }
+
+    if (!buf) {
+        *lenp = (head - ktr->tail)*sizeof(struct ktr_syscall);
+        return 0;
+    }
+
+    maxentries = *lenp / sizeof(struct ktr_syscall);
+    entries = buf;
+    nentries = 0;
+
+    while (ktr->tail != head && nentries < maxentries) {
+        rec = &ktr->records[ktr->tail % KTRACE_NRECORDS];
+
+        /* not published yet; the writer is still at it */
+        if (rec->seq != ktr->tail + 1) {
+            break;
+        }
+
+        memcpy(&entries[nentries], rec, sizeof(struct ktr_syscall));
+
+        /* overwritten while it was copied */
+        if (rec->seq != ktr->tail + 1) {
+            break;
+        }
+
+        nentries++;
+        ktr->tail++;
+    }
+
+    *lenp = nentries*sizeof(struct ktr_syscall);
+
+    return 0;
+}
+
+int
+ktrace_sysctl(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    if (namelen < 1) {
+        return -(EINVAL);
+    }
+
+    switch (name[0]) {
+        case KERN_KTRACE_ENABLE:
+            return ktrace_sysctl_enable(&name[1], namelen - 1, oldp, oldlenp, newp, newlen);
+        case KERN_KTRACE_RECORDS:
+            return ktrace_sysctl_records(&name[1], namelen - 1, oldp, oldlenp);
+        default:
+            break;
+    }
+
+    return -1;
+}
@@ -15,20 +15,31 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
+#include <sys/errno.h>
 #include <sys/malloc.h>
 #include <sys/mutex.h>
 #include <sys/string.h>
+#include <sys/sysctl.h>
 #include <sys/systm.h>
 #include <sys/types.h>
 
 #define MALLOC_ALIGNMENT    128
 #define ALIGN_MASK             0xFFFFFF80
 
+/*
+ * sits in front of each block, separated from it by at least MALLOC_ALIGNMENT
+ * bytes. The word right before the block points back here, so free() finds
+ * it without searching
+ */
 struct malloc_block {
     uint32_t    magic;
-    void    *   prev;
+    void    *   prev;   /* next older free block */
     void    *   ptr;
     size_t      size;
+    bool        allocated;
+#ifdef MALLOC_PROFILE
+    uintptr_t   site;   /* what the block is charged to */
+#endif
 };
 
 #define HEAP_MAGIC 0xBADB01
@@ -39,9 +50,80 @@ intptr_t kernel_heap_end;
 int      kernel_heap_allocated_blocks = 0;
 int      kernel_heap_free_blocks = 0;
 
-struct malloc_block *last_allocated = NULL;
 struct malloc_block *last_freed = NULL;
 
+#ifdef MALLOC_PROFILE
+
+#define MALLOC_NSITES   512
+
+/*
+ * open addressed by return address. Sites are never removed, so once the
+ * table is full new ones are charged to the entry for site 0
+ */
+static struct kinfo_mallocsite malloc_sites[MALLOC_NSITES];
+static int malloc_nsites;
+
+/* called with the heap's critical section held */
+static struct kinfo_mallocsite *
+malloc_site_get(uintptr_t site)
+{
+    int i;
+    uint32_t hash;
+    struct kinfo_mallocsite *entry;
+
+    hash = (site >> 2) * 2654435761u;
+
+    for (i = 0; i < MALLOC_NSITES; i++) {
+        entry = &malloc_sites[(hash + i) % MALLOC_NSITES];
+
+        if (entry->site == site && (site != 0 || entry->allocs != 0)) {
+            return entry;
+        }
+
+        if (entry->site == 0 && entry->allocs == 0) {
+            if (malloc_nsites == MALLOC_NSITES - 1 && site != 0) {
+                return malloc_site_get(0);
+            }
+
+            entry->site = site;
+            malloc_nsites++;
+
+            return entry;
+        }
+    }
+
+    return NULL;
+}
+
+static void
+malloc_site_add(uintptr_t site, size_t size)
+{
+    struct kinfo_mallocsite *entry;
+
+    entry = malloc_site_get(site);
+
+    if (entry) {
+        entry->count++;
+        entry->bytes += size;
+        entry->allocs++;
+    }
+}
+
+static void
+malloc_site_sub(uintptr_t site, size_t size)
+{
+    struct kinfo_mallocsite *entry;
+
+    entry = malloc_site_get(site);
+
+    if (entry) {
+        entry->count--;
+        entry->bytes -= size;
+    }
+}
+
+#endif /* MALLOC_PROFILE */
+
 /*
 static inline size_t
 align_addr(size_t size, uint32_t align)
@@ -80,20 +162,8 @@ find_free_block(size_t size)
     return NULL;
 }
 
-void *
-calloc(int num, size_t size)
-{
-    void *ptr;
-    
-    ptr = malloc(size);
-
-    memset(ptr, num, size);
-
-    return ptr;
-}
-
-void *
-malloc(size_t size)
+static void *
+heap_alloc(size_t size, uintptr_t site)
 {
     size_t aligned_size;
     struct malloc_block *free_block;
@@ -110,11 +180,17 @@ malloc(size_t size)
         free_block->size = aligned_size;
     }
 
-    free_block->prev = last_allocated;
-    last_allocated = free_block;
+    free_block->prev = NULL;
+    free_block->allocated = true;
+    ((struct malloc_block**)free_block->ptr)[-1] = free_block;
 
     kernel_heap_allocated_blocks++;
 
+#ifdef MALLOC_PROFILE
+    free_block->site = site;
+    malloc_site_add(site, aligned_size);
+#endif
+
     critical_exit();
 
     memset(free_block->ptr, 0, size);
@@ -122,48 +198,49 @@ malloc(size_t size)
     return free_block->ptr;
 }
 
-void
-free(void *ptr)
+void *
+calloc(int num, size_t size)
 {
-    bool block_freed;
-
-    struct malloc_block *iter;
-    struct malloc_block *prev;
+    void *ptr;
+    
+    ptr = heap_alloc(num * size, (uintptr_t)__builtin_return_address(0));
 
-    critical_enter();
+    memset(ptr, 0, num * size);
 
-    iter = last_allocated;
-    prev = NULL;
-    block_freed = false;
+    return ptr;
+}
 
-    while (iter) {
+void *
+malloc(size_t size)
+{
+    return heap_alloc(size, (uintptr_t)__builtin_return_address(0));
+}
 
-        if (iter->ptr == ptr) {
-            if (prev) {
-                prev->prev = iter->prev;
-            } else {
-                last_allocated = iter->prev;
-            }
+void
+free(void *ptr)
+{
+    struct malloc_block *block;
 
-            iter->prev = last_freed;
-            last_freed = iter;
-            kernel_heap_allocated_blocks--;
-            kernel_heap_free_blocks++;
-            block_freed = true;
-            break;
-        }
+    block = ((struct malloc_block**)ptr)[-1];
 
-        prev = iter;
-        iter = iter->prev;
-    }
-    
-    //spinlock_unlock(&malloc_lock);
-    critical_exit();
+    critical_enter();
 
-    if (!block_freed) {
+    if (block->magic != HEAP_MAGIC || block->ptr != ptr || !block->allocated) {
+        critical_exit();
         stacktrace(5);
         panic("double free (0x%p)", ptr);
     }
+
+    block->allocated = false;
+    block->prev = last_freed;
+    last_freed = block;
+#ifdef MALLOC_PROFILE
+    malloc_site_sub(block->site, block->size);
+#endif
+    kernel_heap_allocated_blocks--;
+    kernel_heap_free_blocks++;
+
+    critical_exit();
 }
 
 int
@@ -171,7 +248,6 @@ brk(void *ptr)
 {
     kernel_break = (uintptr_t)ptr + 256;
     kernel_break &= 0xFFFFFF00;
-    last_allocated = NULL;
     last_freed = NULL;
     
     kernel_heap_end = kernel_break + 0x1FC00000;
@@ -240,3 +316,108 @@ sbrk_a(size_t increment, uintptr_t align)
 
     return (void*)prev_brk;
 }
+
+#ifdef MALLOC_PROFILE
+
+void *
+calloc_at(int num, size_t size, uintptr_t site)
+{
+    void *ptr;
+
+    ptr = heap_alloc(num * size, site);
+
+    memset(ptr, 0, num * size);
+
+    return ptr;
+}
+
+void *
+malloc_at(size_t size, uintptr_t site)
+{
+    return heap_alloc(size, site);
+}
+
+/*
+ * for heap memory that is never handed back to malloc, like the items of a
+ * pool; it stays charged to site
+ */
+void
+malloc_charge(size_t size, uintptr_t site)
+{
+    critical_enter();
+    malloc_site_add(site, size);
+    critical_exit();
+}
+
+/* copies out every site that has allocated something */
+static int
+malloc_sysctl_sites(void *oldp, size_t *oldlenp)
+{
+    int i;
+    int nentries;
+    int nsites;
+    struct kinfo_mallocsite *snapshot;
+
+    if (!oldlenp) {
+        return -(EINVAL);
+    }
+
+    if (!oldp) {
+        /* leaves room for sites that show up before the second call */
+        *oldlenp = (malloc_nsites + 16)*sizeof(struct kinfo_mallocsite);
+        return 0;
+    }
+
+    nentries = *oldlenp / sizeof(struct kinfo_mallocsite);
+    snapshot = calloc(MALLOC_NSITES, sizeof(struct kinfo_mallocsite));
+    nsites = 0;
+
+    /* the table can't change while it's being copied out to userland */
+    critical_enter();
+
+    for (i = 0; i < MALLOC_NSITES; i++) {
+        if (malloc_sites[i].allocs != 0) {
+            memcpy(&snapshot[nsites++], &malloc_sites[i], sizeof(struct kinfo_mallocsite));
+        }
+    }
+
+    critical_exit();
+
+    if (nentries > nsites) {
+        nentries = nsites;
+    }
+
+    memcpy(oldp, snapshot, nentries*sizeof(struct kinfo_mallocsite));
+    *oldlenp = nentries*sizeof(struct kinfo_mallocsite);
+
+    free(snapshot);
+
+    return 0;
+}
+
+int
+malloc_sysctl(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    if (namelen != 1) {
+        return -(EINVAL);
+    }
+
+    switch (name[0]) {
+        case KERN_MALLOC_SITES:
+            return malloc_sysctl_sites(oldp, oldlenp);
+        default:
+            break;
+    }
+
+    return -1;
+}
+
+#else
+
+int
+malloc_sysctl(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    return -(EOPNOTSUPP);
+}
+
+#endif /* MALLOC_PROFILE */
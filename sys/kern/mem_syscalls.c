@@ -25,6 +25,7 @@
 #include <sys/syscall.h>
 #include <sys/systm.h>
 #include <sys/types.h>
+#include <sys/vdso.h>
 #include <sys/vm.h>
 
 struct mmap_args {
@@ -57,13 +58,15 @@ sys_mmap(struct thread *th, syscall_args_t argv)
 static int
 sys_munmap(struct thread *th, syscall_args_t argv)
 {
-    extern struct vm_space *sched_curr_address_space;
-
     DEFINE_SYSCALL_PARAM(void *, addr, 0, argv);
     DEFINE_SYSCALL_PARAM(size_t, length, 1, argv);
 
     TRACE_SYSCALL("munmap", "0x%p, %d", addr, length);
 
+    if (VDSO_CONTAINS(addr, length)) {
+        return -(EINVAL);
+    }
+
     vm_unmap(sched_curr_address_space, addr, length);
 
     return 0;
@@ -103,6 +106,30 @@ sys_shm_unlink(struct thread *th, syscall_args_t argv)
     return shm_unlink(current_proc, name);
 }
 
+static int
+sys_memfd_create(struct thread *th, syscall_args_t argv)
+{
+    int res;
+    struct file *fp;
+
+    DEFINE_SYSCALL_PARAM(const char *, name, 0, argv);
+    DEFINE_SYSCALL_PARAM(int, flags, 1, argv);
+
+    TRACE_SYSCALL("memfd_create", "\"%s\", %d", name, flags);
+
+    if (vm_access(th->address_space, name, 1, VM_READ)) {
+        return -(EFAULT);
+    }
+
+    res = shm_memfd_create(current_proc, &fp, name, flags);
+
+    if (res != 0) {
+        return res;
+    }
+
+    return procdesc_newfd(fp);
+}
+
 void
 mem_syscalls_init()
 {
@@ -110,4 +137,5 @@ mem_syscalls_init()
     register_syscall(SYS_MUNMAP, 2, sys_munmap);
     register_syscall(SYS_SHM_OPEN, 3, sys_shm_open);
     register_syscall(SYS_SHM_UNLINK, 1, sys_shm_unlink);
+    register_syscall(SYS_MEMFD_CREATE, 2, sys_memfd_create);
 }
@@ -18,6 +18,7 @@
 #include <sys/errno.h>
 #include <sys/fcntl.h>
 #include <sys/file.h>
+#include <sys/ioctl.h>
 #include <sys/malloc.h>
 #include <sys/mutex.h>
 #include <sys/proc.h>
@@ -47,15 +48,21 @@ struct pipe {
 static int pipe_close(struct file *);
 static int pipe_destroy(struct file *);
 static int pipe_duplicate(struct file *);
+static int pipe_ioctl(struct file *, uint64_t, void *);
 static int pipe_read(struct file *, void *, size_t);
+static int pipe_fop_readv(struct file *, const struct iovec *, int, off_t);
 static int pipe_write(struct file *, const void *, size_t);
+static int pipe_fop_writev(struct file *, const struct iovec *, int, off_t);
 
 struct fops pipe_ops = {
     .close      = pipe_close,
     .destroy    = pipe_destroy,
     .duplicate  = pipe_duplicate,
+    .ioctl      = pipe_ioctl,
     .read       = pipe_read,
-    .write      = pipe_write
+    .readv      = pipe_fop_readv,
+    .write      = pipe_write,
+    .writev     = pipe_fop_writev
 };
 
 static struct pipe *
@@ -152,12 +159,74 @@ pipe_duplicate(struct file *newfile)
 }
 
 static int
-pipe_read(struct file *fp, void *buf, size_t nbyte)
+pipe_ioctl(struct file *fp, uint64_t request, void *argp)
+{
+    struct pipe *pipe;
+
+    pipe = fp->state;
+
+    switch (request) {
+        case FIONREAD:
+            *((uint32_t*)argp) = pipe->size;
+            return 0;
+        case FIONSPACE:
+            *((uint32_t*)argp) = pipe->buf_size - pipe->size;
+            return 0;
+    }
+
+    return -(ENOTSUP);
+}
+
+/* copy nbyte bytes out of the ring buffer, starting at the head */
+static void
+pipe_copyout(struct pipe *pipe, uint8_t *buf, size_t nbyte)
+{
+    size_t first;
+
+    first = pipe->buf_size - pipe->head_pos;
+
+    if (first > nbyte) {
+        first = nbyte;
+    }
+
+    memcpy(buf, &pipe->buf[pipe->head_pos], first);
+    memcpy(buf + first, pipe->buf, nbyte - first);
+
+    pipe->head_pos = (pipe->head_pos + nbyte) % pipe->buf_size;
+    pipe->size -= nbyte;
+}
+
+/* copy nbyte bytes into the ring buffer, starting at the tail */
+static void
+pipe_copyin(struct pipe *pipe, const uint8_t *buf, size_t nbyte)
 {
-    extern struct thread *sched_curr_thread;
+    size_t first;
+
+    first = pipe->buf_size - pipe->tail_pos;
+
+    if (first > nbyte) {
+        first = nbyte;
+    }
 
+    memcpy(&pipe->buf[pipe->tail_pos], buf, first);
+    memcpy(pipe->buf, buf + first, nbyte - first);
+
+    pipe->tail_pos = (pipe->tail_pos + nbyte) % pipe->buf_size;
+    pipe->size += nbyte;
+}
+
+/*
+ * Reads from the pipe into an iovec array, filling each segment in turn with
+ * whatever is buffered. Only waits for data before the first byte is copied.
+ * flags are the caller's file flags; layered objects (fifos, ptys, sockets)
+ * pass their own so that O_NONBLOCK is honoured on the outer descriptor
+ */
+int
+pipe_readv(struct file *fp, const struct iovec *iov, int iovcnt, int flags)
+{
     int i;
-    uint8_t *buf8;
+    size_t chunk;
+    size_t total;
     struct pipe *pipe;
     
     pipe = fp->state;
@@ -166,9 +235,15 @@ pipe_read(struct file *fp, void *buf, size_t nbyte)
         return -1;
     }
 
-    buf8 = buf;
+    if (iov_length(iov, iovcnt) == 0) {
+        return 0;
+    }
 
     while (pipe->size == 0 && !pipe->write_closed) {
+        if ((flags & O_NONBLOCK)) {
+            return -(EAGAIN);
+        }
+
         thread_yield();
 
         if (sched_curr_thread->exit_requested) {
@@ -182,16 +257,17 @@ pipe_read(struct file *fp, void *buf, size_t nbyte)
 
     spinlock_lock(&pipe->lock);
 
-    if (nbyte > pipe->size) {
-        nbyte = pipe->size;
-    }
+    for (i = 0, total = 0; i < iovcnt && pipe->size > 0; i++) {
+        chunk = iov[i].iov_len;
 
-    for (i = 0; i < nbyte; i++) {
-        buf8[i] = pipe->buf[i % pipe->buf_size + pipe->head_pos];
-    }
+        if (chunk > pipe->size) {
+            chunk = pipe->size;
+        }
 
-    pipe->size -= nbyte;
-    pipe->head_pos += nbyte;
+        pipe_copyout(pipe, iov[i].iov_base, chunk);
+
+        total += chunk;
+    }
 
     if (pipe->size == 0) {
         pipe->head_pos = 0;
@@ -200,17 +276,24 @@ pipe_read(struct file *fp, void *buf, size_t nbyte)
  
     spinlock_unlock(&pipe->lock);
 
-    return nbyte;
+    return total;
 }
 
-
-static int
-pipe_write(struct file *fp, const void *buf, size_t nbyte)
+/*
+ * Writes an iovec array into the pipe. A request no larger than the pipe
+ * buffer is atomic; the writer waits until all of it fits so that it is never
+ * interleaved with another writer's data. Larger requests are split into
+ * buffer sized chunks
+ */
+int
+pipe_writev(struct file *fp, const struct iovec *iov, int iovcnt, int flags)
 {
-    extern struct thread *sched_curr_thread;
-        
-    int i;
-    uint8_t const *buf8;
+    int seg;
+    size_t seg_off;
+    size_t chunk;
+    size_t nbyte;
+    size_t needed;
+    size_t written;
     struct pipe *pipe;
     
     pipe = fp->state;
@@ -219,32 +302,94 @@ pipe_write(struct file *fp, const void *buf, size_t nbyte)
         return -1;
     }
 
-    while (pipe->size != 0 && !pipe->read_closed) {
-        if (sched_curr_thread->exit_requested) {
-            return -(EINTR);
+    nbyte = iov_length(iov, iovcnt);
+    written = 0;
+    seg = 0;
+    seg_off = 0;
+
+    while (written < nbyte) {
+        needed = nbyte - written;
+
+        if (needed > pipe->buf_size) {
+            needed = 1;
         }
-    }
 
-    if (pipe->read_closed) {
-        return -(EPIPE);
-    }
+        while ((pipe->buf_size - pipe->size) < needed && !pipe->read_closed) {
+            if ((flags & O_NONBLOCK)) {
+                return written > 0 ? written : -(EAGAIN);
+            }
 
-    spinlock_lock(&pipe->lock);
+            thread_yield();
 
-    buf8 = buf;
+            if (sched_curr_thread->exit_requested) {
+                return written > 0 ? written : -(EINTR);
+            }
+        }
 
-    for (i = 0; i < nbyte; i++) {
-        pipe->buf[(i + pipe->tail_pos) % pipe->buf_size] = buf8[i];
-    }
+        if (pipe->read_closed) {
+            return -(EPIPE);
+        }
 
-    pipe->tail_pos += nbyte;
-    pipe->size += nbyte;
+        spinlock_lock(&pipe->lock);
 
-    spinlock_unlock(&pipe->lock);
+        while (seg < iovcnt && pipe->size < pipe->buf_size) {
+            chunk = iov[seg].iov_len - seg_off;
+
+            if (chunk > pipe->buf_size - pipe->size) {
+                chunk = pipe->buf_size - pipe->size;
+            }
+
+            pipe_copyin(pipe, (const uint8_t*)iov[seg].iov_base + seg_off, chunk);
+
+            written += chunk;
+            seg_off += chunk;
+
+            if (seg_off == iov[seg].iov_len) {
+                seg++;
+                seg_off = 0;
+            }
+        }
+
+        spinlock_unlock(&pipe->lock);
+    }
 
     // Note: wait queue is broken, however, this should eventually use the wait queue
     // to put the thread to sleep while waiting for the pipe to fill/drain
     //wq_pulse(&pipe->write_queue);
 
-    return nbyte;
+    return written;
+}
+
+static int
+pipe_read(struct file *fp, void *buf, size_t nbyte)
+{
+    struct iovec iov;
+
+    iov.iov_base = buf;
+    iov.iov_len = nbyte;
+
+    return pipe_readv(fp, &iov, 1, fp->flags);
+}
+
+static int
+pipe_fop_readv(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    return pipe_readv(fp, iov, iovcnt, fp->flags);
+}
+
+static int
+pipe_write(struct file *fp, const void *buf, size_t nbyte)
+{
+    struct iovec iov;
+
+    iov.iov_base = (void*)buf;
+    iov.iov_len = nbyte;
+
+    return pipe_writev(fp, &iov, 1, fp->flags);
+}
+
+static int
+pipe_fop_writev(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    return pipe_writev(fp, iov, iovcnt, fp->flags);
 }
@@ -24,12 +24,17 @@
 #include <sys/string.h>
 #include <sys/systm.h>
 
+LOCK_CLASS(pool_lock_class, "pool");
+
 void
 pool_init(struct pool *pp, size_t size, uintptr_t align)
 {
     memset(pp, 0, sizeof(struct pool));
     pp->entry_size = size;
     pp->align = align;
+
+    spinlock_set_class(&pp->lock, &pool_lock_class);
+    lock_class_register(&pool_lock_class);
 }
 
 void *
@@ -46,6 +51,9 @@ pool_get(struct pool *pp)
             ptr = sbrk(pp->entry_size);
         }
 
+        /* the pool keeps it for good; charge it to whoever made it grow */
+        malloc_charge(pp->entry_size, MALLOC_CALLER());
+
         list_append(&pp->allocated_items, ptr);
 
         goto _cleanup;
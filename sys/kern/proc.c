@@ -22,11 +22,13 @@
 #include <sys/errno.h>
 #include <sys/fcntl.h>
 #include <sys/file.h>
+#include <sys/ktrace.h>
 #include <sys/wait.h>
 #include <sys/malloc.h>
 #include <sys/pool.h>
 #include <sys/proc.h>
 #include <sys/string.h>
+#include <sys/syscallstat.h>
 #include <sys/systm.h>
 #include <sys/time.h>
 #include <sys/vnode.h>
@@ -144,6 +146,9 @@ proc_destroy(struct proc *proc)
 
     wq_empty(&proc->waiters);
 
+    ktrace_free(proc);
+    syscall_stat_free(proc);
+
     proc_count--;
     
     /* send SIGCHLD */ 
@@ -281,6 +286,7 @@ thread_new(struct vm_space *space)
     struct thread *thread;
 
     thread = pool_get(&thread_pool);
+    thread->affinity = CPU_MASK_ALL;
 
     if (space) {
         thread->address_space = space;
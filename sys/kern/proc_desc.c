@@ -128,6 +128,9 @@ set_fcntl_flags(struct file *fp, int flags)
     return 0;
 }
 
+/* status flags that may be changed through F_SETFL */
+#define FCNTL_SETFL_MASK    (O_APPEND | O_NONBLOCK)
+
 int
 procdesc_fcntl(int fd, int cmd, void *arg)
 {
@@ -152,6 +155,12 @@ procdesc_fcntl(int fd, int cmd, void *arg)
                 *((int*)arg) = get_fcntl_flags(fp);
             }
 
+            return 0;
+        case F_GETFL:
+            return fp->flags & (O_ACCMODE | FCNTL_SETFL_MASK);
+        case F_SETFL:
+            fp->flags &= ~FCNTL_SETFL_MASK;
+            fp->flags |= ((int)arg & FCNTL_SETFL_MASK);
             return 0;
     }
 
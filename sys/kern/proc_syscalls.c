@@ -199,8 +199,6 @@ sys_execve(struct thread *th, syscall_args_t args)
 static int
 sys_exit(struct thread *th, syscall_args_t args)
 {
-    extern struct thread *sched_curr_thread;
-
     DEFINE_SYSCALL_PARAM(int, status, 0, args);
 
     TRACE_SYSCALL("exit", "%d", status);
@@ -313,8 +311,6 @@ sys_getppid()
 static int
 sys_gettid(struct thread *th, syscall_args_t argv)
 {
-    extern struct thread *sched_curr_thread;
-
     TRACE_SYSCALL("gettid", "void");
 
     return sched_curr_thread->tid;
@@ -686,8 +682,6 @@ sys_pause(struct thread *th, syscall_args_t argv)
 static int
 sys_thread_sleep(struct thread *th, syscall_args_t argv)
 {
-    extern struct thread *sched_curr_thread;
-
     TRACE_SYSCALL("thread_sleep", "void");
 
     thread_schedule(SSLEEP, sched_curr_thread);
@@ -727,6 +721,72 @@ sys_thread_wake(struct thread *th, syscall_args_t argv)
     return ret;
 }
 
+/* a thread of the calling process; 0 means the calling thread */
+static struct thread *
+find_thread(pid_t tid)
+{
+    list_iter_t iter;
+    struct thread *thread;
+    struct thread *res;
+
+    if (tid == 0) {
+        return sched_curr_thread;
+    }
+
+    list_get_iter(&current_proc->threads, &iter);
+
+    res = NULL;
+
+    while (iter_move_next(&iter, (void**)&thread)) {
+        if (thread->tid == tid) {
+            res = thread;
+            break;
+        }
+    }
+
+    iter_close(&iter);
+
+    return res;
+}
+
+static int
+sys_sched_getaffinity(struct thread *th, syscall_args_t argv)
+{
+    struct thread *thread;
+
+    DEFINE_SYSCALL_PARAM(pid_t, tid, 0, argv);
+
+    TRACE_SYSCALL("sched_getaffinity", "%d", tid);
+
+    thread = find_thread(tid);
+
+    if (!thread) {
+        return -(ESRCH);
+    }
+
+    /* only the bits of CPUs that exist, which keeps the result positive */
+    return thread->affinity & ((1 << ncpus) - 1);
+}
+
+static int
+sys_sched_setaffinity(struct thread *th, syscall_args_t argv)
+{
+    struct thread *thread;
+
+    DEFINE_SYSCALL_PARAM(pid_t, tid, 0, argv);
+    DEFINE_SYSCALL_PARAM(uint32_t, mask, 1, argv);
+
+    TRACE_SYSCALL("sched_setaffinity", "%d, 0x%x", tid, mask);
+
+    thread = find_thread(tid);
+
+    if (!thread) {
+        return -(ESRCH);
+    }
+
+    return sched_setaffinity(thread, mask);
+}
+
 void
 proc_syscalls_init()
 {
@@ -765,6 +825,8 @@ proc_syscalls_init()
     register_syscall(SYS_THREAD_SLEEP, 0, sys_thread_sleep);
     register_syscall(SYS_THREAD_WAKE, 1, sys_thread_wake);
     register_syscall(SYS_GETTID, 0, sys_gettid);
+    register_syscall(SYS_SCHED_GETAFFINITY, 1, sys_sched_getaffinity);
+    register_syscall(SYS_SCHED_SETAFFINITY, 2, sys_sched_setaffinity);
     register_syscall(SYS_FCNTL, 3, sys_fcntl);
     register_syscall(SYS_WORLDCTL, 2, sys_worldctl);
 }
\ No newline at end of file
@@ -0,0 +1,215 @@
+/*
+ * prof.c - sampling profiler
+ *
+ * While profiling is enabled, every timer tick records where the CPU it
+ * arrived on was interrupted, along with a few return addresses when that was
+ * in the kernel. Samples pile up in a ring per CPU until userland drains them
+ * with sysctl; a ring that fills up drops new samples and counts them
+ *
+ * Both the timer interrupt and sysctl run under the giant lock, so the rings
+ * need no locking of their own
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <sys/cpu.h>
+#include <sys/errno.h>
+#include <sys/malloc.h>
+#include <sys/proc.h>
+#include <sys/prof.h>
+#include <sys/string.h>
+#include <sys/sysctl.h>
+#include <sys/types.h>
+
+struct prof_ring {
+    struct kinfo_prof_sample    samples[PROF_NSAMPLES];
+    uint32_t                    head;   /* next sample written */
+    uint32_t                    tail;   /* next sample read */
+};
+
+volatile bool               prof_enabled;
+
+static struct prof_ring *   prof_rings[MAXCPU];
+static uint32_t             prof_dropped;
+
+void
+prof_record(struct cpu *ci, uintptr_t *pcs, int depth, bool user)
+{
+    struct kinfo_prof_sample *sample;
+    struct prof_ring *ring;
+
+    ring = prof_rings[ci->ci_id];
+
+    if (!ring) {
+        return;
+    }
+
+    if (ring->head - ring->tail == PROF_NSAMPLES) {
+        prof_dropped++;
+        return;
+    }
+
+    sample = &ring->samples[ring->head % PROF_NSAMPLES];
+    sample->cpu = ci->ci_id;
+    sample->pid = ci->ci_proc ? ci->ci_proc->pid : 0;
+    sample->user = user;
+    sample->depth = depth;
+
+    memcpy(sample->pc, pcs, depth*sizeof(uintptr_t));
+
+    ring->head++;
+}
+
+static int
+prof_set_enabled(bool enable)
+{
+    int i;
+
+    if (current_proc && current_proc->creds.uid != 0) {
+        return -(EPERM);
+    }
+
+    /*
+     * the rings are only reset when profiling starts; while it runs they
+     * belong to prof_record() and to whoever is draining them
+     */
+    if (enable && !prof_enabled) {
+        for (i = 0; i < ncpus; i++) {
+            if (!prof_rings[i]) {
+                prof_rings[i] = malloc(sizeof(struct prof_ring));
+
+                if (!prof_rings[i]) {
+                    return -(ENOMEM);
+                }
+            }
+
+            prof_rings[i]->head = 0;
+            prof_rings[i]->tail = 0;
+        }
+
+        prof_dropped = 0;
+    }
+
+    prof_enabled = enable;
+
+    return 0;
+}
+
+static int
+prof_sysctl_enable(void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    if (oldp && oldlenp) {
+        if (*oldlenp < sizeof(int)) {
+            return -(EINVAL);
+        }
+
+        *(int*)oldp = prof_enabled;
+        *oldlenp = sizeof(int);
+    } else if (oldlenp) {
+        *oldlenp = sizeof(int);
+    }
+
+    if (newp) {
+        if (newlen != sizeof(int)) {
+            return -(EINVAL);
+        }
+
+        return prof_set_enabled(*(int*)newp != 0);
+    }
+
+    return 0;
+}
+
+/* copies out, and forgets, as many samples as fit; only root may drain them */
+static int
+prof_sysctl_samples(void *buf, size_t *lenp)
+{
+    int i;
+    int maxentries;
+    int nentries;
+    uint32_t pending;
+    struct kinfo_prof_sample *entries;
+    struct prof_ring *ring;
+
+    if (current_proc && current_proc->creds.uid != 0) {
+        return -(EPERM);
+    }
+
+    if (!lenp) {
+        return -(EINVAL);
+    }
+
+    pending = 0;
+
+    for (i = 0; i < ncpus; i++) {
+        if (prof_rings[i]) {
+            pending += prof_rings[i]->head - prof_rings[i]->tail;
+        }
+    }
+
+    if (!buf) {
+        *lenp = pending*sizeof(struct kinfo_prof_sample);
+        return 0;
+    }
+
+    maxentries = *lenp / sizeof(struct kinfo_prof_sample);
+    entries = buf;
+    nentries = 0;
+
+    for (i = 0; i < ncpus && nentries < maxentries; i++) {
+        ring = prof_rings[i];
+
+        if (!ring) {
+            continue;
+        }
+
+        while (ring->tail != ring->head && nentries < maxentries) {
+            memcpy(&entries[nentries++], &ring->samples[ring->tail % PROF_NSAMPLES],
+                    sizeof(struct kinfo_prof_sample));
+            ring->tail++;
+        }
+    }
+
+    *lenp = nentries*sizeof(struct kinfo_prof_sample);
+
+    return 0;
+}
+
+int
+prof_sysctl(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    if (namelen < 1) {
+        return -(EINVAL);
+    }
+
+    switch (name[0]) {
+        case KERN_PROF_ENABLE:
+            return prof_sysctl_enable(oldp, oldlenp, newp, newlen);
+        case KERN_PROF_SAMPLES:
+            return prof_sysctl_samples(oldp, oldlenp);
+        case KERN_PROF_DROPPED:
+            if (!oldp || !oldlenp || *oldlenp < sizeof(uint32_t)) {
+                return -(EINVAL);
+            }
+
+            *(uint32_t*)oldp = prof_dropped;
+            *oldlenp = sizeof(uint32_t);
+
+            return 0;
+        default:
+            break;
+    }
+
+    return -1;
+}
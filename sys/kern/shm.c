@@ -15,39 +15,184 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
+#include <machine/vm.h>
 #include <sys/errno.h>
 #include <sys/fcntl.h>
 #include <sys/file.h>
 #include <sys/malloc.h>
 #include <sys/mutex.h>
 #include <sys/proc.h>
+#include <sys/shm.h>
 #include <sys/stat.h>
 #include <sys/string.h>
 #include <sys/types.h>
+#include <sys/vm.h>
 #include <sys/vnode.h>
 #include <sys/wait.h>
 // delete me
 #include <sys/systm.h>
 
+/* the largest size an object can be truncated to */
+#define SHM_MAX_SIZE    (256 * 1024 * 1024)
+
+/*
+ * A shared memory object owns its pages; they are not tied to the address
+ * space of whoever maps the object first. Each mapping takes its own page
+ * references, so an object can be unlinked, closed or shrunk while mapped
+ * and the existing mappings stay valid
+ */
 struct shm_object {
-    size_t              size;
-    void *              addr;
-    struct vm_space *   space;
+    size_t              size;       /* size in bytes, as set by ftruncate */
+    int                 npages;
+    void **             pages;
+    int                 refs;       /* open file descriptions */
+    bool                linked;     /* reachable through shm_open() */
+    struct vnode *      vn;         /* ownership and permissions; NULL for memfd */
+    spinlock_t          lock;
 };
 
-
-static intptr_t shm_mmap(struct file *, uintptr_t, size_t, int, off_t);
+static int shm_close(struct file *);
+static int shm_duplicate(struct file *);
+static int shm_mmap(struct file *, uintptr_t, size_t, int, off_t);
+static int shm_read(struct file *, void *, size_t);
+static int shm_seek(struct file *, off_t *, off_t, int);
+static int shm_stat(struct file *, struct stat *);
 static int shm_truncate(struct file *, off_t);
+static int shm_write(struct file *, const void *, size_t);
 
 struct fops shm_ops = {
-    .close = NULL,
-    .destroy = NULL,
-    .mmap = shm_mmap,
-    .truncate = shm_truncate
+    .close      = shm_close,
+    .duplicate  = shm_duplicate,
+    .mmap       = shm_mmap,
+    .read       = shm_read,
+    .seek       = shm_seek,
+    .stat       = shm_stat,
+    .truncate   = shm_truncate,
+    .write      = shm_write
 };
 
 static struct dict shm_objects;
 
+static struct shm_object *
+shm_object_new(struct vnode *vn)
+{
+    struct shm_object *obj;
+
+    obj = calloc(1, sizeof(struct shm_object));
+    obj->vn = vn;
+
+    return obj;
+}
+
+static void
+shm_object_destroy(struct shm_object *obj)
+{
+    int i;
+
+    for (i = 0; i < obj->npages; i++) {
+        vm_page_release(obj->pages[i]);
+    }
+
+    if (obj->pages) {
+        free(obj->pages);
+    }
+
+    if (obj->vn) {
+        vn_destroy(obj->vn);
+    }
+
+    free(obj);
+}
+
+/*
+ * grows or shrinks the page array backing an object; new pages are zeroed.
+ * When shrinking, the tail of the last page kept is zeroed too, so growing
+ * the object again never brings back data that was truncated away
+ */
+static int
+shm_object_resize(struct shm_object *obj, size_t size)
+{
+    int i;
+    int npages;
+    void **pages;
+    size_t tail;
+    uint8_t *page;
+
+    npages = size > 0 ? PAGE_COUNT(size) : 0;
+
+    spinlock_lock(&obj->lock);
+
+    if (npages > obj->npages) {
+        /* nothing is allocated unless all of it is there */
+        if (!vm_page_available(npages - obj->npages)) {
+            spinlock_unlock(&obj->lock);
+            return -(ENOMEM);
+        }
+
+        pages = malloc(npages * sizeof(void*));
+
+        if (!pages) {
+            spinlock_unlock(&obj->lock);
+            return -(ENOMEM);
+        }
+
+        for (i = obj->npages; i < npages; i++) {
+            pages[i] = vm_page_alloc();
+
+            /* someone else got there first; leave the object as it was */
+            if (!pages[i]) {
+                while (--i >= obj->npages) {
+                    vm_page_release(pages[i]);
+                }
+
+                free(pages);
+                spinlock_unlock(&obj->lock);
+
+                return -(ENOMEM);
+            }
+        }
+
+        if (obj->pages) {
+            memcpy(pages, obj->pages, obj->npages * sizeof(void*));
+            free(obj->pages);
+        }
+
+        obj->pages = pages;
+    } else {
+        for (i = npages; i < obj->npages; i++) {
+            vm_page_release(obj->pages[i]);
+        }
+
+        tail = PAGE_OFFSET(size);
+
+        if (size < obj->size && tail != 0) {
+            page = vm_page_kva(obj->pages[npages - 1]);
+            memset(page + tail, 0, PAGE_SIZE - tail);
+        }
+    }
+
+    obj->npages = npages;
+    obj->size = size;
+
+    spinlock_unlock(&obj->lock);
+
+    return 0;
+}
+
+static struct file *
+shm_object_to_file(struct shm_object *obj, int oflag)
+{
+    struct file *fp;
+
+    fp = file_new(&shm_ops, obj);
+
+    fp->flags = oflag & (O_ACCMODE | O_CLOEXEC);
+
+    obj->refs++;
+
+    return fp;
+}
+
 int
 shm_open(struct proc *proc, struct file **result, const char *name, int oflag, mode_t mode)
 {    
@@ -56,7 +201,6 @@ shm_open(struct proc *proc, struct file **result, const char *name, int oflag, m
     bool will_write;
 
     struct cred *creds;
-    struct file *fp;
     struct shm_object *shm;
     struct vnode *node;
     
@@ -65,7 +209,9 @@ shm_open(struct proc *proc, struct file **result, const char *name, int oflag, m
     if (!dict_get(&shm_objects, name, (void**)&node)) {
         node = vn_new(NULL, NULL, NULL);
 
-        shm = calloc(1, sizeof(struct shm_object));
+        shm = shm_object_new(node);
+        shm->linked = true;
+
         node->state = shm;
         node->uid = creds->uid;
         node->gid = creds->gid;
@@ -82,7 +228,7 @@ shm_open(struct proc *proc, struct file **result, const char *name, int oflag, m
                 (node->gid == creds->gid && (node->mode & S_IRGRP)) ||
                 (node->mode & S_IROTH);
 
-    will_write = (oflag & O_WRONLY);
+    will_write = (oflag & O_ACCMODE) != O_RDONLY;
 
     if (will_write && !can_write) {
         return -(EPERM);
@@ -92,11 +238,7 @@ shm_open(struct proc *proc, struct file **result, const char *name, int oflag, m
         return -(EPERM);
     }
 
-    fp = file_new(&shm_ops, node);
-
-    fp->state = node->state;
-
-    *result = fp;
+    *result = shm_object_to_file(node->state, oflag);
 
     return 0;  
 }
@@ -127,44 +269,267 @@ shm_unlink(struct proc *proc, const char *name)
     }
 
     dict_remove(&shm_objects, name);
-    free(object);
+
+    object->linked = false;
+
+    /* open descriptors keep the object alive; the last close releases it */
+    if (object->refs == 0) {
+        shm_object_destroy(object);
+    }
+
+    return 0;
+}
+
+/* creates an anonymous object that is only reachable through its descriptor */
+int
+shm_memfd_create(struct proc *proc, struct file **result, const char *name, int flags)
+{
+    int oflag;
+    struct shm_object *obj;
+
+    if ((flags & ~MFD_CLOEXEC)) {
+        return -(EINVAL);
+    }
+
+    obj = shm_object_new(NULL);
+
+    oflag = O_RDWR;
+
+    if ((flags & MFD_CLOEXEC)) {
+        oflag |= O_CLOEXEC;
+    }
+
+    *result = shm_object_to_file(obj, oflag);
+
+    return 0;
+}
+
+static int
+shm_close(struct file *fp)
+{
+    struct shm_object *obj;
+
+    obj = fp->state;
+
+    obj->refs--;
+
+    if (obj->refs == 0 && !obj->linked) {
+        shm_object_destroy(obj);
+    }
+
+    return 0;
+}
+
+static int
+shm_duplicate(struct file *fp)
+{
+    struct shm_object *obj;
+
+    obj = fp->state;
+
+    obj->refs++;
 
     return 0;
 }
 
-static intptr_t
+/*
+ * maps size bytes of the object starting at offset, which must be page
+ * aligned. The range has to lie within the object
+ */
+static int
 shm_mmap(struct file *fp, uintptr_t addr, size_t size, int prot, off_t offset)
 {
+    int i;
+    int first;
+    int npages;
+    void *res;
+    void **pages;
     struct shm_object *obj;
     struct vm_space *space; 
 
     obj = fp->state;
 
-    if (size != obj->size) {
-        return -1;
+    if (size == 0 || offset < 0 || (offset & (PAGE_SIZE - 1))) {
+        return -(EINVAL);
     }
 
+    if ((prot & VM_WRITE) && (fp->flags & O_ACCMODE) == O_RDONLY) {
+        return -(EACCES);
+    }
+
+    /* user mappings only */
+    prot &= ~VM_KERN;
+
     space = current_proc->thread->address_space;
+    first = PAGE_INDEX(offset);
+    npages = PAGE_COUNT(size);
 
-    if (!obj->space) {
-        /* its not mapped already, we've got to allocate and map space */
-        obj->space = space; 
-        obj->addr = vm_map(space, NULL, size, prot);
-        return (intptr_t)obj->addr;
+    pages = calloc(npages, sizeof(void*));
+
+    if (!pages) {
+        return -(ENOMEM);
     }
 
-    /* in this case, its already mapped; just gotta share it with the calling process */
-    return (intptr_t)vm_share(space, obj->space, NULL, obj->addr, obj->size, prot);
+    /*
+     * the pages are held so a concurrent truncate can't free them, and the
+     * object's lock is dropped before mapping, which allocates page tables
+     */
+    spinlock_lock(&obj->lock);
+
+    if (offset + size > obj->size) {
+        spinlock_unlock(&obj->lock);
+        free(pages);
+        return -(ENXIO);
+    }
+
+    for (i = 0; i < npages; i++) {
+        pages[i] = obj->pages[first + i];
+        vm_page_hold(pages[i]);
+    }
+
+    spinlock_unlock(&obj->lock);
+
+    res = vm_map_pages(space, (void*)addr, pages, npages, prot);
+
+    for (i = 0; i < npages; i++) {
+        vm_page_release(pages[i]);
+    }
+
+    free(pages);
+
+    return (intptr_t)res;
 }
 
+/* copies between a buffer and the object's pages through the kernel mapping */
 static int
-shm_truncate(struct file *fp, off_t length)
+shm_copy(struct shm_object *obj, off_t pos, void *buf, size_t nbyte, bool write)
 {
+    size_t copied;
+    size_t chunk;
+    size_t page_off;
+    uint8_t *page;
+
+    spinlock_lock(&obj->lock);
+
+    if (pos >= obj->size) {
+        spinlock_unlock(&obj->lock);
+        return 0;
+    }
+
+    if (nbyte > obj->size - pos) {
+        nbyte = obj->size - pos;
+    }
+
+    for (copied = 0; copied < nbyte; copied += chunk) {
+        page = vm_page_kva(obj->pages[PAGE_INDEX(pos + copied)]);
+        page_off = PAGE_OFFSET(pos + copied);
+        chunk = PAGE_SIZE - page_off;
+
+        if (chunk > nbyte - copied) {
+            chunk = nbyte - copied;
+        }
+
+        if (write) {
+            memcpy(page + page_off, (uint8_t*)buf + copied, chunk);
+        } else {
+            memcpy((uint8_t*)buf + copied, page + page_off, chunk);
+        }
+    }
+
+    spinlock_unlock(&obj->lock);
+
+    return nbyte;
+}
+
+static int
+shm_read(struct file *fp, void *buf, size_t nbyte)
+{
+    return shm_copy(fp->state, fp->position, buf, nbyte, false);
+}
+
+static int
+shm_seek(struct file *fp, off_t *pos, off_t off, int whence)
+{
+    off_t new_pos;
     struct shm_object *obj;
-    
+
     obj = fp->state;
 
-    obj->size = length;
+    switch (whence) {
+        case SEEK_CUR:
+            new_pos = *pos + off;
+            break;
+        case SEEK_END:
+            new_pos = obj->size + off;
+            break;
+        case SEEK_SET:
+            new_pos = off;
+            break;
+        default:
+            return -(EINVAL);
+    }
+
+    if (new_pos < 0) {
+        return -(EINVAL);
+    }
+
+    *pos = new_pos;
+
+    return new_pos;
+}
+
+static int
+shm_stat(struct file *fp, struct stat *stat)
+{
+    struct shm_object *obj;
+
+    obj = fp->state;
+
+    memset(stat, 0, sizeof(struct stat));
+
+    stat->st_mode = S_IFREG | (obj->vn ? obj->vn->mode : 0600);
+    stat->st_size = obj->size;
+    stat->st_blksize = PAGE_SIZE;
+    stat->st_blocks = obj->npages;
+
+    if (obj->vn) {
+        stat->st_uid = obj->vn->uid;
+        stat->st_gid = obj->vn->gid;
+    }
 
     return 0;
 }
+
+static int
+shm_truncate(struct file *fp, off_t length)
+{
+    if (length < 0) {
+        return -(EINVAL);
+    }
+
+    if ((fp->flags & O_ACCMODE) == O_RDONLY) {
+        return -(EINVAL);
+    }
+
+    /* checked before narrowing to size_t */
+    if (length > SHM_MAX_SIZE) {
+        return -(EFBIG);
+    }
+
+    return shm_object_resize(fp->state, (size_t)length);
+}
+
+/* writes never extend the object; use ftruncate to size it first */
+static int
+shm_write(struct file *fp, const void *buf, size_t nbyte)
+{
+    int res;
+
+    res = shm_copy(fp->state, fp->position, (void*)buf, nbyte, true);
+
+    if (res == 0 && nbyte > 0) {
+        return -(ENOSPC);
+    }
+
+    return res;
+}
@@ -30,9 +30,11 @@
 #include <sys/vnode.h>
 
 /* the built-in protocols */
+extern struct protocol in_protocol;
 extern struct protocol un_protocol;
 
 struct protocol *socket_builtin_protocols[] = {
+    &in_protocol,
     &un_protocol,
     NULL
 };
@@ -73,16 +75,34 @@ sock_file_getvn(struct file *fp, struct vnode **vn)
     return SOCK_GETVN(fp->state, vn);
 }
 
+static int
+sock_file_ioctl(struct file *fp, uint64_t request, void *argp)
+{
+    return SOCK_IOCTL(fp->state, request, argp);
+}
+
 static int
 sock_file_read(struct file *fp, void *buf, size_t nbyte)
 {
-    return SOCK_RECV(fp->state, buf, nbyte);
+    return SOCK_RECV(fp->state, buf, nbyte, fp->flags);
+}
+
+static int
+sock_file_readv(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    return SOCK_RECVV(fp->state, iov, iovcnt, fp->flags);
 }
 
 static int
 sock_file_write(struct file *fp, const void *buf, size_t nbyte)
 {
-    return SOCK_SEND(fp->state, buf, nbyte);
+    return SOCK_SEND(fp->state, buf, nbyte, fp->flags);
+}
+
+static int
+sock_file_writev(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    return SOCK_SENDV(fp->state, iov, iovcnt, fp->flags);
 }
 
 struct fops sock_file_ops = {
@@ -90,8 +110,11 @@ struct fops sock_file_ops = {
     .destroy    = sock_file_destroy,
     .duplicate  = sock_file_duplicate,
     .getvn      = sock_file_getvn,
+    .ioctl      = sock_file_ioctl,
     .read       = sock_file_read,
+    .readv      = sock_file_readv,
     .write      = sock_file_write,
+    .writev     = sock_file_writev,
 };
 
 static struct protocol *
@@ -16,11 +16,17 @@
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 #include <sys/errno.h>
+#include <sys/fcntl.h>
 #include <sys/proc.h>
 #include <sys/procdesc.h>
 #include <sys/socket.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
+#include <sys/uio.h>
+#include <sys/vm.h>
+
+/* O_NONBLOCK for this call only if MSG_DONTWAIT was given */
+#define MSG_TO_FFLAGS(fp, flags) ((fp)->flags | (((flags) & MSG_DONTWAIT) ? O_NONBLOCK : 0))
 
 static int
 sys_accept(struct thread *th, syscall_args_t argv)
@@ -43,7 +49,7 @@ sys_accept(struct thread *th, syscall_args_t argv)
 
     sock = file_to_sock(fp);
 
-    res = SOCK_ACCEPT(sock, &client, address, address_len);
+    res = SOCK_ACCEPT(sock, &client, address, address_len, fp->flags);
 
     if (res == 0) {
         file = sock_to_file(client);
@@ -90,12 +96,180 @@ sys_connect(struct thread *th, syscall_args_t argv)
     if (fp) {
         sock = file_to_sock(fp);
 
-        return SOCK_CONNECT(sock, address, address_len);
+        return SOCK_CONNECT(sock, address, address_len, fp->flags);
     }
 
     return -(EBADF);
 }
 
+static int
+sys_getsockopt(struct thread *th, syscall_args_t argv)
+{
+    int res;
+    size_t len;
+    struct file *fp;
+
+    DEFINE_SYSCALL_PARAM(int, fd, 0, argv);
+    DEFINE_SYSCALL_PARAM(int, level, 1, argv);
+    DEFINE_SYSCALL_PARAM(int, name, 2, argv);
+    DEFINE_SYSCALL_PARAM(void*, val, 3, argv);
+    DEFINE_SYSCALL_PARAM(socklen_t*, val_len, 4, argv);
+
+    fp = procdesc_getfile(fd);
+
+    if (!fp) {
+        return -(EBADF);
+    }
+
+    if (vm_access(th->address_space, val_len, sizeof(socklen_t), VM_READ | VM_WRITE)) {
+        return -(EFAULT);
+    }
+
+    len = *val_len;
+
+    if (vm_access(th->address_space, val, len, VM_WRITE)) {
+        return -(EFAULT);
+    }
+
+    res = SOCK_GETSOCKOPT(file_to_sock(fp), level, name, val, &len);
+
+    if (res == 0) {
+        *val_len = len;
+    }
+
+    return res;
+}
+
+static int
+sys_listen(struct thread *th, syscall_args_t argv)
+{
+    struct file *fp;
+
+    DEFINE_SYSCALL_PARAM(int, fd, 0, argv);
+    DEFINE_SYSCALL_PARAM(int, backlog, 1, argv);
+
+    fp = procdesc_getfile(fd);
+
+    if (!fp) {
+        return -(EBADF);
+    }
+
+    return SOCK_LISTEN(file_to_sock(fp), backlog);
+}
+
+static int
+sys_recvmsg(struct thread *th, syscall_args_t argv)
+{
+    int res;
+    size_t namelen;
+    struct file *fp;
+    struct iovec *iov;
+    struct iovec small_iov[UIO_SMALLIOV];
+
+    DEFINE_SYSCALL_PARAM(int, fd, 0, argv);
+    DEFINE_SYSCALL_PARAM(struct msghdr*, msg, 1, argv);
+    DEFINE_SYSCALL_PARAM(int, flags, 2, argv);
+
+    fp = procdesc_getfile(fd);
+
+    if (!fp) {
+        return -(EBADF);
+    }
+
+    if (vm_access(th->address_space, msg, sizeof(struct msghdr), VM_READ | VM_WRITE)) {
+        return -(EFAULT);
+    }
+
+    if (msg->msg_name && vm_access(th->address_space, msg->msg_name, msg->msg_namelen, VM_WRITE)) {
+        return -(EFAULT);
+    }
+
+    res = iov_copyin(th, msg->msg_iov, msg->msg_iovlen, VM_WRITE, small_iov, &iov);
+
+    if (res != 0) {
+        return res;
+    }
+
+    namelen = msg->msg_namelen;
+
+    res = SOCK_RECVFROM(file_to_sock(fp), iov, msg->msg_iovlen, MSG_TO_FFLAGS(fp, flags),
+                        msg->msg_name, msg->msg_name ? &namelen : NULL);
+
+    if (res >= 0) {
+        msg->msg_namelen = msg->msg_name ? namelen : 0;
+        msg->msg_controllen = 0;
+        msg->msg_flags = 0;
+    }
+
+    iov_free(iov, small_iov);
+
+    return res;
+}
+
+static int
+sys_sendmsg(struct thread *th, syscall_args_t argv)
+{
+    int res;
+    struct file *fp;
+    struct iovec *iov;
+    struct iovec small_iov[UIO_SMALLIOV];
+
+    DEFINE_SYSCALL_PARAM(int, fd, 0, argv);
+    DEFINE_SYSCALL_PARAM(const struct msghdr*, msg, 1, argv);
+    DEFINE_SYSCALL_PARAM(int, flags, 2, argv);
+
+    fp = procdesc_getfile(fd);
+
+    if (!fp) {
+        return -(EBADF);
+    }
+
+    if (vm_access(th->address_space, msg, sizeof(struct msghdr), VM_READ)) {
+        return -(EFAULT);
+    }
+
+    if (msg->msg_name && vm_access(th->address_space, msg->msg_name, msg->msg_namelen, VM_READ)) {
+        return -(EFAULT);
+    }
+
+    res = iov_copyin(th, msg->msg_iov, msg->msg_iovlen, VM_READ, small_iov, &iov);
+
+    if (res != 0) {
+        return res;
+    }
+
+    res = SOCK_SENDTO(file_to_sock(fp), iov, msg->msg_iovlen, MSG_TO_FFLAGS(fp, flags),
+                      msg->msg_name, msg->msg_namelen);
+
+    iov_free(iov, small_iov);
+
+    return res;
+}
+
+static int
+sys_setsockopt(struct thread *th, syscall_args_t argv)
+{
+    struct file *fp;
+
+    DEFINE_SYSCALL_PARAM(int, fd, 0, argv);
+    DEFINE_SYSCALL_PARAM(int, level, 1, argv);
+    DEFINE_SYSCALL_PARAM(int, name, 2, argv);
+    DEFINE_SYSCALL_PARAM(const void*, val, 3, argv);
+    DEFINE_SYSCALL_PARAM(socklen_t, val_len, 4, argv);
+
+    fp = procdesc_getfile(fd);
+
+    if (!fp) {
+        return -(EBADF);
+    }
+
+    if (vm_access(th->address_space, val, val_len, VM_READ)) {
+        return -(EFAULT);
+    }
+
+    return SOCK_SETSOCKOPT(file_to_sock(fp), level, name, val, val_len);
+}
+
 static int
 sys_socket(struct thread *th, syscall_args_t argv)
 {
@@ -124,5 +298,10 @@ socket_syscalls_init()
     register_syscall(SYS_ACCEPT, 3, sys_accept);
     register_syscall(SYS_BIND, 3, sys_bind);
     register_syscall(SYS_CONNECT, 3, sys_connect);
+    register_syscall(SYS_GETSOCKOPT, 5, sys_getsockopt);
+    register_syscall(SYS_LISTEN, 2, sys_listen);
+    register_syscall(SYS_RECVMSG, 3, sys_recvmsg);
+    register_syscall(SYS_SENDMSG, 3, sys_sendmsg);
+    register_syscall(SYS_SETSOCKOPT, 5, sys_setsockopt);
     register_syscall(SYS_SOCKET, 3, sys_socket);
 }
@@ -0,0 +1,210 @@
+/*
+ * softirq.c - interrupt bottom halves and kernel worker threads
+ *
+ * Interrupt handlers do as little as they can and raise a softirq for the
+ * rest. Pending softirqs are kept per CPU and run on the way out of the
+ * interrupt, after the interrupt controller was acknowledged and with
+ * interrupts enabled again, so the next device interrupt isn't held up by
+ * them. The CPU isn't switched to another thread while it runs them.
+ *
+ * Work that may sleep goes to the worker thread of the CPU queueing it
+ * instead. Each CPU gets one, pinned to it, once the processors are up
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <machine/interrupt.h>
+#include <sys/cpu.h>
+#include <sys/proc.h>
+#include <sys/softirq.h>
+#include <sys/types.h>
+
+/* softirqs raised while running softirqs are picked up this many times over */
+#define SOFTIRQ_MAX_RESTART 4
+
+static softirq_handler_t    softirq_handlers[NSOFTIRQ];
+
+/* may be called from anywhere, including interrupt handlers */
+void
+softirq_raise(int num)
+{
+    __sync_fetch_and_or(&curcpu()->ci_softirq_pending, 1 << num);
+}
+
+void
+softirq_register(int num, softirq_handler_t handler)
+{
+    softirq_handlers[num] = handler;
+}
+
+/*
+ * called with interrupts disabled on the way out of an interrupt. Anything
+ * still pending after a few rounds waits for the next one, which is at most
+ * a tick away
+ */
+void
+softirq_run()
+{
+    int i;
+    int restarts;
+    uint32_t pending;
+    struct cpu *ci;
+
+    ci = curcpu();
+
+    /* an interrupt arriving while softirqs run leaves its own for the outer loop */
+    if (ci->ci_softirq_active || !ci->ci_softirq_pending) {
+        return;
+    }
+
+    ci->ci_softirq_active = true;
+
+    for (restarts = 0; restarts < SOFTIRQ_MAX_RESTART && ci->ci_softirq_pending; restarts++) {
+        pending = __sync_lock_test_and_set(&ci->ci_softirq_pending, 0);
+
+        bus_interrupts_on();
+
+        for (i = 0; i < NSOFTIRQ; i++) {
+            if ((pending & (1 << i)) && softirq_handlers[i]) {
+                softirq_handlers[i]();
+            }
+        }
+
+        bus_interrupts_off();
+    }
+
+    ci->ci_softirq_active = false;
+}
+
+void
+work_init(struct work *work, work_func_t func, void *argp)
+{
+    work->next = NULL;
+    work->func = func;
+    work->argp = argp;
+    work->queued = false;
+}
+
+/*
+ * hands a work item to the current CPU's worker. Returns false if it was
+ * already queued, in which case it still runs just once
+ */
+bool
+work_queue(struct work *work)
+{
+    int enabled;
+    struct cpu *ci;
+    struct thread *worker;
+
+    enabled = intr_save();
+
+    if (work->queued) {
+        intr_restore(enabled);
+        return false;
+    }
+
+    ci = curcpu();
+
+    work->queued = true;
+    work->next = NULL;
+
+    if (ci->ci_work_tail) {
+        ci->ci_work_tail->next = work;
+    } else {
+        ci->ci_work_head = work;
+    }
+
+    ci->ci_work_tail = work;
+
+    worker = ci->ci_worker;
+
+    if (worker && worker->state == SSLEEP) {
+        thread_schedule(SRUN, worker);
+    }
+
+    intr_restore(enabled);
+
+    return true;
+}
+
+static struct work *
+work_dequeue(struct cpu *ci)
+{
+    struct work *work;
+
+    work = ci->ci_work_head;
+
+    if (work) {
+        ci->ci_work_head = work->next;
+
+        if (!ci->ci_work_head) {
+            ci->ci_work_tail = NULL;
+        }
+
+        work->next = NULL;
+        work->queued = false;
+    }
+
+    return work;
+}
+
+static int
+worker_thread(void *argp)
+{
+    int enabled;
+    struct cpu *ci;
+    struct thread *self;
+    struct work *work;
+
+    ci = argp;
+    self = sched_curr_thread;
+
+    sched_setaffinity(self, 1 << ci->ci_id);
+
+    ci->ci_worker = self;
+
+    for (;;) {
+        /* nothing may be queued between finding the queue empty and going to sleep */
+        enabled = intr_save();
+
+        work = work_dequeue(ci);
+
+        if (!work) {
+            thread_schedule(SSLEEP, self);
+        }
+
+        intr_restore(enabled);
+
+        if (work) {
+            work->func(work, work->argp);
+        } else {
+            thread_yield();
+        }
+    }
+
+    return 0;
+}
+
+/* called once the application processors are running */
+void
+workers_init()
+{
+    int i;
+
+    for (i = 0; i < ncpus; i++) {
+        if (cpus[i].ci_running) {
+            thread_run(worker_thread, NULL, &cpus[i]);
+        }
+    }
+}
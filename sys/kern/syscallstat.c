@@ -0,0 +1,200 @@
+/*
+ * syscallstat.c - system call counters and latency histograms
+ *
+ * Every call is counted and its duration in TSC cycles sorted into a log2
+ * bucket, bucket n holding durations below 2^n cycles. Processes only keep
+ * their own statistics when asked to through KERN_SYSCALLSTAT_PROC. All of
+ * it is updated under the giant lock
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <sys/errno.h>
+#include <sys/malloc.h>
+#include <sys/proc.h>
+#include <sys/string.h>
+#include <sys/syscallstat.h>
+#include <sys/sysctl.h>
+#include <sys/types.h>
+#include <sys/world.h>
+
+static struct syscall_stats syscall_stats_all;
+
+static inline void
+syscall_stat_add(struct syscall_stat *stat, int ret, uint64_t cycles)
+{
+    int bucket;
+
+    if (cycles >> 32) {
+        bucket = KSYSCALLSTAT_NBUCKETS - 1;
+    } else if (cycles) {
+        bucket = 32 - __builtin_clz((uint32_t)cycles);
+    } else {
+        bucket = 0;
+    }
+
+    if (bucket >= KSYSCALLSTAT_NBUCKETS) {
+        bucket = KSYSCALLSTAT_NBUCKETS - 1;
+    }
+
+    stat->calls++;
+    stat->cycles += cycles;
+    stat->hist[bucket]++;
+
+    if (ret < 0) {
+        stat->errors++;
+    }
+}
+
+void
+syscall_stat_account(struct proc *proc, int num, int ret, uint64_t cycles)
+{
+    syscall_stat_add(&syscall_stats_all.calls[num], ret, cycles);
+
+    if (proc->syscall_stats) {
+        syscall_stat_add(&proc->syscall_stats->calls[num], ret, cycles);
+    }
+}
+
+void
+syscall_stat_free(struct proc *proc)
+{
+    if (proc->syscall_stats) {
+        free(proc->syscall_stats);
+        proc->syscall_stats = NULL;
+    }
+}
+
+/* the calls that were made at least once */
+static int
+syscall_stat_copyout(struct syscall_stats *stats, void *buf, size_t *lenp)
+{
+    int i;
+    int maxentries;
+    int nentries;
+    struct kinfo_syscallstat *entries;
+    struct syscall_stat *stat;
+
+    nentries = 0;
+
+    for (i = 0; i < SYSCALLSTAT_NCALLS; i++) {
+        if (stats->calls[i].calls) {
+            nentries++;
+        }
+    }
+
+    if (!buf) {
+        *lenp = nentries*sizeof(struct kinfo_syscallstat);
+        return 0;
+    }
+
+    maxentries = *lenp / sizeof(struct kinfo_syscallstat);
+    entries = buf;
+    nentries = 0;
+
+    for (i = 0; i < SYSCALLSTAT_NCALLS && nentries < maxentries; i++) {
+        stat = &stats->calls[i];
+
+        if (!stat->calls) {
+            continue;
+        }
+
+        entries[nentries].num = i;
+        entries[nentries].calls = stat->calls;
+        entries[nentries].errors = stat->errors;
+        entries[nentries].cycles = stat->cycles;
+
+        memcpy(entries[nentries].hist, stat->hist, sizeof(stat->hist));
+
+        nentries++;
+    }
+
+    *lenp = nentries*sizeof(struct kinfo_syscallstat);
+
+    return 0;
+}
+
+/*
+ * writing a non-zero int starts keeping statistics for the process, zero
+ * stops and forgets them
+ */
+static int
+syscall_stat_sysctl_proc(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    struct proc *proc;
+
+    if (namelen != 1) {
+        return -(EINVAL);
+    }
+
+    proc = proc_find(name[0]);
+
+    if (!proc || !WORLD_CAN_SEE_PROC(current_proc->world, proc)) {
+        return -(ESRCH);
+    }
+
+    if (newp) {
+        if (newlen != sizeof(int)) {
+            return -(EINVAL);
+        }
+
+        if (current_proc->creds.uid != 0 && current_proc->creds.uid != proc->creds.uid) {
+            return -(EPERM);
+        }
+
+        if (!*(int*)newp) {
+            syscall_stat_free(proc);
+        } else if (!proc->syscall_stats) {
+            proc->syscall_stats = calloc(1, sizeof(struct syscall_stats));
+
+            if (!proc->syscall_stats) {
+                return -(ENOMEM);
+            }
+        }
+    }
+
+    if (!oldlenp) {
+        return 0;
+    }
+
+    if (!proc->syscall_stats) {
+        *oldlenp = 0;
+        return 0;
+    }
+
+    return syscall_stat_copyout(proc->syscall_stats, oldp, oldlenp);
+}
+
+int
+syscall_stat_sysctl(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    if (namelen < 1) {
+        return -(EINVAL);
+    }
+
+    switch (name[0]) {
+        case KERN_SYSCALLSTAT_ALL:
+            if (!oldlenp) {
+                return -(EINVAL);
+            }
+
+            return syscall_stat_copyout(&syscall_stats_all, oldp, oldlenp);
+        case KERN_SYSCALLSTAT_PROC:
+            return syscall_stat_sysctl_proc(&name[1], namelen - 1, oldp, oldlenp, newp, newlen);
+        default:
+            break;
+    }
+
+    return -1;
+}
@@ -18,16 +18,43 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
+#include <sys/bootstage.h>
+#include <sys/interrupt.h>
+#include <sys/kstat.h>
+#include <sys/ktrace.h>
+#include <sys/malloc.h>
 #include <sys/proc.h>
+#include <sys/prof.h>
+#include <sys/syscallstat.h>
 #include <sys/sysctl.h>
+#include <sys/systm.h>
+#include <sys/trace.h>
 #include <sys/types.h>
 
 int
 kern_sysctl(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
 {
     switch (name[0]) {
-        case KERN_PROC:
-            return proc_sysctl(&name[1], namelen - 1, oldp, oldlenp, newp, newlen);
+        case KERN_SCHED:
+            return sched_sysctl(&name[1], namelen - 1, oldp, oldlenp, newp, newlen);
+        case KERN_INTR:
+            return intr_sysctl(&name[1], namelen - 1, oldp, oldlenp, newp, newlen);
+        case KERN_PROF:
+            return prof_sysctl(&name[1], namelen - 1, oldp, oldlenp, newp, newlen);
+        case KERN_KSYM:
+            return ksym_sysctl(&name[1], namelen - 1, oldp, oldlenp, newp, newlen);
+        case KERN_KTRACE:
+            return ktrace_sysctl(&name[1], namelen - 1, oldp, oldlenp, newp, newlen);
+        case KERN_SYSCALLSTAT:
+            return syscall_stat_sysctl(&name[1], namelen - 1, oldp, oldlenp, newp, newlen);
+        case KERN_KSTAT:
+            return kstat_sysctl(&name[1], namelen - 1, oldp, oldlenp, newp, newlen);
+        case KERN_TRACE:
+            return trace_sysctl(&name[1], namelen - 1, oldp, oldlenp, newp, newlen);
+        case KERN_MALLOC:
+            return malloc_sysctl(&name[1], namelen - 1, oldp, oldlenp, newp, newlen);
+        case KERN_BOOT:
+            return bootstage_sysctl(&name[1], namelen - 1, oldp, oldlenp, newp, newlen);
     }
 
     return -1;
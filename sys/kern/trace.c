@@ -0,0 +1,261 @@
+/*
+ * trace.c - static kernel tracepoints
+ *
+ * Tracepoints are TRACE() calls compiled into the code they instrument. While
+ * their event is enabled in trace_mask they append a fixed size binary record
+ * to the buffer of the CPU they run on, which userland maps read-only through
+ * /dev/trace and drains without entering the kernel. Nothing is formatted in
+ * the kernel and nothing waits for the reader; a reader that falls behind
+ * loses records and can tell from their sequence numbers.
+ *
+ * The buffers are allocated the first time tracing is enabled and kept from
+ * then on, because they may be mapped by processes that outlive tracing
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <machine/cpufunc.h>
+#include <machine/vm.h>
+#include <sys/cdev.h>
+#include <sys/cpu.h>
+#include <sys/devno.h>
+#include <sys/errno.h>
+#include <sys/proc.h>
+#include <sys/sysctl.h>
+#include <sys/trace.h>
+#include <sys/types.h>
+#include <sys/vm.h>
+
+#define TRACE_RECORDS_PER_PAGE  (PAGE_SIZE / sizeof(struct trace_record))
+
+struct trace_buf {
+    struct trace_header *   header;
+    struct trace_record *   records[TRACE_NPAGES];  /* kernel mapping of each page */
+    void *                  pages[TRACE_NPAGES + 1];
+};
+
+static int trace_mmap(struct cdev *, uintptr_t, size_t, int, off_t);
+
+struct cdev trace_device = {
+    .name       =   "trace",
+    .mode       =   0400,
+    .majorno    =   DEV_MAJOR_TRACE,
+    .minorno    =   0,
+    .ops.mmap   =   trace_mmap,
+    .state      =   NULL
+};
+
+volatile uint32_t trace_mask;
+
+static struct trace_buf trace_bufs[MAXCPU];
+static bool trace_have_tsc;
+
+void
+trace_record(int event, uint32_t a0, uint32_t a1, uint32_t a2)
+{
+    uint32_t slot;
+    uint32_t index;
+    struct cpu *ci;
+    struct thread *thread;
+    struct trace_buf *tb;
+    struct trace_record *rec;
+
+    ci = curcpu();
+    tb = &trace_bufs[ci->ci_id];
+
+    /* a CPU started after tracing was enabled has no buffer */
+    if (!tb->header) {
+        return;
+    }
+
+    /* an interrupt may trace on this CPU in between; each gets its own slot */
+    slot = __sync_fetch_and_add(&tb->header->head, 1);
+    index = slot % TRACE_NRECORDS;
+    rec = &tb->records[index / TRACE_RECORDS_PER_PAGE][index % TRACE_RECORDS_PER_PAGE];
+
+    rec->seq = 0;
+    __sync_synchronize();
+
+    thread = ci->ci_thread;
+
+    rec->event = event;
+    rec->cpu = ci->ci_id;
+    rec->tsc = trace_have_tsc ? rdtsc() : 0;
+    rec->tid = thread ? thread->tid : 0;
+    rec->args[0] = a0;
+    rec->args[1] = a1;
+    rec->args[2] = a2;
+
+    __sync_synchronize();
+    rec->seq = slot + 1;
+}
+
+static int
+trace_alloc()
+{
+    int i;
+    int j;
+    struct trace_buf *tb;
+
+    for (i = 0; i < ncpus; i++) {
+        tb = &trace_bufs[i];
+
+        if (tb->header) {
+            continue;
+        }
+
+        for (j = 0; j < TRACE_NPAGES + 1; j++) {
+            tb->pages[j] = vm_page_alloc();
+
+            if (!tb->pages[j]) {
+                while (--j >= 0) {
+                    vm_page_release(tb->pages[j]);
+                }
+
+                return -(ENOMEM);
+            }
+        }
+
+        for (j = 0; j < TRACE_NPAGES; j++) {
+            tb->records[j] = vm_page_kva(tb->pages[j + 1]);
+        }
+
+        ((struct trace_header*)vm_page_kva(tb->pages[0]))->cpu = i;
+
+        /* published last; trace_record() checks for it */
+        __sync_synchronize();
+        tb->header = vm_page_kva(tb->pages[0]);
+    }
+
+    return 0;
+}
+
+/* offset cpu*TRACE_BUF_SIZE maps that CPU's buffer; only read access is given */
+static int
+trace_mmap(struct cdev *dev, uintptr_t addr, size_t size, int prot, off_t offset)
+{
+    int cpu;
+    uint32_t off;
+    void *res;
+    struct trace_buf *tb;
+
+    if (offset < 0 || offset >= MAXCPU*TRACE_BUF_SIZE || size != TRACE_BUF_SIZE) {
+        return -(EINVAL);
+    }
+
+    /* keeps the division 32 bit */
+    off = (uint32_t)offset;
+
+    if ((off % TRACE_BUF_SIZE) != 0) {
+        return -(EINVAL);
+    }
+
+    cpu = off / TRACE_BUF_SIZE;
+
+    if (cpu >= ncpus || !trace_bufs[cpu].header) {
+        return -(ENXIO);
+    }
+
+    if ((prot & VM_WRITE)) {
+        return -(EACCES);
+    }
+
+    tb = &trace_bufs[cpu];
+
+    res = vm_map_pages(current_proc->thread->address_space, (void*)addr, tb->pages,
+            TRACE_NPAGES + 1, prot & ~VM_KERN);
+
+    return (intptr_t)res;
+}
+
+/* reads or replaces the mask of enabled events; replacing it is root only */
+static int
+trace_sysctl_mask(void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    uint32_t mask;
+
+    if (oldp && oldlenp) {
+        if (*oldlenp < sizeof(uint32_t)) {
+            return -(EINVAL);
+        }
+
+        *(uint32_t*)oldp = trace_mask;
+        *oldlenp = sizeof(uint32_t);
+    } else if (oldlenp) {
+        *oldlenp = sizeof(uint32_t);
+    }
+
+    if (!newp) {
+        return 0;
+    }
+
+    if (newlen != sizeof(uint32_t)) {
+        return -(EINVAL);
+    }
+
+    if (current_proc->creds.uid != 0) {
+        return -(EPERM);
+    }
+
+    mask = *(uint32_t*)newp & ((1 << TRACE_NEVENTS) - 2);
+
+    if (mask && trace_alloc() != 0) {
+        return -(ENOMEM);
+    }
+
+    trace_mask = mask;
+
+    return 0;
+}
+
+int
+trace_sysctl(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen)
+{
+    if (namelen < 1) {
+        return -(EINVAL);
+    }
+
+    switch (name[0]) {
+        case KERN_TRACE_MASK:
+            return trace_sysctl_mask(oldp, oldlenp, newp, newlen);
+        case KERN_TRACE_NCPUS:
+            if (!oldp || !oldlenp || *oldlenp < sizeof(int)) {
+                return -(EINVAL);
+            }
+
+            *(int*)oldp = ncpus;
+            *oldlenp = sizeof(int);
+
+            return 0;
+        default:
+            break;
+    }
+
+    return -1;
+}
+
+void
+trace_init()
+{
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+
+    trace_have_tsc = (edx & CPUID_TSC) != 0;
+
+    cdev_register(&trace_device);
+}
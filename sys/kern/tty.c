@@ -0,0 +1,645 @@
+/*
+ * tty.c - terminal line discipline
+ *
+ * This file implements the line discipline shared by all terminal devices
+ * (pseudo-terminals and serial ports). It owns the input queue read by the
+ * slave side, performs canonical line editing, echo, input translation and
+ * OPOST output processing
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <sys/errno.h>
+#include <sys/fcntl.h>
+#include <sys/ioctl.h>
+#include <sys/proc.h>
+#include <sys/sched.h>
+#include <sys/string.h>
+#include <sys/termios.h>
+#include <sys/tty.h>
+#include <sys/types.h>
+
+#define TTY_ECHOBUF_SIZE    64
+
+/* input flags that require each received byte to be inspected */
+#define TTY_IFLAG_XLATE     (ICRNL | INLCR | IGNCR | ISTRIP)
+
+void
+tty_init(struct tty *tty, tty_output_t output, tty_poll_t poll, void *state)
+{
+    memset(tty, 0, sizeof(struct tty));
+
+    tty->output = output;
+    tty->poll = poll;
+    tty->state = state;
+
+    tty->termios.c_iflag = ICRNL;
+    tty->termios.c_oflag = OPOST | ONLCR;
+    tty->termios.c_lflag = ECHO | ECHOE | ICANON;
+    tty->termios.c_cc[VMIN] = 1;
+    tty->termios.c_cc[VTIME] = 0;
+
+    tty->winsize.ws_row = 50;
+    tty->winsize.ws_col = 100;
+}
+
+/* appends to the input queue; the caller must hold tty->lock */
+static size_t
+tty_inq_put(struct tty *tty, const char *buf, size_t nbyte)
+{
+    size_t tail;
+    size_t first;
+
+    if (nbyte > TTY_INQ_SPACE(tty)) {
+        nbyte = TTY_INQ_SPACE(tty);
+    }
+
+    tail = (tty->inq_head + tty->inq_count) % TTY_INQ_SIZE;
+    first = TTY_INQ_SIZE - tail;
+
+    if (first > nbyte) {
+        first = nbyte;
+    }
+
+    memcpy(&tty->inq[tail], buf, first);
+    memcpy(tty->inq, buf + first, nbyte - first);
+
+    tty->inq_count += nbyte;
+
+    return nbyte;
+}
+
+/*
+ * removes queued input into an iovec array; the caller must hold tty->lock.
+ * In canonical mode a read never returns more than one line
+ */
+static size_t
+tty_inq_get(struct tty *tty, const struct iovec *iov, int iovcnt, bool canon)
+{
+    int i;
+    size_t n;
+    size_t chunk;
+    size_t first;
+    size_t copied;
+    uint8_t *dst;
+
+    n = iov_length(iov, iovcnt);
+
+    if (n > tty->inq_count) {
+        n = tty->inq_count;
+    }
+
+    if (canon) {
+        for (i = 0; i < n; i++) {
+            if (tty->inq[(tty->inq_head + i) % TTY_INQ_SIZE] == '\n') {
+                n = i + 1;
+                break;
+            }
+        }
+    }
+
+    for (i = 0, copied = 0; i < iovcnt && copied < n; i++) {
+        dst = iov[i].iov_base;
+        chunk = iov[i].iov_len;
+
+        if (chunk > n - copied) {
+            chunk = n - copied;
+        }
+
+        first = TTY_INQ_SIZE - tty->inq_head;
+
+        if (first > chunk) {
+            first = chunk;
+        }
+
+        memcpy(dst, &tty->inq[tty->inq_head], first);
+        memcpy(dst + first, tty->inq, chunk - first);
+
+        tty->inq_head = (tty->inq_head + chunk) % TTY_INQ_SIZE;
+        tty->inq_count -= chunk;
+        copied += chunk;
+    }
+
+    if (tty->inq_count == 0) {
+        tty->inq_head = 0;
+    }
+
+    return copied;
+}
+
+/*
+ * moves the line being edited onto the input queue. Fails with -(EAGAIN),
+ * leaving the line in place, if the whole line does not fit yet
+ */
+static int
+tty_commit_line(struct tty *tty)
+{
+    int res;
+
+    res = 0;
+
+    spinlock_lock(&tty->lock);
+
+    if (tty->line_pos > TTY_INQ_SPACE(tty)) {
+        res = -(EAGAIN);
+    } else {
+        tty_inq_put(tty, tty->line_buf, tty->line_pos);
+    }
+
+    spinlock_unlock(&tty->lock);
+
+    if (res == 0) {
+        tty->line_pos = 0;
+    }
+
+    return res;
+}
+
+/*
+ * hands translated output to the driver. Returns how many of the pending
+ * input bytes it accounts for; a short write is mapped back through ONLCR,
+ * where every '\n' went out behind a '\r' with no input byte of its own
+ */
+static int
+tty_flush_obuf(struct tty *tty, const char *obuf, size_t out, size_t pending, tcflag_t oflag, int flags)
+{
+    int res;
+    int i;
+    struct iovec iov;
+
+    iov.iov_base = (void*)obuf;
+    iov.iov_len = out;
+
+    res = tty->output(tty, &iov, 1, flags);
+
+    if (res < 0 || res == out) {
+        return res < 0 ? res : pending;
+    }
+
+    if (!(oflag & ONLCR) || res == 0) {
+        return res;
+    }
+
+    pending = res;
+
+    for (i = 0; i < res; i++) {
+        if (obuf[i] == '\n') {
+            pending--;
+        }
+    }
+
+    /* the write stopped between an inserted '\r' and its '\n' */
+    if (obuf[res - 1] == '\r' && obuf[res] == '\n') {
+        pending--;
+    }
+
+    return pending;
+}
+
+/*
+ * OPOST processing. The whole vector is translated into obuf, copying runs
+ * that need no translation in bulk, and handed to the driver only when obuf
+ * fills up and once at the end. Returns the number of input bytes written;
+ * if the driver fails part way, what it took before that is reported
+ */
+static int
+tty_oprocess(struct tty *tty, char *obuf, size_t size, const struct iovec *iov, int iovcnt, int flags)
+{
+    int i;
+    int res;
+    char ch;
+    const char *buf;
+    size_t j;
+    size_t len;
+    size_t run;
+    size_t out;
+    size_t pending;
+    size_t done;
+    tcflag_t oflag;
+
+    oflag = tty->termios.c_oflag;
+    out = 0;
+    pending = 0;
+    done = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        buf = iov[i].iov_base;
+        len = iov[i].iov_len;
+
+        for (j = 0; j < len;) {
+            if (out + 2 > size) {
+                res = tty_flush_obuf(tty, obuf, out, pending, oflag, flags);
+
+                if (res < 0) {
+                    return done > 0 ? done : res;
+                }
+
+                done += res;
+
+                if (res < pending) {
+                    return done;
+                }
+
+                out = 0;
+                pending = 0;
+            }
+
+            ch = buf[j];
+
+            if (ch == '\n' && (oflag & ONLCR)) {
+                obuf[out++] = '\r';
+                obuf[out++] = '\n';
+                j++;
+                pending++;
+            } else if ((oflag & OLCUC)) {
+                obuf[out++] = (ch >= 'a' && ch <= 'z') ? ch - 'a' + 'A' : ch;
+                j++;
+                pending++;
+            } else {
+                for (run = j + 1; run < len && run - j < size - out; run++) {
+                    if (buf[run] == '\n' && (oflag & ONLCR)) {
+                        break;
+                    }
+                }
+
+                memcpy(&obuf[out], &buf[j], run - j);
+
+                out += run - j;
+                pending += run - j;
+                j = run;
+            }
+        }
+    }
+
+    if (out > 0) {
+        res = tty_flush_obuf(tty, obuf, out, pending, oflag, flags);
+
+        if (res < 0) {
+            return done > 0 ? done : res;
+        }
+
+        done += res;
+    }
+
+    return done;
+}
+
+/*
+ * the output queue belongs to one writer from translation until the driver
+ * has taken all of it, so concurrent writes never interleave. olock only
+ * guards the handover and is not held while the driver runs, which may wait
+ */
+static int
+tty_outq_acquire(struct tty *tty)
+{
+    spinlock_lock(&tty->olock);
+
+    while (tty->outq_busy) {
+        spinlock_unlock(&tty->olock);
+
+        thread_yield();
+
+        if (thread_exit_requested()) {
+            return -(EINTR);
+        }
+
+        spinlock_lock(&tty->olock);
+    }
+
+    tty->outq_busy = true;
+
+    spinlock_unlock(&tty->olock);
+
+    return 0;
+}
+
+static void
+tty_outq_release(struct tty *tty)
+{
+    spinlock_lock(&tty->olock);
+    tty->outq_busy = false;
+    spinlock_unlock(&tty->olock);
+}
+
+/*
+ * echo never waits for the device, nor for a writer that owns the output
+ * queue; if the master isn't draining its side, whatever doesn't fit is
+ * dropped rather than stalling input
+ */
+static void
+tty_echo(struct tty *tty, const char *buf, size_t nbyte)
+{
+    char obuf[TTY_ECHOBUF_SIZE * 2];
+    struct iovec iov;
+
+    iov.iov_base = (void*)buf;
+    iov.iov_len = nbyte;
+
+    if ((tty->termios.c_oflag & OPOST)) {
+        tty_oprocess(tty, obuf, sizeof(obuf), &iov, 1, O_NONBLOCK);
+        return;
+    }
+
+    tty->output(tty, &iov, 1, O_NONBLOCK);
+}
+
+/*
+ * handles bytes received from the device (or written to a pty master).
+ * Returns the number of bytes consumed, which is limited by the space left in
+ * the input queue; in canonical mode input stops at a line that doesn't fit
+ */
+int
+tty_input(struct tty *tty, const char *buf, size_t nbyte)
+{
+    size_t i;
+    size_t cooked_len;
+    size_t echo_len;
+    char ch;
+    char cooked[TTY_ECHOBUF_SIZE];
+    char echo[TTY_ECHOBUF_SIZE];
+    tcflag_t iflag;
+    tcflag_t lflag;
+
+    iflag = tty->termios.c_iflag;
+    lflag = tty->termios.c_lflag;
+
+    if (!(lflag & ICANON) && nbyte > TTY_INQ_SPACE(tty)) {
+        nbyte = TTY_INQ_SPACE(tty);
+    }
+
+    /* raw mode without echo or translation: queue everything as-is */
+    if (!(lflag & (ICANON | ECHO)) && !(iflag & TTY_IFLAG_XLATE)) {
+        spinlock_lock(&tty->lock);
+        nbyte = tty_inq_put(tty, buf, nbyte);
+        spinlock_unlock(&tty->lock);
+
+        return nbyte;
+    }
+
+    cooked_len = 0;
+    echo_len = 0;
+
+    for (i = 0; i < nbyte; i++) {
+        if (cooked_len == TTY_ECHOBUF_SIZE) {
+            spinlock_lock(&tty->lock);
+            tty_inq_put(tty, cooked, cooked_len);
+            spinlock_unlock(&tty->lock);
+            cooked_len = 0;
+        }
+
+        if (echo_len > TTY_ECHOBUF_SIZE - 3) {
+            tty_echo(tty, echo, echo_len);
+            echo_len = 0;
+        }
+
+        ch = buf[i];
+
+        if ((iflag & ISTRIP)) {
+            ch &= 0x7F;
+        }
+
+        if (ch == '\r') {
+            if ((iflag & IGNCR)) {
+                continue;
+            }
+
+            if ((iflag & ICRNL)) {
+                ch = '\n';
+            }
+        } else if (ch == '\n' && (iflag & INLCR)) {
+            ch = '\r';
+        }
+
+        if (!(lflag & ICANON)) {
+            cooked[cooked_len++] = ch;
+        } else if (ch == '\b' || ch == 0x7F) {
+            /* erase; never echoed as-is */
+            if (tty->line_pos > 0) {
+                tty->line_pos--;
+
+                if ((lflag & ECHO) && (lflag & ECHOE)) {
+                    memcpy(&echo[echo_len], "\b \b", 3);
+                    echo_len += 3;
+                } else if ((lflag & ECHO)) {
+                    echo[echo_len++] = '\b';
+                }
+            }
+
+            continue;
+        } else {
+            tty->line_buf[tty->line_pos++] = ch;
+
+            if ((ch == '\n' || tty->line_pos == TTY_LINEBUF_SIZE) && tty_commit_line(tty) != 0) {
+                tty->line_pos--;
+                break;
+            }
+        }
+
+        if ((lflag & ECHO) || (ch == '\n' && (lflag & ECHONL))) {
+            echo[echo_len++] = ch;
+        }
+    }
+
+    if (cooked_len > 0) {
+        spinlock_lock(&tty->lock);
+        tty_inq_put(tty, cooked, cooked_len);
+        spinlock_unlock(&tty->lock);
+    }
+
+    if (echo_len > 0) {
+        tty_echo(tty, echo, echo_len);
+    }
+
+    return i;
+}
+
+int
+tty_ioctl(struct tty *tty, uint64_t request, uintptr_t argp)
+{
+    pid_t pgid;
+    struct pgrp *pgrp;
+    struct session *session;
+
+    switch (request) {
+    case FIONREAD:
+        if (tty->poll) {
+            tty->poll(tty);
+        }
+
+        *((uint32_t*)argp) = tty->inq_count;
+        return 0;
+    case TCGETS:
+        memcpy((void*)argp, &tty->termios, sizeof(struct termios));
+        return 0;
+    case TCSETSF:
+        spinlock_lock(&tty->lock);
+        tty->inq_head = 0;
+        tty->inq_count = 0;
+        tty->line_pos = 0;
+        spinlock_unlock(&tty->lock);
+        /* fall through */
+    case TCSETS:
+    case TCSETSW:
+        memcpy(&tty->termios, (void*)argp, sizeof(struct termios));
+
+        /*
+         * leaving canonical mode makes a partially edited line readable;
+         * whatever doesn't fit is discarded, as TCSETSF would
+         */
+        if (!(tty->termios.c_lflag & ICANON) && tty->line_pos > 0) {
+            spinlock_lock(&tty->lock);
+            tty_inq_put(tty, tty->line_buf, tty->line_pos);
+            spinlock_unlock(&tty->lock);
+
+            tty->line_pos = 0;
+        }
+
+        return 0;
+    case TIOCSWINSZ:
+        memcpy(&tty->winsize, (void*)argp, sizeof(struct winsize));
+        return 0;
+    case TIOCGWINSZ:
+        memcpy((void*)argp, &tty->winsize, sizeof(struct winsize));
+        return 0;
+    case TIOCSCTTY:
+        session = PROC_GET_SESSION(current_proc);
+
+        if (!session->ctty) {
+            session->ctty = tty->cdev;
+            return 0;
+        }
+
+        return -1;
+    case TIOCSPGRP:
+        pgid = *((pid_t*)argp);
+        pgrp = pgrp_find(pgid);
+
+        if (pgrp) {
+            tty->foreground = pgid;
+            return 0;
+        }
+
+        return -(ESRCH);
+    case TIOCGPGRP:
+        *((pid_t*)argp) = tty->foreground;
+        return 0;
+    }
+
+    return -(ENOTSUP);
+}
+
+/*
+ * reads from the input queue. Canonical reads wait for a complete line. In
+ * non-canonical mode VMIN is the number of bytes to wait for and VTIME (in
+ * tenths of a second) is an inter-byte timer when VMIN > 0, or an overall
+ * timeout when VMIN == 0. VMIN == VTIME == 0 returns whatever is queued
+ */
+int
+tty_read(struct tty *tty, const struct iovec *iov, int iovcnt)
+{
+    int res;
+    int last_count;
+    bool canon;
+    size_t nbyte;
+    size_t want;
+    uint32_t timeout;
+    uint32_t deadline;
+
+    nbyte = iov_length(iov, iovcnt);
+
+    if (nbyte == 0) {
+        return 0;
+    }
+
+    canon = (tty->termios.c_lflag & ICANON) != 0;
+
+    if (canon) {
+        want = 1;
+        timeout = 0;
+    } else {
+        want = tty->termios.c_cc[VMIN];
+        timeout = tty->termios.c_cc[VTIME] * sched_hz / 10;
+
+        if (want > nbyte) {
+            want = nbyte;
+        }
+    }
+
+    last_count = -1;
+    deadline = 0;
+
+    for (;;) {
+        if (tty->poll) {
+            tty->poll(tty);
+        }
+
+        if (want > 0 && tty->inq_count >= want) {
+            break;
+        }
+
+        if (want == 0 && (timeout == 0 || tty->inq_count > 0)) {
+            break;
+        }
+
+        if (timeout > 0) {
+            if (tty->inq_count != last_count) {
+                last_count = tty->inq_count;
+                deadline = sched_ticks + timeout;
+            } else if ((want == 0 || tty->inq_count > 0) && sched_ticks >= deadline) {
+                break;
+            }
+        }
+
+        thread_yield();
+
+        if (thread_exit_requested()) {
+            return -(EINTR);
+        }
+    }
+
+    spinlock_lock(&tty->lock);
+    res = tty_inq_get(tty, iov, iovcnt, canon);
+    spinlock_unlock(&tty->lock);
+
+    return res;
+}
+
+/*
+ * writes output from the slave side. In raw mode (or when no output flag
+ * needs translation) the vector is passed to the driver untouched
+ */
+int
+tty_write(struct tty *tty, const struct iovec *iov, int iovcnt)
+{
+    int res;
+    tcflag_t oflag;
+
+    oflag = tty->termios.c_oflag;
+
+    if (!(oflag & OPOST) || !(oflag & (ONLCR | OLCUC))) {
+        return tty->output(tty, iov, iovcnt, 0);
+    }
+
+    res = tty_outq_acquire(tty);
+
+    if (res != 0) {
+        return res;
+    }
+
+    res = tty_oprocess(tty, tty->outq, TTY_OUTQ_SIZE, iov, iovcnt, 0);
+
+    tty_outq_release(tty);
+
+    return res;
+}
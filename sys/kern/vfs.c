@@ -23,6 +23,7 @@
 #include <sys/errno.h>
 #include <sys/fcntl.h>
 #include <sys/file.h>
+#include <sys/ioctl.h>
 #include <sys/limits.h>
 #include <sys/malloc.h>
 #include <sys/mount.h>
@@ -130,6 +131,108 @@ file_duplicate(struct file *file)
 
 
 /* filesystem routines */
+/*
+ * generic vectored read. Files without a native readv are called once per
+ * segment; because their read method works off of the file position, the
+ * position is pointed at the requested offset for the duration of the call
+ */
+int
+file_readv(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    int i;
+    int res;
+    int total;
+    off_t saved_pos;
+    struct fops *ops;
+
+    ops = fp->ops;
+
+    if (ops->readv) {
+        return ops->readv(fp, iov, iovcnt, offset);
+    }
+
+    if (!ops->read) {
+        return -(EPERM);
+    }
+
+    saved_pos = fp->position;
+    total = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+
+        fp->position = offset + total;
+
+        res = ops->read(fp, iov[i].iov_base, iov[i].iov_len);
+
+        if (res < 0) {
+            total = total > 0 ? total : res;
+            break;
+        }
+
+        total += res;
+
+        /* short read, or a stream that would otherwise block on the next segment */
+        if (res < iov[i].iov_len || !ops->seek) {
+            break;
+        }
+    }
+
+    fp->position = saved_pos;
+
+    return total;
+}
+
+int
+file_writev(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    int i;
+    int res;
+    int total;
+    off_t saved_pos;
+    struct fops *ops;
+
+    ops = fp->ops;
+
+    if (ops->writev) {
+        return ops->writev(fp, iov, iovcnt, offset);
+    }
+
+    if (!ops->write) {
+        return -(EPERM);
+    }
+
+    saved_pos = fp->position;
+    total = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+
+        fp->position = offset + total;
+
+        res = ops->write(fp, iov[i].iov_base, iov[i].iov_len);
+
+        if (res < 0) {
+            total = total > 0 ? total : res;
+            break;
+        }
+
+        total += res;
+
+        if (res < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    fp->position = saved_pos;
+
+    return total;
+}
+
 int
 fs_open(struct file *dev_fp, struct vnode **vn_res, const char *fsname, int flags)
 {
@@ -322,6 +425,26 @@ vfop_getvn(struct file *fp, struct vnode **result)
 static int
 vfop_ioctl(struct file *fp, uint64_t request, void *arg)
 {
+    struct stat stat;
+    struct vnode *vn;
+
+    vn = fp->state;
+
+    switch (request) {
+        case FIONREAD:
+            if (!vn || VOP_STAT(vn, &stat) != 0) {
+                return -(ENOTSUP);
+            }
+
+            if (stat.st_size > FILE_POSITION(fp)) {
+                *((uint32_t*)arg) = stat.st_size - FILE_POSITION(fp);
+            } else {
+                *((uint32_t*)arg) = 0;
+            }
+
+            return 0;
+    }
+
     return -(ENOTSUP);
 }
 
@@ -353,6 +476,20 @@ vfop_read(struct file *fp, void *buf, size_t nbyte)
     return -(ENOTSUP);
 }
 
+static int
+vfop_readv(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    struct vnode *vn;
+    
+    vn = fp->state;
+
+    if (vn) {
+        return VOP_READV(vn, iov, iovcnt, offset);
+    }
+
+    return -(ENOTSUP);
+}
+
 static int
 vfop_seek(struct file *fp, off_t *pos, off_t off, int whence)
 {
@@ -429,6 +566,20 @@ vfop_write(struct file *fp, const void *buf, size_t nbyte)
     return -(ENOTSUP);
 }
 
+static int
+vfop_writev(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    struct vnode *vn;
+    
+    vn = fp->state;
+
+    if (vn) {
+        return VOP_WRITEV(vn, iov, iovcnt, offset);
+    }
+
+    return -(ENOTSUP);
+}
+
 /* file operation struct for file interface */
 struct fops vfs_ops = {
     .chmod      = vfop_chmod,
@@ -440,11 +591,13 @@ struct fops vfs_ops = {
     .getvn      = vfop_getvn,
     .ioctl      = vfop_ioctl,    
     .read       = vfop_read,
+    .readv      = vfop_readv,
     .readdirent = vfop_readdirent,
     .seek       = vfop_seek,
     .stat       = vfop_stat,
     .truncate   = vfop_truncate,
-    .write      = vfop_write
+    .write      = vfop_write,
+    .writev     = vfop_writev
 };
 
 /* helper function to split directory and filename from a full path string */
@@ -841,6 +994,10 @@ vfs_open_r(struct proc *proc, struct file **result, const char *path, int flags)
 
         if ((child->mode & S_IFIFO)) {
             file = fifo_to_file(child, flags);
+
+            if (!file) {
+                return -(ENXIO);
+            }
         }
 
         if ((child->mode & S_IFCHR)) {
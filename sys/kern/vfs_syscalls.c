@@ -25,15 +25,75 @@
 #include <sys/errno.h>
 #include <sys/fcntl.h>
 #include <sys/interrupt.h>
+#include <sys/malloc.h>
 #include <sys/mount.h>
 #include <sys/pipe.h>
 #include <sys/proc.h>
 #include <sys/procdesc.h>
+#include <sys/string.h>
 #include <sys/syscall.h>
 #include <sys/systm.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/vnode.h>
 
+/*
+ * copies a user supplied iovec array into kernel memory and validates every
+ * segment against the address space. *result is either small_iov or a heap
+ * allocation that must be released with iov_free()
+ */
+int
+iov_copyin(struct thread *th, const struct iovec *uiov, int iovcnt, int prot,
+           struct iovec *small_iov, struct iovec **result)
+{
+    int i;
+    size_t total;
+    struct iovec *iov;
+
+    if (iovcnt <= 0 || iovcnt > IOV_MAX) {
+        return -(EINVAL);
+    }
+
+    if (vm_access(th->address_space, uiov, iovcnt*sizeof(struct iovec), VM_READ)) {
+        return -(EFAULT);
+    }
+
+    if (iovcnt <= UIO_SMALLIOV) {
+        iov = small_iov;
+    } else {
+        iov = malloc(iovcnt*sizeof(struct iovec));
+    }
+
+    memcpy(iov, uiov, iovcnt*sizeof(struct iovec));
+
+    for (i = 0, total = 0; i < iovcnt; i++) {
+        /* the total must be representable in the (int) return value */
+        if (iov[i].iov_len > 0x7FFFFFFF - total) {
+            if (iov != small_iov) free(iov);
+            return -(EINVAL);
+        }
+
+        total += iov[i].iov_len;
+
+        if (iov[i].iov_len > 0 && vm_access(th->address_space, iov[i].iov_base, iov[i].iov_len, prot)) {
+            if (iov != small_iov) free(iov);
+            return -(EFAULT);
+        }
+    }
+
+    *result = iov;
+
+    return 0;
+}
+
+void
+iov_free(struct iovec *iov, struct iovec *small_iov)
+{
+    if (iov != small_iov) {
+        free(iov);
+    }
+}
+
 static int
 sys_access(struct thread *th, syscall_args_t argv)
 {
@@ -294,6 +354,166 @@ sys_pipe(struct thread *th, syscall_args_t argv)
     return 0;
 }
 
+static int
+sys_pread(struct thread *th, syscall_args_t argv)
+{
+    off_t offset;
+    struct file *file;
+    struct iovec iov;
+
+    DEFINE_SYSCALL_PARAM(int, fildes, 0, argv);
+    DEFINE_SYSCALL_PARAM(void *, buf, 1, argv);
+    DEFINE_SYSCALL_PARAM(size_t, nbyte, 2, argv);
+    DEFINE_SYSCALL_PARAM(uint64_t, offset_low, 3, argv);
+    DEFINE_SYSCALL_PARAM(uint64_t, offset_high, 4, argv);
+
+    offset = (offset_low | (offset_high << 32));
+
+    /* the count must be representable in the (int) return value */
+    if (nbyte > 0x7FFFFFFF) {
+        return -(EINVAL);
+    }
+
+    if (vm_access(th->address_space, buf, nbyte, VM_WRITE)) {
+        return -(EFAULT);
+    }
+
+    TRACE_SYSCALL("pread", "%d, %p, %d, %d, %d", fildes, buf, nbyte, offset_low, offset_high);
+
+    bus_interrupts_on();
+
+    file = procdesc_getfile(fildes);
+
+    if (!file) {
+        return -(EBADF);
+    }
+
+    iov.iov_base = buf;
+    iov.iov_len = nbyte;
+
+    return FOP_PREADV(file, &iov, 1, offset);
+}
+
+static int
+sys_preadv(struct thread *th, syscall_args_t argv)
+{
+    int res;
+    off_t offset;
+    struct file *file;
+    struct iovec *iov;
+    struct iovec small_iov[UIO_SMALLIOV];
+
+    DEFINE_SYSCALL_PARAM(int, fildes, 0, argv);
+    DEFINE_SYSCALL_PARAM(const struct iovec *, uiov, 1, argv);
+    DEFINE_SYSCALL_PARAM(int, iovcnt, 2, argv);
+    DEFINE_SYSCALL_PARAM(uint64_t, offset_low, 3, argv);
+    DEFINE_SYSCALL_PARAM(uint64_t, offset_high, 4, argv);
+
+    offset = (offset_low | (offset_high << 32));
+
+    TRACE_SYSCALL("preadv", "%d, %p, %d, %d, %d", fildes, uiov, iovcnt, offset_low, offset_high);
+
+    res = iov_copyin(th, uiov, iovcnt, VM_WRITE, small_iov, &iov);
+
+    if (res != 0) {
+        return res;
+    }
+
+    bus_interrupts_on();
+
+    file = procdesc_getfile(fildes);
+
+    if (file) {
+        res = FOP_PREADV(file, iov, iovcnt, offset);
+    } else {
+        res = -(EBADF);
+    }
+
+    iov_free(iov, small_iov);
+
+    return res;
+}
+
+static int
+sys_pwrite(struct thread *th, syscall_args_t argv)
+{
+    off_t offset;
+    struct file *file;
+    struct iovec iov;
+
+    DEFINE_SYSCALL_PARAM(int, fildes, 0, argv);
+    DEFINE_SYSCALL_PARAM(void *, buf, 1, argv);
+    DEFINE_SYSCALL_PARAM(size_t, nbyte, 2, argv);
+    DEFINE_SYSCALL_PARAM(uint64_t, offset_low, 3, argv);
+    DEFINE_SYSCALL_PARAM(uint64_t, offset_high, 4, argv);
+
+    offset = (offset_low | (offset_high << 32));
+
+    /* the count must be representable in the (int) return value */
+    if (nbyte > 0x7FFFFFFF) {
+        return -(EINVAL);
+    }
+
+    if (vm_access(th->address_space, buf, nbyte, VM_READ)) {
+        return -(EFAULT);
+    }
+
+    TRACE_SYSCALL("pwrite", "%d, %p, %d, %d, %d", fildes, buf, nbyte, offset_low, offset_high);
+
+    bus_interrupts_on();
+
+    file = procdesc_getfile(fildes);
+
+    if (!file) {
+        return -(EBADF);
+    }
+
+    iov.iov_base = buf;
+    iov.iov_len = nbyte;
+
+    return FOP_PWRITEV(file, &iov, 1, offset);
+}
+
+static int
+sys_pwritev(struct thread *th, syscall_args_t argv)
+{
+    int res;
+    off_t offset;
+    struct file *file;
+    struct iovec *iov;
+    struct iovec small_iov[UIO_SMALLIOV];
+
+    DEFINE_SYSCALL_PARAM(int, fildes, 0, argv);
+    DEFINE_SYSCALL_PARAM(const struct iovec *, uiov, 1, argv);
+    DEFINE_SYSCALL_PARAM(int, iovcnt, 2, argv);
+    DEFINE_SYSCALL_PARAM(uint64_t, offset_low, 3, argv);
+    DEFINE_SYSCALL_PARAM(uint64_t, offset_high, 4, argv);
+
+    offset = (offset_low | (offset_high << 32));
+
+    TRACE_SYSCALL("pwritev", "%d, %p, %d, %d, %d", fildes, uiov, iovcnt, offset_low, offset_high);
+
+    res = iov_copyin(th, uiov, iovcnt, VM_READ, small_iov, &iov);
+
+    if (res != 0) {
+        return res;
+    }
+
+    bus_interrupts_on();
+
+    file = procdesc_getfile(fildes);
+
+    if (file) {
+        res = FOP_PWRITEV(file, iov, iovcnt, offset);
+    } else {
+        res = -(EBADF);
+    }
+
+    iov_free(iov, small_iov);
+
+    return res;
+}
+
 static int
 sys_read(struct thread *th, syscall_args_t argv)
 {
@@ -303,6 +523,11 @@ sys_read(struct thread *th, syscall_args_t argv)
     DEFINE_SYSCALL_PARAM(char*, buf, 1, argv);
     DEFINE_SYSCALL_PARAM(size_t, nbyte, 2, argv);
 
+    /* the count must be representable in the (int) return value */
+    if (nbyte > 0x7FFFFFFF) {
+        return -(EINVAL);
+    }
+
     if (vm_access(th->address_space, buf, nbyte, VM_WRITE)) {
         return -(EFAULT);
     }
@@ -320,6 +545,41 @@ sys_read(struct thread *th, syscall_args_t argv)
     return -(EBADF);
 }
 
+static int
+sys_readv(struct thread *th, syscall_args_t argv)
+{
+    int res;
+    struct file *file;
+    struct iovec *iov;
+    struct iovec small_iov[UIO_SMALLIOV];
+
+    DEFINE_SYSCALL_PARAM(int, fildes, 0, argv);
+    DEFINE_SYSCALL_PARAM(const struct iovec *, uiov, 1, argv);
+    DEFINE_SYSCALL_PARAM(int, iovcnt, 2, argv);
+
+    TRACE_SYSCALL("readv", "%d, %p, %d", fildes, uiov, iovcnt);
+
+    res = iov_copyin(th, uiov, iovcnt, VM_WRITE, small_iov, &iov);
+
+    if (res != 0) {
+        return res;
+    }
+
+    bus_interrupts_on();
+
+    file = procdesc_getfile(fildes);
+
+    if (file) {
+        res = FOP_READV(file, iov, iovcnt);
+    } else {
+        res = -(EBADF);
+    }
+
+    iov_free(iov, small_iov);
+
+    return res;
+}
+
 static int
 sys_readdir(struct thread *th, syscall_args_t argv)
 {
@@ -551,6 +811,11 @@ sys_write(struct thread *th, syscall_args_t argv)
 
     TRACE_SYSCALL("write", "%d, %p, %d", fildes, buf, nbyte);
 
+    /* the count must be representable in the (int) return value */
+    if (nbyte > 0x7FFFFFFF) {
+        return -(EINVAL);
+    }
+
     if (vm_access(th->address_space, buf, nbyte, VM_READ)) {
         return -(EFAULT);
     }
@@ -566,6 +831,41 @@ sys_write(struct thread *th, syscall_args_t argv)
     return -(EBADF);
 }
 
+static int
+sys_writev(struct thread *th, syscall_args_t argv)
+{
+    int res;
+    struct file *file;
+    struct iovec *iov;
+    struct iovec small_iov[UIO_SMALLIOV];
+
+    DEFINE_SYSCALL_PARAM(int, fildes, 0, argv);
+    DEFINE_SYSCALL_PARAM(const struct iovec *, uiov, 1, argv);
+    DEFINE_SYSCALL_PARAM(int, iovcnt, 2, argv);
+
+    TRACE_SYSCALL("writev", "%d, %p, %d", fildes, uiov, iovcnt);
+
+    res = iov_copyin(th, uiov, iovcnt, VM_READ, small_iov, &iov);
+
+    if (res != 0) {
+        return res;
+    }
+
+    bus_interrupts_on();
+
+    file = procdesc_getfile(fildes);
+
+    if (file) {
+        res = FOP_WRITEV(file, iov, iovcnt);
+    } else {
+        res = -(EBADF);
+    }
+
+    iov_free(iov, small_iov);
+
+    return res;
+}
+
 void
 vfs_syscalls_init()
 {
@@ -594,4 +894,10 @@ vfs_syscalls_init()
     register_syscall(SYS_UTIMES, 2, sys_utimes);
     register_syscall(SYS_MOUNT, 4, sys_mount);
     register_syscall(SYS_LSEEK64, 4, sys_lseek64);
+    register_syscall(SYS_READV, 3, sys_readv);
+    register_syscall(SYS_WRITEV, 3, sys_writev);
+    register_syscall(SYS_PREAD, 5, sys_pread);
+    register_syscall(SYS_PWRITE, 5, sys_pwrite);
+    register_syscall(SYS_PREADV, 5, sys_preadv);
+    register_syscall(SYS_PWRITEV, 5, sys_pwritev);
 }
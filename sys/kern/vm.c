@@ -23,6 +23,7 @@
 #include <sys/malloc.h>
 #include <sys/systm.h>
 #include <sys/types.h>
+#include <sys/vdso.h>
 #include <sys/vm.h>
 
 /* bitmap macros */
@@ -163,6 +164,11 @@ vm_access(struct vm_space *space, const void *buf, size_t nbyte, int prot)
         return -1;
     }
 
+    /* the kernel doesn't honour read-only mappings on its own writes */
+    if (VM_IS_WRITABLE(prot) && VDSO_CONTAINS(buf, nbyte)) {
+        return -1;
+    }
+
     start_page = PAGE_INDEX((uintptr_t)buf - vamap->base);
     required_pages = PAGE_COUNT(nbyte);
 
@@ -27,6 +27,7 @@
 #include <sys/mount.h>
 #include <sys/pool.h>
 #include <sys/string.h>
+#include <sys/trace.h>
 #include <sys/vnode.h>
 
 int vfs_node_count = 0;
@@ -158,6 +159,8 @@ vn_lookup(struct vnode *parent, struct vnode **result, const char *name)
         res = 0;
     }
 
+    TRACE(TRACE_VFS_LOOKUP, parent->inode, res, node ? node->inode : 0);
+
     if (node && node->ismount) {
         *result = node->mount;
     } else if (node) {
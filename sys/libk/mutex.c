@@ -13,46 +13,128 @@
  * with this program; if not, write to the Free Software Foundation, Inc.,
  * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
  */
-#include <sys/mutex.h>
-#include <sys/systm.h>
+#include <machine/cpu.h>
+#include <machine/cpufunc.h>
 #include <machine/interrupt.h>
+#include <sys/mutex.h>
+
+#ifdef LOCK_STATS
+
+LOCK_CLASS(lock_class_other, "other");
+
+/* defined in ds/list.c */
+extern struct lock_class list_lock_class;
 
-static inline uint32_t
-get_eflags()
+/* adds a class's counters to the kstats; registering it again does nothing */
+void
+lock_class_register(struct lock_class *class)
 {
-    uint32_t flags;
+    if (class->lc_registered) {
+        return;
+    }
 
-    asm volatile("pushf ; pop %0" : "=rm" (flags) :: "memory");
+    class->lc_registered = true;
 
-    return flags;
+    kstat_register(class->lc_kstats, sizeof(class->lc_kstats) / sizeof(class->lc_kstats[0]));
 }
 
+/* classes of locks that have no initialization of their own to register them */
 void
-spinlock_lock(spinlock_t volatile *lock)
+lock_stats_init()
 {
-    /* debug code to detect deadlocks. will remove */
-    uint32_t flags = get_eflags();
-    
-    bool deadlock =  (*lock && (flags & 0x200) == 0);
-
-    if (deadlock) {
-        printf("kernel: we will deadlock\n\r");
-        stacktrace(5); 
-        asm volatile("sti");
+    lock_class_register(&lock_class_other);
+    lock_class_register(&list_lock_class);
+}
+
+/*
+ * called by the new holder. Every CPU may be updating the same class, so the
+ * counters are only ever changed with locked instructions
+ */
+static inline void
+lock_stats_acquired(spinlock_t volatile *lock, bool contended, uint64_t spin)
+{
+    struct lock_class *class;
+
+    class = lock->class ? lock->class : &lock_class_other;
+
+    __sync_fetch_and_add(&class->lc_acquired, 1);
+
+    if (contended) {
+        __sync_fetch_and_add(&class->lc_contended, 1);
+        __sync_fetch_and_add(&class->lc_spin_cycles, spin);
     }
 
-    while (*lock) {
+    lock->acquired_at = rdtsc();
+}
+
+/* called by the holder before it lets go */
+static inline void
+lock_stats_released(spinlock_t volatile *lock)
+{
+    uint32_t max;
+    uint64_t hold;
+    struct lock_class *class;
+
+    class = lock->class ? lock->class : &lock_class_other;
+    hold = rdtsc() - lock->acquired_at;
+
+    if (hold > 0xFFFFFFFF) {
+        hold = 0xFFFFFFFF;
+    }
+
+    do {
+        max = class->lc_max_hold;
+
+        if (hold <= max) {
+            break;
+        }
+    } while (!__sync_bool_compare_and_swap(&class->lc_max_hold, max, (uint32_t)hold));
+}
+
+#endif /* LOCK_STATS */
+
+/*
+ * spins with the caller's interrupt state left as it was; callers that rely
+ * on interrupts being off (critical_enter(), interrupt handlers) depend on
+ * it. A holder must never sleep or yield, so it always gets to finish
+ */
+void
+spinlock_lock(spinlock_t volatile *lock)
+{
+    uint16_t ticket;
+#ifdef LOCK_STATS
+    uint64_t start;
+#endif
+
+    ticket = __sync_fetch_and_add(&lock->next, 1);
+
+    if (lock->owner == ticket) {
+#ifdef LOCK_STATS
+        lock_stats_acquired(lock, false, 0);
+#endif
+        return;
     }
-    
-    if (deadlock) {
-        asm volatile("cli");
+
+#ifdef LOCK_STATS
+    start = rdtsc();
+#endif
+
+    while (lock->owner != ticket) {
+        cpu_pause();
     }
 
-    __sync_lock_test_and_set(lock, 1);
+#ifdef LOCK_STATS
+    lock_stats_acquired(lock, true, rdtsc() - start);
+#endif
 }
 
 void
 spinlock_unlock(spinlock_t volatile *lock)
 {
-    __sync_lock_release(lock, 0);
+#ifdef LOCK_STATS
+    lock_stats_released(lock);
+#endif
+
+    /* only the holder writes owner; the locked add doubles as a barrier */
+    __sync_fetch_and_add(&lock->owner, 1);
 }
@@ -20,6 +20,62 @@
 #define MAX(X, Y) ((X > Y) ? X : Y)
 #define MIN(X, Y) ((X < Y) ? X : Y)
 
+#define LIBK_PAGE_SIZE  4096
+
+/* true if any of the four bytes in a word is zero */
+#define HAS_ZERO_BYTE(w) (((w) - 0x01010101) & ~(w) & 0x80808080)
+
+/* a 32-bit word that may alias any other type */
+typedef uint32_t __attribute__((may_alias)) word_t;
+
+/* below this many bytes, starting up a rep movs or rep stos costs more than it saves */
+#define REP_THRESHOLD   64
+
+static inline void *
+memcpy_small(void *dest, const void *src, size_t nbyte)
+{
+    uint8_t *dest_buf;
+    const uint8_t *src_buf;
+
+    dest_buf = dest;
+    src_buf = src;
+
+    while (nbyte >= 4) {
+        *(word_t*)dest_buf = *(const word_t*)src_buf;
+        dest_buf += 4;
+        src_buf += 4;
+        nbyte -= 4;
+    }
+
+    while (nbyte > 0) {
+        *(dest_buf++) = *(src_buf++);
+        nbyte--;
+    }
+
+    return dest;
+}
+
+static inline void *
+memset_small(void *ptr, uint32_t word, size_t nbyte)
+{
+    uint8_t *buf;
+
+    buf = ptr;
+
+    while (nbyte >= 4) {
+        *(word_t*)buf = word;
+        buf += 4;
+        nbyte -= 4;
+    }
+
+    while (nbyte > 0) {
+        *(buf++) = (uint8_t)word;
+        nbyte--;
+    }
+
+    return ptr;
+}
+
 int
 atoi(const char *str, int base)
 {
@@ -90,16 +146,27 @@ itoa_u(unsigned int value, char *str, int base)
 int
 memcmp(const void *buf1, const void *buf2, size_t nbyte)
 {
-    const char *str1 = buf1;
-    const char *str2 = buf2;
+    const uint8_t *str1;
+    const uint8_t *str2;
 
-    for (int i = 0; i < nbyte; i++) {
-        char c1 = str1[i];
-        char c2 = str2[i];
+    str1 = buf1;
+    str2 = buf2;
 
-        if (c1 != c2) {
-            return c1 - c2;
+    /* skip over the equal part a word at a time, then find the byte that differs */
+    while (nbyte >= 4 && *(const word_t*)str1 == *(const word_t*)str2) {
+        str1 += 4;
+        str2 += 4;
+        nbyte -= 4;
+    }
+
+    while (nbyte > 0) {
+        if (*str1 != *str2) {
+            return *str1 - *str2;
         }
+
+        str1++;
+        str2++;
+        nbyte--;
     }
 
     return 0;
@@ -108,12 +175,64 @@ memcmp(const void *buf1, const void *buf2, size_t nbyte)
 void *
 memcpy(void *dest, const void *src, size_t nbyte)
 {
-    char *dest_buf = (char*)dest;
-    char *src_buf = (char*)src;
+    uint8_t *dest_buf;
+    const uint8_t *src_buf;
+    size_t count;
 
+    if (nbyte < REP_THRESHOLD) {
+        return memcpy_small(dest, src, nbyte);
+    }
 
-    for (int i = 0; i < nbyte; i++) {
-        *(dest_buf++) = *(src_buf++);
+    dest_buf = dest;
+    src_buf = src;
+
+    /* unaligned stores cost more than unaligned loads, so align the destination */
+    count = -(uintptr_t)dest_buf & 3;
+    memcpy_small(dest_buf, src_buf, count);
+
+    dest_buf += count;
+    src_buf += count;
+    nbyte -= count;
+    count = nbyte / 4;
+
+    asm volatile("rep movsl" : "+D"(dest_buf), "+S"(src_buf), "+c"(count) : : "memory");
+
+    memcpy_small(dest_buf, src_buf, nbyte & 3);
+
+    return dest;
+}
+
+void *
+memmove(void *dest, const void *src, size_t nbyte)
+{
+    uint8_t *dest_buf;
+    const uint8_t *src_buf;
+
+    dest_buf = dest;
+    src_buf = src;
+
+    if (dest_buf <= src_buf || dest_buf >= src_buf + nbyte) {
+        return memcpy(dest, src, nbyte);
+    }
+
+    /*
+     * the regions overlap with the destination above the source, so copy from
+     * the end. This isn't done with std; rep movs, since an interrupt arriving
+     * in between would run the kernel with the direction flag set
+     */
+    dest_buf += nbyte;
+    src_buf += nbyte;
+
+    while (nbyte >= 4) {
+        dest_buf -= 4;
+        src_buf -= 4;
+        nbyte -= 4;
+        *(word_t*)dest_buf = *(const word_t*)src_buf;
+    }
+
+    while (nbyte > 0) {
+        *(--dest_buf) = *(--src_buf);
+        nbyte--;
     }
 
     return dest;
@@ -122,15 +241,53 @@ memcpy(void *dest, const void *src, size_t nbyte)
 void *
 memset(void *ptr, int value, size_t nbyte)
 {
-    char *buf = (char*)ptr;
+    uint8_t *buf;
+    size_t count;
+    uint32_t word;
+
+    word = (uint8_t)value * 0x01010101;
 
-    for (int i = 0; i < nbyte; i++) {
-        buf[i] = 0;
+    if (nbyte < REP_THRESHOLD) {
+        return memset_small(ptr, word, nbyte);
     }
 
+    buf = ptr;
+
+    count = -(uintptr_t)buf & 3;
+    memset_small(buf, word, count);
+
+    buf += count;
+    nbyte -= count;
+    count = nbyte / 4;
+
+    asm volatile("rep stosl" : "+D"(buf), "+c"(count) : "a"(word) : "memory");
+
+    memset_small(buf, word, nbyte & 3);
+
     return ptr;
 }
 
+/* copies a page-aligned page; used for frames, which are always exactly one page */
+void
+page_copy(void *dest, const void *src)
+{
+    size_t count;
+
+    count = LIBK_PAGE_SIZE / 4;
+
+    asm volatile("rep movsl" : "+D"(dest), "+S"(src), "+c"(count) : : "memory");
+}
+
+void
+page_zero(void *page)
+{
+    size_t count;
+
+    count = LIBK_PAGE_SIZE / 4;
+
+    asm volatile("rep stosl" : "+D"(page), "+c"(count) : "a"(0) : "memory");
+}
+
 void
 sprintf(char *str, const char *fmt, ...)
 {
@@ -169,20 +326,84 @@ strcpy(char *dest, const char *src)
 int
 strlen(const char *str)
 {
-    int len = 0;
+    const char *end;
+    const word_t *words;
+    uint32_t word;
 
-    while (*str) {
-        len++;
-        str++;
+    end = str;
+
+    while ((uintptr_t)end & 3) {
+        if (*end == 0) {
+            return end - str;
+        }
+
+        end++;
     }
 
-    return len;
+    /*
+     * an aligned word never crosses into the next page, so reading past the
+     * terminator is harmless. Stop at the first word with a zero byte in it
+     */
+    words = (const word_t*)end;
+
+    for (;;) {
+        word = *words;
+
+        if (HAS_ZERO_BYTE(word)) {
+            break;
+        }
+
+        words++;
+    }
+
+    end = (const char*)words;
+
+    while (*end) {
+        end++;
+    }
+
+    return end - str;
 }
 
 int
 strcmp(const char *str1, const char *str2)
 {
-    return strncmp(str1, str2, MIN(strlen(str1), strlen(str2)));
+    const uint8_t *s1;
+    const uint8_t *s2;
+    uint32_t word;
+
+    s1 = (const uint8_t*)str1;
+    s2 = (const uint8_t*)str2;
+
+    /* both strings can only be walked a word at a time if they're aligned alike */
+    if ((((uintptr_t)s1 ^ (uintptr_t)s2) & 3) == 0) {
+        while ((uintptr_t)s1 & 3) {
+            if (*s1 == 0 || *s1 != *s2) {
+                return *s1 - *s2;
+            }
+
+            s1++;
+            s2++;
+        }
+
+        for (;;) {
+            word = *(const word_t*)s1;
+
+            if (word != *(const word_t*)s2 || HAS_ZERO_BYTE(word)) {
+                break;
+            }
+
+            s1 += 4;
+            s2 += 4;
+        }
+    }
+
+    while (*s1 && *s1 == *s2) {
+        s1++;
+        s2++;
+    }
+
+    return *s1 - *s2;
 }
 
 char *
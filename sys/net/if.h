@@ -0,0 +1,53 @@
+/*
+ * if.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _NET_IF_H
+#define _NET_IF_H
+
+#include <net/mbuf.h>
+#include <sys/in.h>
+#include <sys/types.h>
+
+#define IFF_UP          0x01
+#define IFF_LOOPBACK    0x02
+
+#define LOMTU           16384
+
+struct ifnet;
+
+typedef int (*if_output_t)(struct ifnet *, struct mbuf *);
+
+struct ifnet {
+    char                if_name[8];
+    int                 if_flags;
+    size_t              if_mtu;
+    in_addr_t           if_addr;        /* network byte order */
+    in_addr_t           if_netmask;
+    if_output_t         if_output;
+    uint64_t            if_ipackets;
+    uint64_t            if_opackets;
+    uint64_t            if_ibytes;
+    uint64_t            if_obytes;
+};
+
+extern struct ifnet loif;
+
+struct ifnet *  if_route(in_addr_t);
+bool            if_islocal(in_addr_t);
+void            lo_dispatch();
+
+#endif /* _NET_IF_H */
@@ -0,0 +1,101 @@
+/*
+ * if_loop.c - Loopback interface
+ *
+ * Packets sent to 127.0.0.0/8 are queued here and fed back into ip_input()
+ * when the network lock is released. Queueing instead of calling straight
+ * back up the stack keeps the recursion depth bounded (an ACK generated by
+ * tcp_input() would otherwise re-enter the sender's tcp_input()) and lets a
+ * whole exchange, such as the TCP handshake, complete before the caller
+ * returns to user space
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <net/if.h>
+#include <net/inet.h>
+#include <net/mbuf.h>
+#include <sys/in.h>
+#include <sys/types.h>
+
+static int lo_output(struct ifnet *, struct mbuf *);
+
+struct ifnet loif = {
+    .if_name    = "lo0",
+    .if_flags   = IFF_UP | IFF_LOOPBACK,
+    .if_mtu     = LOMTU,
+    .if_output  = lo_output
+};
+
+/* packets waiting to be received; protected by the network lock */
+static struct mbuf *lo_queue_head;
+static struct mbuf *lo_queue_tail;
+
+static int
+lo_output(struct ifnet *ifp, struct mbuf *m)
+{
+    ifp->if_opackets++;
+    ifp->if_obytes += m->m_pktlen;
+
+    /* nothing can corrupt the packet between here and ip_input() */
+    m->m_flags |= M_LOOP;
+    m->m_nextpkt = NULL;
+
+    if (lo_queue_tail) {
+        lo_queue_tail->m_nextpkt = m;
+    } else {
+        lo_queue_head = m;
+    }
+
+    lo_queue_tail = m;
+
+    return 0;
+}
+
+/* delivers every queued packet, including any generated while doing so */
+void
+lo_dispatch()
+{
+    struct mbuf *m;
+
+    while ((m = lo_queue_head)) {
+        lo_queue_head = m->m_nextpkt;
+
+        if (!lo_queue_head) {
+            lo_queue_tail = NULL;
+        }
+
+        m->m_nextpkt = NULL;
+
+        loif.if_ipackets++;
+        loif.if_ibytes += m->m_pktlen;
+
+        ip_input(&loif, m);
+    }
+}
+
+struct ifnet *
+if_route(in_addr_t dst)
+{
+    if ((ntohl(dst) >> 24) == IN_LOOPBACKNET) {
+        return &loif;
+    }
+
+    return NULL;
+}
+
+bool
+if_islocal(in_addr_t addr)
+{
+    return addr == INADDR_ANY || (ntohl(addr) >> 24) == IN_LOOPBACKNET;
+}
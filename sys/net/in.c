@@ -0,0 +1,472 @@
+/*
+ * in.c - Internet protocol family
+ *
+ * AF_INET sockets are created through this file and then handed to TCP or
+ * UDP depending on their type. It also holds what the transports share:
+ * the network lock, protocol control block tables, address conversion and
+ * socket level options
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <net/if.h>
+#include <net/inet.h>
+#include <net/mbuf.h>
+#include <sys/errno.h>
+#include <sys/fcntl.h>
+#include <sys/in.h>
+#include <sys/malloc.h>
+#include <sys/mutex.h>
+#include <sys/proc.h>
+#include <sys/socket.h>
+#include <sys/string.h>
+#include <sys/types.h>
+
+/* socket buffers may not be made larger than this */
+#define SB_MAX  (256*1024)
+
+extern struct protocol tcp_protocol;
+extern struct protocol udp_protocol;
+
+static int in_init(struct socket *, int, int);
+
+struct socket_ops in_ops = {
+    .init       = in_init
+};
+
+struct protocol in_protocol = {
+    .address_family = AF_INET,
+    .ops            = &in_ops
+};
+
+static spinlock_t net_spinlock;
+
+/* picks the transport; from here on the socket talks to it directly */
+static int
+in_init(struct socket *sock, int type, int protocol)
+{
+    switch (type) {
+        case SOCK_STREAM:
+            if (protocol != IPPROTO_IP && protocol != IPPROTO_TCP) {
+                return -(EPROTONOSUPPORT);
+            }
+
+            sock->protocol = &tcp_protocol;
+            break;
+        case SOCK_DGRAM:
+            if (protocol != IPPROTO_IP && protocol != IPPROTO_UDP) {
+                return -(EPROTONOSUPPORT);
+            }
+
+            sock->protocol = &udp_protocol;
+            break;
+        default:
+            return -(EPROTOTYPE);
+    }
+
+    return sock->protocol->ops->init(sock, type, protocol);
+}
+
+void
+net_lock()
+{
+    spinlock_lock(&net_spinlock);
+}
+
+/* delivers any looped back packets before letting go of the stack */
+void
+net_unlock()
+{
+    lo_dispatch();
+
+    spinlock_unlock(&net_spinlock);
+}
+
+/*
+ * waits for another thread to change the state of a socket. Called, and
+ * returns, with the network lock held
+ */
+int
+net_wait(int flags)
+{
+    if ((flags & O_NONBLOCK)) {
+        return -(EAGAIN);
+    }
+
+    net_unlock();
+
+    thread_yield();
+
+    net_lock();
+
+    if (thread_exit_requested()) {
+        return -(EINTR);
+    }
+
+    return 0;
+}
+
+/* the internet checksum (RFC 1071) over a contiguous buffer */
+uint16_t
+in_cksum(const void *buf, size_t len)
+{
+    uint32_t sum;
+    const uint16_t *w;
+
+    sum = 0;
+    w = buf;
+
+    while (len > 1) {
+        sum += *w++;
+        len -= 2;
+    }
+
+    if (len) {
+        sum += *(const uint8_t*)w;
+    }
+
+    sum = (sum >> 16) + (sum & 0xFFFF);
+    sum += (sum >> 16);
+
+    return (uint16_t)~sum;
+}
+
+/* validates a user supplied address */
+int
+in_getsockaddr(struct sockaddr_in *sin, void *address, size_t address_len)
+{
+    if (!address || address_len < sizeof(struct sockaddr_in)) {
+        return -(EINVAL);
+    }
+
+    memcpy(sin, address, sizeof(struct sockaddr_in));
+
+    if (sin->sin_family != AF_INET) {
+        return -(EAFNOSUPPORT);
+    }
+
+    return 0;
+}
+
+void
+in_setsockaddr(in_addr_t addr, in_port_t port, void *address, size_t *address_len)
+{
+    size_t len;
+    struct sockaddr_in sin;
+
+    if (!address || !address_len) {
+        return;
+    }
+
+    memset(&sin, 0, sizeof(sin));
+
+    sin.sin_family = AF_INET;
+    sin.sin_port = port;
+    sin.sin_addr.s_addr = addr;
+
+    len = *address_len < sizeof(sin) ? *address_len : sizeof(sin);
+
+    memcpy(address, &sin, len);
+
+    *address_len = sizeof(sin);
+}
+
+/* SOL_SOCKET options common to every internet socket */
+int
+in_getopt(struct inpcb *inp, int level, int name, void *val, size_t *len)
+{
+    int res;
+
+    if (level != SOL_SOCKET) {
+        return -(ENOPROTOOPT);
+    }
+
+    if (*len < sizeof(int)) {
+        return -(EINVAL);
+    }
+
+    switch (name) {
+        case SO_ERROR:
+            res = inp->inp_error;
+            inp->inp_error = 0;
+            break;
+        case SO_RCVBUF:
+            res = inp->inp_rcv.sb_hiwat;
+            break;
+        case SO_REUSEADDR:
+            res = (inp->inp_flags & INP_REUSEADDR) != 0;
+            break;
+        case SO_SNDBUF:
+            res = inp->inp_snd.sb_hiwat;
+            break;
+        default:
+            return -(ENOPROTOOPT);
+    }
+
+    *(int*)val = res;
+    *len = sizeof(int);
+
+    return 0;
+}
+
+int
+in_setopt(struct inpcb *inp, int level, int name, const void *val, size_t len)
+{
+    int arg;
+
+    if (level != SOL_SOCKET) {
+        return -(ENOPROTOOPT);
+    }
+
+    if (len < sizeof(int)) {
+        return -(EINVAL);
+    }
+
+    arg = *(const int*)val;
+
+    switch (name) {
+        case SO_RCVBUF:
+        case SO_SNDBUF:
+            if (arg <= 0 || arg > SB_MAX) {
+                return -(ENOBUFS);
+            }
+
+            if (name == SO_RCVBUF) {
+                inp->inp_rcv.sb_hiwat = arg;
+            } else {
+                inp->inp_snd.sb_hiwat = arg;
+            }
+
+            return 0;
+        case SO_REUSEADDR:
+            if (arg) {
+                inp->inp_flags |= INP_REUSEADDR;
+            } else {
+                inp->inp_flags &= ~INP_REUSEADDR;
+            }
+
+            return 0;
+    }
+
+    return -(ENOPROTOOPT);
+}
+
+struct inpcb *
+in_pcballoc()
+{
+    return calloc(1, sizeof(struct inpcb));
+}
+
+void
+in_pcbinsert(struct inpcbtable *table, struct inpcb *inp)
+{
+    inp->inp_next = table->ipt_head;
+    table->ipt_head = inp;
+}
+
+void
+in_pcbremove(struct inpcbtable *table, struct inpcb *inp)
+{
+    struct inpcb **pp;
+
+    for (pp = &table->ipt_head; *pp; pp = &(*pp)->inp_next) {
+        if (*pp == inp) {
+            *pp = inp->inp_next;
+            break;
+        }
+    }
+
+    inp->inp_next = NULL;
+}
+
+void
+in_pcbfree(struct inpcbtable *table, struct inpcb *inp)
+{
+    in_pcbremove(table, inp);
+
+    sb_flush(&inp->inp_rcv);
+    sb_flush(&inp->inp_snd);
+
+    free(inp);
+}
+
+/*
+ * finds the pcb a packet belongs to. An exact match on both ends wins;
+ * with wildcard set, a pcb that is only bound to the local port will do
+ */
+struct inpcb *
+in_pcblookup(struct inpcbtable *table, in_addr_t faddr, in_port_t fport,
+             in_addr_t laddr, in_port_t lport, bool wildcard)
+{
+    struct inpcb *inp;
+    struct inpcb *match;
+
+    match = NULL;
+
+    for (inp = table->ipt_head; inp; inp = inp->inp_next) {
+        if (inp->inp_lport != lport) {
+            continue;
+        }
+
+        if (inp->inp_faddr == faddr && inp->inp_fport == fport &&
+            (inp->inp_laddr == laddr || inp->inp_laddr == INADDR_ANY)) {
+            return inp;
+        }
+
+        if (wildcard && inp->inp_faddr == INADDR_ANY &&
+            (inp->inp_laddr == laddr || inp->inp_laddr == INADDR_ANY)) {
+            /* prefer a pcb bound to this exact address */
+            if (!match || inp->inp_laddr != INADDR_ANY) {
+                match = inp;
+            }
+        }
+    }
+
+    return match;
+}
+
+static bool
+in_pcbinuse(struct inpcbtable *table, struct inpcb *self, in_addr_t laddr, in_port_t lport)
+{
+    struct inpcb *inp;
+
+    for (inp = table->ipt_head; inp; inp = inp->inp_next) {
+        if (inp == self || inp->inp_lport != lport) {
+            continue;
+        }
+
+        if (inp->inp_laddr != laddr && inp->inp_laddr != INADDR_ANY && laddr != INADDR_ANY) {
+            continue;
+        }
+
+        /* connected pcbs only conflict with each other on the full tuple */
+        if ((self->inp_flags & INP_REUSEADDR) && inp->inp_faddr != INADDR_ANY) {
+            continue;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+/* binds to sin, or to an ephemeral port on any address when sin is NULL */
+int
+in_pcbbind(struct inpcbtable *table, struct inpcb *inp, struct sockaddr_in *sin)
+{
+    int i;
+    in_addr_t laddr;
+    in_port_t lport;
+
+    if (inp->inp_lport != 0) {
+        return -(EINVAL);
+    }
+
+    laddr = sin ? sin->sin_addr.s_addr : INADDR_ANY;
+    lport = sin ? sin->sin_port : 0;
+
+    if (!if_islocal(laddr)) {
+        return -(EADDRNOTAVAIL);
+    }
+
+    if (lport != 0) {
+        if (in_pcbinuse(table, inp, laddr, lport)) {
+            return -(EADDRINUSE);
+        }
+    } else {
+        for (i = IPPORT_EPHEMERALFIRST; i <= IPPORT_EPHEMERALLAST; i++) {
+            table->ipt_lastport++;
+
+            if (table->ipt_lastport < IPPORT_EPHEMERALFIRST) {
+                table->ipt_lastport = IPPORT_EPHEMERALFIRST;
+            }
+
+            lport = htons(table->ipt_lastport);
+
+            if (!in_pcbinuse(table, inp, laddr, lport)) {
+                break;
+            }
+        }
+
+        if (i > IPPORT_EPHEMERALLAST) {
+            return -(EADDRINUSE);
+        }
+    }
+
+    inp->inp_laddr = laddr;
+    inp->inp_lport = lport;
+
+    in_pcbinsert(table, inp);
+
+    return 0;
+}
+
+/* sets the foreign address, binding the local end first when needed */
+int
+in_pcbconnect(struct inpcbtable *table, struct inpcb *inp, struct sockaddr_in *sin)
+{
+    int res;
+    in_addr_t faddr;
+    struct ifnet *ifp;
+
+    faddr = sin->sin_addr.s_addr;
+
+    /* like BSD, connecting to INADDR_ANY means this host */
+    if (faddr == INADDR_ANY) {
+        faddr = loif.if_addr;
+    }
+
+    if (sin->sin_port == 0) {
+        return -(EADDRNOTAVAIL);
+    }
+
+    ifp = if_route(faddr);
+
+    if (!ifp) {
+        return -(ENETUNREACH);
+    }
+
+    if (in_pcblookup(table, faddr, sin->sin_port, inp->inp_laddr ? inp->inp_laddr : ifp->if_addr,
+                     inp->inp_lport, false) && inp->inp_lport != 0) {
+        return -(EADDRINUSE);
+    }
+
+    if (inp->inp_lport == 0) {
+        res = in_pcbbind(table, inp, NULL);
+
+        if (res != 0) {
+            return res;
+        }
+    }
+
+    if (inp->inp_laddr == INADDR_ANY) {
+        inp->inp_laddr = ifp->if_addr;
+    }
+
+    inp->inp_faddr = faddr;
+    inp->inp_fport = sin->sin_port;
+
+    return 0;
+}
+
+void
+inet_init()
+{
+    extern void tcp_init();
+
+    loif.if_addr = htonl(INADDR_LOOPBACK);
+    loif.if_netmask = htonl(0xFF000000);
+
+    tcp_init();
+}
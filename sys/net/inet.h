@@ -0,0 +1,99 @@
+/*
+ * inet.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _NET_INET_H
+#define _NET_INET_H
+
+#include <net/mbuf.h>
+#include <sys/in.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+
+struct ifnet;
+
+#define IPVERSION       4
+#define IPDEFTTL        64
+
+struct ip {
+    uint8_t             ip_vhl;     /* version << 4 | header length >> 2 */
+    uint8_t             ip_tos;
+    uint16_t            ip_len;
+    uint16_t            ip_id;
+    uint16_t            ip_off;
+    uint8_t             ip_ttl;
+    uint8_t             ip_p;
+    uint16_t            ip_sum;
+    in_addr_t           ip_src;
+    in_addr_t           ip_dst;
+} __attribute__((packed));
+
+#define IP_HLEN(ip) (((ip)->ip_vhl & 0x0F) << 2)
+
+#define INP_REUSEADDR   0x01    /* SO_REUSEADDR */
+#define INP_DETACHED    0x02    /* the socket has been closed */
+
+/*
+ * protocol control block shared by TCP and UDP; tracks the addresses a
+ * socket is bound and connected to, along with its socket buffers.
+ * Addresses and ports are kept in network byte order
+ */
+struct inpcb {
+    struct inpcb *      inp_next;
+    in_addr_t           inp_laddr;
+    in_port_t           inp_lport;
+    in_addr_t           inp_faddr;
+    in_port_t           inp_fport;
+    int                 inp_flags;
+    int                 inp_error;  /* pending SO_ERROR */
+    struct sockbuf      inp_rcv;
+    struct sockbuf      inp_snd;
+    void *              inp_ppcb;   /* protocol specific state */
+};
+
+struct inpcbtable {
+    struct inpcb *      ipt_head;
+    in_port_t           ipt_lastport;   /* host byte order */
+};
+
+#define IPPORT_EPHEMERALFIRST   49152
+#define IPPORT_EPHEMERALLAST    65535
+
+/* the whole stack runs under this lock */
+void            net_lock();
+void            net_unlock();
+int             net_wait(int);
+
+uint16_t        in_cksum(const void *, size_t);
+
+int             in_getsockaddr(struct sockaddr_in *, void *, size_t);
+void            in_setsockaddr(in_addr_t, in_port_t, void *, size_t *);
+
+int             in_getopt(struct inpcb *, int, int, void *, size_t *);
+int             in_setopt(struct inpcb *, int, int, const void *, size_t);
+
+struct inpcb *  in_pcballoc();
+int             in_pcbbind(struct inpcbtable *, struct inpcb *, struct sockaddr_in *);
+int             in_pcbconnect(struct inpcbtable *, struct inpcb *, struct sockaddr_in *);
+void            in_pcbfree(struct inpcbtable *, struct inpcb *);
+void            in_pcbinsert(struct inpcbtable *, struct inpcb *);
+void            in_pcbremove(struct inpcbtable *, struct inpcb *);
+struct inpcb *  in_pcblookup(struct inpcbtable *, in_addr_t, in_port_t, in_addr_t, in_port_t, bool);
+
+void            ip_input(struct ifnet *, struct mbuf *);
+int             ip_output(struct mbuf *, in_addr_t, in_addr_t, int);
+
+#endif /* _NET_INET_H */
@@ -0,0 +1,127 @@
+/*
+ * ip.c - Internet Protocol version 4
+ *
+ * Only what a host with a single loopback interface needs: no forwarding,
+ * no options and no fragmentation. Transports are expected to keep their
+ * packets within the interface MTU
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <net/if.h>
+#include <net/inet.h>
+#include <net/mbuf.h>
+#include <net/tcp.h>
+#include <net/udp.h>
+#include <sys/errno.h>
+#include <sys/in.h>
+#include <sys/types.h>
+
+static uint16_t ip_id;
+
+void
+ip_input(struct ifnet *ifp, struct mbuf *m)
+{
+    size_t hlen;
+    size_t len;
+    in_addr_t src;
+    in_addr_t dst;
+    struct ip *ip;
+
+    m = m_pullup(m, sizeof(struct ip));
+
+    if (!m) {
+        return;
+    }
+
+    ip = MTOD(m, struct ip*);
+    hlen = IP_HLEN(ip);
+    len = ntohs(ip->ip_len);
+
+    if ((ip->ip_vhl >> 4) != IPVERSION || hlen < sizeof(struct ip) || len < hlen || len > m->m_pktlen) {
+        goto drop;
+    }
+
+    if (!(m->m_flags & M_LOOP) && in_cksum(ip, hlen) != 0) {
+        goto drop;
+    }
+
+    /* fragments are never generated, so they are never reassembled */
+    if ((ntohs(ip->ip_off) & 0x3FFF) != 0) {
+        goto drop;
+    }
+
+    if (!if_islocal(ip->ip_dst)) {
+        goto drop;
+    }
+
+    src = ip->ip_src;
+    dst = ip->ip_dst;
+
+    switch (ip->ip_p) {
+        case IPPROTO_TCP:
+            m_adj(m, hlen);
+            tcp_input(m, src, dst);
+            return;
+        case IPPROTO_UDP:
+            m_adj(m, hlen);
+            udp_input(m, src, dst);
+            return;
+    }
+
+drop:
+    m_freem(m);
+}
+
+/* prepends an IP header and hands the packet to the outgoing interface */
+int
+ip_output(struct mbuf *m, in_addr_t src, in_addr_t dst, int proto)
+{
+    struct ifnet *ifp;
+    struct ip *ip;
+
+    ifp = if_route(dst);
+
+    if (!ifp) {
+        m_freem(m);
+        return -(ENETUNREACH);
+    }
+
+    m = m_prepend(m, sizeof(struct ip));
+
+    if (m->m_pktlen > ifp->if_mtu) {
+        m_freem(m);
+        return -(EMSGSIZE);
+    }
+
+    ip = MTOD(m, struct ip*);
+
+    ip->ip_vhl = (IPVERSION << 4) | (sizeof(struct ip) >> 2);
+    ip->ip_tos = 0;
+    ip->ip_len = htons(m->m_pktlen);
+    ip->ip_id = htons(ip_id++);
+    ip->ip_off = 0;
+    ip->ip_ttl = IPDEFTTL;
+    ip->ip_p = proto;
+    ip->ip_sum = 0;
+    ip->ip_src = src;
+    ip->ip_dst = dst;
+
+    /* loopback never verifies it, so don't bother computing it */
+    if (!(ifp->if_flags & IFF_LOOPBACK)) {
+        ip->ip_sum = in_cksum(ip, sizeof(struct ip));
+    }
+
+    return ifp->if_output(ifp, m);
+}
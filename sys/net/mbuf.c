@@ -0,0 +1,557 @@
+/*
+ * mbuf.c - Network packet buffers
+ *
+ * Packets are chains of mbufs. Small amounts of data are stored inline,
+ * anything larger goes into reference counted clusters that can be shared
+ * between chains; m_copym() hands out references instead of copying, which
+ * is what lets TCP keep its send buffer and transmit from it at the same
+ * time. Both mbufs and clusters are recycled through free lists rather than
+ * going back to the heap
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <net/mbuf.h>
+#include <sys/malloc.h>
+#include <sys/mutex.h>
+#include <sys/string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+static struct mbuf *        mbuf_free_list;
+static struct mcluster *    mcl_free_list;
+static spinlock_t           mbuf_lock;
+
+/* bytes that can still be appended to an mbuf without touching shared data */
+static size_t
+m_trailingspace(struct mbuf *m)
+{
+    uint8_t *end;
+
+    if ((m->m_flags & M_EXT)) {
+        if (m->m_ext->refs != 1) {
+            return 0;
+        }
+
+        end = &m->m_ext->buf[MCLBYTES];
+    } else {
+        end = &m->m_dat[MLEN];
+    }
+
+    return end - (m->m_data + m->m_len);
+}
+
+static size_t
+m_leadingspace(struct mbuf *m)
+{
+    if ((m->m_flags & M_EXT)) {
+        return m->m_ext->refs == 1 ? m->m_data - m->m_ext->buf : 0;
+    }
+
+    return m->m_data - m->m_dat;
+}
+
+struct mbuf *
+m_get(int flags)
+{
+    struct mbuf *m;
+
+    spinlock_lock(&mbuf_lock);
+
+    m = mbuf_free_list;
+
+    if (m) {
+        mbuf_free_list = m->m_next;
+    }
+
+    spinlock_unlock(&mbuf_lock);
+
+    if (!m) {
+        m = malloc(sizeof(struct mbuf));
+    }
+
+    m->m_next = NULL;
+    m->m_nextpkt = NULL;
+    m->m_data = m->m_dat;
+    m->m_len = 0;
+    m->m_flags = flags;
+    m->m_pktlen = 0;
+    m->m_ext = NULL;
+
+    return m;
+}
+
+/* an mbuf backed by a fresh cluster */
+struct mbuf *
+m_getcl(int flags)
+{
+    struct mbuf *m;
+    struct mcluster *cl;
+
+    m = m_get(flags | M_EXT);
+
+    spinlock_lock(&mbuf_lock);
+
+    cl = mcl_free_list;
+
+    if (cl) {
+        mcl_free_list = cl->next;
+    }
+
+    spinlock_unlock(&mbuf_lock);
+
+    if (!cl) {
+        cl = malloc(sizeof(struct mcluster));
+    }
+
+    cl->refs = 1;
+
+    m->m_ext = cl;
+    m->m_data = cl->buf;
+
+    return m;
+}
+
+/* frees a single mbuf and returns the next one in the chain */
+struct mbuf *
+m_free(struct mbuf *m)
+{
+    struct mbuf *next;
+    struct mcluster *cl;
+
+    next = m->m_next;
+    cl = NULL;
+
+    if ((m->m_flags & M_EXT) && __sync_sub_and_fetch(&m->m_ext->refs, 1) == 0) {
+        cl = m->m_ext;
+    }
+
+    spinlock_lock(&mbuf_lock);
+
+    if (cl) {
+        cl->next = mcl_free_list;
+        mcl_free_list = cl;
+    }
+
+    m->m_next = mbuf_free_list;
+    mbuf_free_list = m;
+
+    spinlock_unlock(&mbuf_lock);
+
+    return next;
+}
+
+void
+m_freem(struct mbuf *m)
+{
+    while (m) {
+        m = m_free(m);
+    }
+}
+
+/* removes len bytes from the front of a chain */
+void
+m_adj(struct mbuf *m, size_t len)
+{
+    size_t chunk;
+    struct mbuf *n;
+
+    if ((m->m_flags & M_PKTHDR)) {
+        m->m_pktlen -= len;
+    }
+
+    for (n = m; n && len > 0; n = n->m_next) {
+        chunk = len < n->m_len ? len : n->m_len;
+
+        n->m_data += chunk;
+        n->m_len -= chunk;
+
+        len -= chunk;
+    }
+}
+
+/*
+ * returns a new chain referencing len bytes of m starting at off. Cluster
+ * data is shared; only the small inline buffers are copied
+ */
+struct mbuf *
+m_copym(struct mbuf *m, size_t off, size_t len)
+{
+    size_t chunk;
+    struct mbuf *head;
+    struct mbuf *n;
+    struct mbuf **tail;
+
+    while (m && off >= m->m_len) {
+        off -= m->m_len;
+        m = m->m_next;
+    }
+
+    head = NULL;
+    tail = &head;
+
+    for (; m && len > 0; m = m->m_next, off = 0) {
+        chunk = m->m_len - off;
+
+        if (chunk > len) {
+            chunk = len;
+        }
+
+        if ((m->m_flags & M_EXT)) {
+            n = m_get(M_EXT);
+            n->m_ext = m->m_ext;
+            n->m_data = m->m_data + off;
+
+            __sync_add_and_fetch(&m->m_ext->refs, 1);
+        } else {
+            n = m_get(0);
+            memcpy(n->m_data, m->m_data + off, chunk);
+        }
+
+        n->m_len = chunk;
+
+        *tail = n;
+        tail = &n->m_next;
+
+        len -= chunk;
+    }
+
+    return head;
+}
+
+/*
+ * builds a packet from len bytes of a user iovec, skipping the first off
+ * bytes. Room for protocol headers is left in front of small packets
+ */
+struct mbuf *
+m_fromiov(const struct iovec *iov, int iovcnt, size_t off, size_t len)
+{
+    int i;
+    size_t chunk;
+    size_t total;
+    struct mbuf *head;
+    struct mbuf *m;
+    struct mbuf **tail;
+
+    head = NULL;
+    tail = &head;
+    total = len;
+
+    for (i = 0; i < iovcnt && off >= iov[i].iov_len; i++) {
+        off -= iov[i].iov_len;
+    }
+
+    while (len > 0 && i < iovcnt) {
+        if (!head && len <= MLEN - MAX_HDR) {
+            m = m_get(0);
+            m->m_data += MAX_HDR;
+        } else if (len <= MLEN) {
+            m = m_get(0);
+        } else {
+            m = m_getcl(0);
+        }
+
+        *tail = m;
+        tail = &m->m_next;
+
+        while (len > 0 && i < iovcnt && (chunk = m_trailingspace(m)) > 0) {
+            if (chunk > iov[i].iov_len - off) {
+                chunk = iov[i].iov_len - off;
+            }
+
+            if (chunk > len) {
+                chunk = len;
+            }
+
+            memcpy(m->m_data + m->m_len, (uint8_t*)iov[i].iov_base + off, chunk);
+
+            m->m_len += chunk;
+            off += chunk;
+            len -= chunk;
+
+            if (off == iov[i].iov_len) {
+                off = 0;
+                i++;
+            }
+        }
+    }
+
+    if (head) {
+        head->m_flags |= M_PKTHDR;
+        head->m_pktlen = total - len;
+    }
+
+    return head;
+}
+
+/*
+ * copies len bytes of a chain, starting at moff, into a user iovec starting
+ * at uoff. Returns the number of bytes copied
+ */
+size_t
+m_toiov(struct mbuf *m, size_t moff, const struct iovec *iov, int iovcnt, size_t uoff, size_t len)
+{
+    int i;
+    size_t chunk;
+    size_t copied;
+
+    while (m && moff >= m->m_len) {
+        moff -= m->m_len;
+        m = m->m_next;
+    }
+
+    for (i = 0; i < iovcnt && uoff >= iov[i].iov_len; i++) {
+        uoff -= iov[i].iov_len;
+    }
+
+    copied = 0;
+
+    while (m && i < iovcnt && copied < len) {
+        chunk = m->m_len - moff;
+
+        if (chunk > iov[i].iov_len - uoff) {
+            chunk = iov[i].iov_len - uoff;
+        }
+
+        if (chunk > len - copied) {
+            chunk = len - copied;
+        }
+
+        memcpy((uint8_t*)iov[i].iov_base + uoff, m->m_data + moff, chunk);
+
+        copied += chunk;
+        moff += chunk;
+        uoff += chunk;
+
+        if (moff == m->m_len) {
+            m = m->m_next;
+            moff = 0;
+        }
+
+        if (uoff == iov[i].iov_len) {
+            i++;
+            uoff = 0;
+        }
+    }
+
+    return copied;
+}
+
+/* makes room for a len byte header in front of a packet */
+struct mbuf *
+m_prepend(struct mbuf *m, size_t len)
+{
+    struct mbuf *n;
+
+    if (m && m_leadingspace(m) >= len) {
+        m->m_data -= len;
+        m->m_len += len;
+        m->m_pktlen += len;
+
+        return m;
+    }
+
+    n = m_get(M_PKTHDR);
+
+    /* keep the header at the end so lower layers can prepend in place */
+    n->m_data = &n->m_dat[MLEN - len];
+    n->m_len = len;
+    n->m_next = m;
+    n->m_pktlen = len;
+
+    if (m) {
+        n->m_pktlen += m->m_pktlen;
+        n->m_flags |= (m->m_flags & M_LOOP);
+        m->m_flags &= ~M_PKTHDR;
+    }
+
+    return n;
+}
+
+/* ensures the first len bytes of a packet are contiguous */
+struct mbuf *
+m_pullup(struct mbuf *m, size_t len)
+{
+    size_t chunk;
+    struct mbuf *n;
+
+    if (m->m_len >= len) {
+        return m;
+    }
+
+    if (len > MLEN || m->m_pktlen < len) {
+        m_freem(m);
+        return NULL;
+    }
+
+    n = m_get(m->m_flags & (M_PKTHDR | M_LOOP));
+    n->m_pktlen = m->m_pktlen;
+
+    while (m && n->m_len < len) {
+        chunk = len - n->m_len;
+
+        if (chunk > m->m_len) {
+            chunk = m->m_len;
+        }
+
+        memcpy(n->m_data + n->m_len, m->m_data, chunk);
+
+        n->m_len += chunk;
+        m->m_data += chunk;
+        m->m_len -= chunk;
+
+        if (m->m_len == 0) {
+            m = m_free(m);
+        }
+    }
+
+    n->m_next = m;
+
+    return n;
+}
+
+/* appends a chain to a byte stream, coalescing small writes */
+void
+sb_append(struct sockbuf *sb, struct mbuf *m)
+{
+    struct mbuf *tail;
+
+    tail = sb->sb_tail;
+
+    while (m) {
+        sb->sb_cc += m->m_len;
+
+        if (m->m_len == 0) {
+            m = m_free(m);
+            continue;
+        }
+
+        if (tail && !(m->m_flags & M_EXT) && m_trailingspace(tail) >= m->m_len) {
+            memcpy(tail->m_data + tail->m_len, m->m_data, m->m_len);
+            tail->m_len += m->m_len;
+            m = m_free(m);
+            continue;
+        }
+
+        if (tail) {
+            tail->m_next = m;
+        } else {
+            sb->sb_mb = m;
+        }
+
+        tail = m;
+        m = m->m_next;
+        tail->m_next = NULL;
+        tail->m_flags &= ~M_PKTHDR;
+    }
+
+    sb->sb_tail = tail;
+}
+
+/*
+ * queues a datagram as its own record. The chain may start with an M_ADDR
+ * mbuf, which is not counted against the buffer
+ */
+void
+sb_appendpkt(struct sockbuf *sb, struct mbuf *m)
+{
+    struct mbuf *n;
+
+    for (n = m; n; n = n->m_next) {
+        if (!(n->m_flags & M_ADDR)) {
+            sb->sb_cc += n->m_len;
+        }
+    }
+
+    m->m_nextpkt = NULL;
+
+    if (sb->sb_tail) {
+        sb->sb_tail->m_nextpkt = m;
+    } else {
+        sb->sb_mb = m;
+    }
+
+    sb->sb_tail = m;
+}
+
+struct mbuf *
+sb_dequeuepkt(struct sockbuf *sb)
+{
+    struct mbuf *m;
+    struct mbuf *n;
+
+    m = sb->sb_mb;
+
+    if (!m) {
+        return NULL;
+    }
+
+    sb->sb_mb = m->m_nextpkt;
+
+    if (!sb->sb_mb) {
+        sb->sb_tail = NULL;
+    }
+
+    m->m_nextpkt = NULL;
+
+    for (n = m; n; n = n->m_next) {
+        if (!(n->m_flags & M_ADDR)) {
+            sb->sb_cc -= n->m_len;
+        }
+    }
+
+    return m;
+}
+
+/* discards len bytes from the front of a byte stream */
+void
+sb_drop(struct sockbuf *sb, size_t len)
+{
+    struct mbuf *m;
+
+    m = sb->sb_mb;
+
+    sb->sb_cc -= len;
+
+    while (m && len > 0) {
+        if (len < m->m_len) {
+            m->m_data += len;
+            m->m_len -= len;
+            break;
+        }
+
+        len -= m->m_len;
+        m = m_free(m);
+    }
+
+    sb->sb_mb = m;
+
+    if (!m) {
+        sb->sb_tail = NULL;
+    }
+}
+
+void
+sb_flush(struct sockbuf *sb)
+{
+    struct mbuf *m;
+
+    while ((m = sb->sb_mb)) {
+        sb->sb_mb = m->m_nextpkt;
+        m_freem(m);
+    }
+
+    sb->sb_tail = NULL;
+    sb->sb_cc = 0;
+}
@@ -0,0 +1,86 @@
+/*
+ * mbuf.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _NET_MBUF_H
+#define _NET_MBUF_H
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define MLEN        192     /* bytes stored inside the mbuf itself */
+#define MCLBYTES    2048    /* size of an external cluster */
+
+/* headroom left at the front of a packet for protocol headers */
+#define MAX_HDR     64
+
+#define M_PKTHDR    0x01    /* first mbuf of a packet; m_pktlen is valid */
+#define M_EXT       0x02    /* data lives in a (possibly shared) cluster */
+#define M_LOOP      0x04    /* packet never left the host; skip checksums */
+#define M_ADDR      0x08    /* holds the sender's address of a datagram */
+
+struct mcluster {
+    int                 refs;
+    struct mcluster *   next;       /* free list linkage */
+    uint8_t             buf[MCLBYTES];
+};
+
+/*
+ * packet buffers. Large payloads are kept in reference counted clusters, so
+ * a packet can be handed from the socket layer through IP and back up to the
+ * receiving socket without its payload ever being copied
+ */
+struct mbuf {
+    struct mbuf *       m_next;     /* next buffer of this packet */
+    struct mbuf *       m_nextpkt;  /* next packet in a queue */
+    uint8_t *           m_data;
+    size_t              m_len;
+    int                 m_flags;
+    size_t              m_pktlen;   /* total length of the chain */
+    struct mcluster *   m_ext;
+    uint8_t             m_dat[MLEN];
+};
+
+/* a byte stream or a queue of datagrams waiting on a socket */
+struct sockbuf {
+    struct mbuf *       sb_mb;
+    struct mbuf *       sb_tail;    /* last mbuf (stream) or last packet */
+    size_t              sb_cc;      /* bytes of data buffered */
+    size_t              sb_hiwat;   /* capacity */
+};
+
+#define MTOD(m, t) ((t)((m)->m_data))
+
+#define SB_SPACE(sb) ((sb)->sb_hiwat > (sb)->sb_cc ? (sb)->sb_hiwat - (sb)->sb_cc : 0)
+
+struct mbuf *   m_copym(struct mbuf *, size_t, size_t);
+void            m_adj(struct mbuf *, size_t);
+struct mbuf *   m_free(struct mbuf *);
+void            m_freem(struct mbuf *);
+struct mbuf *   m_fromiov(const struct iovec *, int, size_t, size_t);
+struct mbuf *   m_get(int);
+struct mbuf *   m_getcl(int);
+struct mbuf *   m_prepend(struct mbuf *, size_t);
+struct mbuf *   m_pullup(struct mbuf *, size_t);
+size_t          m_toiov(struct mbuf *, size_t, const struct iovec *, int, size_t, size_t);
+
+void            sb_append(struct sockbuf *, struct mbuf *);
+void            sb_appendpkt(struct sockbuf *, struct mbuf *);
+struct mbuf *   sb_dequeuepkt(struct sockbuf *);
+void            sb_drop(struct sockbuf *, size_t);
+void            sb_flush(struct sockbuf *);
+
+#endif /* _NET_MBUF_H */
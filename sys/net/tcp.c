@@ -0,0 +1,762 @@
+/*
+ * tcp.c - Transmission Control Protocol
+ *
+ * The protocol engine: segment input, output, connection teardown and the
+ * timers. The socket interface lives in tcp_usrreq.c.
+ *
+ * This is written for the loopback interface, which never drops, reorders
+ * or corrupts a segment. There is no retransmission, out of order segments
+ * are discarded and TIME_WAIT is left immediately; anything that could only
+ * happen on a real network is answered with an ACK or RST. Flow control
+ * (the advertised window), Nagle's algorithm and delayed ACKs are handled
+ * as on any other stack, since they govern how efficiently data moves even
+ * between two processes on the same host
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <ds/list.h>
+#include <net/if.h>
+#include <net/inet.h>
+#include <net/mbuf.h>
+#include <net/tcp.h>
+#include <sys/errno.h>
+#include <sys/in.h>
+#include <sys/malloc.h>
+#include <sys/proc.h>
+#include <sys/sched.h>
+#include <sys/types.h>
+
+#define MS_TO_TICKS(ms) ((ms) * sched_hz / 1000)
+
+/* how often the timer thread looks for expired delayed ACKs */
+#define TCP_TIMER_MS    10
+
+struct inpcbtable tcbtable;
+
+static uint32_t tcp_iss_seed;
+
+/* flags every segment sent in a given state carries */
+static const uint8_t tcp_outflags[] = {
+    [TCPS_CLOSED]       = 0,
+    [TCPS_LISTEN]       = 0,
+    [TCPS_SYN_SENT]     = TH_SYN,
+    [TCPS_SYN_RECEIVED] = TH_SYN | TH_ACK,
+    [TCPS_ESTABLISHED]  = TH_ACK,
+    [TCPS_CLOSE_WAIT]   = TH_ACK,
+    [TCPS_FIN_WAIT_1]   = TH_FIN | TH_ACK,
+    [TCPS_CLOSING]      = TH_FIN | TH_ACK,
+    [TCPS_LAST_ACK]     = TH_FIN | TH_ACK,
+    [TCPS_FIN_WAIT_2]   = TH_ACK,
+    [TCPS_TIME_WAIT]    = TH_ACK
+};
+
+uint32_t
+tcp_newiss()
+{
+    tcp_iss_seed += 64000 + sched_ticks;
+
+    return tcp_iss_seed;
+}
+
+/* largest segment the route to the peer can carry */
+size_t
+tcp_mss(struct inpcb *inp)
+{
+    struct ifnet *ifp;
+
+    ifp = if_route(inp->inp_faddr);
+
+    if (!ifp) {
+        return TCP_MSS;
+    }
+
+    return ifp->if_mtu - sizeof(struct ip) - sizeof(struct tcphdr);
+}
+
+struct tcpcb *
+tcp_newtcpcb(struct inpcb *inp)
+{
+    struct tcpcb *tp;
+
+    tp = calloc(1, sizeof(struct tcpcb));
+
+    if (!tp) {
+        return NULL;
+    }
+
+    tp->t_inpcb = inp;
+    tp->t_state = TCPS_CLOSED;
+    tp->t_maxseg = TCP_MSS;
+
+    inp->inp_ppcb = tp;
+
+    return tp;
+}
+
+/*
+ * moves a connection to CLOSED. The pcb is released right away unless a
+ * socket still refers to it, in which case the final close does it
+ */
+struct tcpcb *
+tcp_close(struct tcpcb *tp)
+{
+    struct inpcb *inp;
+    struct tcpcb *child;
+
+    inp = tp->t_inpcb;
+
+    tp->t_state = TCPS_CLOSED;
+    tp->t_flags &= ~(TF_ACKNOW | TF_DELACK);
+
+    in_pcbremove(&tcbtable, inp);
+
+    sb_flush(&inp->inp_snd);
+
+    /* connections nobody accepted go down with their listener */
+    while (list_remove_front(&tp->t_queue, (void**)&child)) {
+        child->t_head = NULL;
+        child->t_inpcb->inp_flags |= INP_DETACHED;
+
+        tcp_drop(child, ECONNABORTED);
+    }
+
+    if (tp->t_head) {
+        list_remove(&tp->t_head->t_queue, tp);
+
+        tp->t_head = NULL;
+        inp->inp_flags |= INP_DETACHED;
+    }
+
+    if ((inp->inp_flags & INP_DETACHED)) {
+        in_pcbfree(&tcbtable, inp);
+        free(tp);
+        return NULL;
+    }
+
+    return tp;
+}
+
+/* aborts a connection, telling the peer with a RST */
+struct tcpcb *
+tcp_drop(struct tcpcb *tp, int error)
+{
+    struct inpcb *inp;
+
+    inp = tp->t_inpcb;
+
+    if (tp->t_state >= TCPS_SYN_RECEIVED) {
+        tcp_respond(inp->inp_laddr, inp->inp_lport, inp->inp_faddr, inp->inp_fport,
+                    tp->snd_nxt, tp->rcv_nxt, TH_RST | TH_ACK);
+    }
+
+    inp->inp_error = error;
+
+    return tcp_close(tp);
+}
+
+/* sends a segment that does not belong to any connection, such as a RST */
+void
+tcp_respond(in_addr_t laddr, in_port_t lport, in_addr_t faddr, in_port_t fport,
+            uint32_t seq, uint32_t ack, int flags)
+{
+    struct mbuf *m;
+    struct tcphdr *th;
+
+    m = m_prepend(NULL, sizeof(struct tcphdr));
+    th = MTOD(m, struct tcphdr*);
+
+    th->th_sport = lport;
+    th->th_dport = fport;
+    th->th_seq = htonl(seq);
+    th->th_ack = htonl(ack);
+    th->th_off = (sizeof(struct tcphdr) >> 2) << 4;
+    th->th_flags = flags;
+    th->th_win = 0;
+    th->th_sum = 0;
+    th->th_urp = 0;
+
+    ip_output(m, laddr, faddr, IPPROTO_TCP);
+}
+
+/*
+ * sends whatever the connection is allowed to send: new data within the
+ * peer's window, SYN or FIN, pending ACKs and window updates
+ */
+int
+tcp_output(struct tcpcb *tp)
+{
+    int flags;
+    int res;
+    bool idle;
+    bool sendalot;
+    size_t hdrlen;
+    size_t len;
+    size_t off;
+    size_t win;
+    int32_t adv;
+    int32_t recvwin;
+    uint8_t *opt;
+
+    struct inpcb *inp;
+    struct mbuf *m;
+    struct sockbuf *snd;
+    struct tcphdr *th;
+
+    inp = tp->t_inpcb;
+    snd = &inp->inp_snd;
+
+    if (tp->t_state == TCPS_CLOSED || tp->t_state == TCPS_LISTEN) {
+        return 0;
+    }
+
+again:
+    sendalot = false;
+    idle = tp->snd_nxt == tp->snd_una;
+    flags = tcp_outflags[tp->t_state];
+    off = tp->snd_nxt - tp->snd_una;
+    win = tp->snd_wnd < snd->sb_cc ? tp->snd_wnd : snd->sb_cc;
+    len = win > off ? win - off : 0;
+
+    if ((flags & TH_SYN)) {
+        if (tp->snd_nxt != tp->iss) {
+            flags &= ~TH_SYN;
+        }
+
+        len = 0;
+    }
+
+    if (len > tp->t_maxseg) {
+        len = tp->t_maxseg;
+        sendalot = true;
+    }
+
+    /* the FIN goes out with, or after, the last byte of data */
+    if ((flags & TH_FIN) && ((tp->t_flags & TF_SENTFIN) || off + len < snd->sb_cc)) {
+        flags &= ~TH_FIN;
+    }
+
+    recvwin = SB_SPACE(&inp->inp_rcv);
+
+    if (recvwin > TCP_MAXWIN) {
+        recvwin = TCP_MAXWIN;
+    }
+
+    /* never shrink a window that has already been offered */
+    if (recvwin < (int32_t)(tp->rcv_adv - tp->rcv_nxt)) {
+        recvwin = tp->rcv_adv - tp->rcv_nxt;
+    }
+
+    if (len > 0) {
+        if (len == tp->t_maxseg) {
+            goto send;
+        }
+
+        /*
+         * Nagle: a partial segment waits while earlier data is still
+         * unacknowledged, unless the application turned this off or is
+         * closing the connection
+         */
+        if ((idle || (tp->t_flags & TF_NODELAY) || tp->t_state >= TCPS_FIN_WAIT_1) &&
+            off + len >= snd->sb_cc) {
+            goto send;
+        }
+
+        /* the peer's window is what's holding us back */
+        if (tp->snd_wnd > 0 && len >= tp->snd_wnd / 2) {
+            goto send;
+        }
+    }
+
+    if ((flags & (TH_SYN | TH_FIN)) || (tp->t_flags & TF_ACKNOW)) {
+        goto send;
+    }
+
+    /* tell the peer once the application has drained a useful amount */
+    if (tp->t_state >= TCPS_ESTABLISHED && !TCPS_HAVERCVDFIN(tp->t_state)) {
+        adv = recvwin - (int32_t)(tp->rcv_adv - tp->rcv_nxt);
+
+        if (adv >= (int32_t)(2 * tp->t_maxseg) || adv >= (int32_t)(inp->inp_rcv.sb_hiwat / 2)) {
+            goto send;
+        }
+    }
+
+    return 0;
+
+send:
+    hdrlen = sizeof(struct tcphdr) + ((flags & TH_SYN) ? 4 : 0);
+
+    m = len > 0 ? m_copym(snd->sb_mb, off, len) : NULL;
+    m = m_prepend(m, hdrlen);
+
+    th = MTOD(m, struct tcphdr*);
+
+    th->th_sport = inp->inp_lport;
+    th->th_dport = inp->inp_fport;
+    th->th_seq = htonl(tp->snd_nxt);
+    th->th_ack = (flags & TH_ACK) ? htonl(tp->rcv_nxt) : 0;
+    th->th_off = (hdrlen >> 2) << 4;
+    th->th_flags = flags;
+    th->th_win = htons(recvwin);
+    th->th_urp = 0;
+
+    /* lo is the only interface and checksums are not used on it */
+    th->th_sum = 0;
+
+    if (len > 0 && off + len == snd->sb_cc) {
+        th->th_flags |= TH_PUSH;
+    }
+
+    if ((flags & TH_SYN)) {
+        opt = (uint8_t*)(th + 1);
+        opt[0] = TCPOPT_MAXSEG;
+        opt[1] = 4;
+        opt[2] = tcp_mss(inp) >> 8;
+        opt[3] = tcp_mss(inp) & 0xFF;
+
+        tp->snd_nxt++;
+    }
+
+    tp->snd_nxt += len;
+
+    if ((flags & TH_FIN)) {
+        tp->snd_nxt++;
+        tp->t_flags |= TF_SENTFIN;
+    }
+
+    if (SEQ_GT(tp->rcv_nxt + recvwin, tp->rcv_adv)) {
+        tp->rcv_adv = tp->rcv_nxt + recvwin;
+    }
+
+    /* whatever was pending rides along with this segment */
+    tp->t_flags &= ~(TF_ACKNOW | TF_DELACK);
+    tp->t_unacked = 0;
+
+    res = ip_output(m, inp->inp_laddr, inp->inp_faddr, IPPROTO_TCP);
+
+    if (res != 0) {
+        return res;
+    }
+
+    if (sendalot) {
+        goto again;
+    }
+
+    return 0;
+}
+
+/* the MSS option of a SYN, if present */
+static size_t
+tcp_getmss(struct tcphdr *th, size_t hlen)
+{
+    size_t cnt;
+    size_t optlen;
+    uint8_t *cp;
+
+    cp = (uint8_t*)(th + 1);
+    cnt = hlen - sizeof(struct tcphdr);
+
+    while (cnt > 0 && cp[0] != TCPOPT_EOL) {
+        if (cp[0] == TCPOPT_NOP) {
+            optlen = 1;
+        } else {
+            if (cnt < 2 || cp[1] < 2 || cp[1] > cnt) {
+                break;
+            }
+
+            optlen = cp[1];
+
+            if (cp[0] == TCPOPT_MAXSEG && optlen == 4) {
+                return (cp[2] << 8) | cp[3];
+            }
+        }
+
+        cp += optlen;
+        cnt -= optlen;
+    }
+
+    return TCP_MSS;
+}
+
+/*
+ * an embryonic connection for a SYN that arrived on a listening socket, or
+ * NULL if there is no memory for one
+ */
+static struct tcpcb *
+tcp_newconn(struct tcpcb *head, in_addr_t src, in_port_t sport, in_addr_t dst, in_port_t dport)
+{
+    struct inpcb *inp;
+    struct inpcb *head_inp;
+    struct tcpcb *tp;
+
+    head_inp = head->t_inpcb;
+
+    inp = in_pcballoc();
+
+    if (!inp) {
+        return NULL;
+    }
+
+    inp->inp_laddr = dst;
+    inp->inp_lport = dport;
+    inp->inp_faddr = src;
+    inp->inp_fport = sport;
+    inp->inp_flags = head_inp->inp_flags & INP_REUSEADDR;
+    inp->inp_rcv.sb_hiwat = head_inp->inp_rcv.sb_hiwat;
+    inp->inp_snd.sb_hiwat = head_inp->inp_snd.sb_hiwat;
+
+    tp = tcp_newtcpcb(inp);
+
+    if (!tp) {
+        free(inp);
+        return NULL;
+    }
+
+    tp->t_flags = head->t_flags & (TF_NODELAY | TF_QUICKACK);
+    tp->t_head = head;
+
+    tp->iss = tcp_newiss();
+    tp->snd_una = tp->iss;
+    tp->snd_nxt = tp->iss;
+
+    list_append(&head->t_queue, tp);
+    in_pcbinsert(&tcbtable, inp);
+
+    return tp;
+}
+
+void
+tcp_input(struct mbuf *m, in_addr_t src, in_addr_t dst)
+{
+    int flags;
+    bool ourfinisacked;
+    size_t acked;
+    size_t hlen;
+    size_t mss;
+    size_t tlen;
+    uint32_t ack;
+    uint32_t seq;
+    uint32_t win;
+    in_port_t dport;
+    in_port_t sport;
+
+    struct inpcb *inp;
+    struct tcpcb *tp;
+    struct tcphdr *th;
+
+    m = m_pullup(m, sizeof(struct tcphdr));
+
+    if (!m) {
+        return;
+    }
+
+    th = MTOD(m, struct tcphdr*);
+    hlen = (th->th_off >> 4) << 2;
+
+    if (hlen < sizeof(struct tcphdr) || hlen > m->m_pktlen) {
+        m_freem(m);
+        return;
+    }
+
+    m = m_pullup(m, hlen);
+
+    if (!m) {
+        return;
+    }
+
+    th = MTOD(m, struct tcphdr*);
+
+    flags = th->th_flags;
+    seq = ntohl(th->th_seq);
+    ack = ntohl(th->th_ack);
+    win = ntohs(th->th_win);
+    sport = th->th_sport;
+    dport = th->th_dport;
+    mss = (flags & TH_SYN) ? tcp_getmss(th, hlen) : TCP_MSS;
+    tlen = m->m_pktlen - hlen;
+
+    m_adj(m, hlen);
+
+    inp = in_pcblookup(&tcbtable, src, sport, dst, dport, true);
+
+    if (!inp) {
+        goto dropwithreset;
+    }
+
+    tp = INTOTCPCB(inp);
+
+    switch (tp->t_state) {
+        case TCPS_CLOSED:
+            goto dropwithreset;
+        case TCPS_LISTEN:
+            if ((flags & TH_RST)) {
+                goto drop;
+            }
+
+            if ((flags & TH_ACK)) {
+                goto dropwithreset;
+            }
+
+            if (!(flags & TH_SYN)) {
+                goto drop;
+            }
+
+            /* nothing retransmits the SYN, so refuse rather than ignore it */
+            if (LIST_SIZE(&tp->t_queue) >= tp->t_qlimit) {
+                goto dropwithreset;
+            }
+
+            tp = tcp_newconn(tp, src, sport, dst, dport);
+
+            /* out of memory; refuse for the same reason as a full queue */
+            if (!tp) {
+                goto dropwithreset;
+            }
+
+            tp->t_state = TCPS_SYN_RECEIVED;
+            tp->t_maxseg = mss < tcp_mss(tp->t_inpcb) ? mss : tcp_mss(tp->t_inpcb);
+            tp->irs = seq;
+            tp->rcv_nxt = seq + 1;
+            tp->rcv_adv = tp->rcv_nxt;
+            tp->snd_wnd = win;
+
+            tcp_output(tp);
+
+            goto drop;
+        case TCPS_SYN_SENT:
+            if ((flags & TH_ACK) && ack != tp->iss + 1) {
+                goto dropwithreset;
+            }
+
+            if ((flags & TH_RST)) {
+                if ((flags & TH_ACK)) {
+                    inp->inp_error = ECONNREFUSED;
+                    tp = tcp_close(tp);
+                }
+
+                goto drop;
+            }
+
+            /* simultaneous open is not supported */
+            if (!(flags & TH_SYN) || !(flags & TH_ACK)) {
+                goto drop;
+            }
+
+            tp->t_state = TCPS_ESTABLISHED;
+            tp->t_maxseg = mss < tcp_mss(inp) ? mss : tcp_mss(inp);
+            tp->t_flags |= TF_ACKNOW;
+            tp->irs = seq;
+            tp->rcv_nxt = seq + 1;
+            tp->rcv_adv = tp->rcv_nxt;
+            tp->snd_una = ack;
+            tp->snd_wnd = win;
+
+            tcp_output(tp);
+
+            goto drop;
+    }
+
+    if ((flags & TH_RST)) {
+        inp->inp_error = tp->t_state == TCPS_CLOSE_WAIT ? EPIPE : ECONNRESET;
+        tp = tcp_close(tp);
+        goto drop;
+    }
+
+    if ((flags & TH_SYN) || !(flags & TH_ACK)) {
+        goto drop;
+    }
+
+    /* anything not starting at rcv_nxt is a duplicate; keep only the ACK */
+    if ((tlen > 0 || (flags & TH_FIN)) && seq != tp->rcv_nxt) {
+        tp->t_flags |= TF_ACKNOW;
+        flags &= ~TH_FIN;
+        tlen = 0;
+    }
+
+    if (SEQ_GT(ack, tp->snd_nxt)) {
+        tp->t_flags |= TF_ACKNOW;
+        goto dropafterack;
+    }
+
+    if (tp->t_state == TCPS_SYN_RECEIVED) {
+        if (ack != tp->iss + 1) {
+            goto dropwithreset;
+        }
+
+        /* accept() will now pick it up */
+        tp->t_state = TCPS_ESTABLISHED;
+    }
+
+    ourfinisacked = false;
+
+    if (SEQ_GT(ack, tp->snd_una)) {
+        acked = ack - tp->snd_una;
+
+        /* the SYN and FIN take up sequence space but not buffer space */
+        if (tp->snd_una == tp->iss) {
+            acked--;
+        }
+
+        if ((tp->t_flags & TF_SENTFIN) && ack == tp->snd_nxt) {
+            acked--;
+            ourfinisacked = true;
+        }
+
+        sb_drop(&inp->inp_snd, acked);
+
+        tp->snd_una = ack;
+    }
+
+    tp->snd_wnd = win;
+
+    if (ourfinisacked) {
+        switch (tp->t_state) {
+            case TCPS_FIN_WAIT_1:
+                tp->t_state = TCPS_FIN_WAIT_2;
+                tp->t_timer = sched_ticks + MS_TO_TICKS(TCP_FINWAIT2_MS);
+                break;
+            case TCPS_CLOSING:
+            case TCPS_LAST_ACK:
+                tp = tcp_close(tp);
+                goto drop;
+        }
+    }
+
+    if (tlen > 0) {
+        switch (tp->t_state) {
+            case TCPS_ESTABLISHED:
+            case TCPS_FIN_WAIT_1:
+            case TCPS_FIN_WAIT_2:
+                break;
+            default:
+                tlen = 0;
+                break;
+        }
+    }
+
+    if (tlen > 0) {
+        /* nobody is left to read it */
+        if ((inp->inp_flags & INP_DETACHED)) {
+            tp = tcp_drop(tp, 0);
+            goto drop;
+        }
+
+        sb_append(&inp->inp_rcv, m);
+
+        m = NULL;
+
+        tp->rcv_nxt += tlen;
+
+        /* acknowledge every other segment, hold back the rest */
+        if ((tp->t_flags & TF_QUICKACK) || ++tp->t_unacked >= 2) {
+            tp->t_flags |= TF_ACKNOW;
+        } else if (!(tp->t_flags & TF_DELACK)) {
+            tp->t_flags |= TF_DELACK;
+            tp->t_delack = sched_ticks + MS_TO_TICKS(TCP_DELACK_MS);
+        }
+    }
+
+    if ((flags & TH_FIN)) {
+        tp->rcv_nxt++;
+        tp->t_flags |= TF_ACKNOW;
+
+        switch (tp->t_state) {
+            case TCPS_ESTABLISHED:
+                tp->t_state = TCPS_CLOSE_WAIT;
+                break;
+            case TCPS_FIN_WAIT_1:
+                tp->t_state = TCPS_CLOSING;
+                break;
+            case TCPS_FIN_WAIT_2:
+                /* nothing can still be in flight, so skip TIME_WAIT */
+                tp->t_state = TCPS_TIME_WAIT;
+                tcp_output(tp);
+                tp = tcp_close(tp);
+                goto drop;
+        }
+    }
+
+dropafterack:
+    tcp_output(tp);
+drop:
+    m_freem(m);
+    return;
+
+dropwithreset:
+    if (!(flags & TH_RST)) {
+        if ((flags & TH_ACK)) {
+            tcp_respond(dst, dport, src, sport, ack, 0, TH_RST);
+        } else {
+            tcp_respond(dst, dport, src, sport, 0, seq + tlen + ((flags & TH_SYN) ? 1 : 0),
+                        TH_RST | TH_ACK);
+        }
+    }
+
+    m_freem(m);
+}
+
+/* sends held back ACKs and reaps orphaned connections */
+static void
+tcp_timers()
+{
+    struct inpcb *inp;
+    struct inpcb *next;
+    struct tcpcb *tp;
+
+    for (inp = tcbtable.ipt_head; inp; inp = next) {
+        next = inp->inp_next;
+        tp = INTOTCPCB(inp);
+
+        if ((tp->t_flags & TF_DELACK) && (int32_t)(sched_ticks - tp->t_delack) >= 0) {
+            tp->t_flags |= TF_ACKNOW;
+            tcp_output(tp);
+        }
+
+        if (tp->t_state == TCPS_FIN_WAIT_2 && (inp->inp_flags & INP_DETACHED) &&
+            (int32_t)(sched_ticks - tp->t_timer) >= 0) {
+            tcp_close(tp);
+        }
+    }
+}
+
+static int
+tcp_timer_thread(void *argp)
+{
+    uint32_t next;
+
+    next = 0;
+
+    for (;;) {
+        thread_yield();
+
+        if ((int32_t)(sched_ticks - next) < 0) {
+            continue;
+        }
+
+        next = sched_ticks + MS_TO_TICKS(TCP_TIMER_MS);
+
+        /* segments sent from here are delivered by net_unlock() */
+        net_lock();
+        tcp_timers();
+        net_unlock();
+    }
+
+    return 0;
+}
+
+void
+tcp_init()
+{
+    thread_run(tcp_timer_thread, NULL, NULL);
+}
@@ -0,0 +1,125 @@
+/*
+ * tcp.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _NET_TCP_H
+#define _NET_TCP_H
+
+#include <ds/list.h>
+#include <net/inet.h>
+#include <net/mbuf.h>
+#include <sys/in.h>
+#include <sys/types.h>
+
+struct tcphdr {
+    in_port_t           th_sport;
+    in_port_t           th_dport;
+    uint32_t            th_seq;
+    uint32_t            th_ack;
+    uint8_t             th_off;     /* data offset in words << 4 */
+    uint8_t             th_flags;
+    uint16_t            th_win;
+    uint16_t            th_sum;
+    uint16_t            th_urp;
+} __attribute__((packed));
+
+#define TH_FIN          0x01
+#define TH_SYN          0x02
+#define TH_RST          0x04
+#define TH_PUSH         0x08
+#define TH_ACK          0x10
+
+#define TCPOPT_EOL      0
+#define TCPOPT_NOP      1
+#define TCPOPT_MAXSEG   2
+
+#define TCP_MSS         536     /* used when the peer sends no MSS option */
+#define TCP_MAXWIN      65535   /* no window scaling */
+#define TCP_SENDSPACE   (64*1024)
+#define TCP_RECVSPACE   TCP_MAXWIN
+
+/* how long an ACK may be held back waiting for data to piggyback on */
+#define TCP_DELACK_MS   40
+
+/* how long an orphaned connection may sit in FIN_WAIT_2 */
+#define TCP_FINWAIT2_MS 60000
+
+#define TCPS_CLOSED         0
+#define TCPS_LISTEN         1
+#define TCPS_SYN_SENT       2
+#define TCPS_SYN_RECEIVED   3
+#define TCPS_ESTABLISHED    4
+#define TCPS_CLOSE_WAIT     5
+#define TCPS_FIN_WAIT_1     6
+#define TCPS_CLOSING        7
+#define TCPS_LAST_ACK       8
+#define TCPS_FIN_WAIT_2     9
+#define TCPS_TIME_WAIT      10
+
+/* the peer has sent its FIN; nothing more will arrive */
+#define TCPS_HAVERCVDFIN(s) ((s) == TCPS_CLOSE_WAIT || ((s) >= TCPS_CLOSING && (s) != TCPS_FIN_WAIT_2))
+
+#define TF_ACKNOW       0x01    /* send an ACK as soon as possible */
+#define TF_DELACK       0x02    /* an ACK is being held back */
+#define TF_NODELAY      0x04    /* TCP_NODELAY */
+#define TF_QUICKACK     0x08    /* TCP_QUICKACK */
+#define TF_SENTFIN      0x10
+
+#define SEQ_LT(a, b)    ((int32_t)((a) - (b)) < 0)
+#define SEQ_LEQ(a, b)   ((int32_t)((a) - (b)) <= 0)
+#define SEQ_GT(a, b)    ((int32_t)((a) - (b)) > 0)
+#define SEQ_GEQ(a, b)   ((int32_t)((a) - (b)) >= 0)
+
+struct tcpcb {
+    struct inpcb *      t_inpcb;
+    int                 t_state;
+    int                 t_flags;
+    size_t              t_maxseg;
+    uint32_t            t_delack;   /* tick at which a held back ACK is sent */
+    uint32_t            t_timer;    /* FIN_WAIT_2 timeout of an orphaned connection */
+    int                 t_unacked;  /* segments received since the last ACK */
+
+    /* listening sockets; pending and completed connections */
+    struct tcpcb *      t_head;
+    struct list         t_queue;
+    int                 t_qlimit;
+
+    /* send sequence space */
+    uint32_t            iss;
+    uint32_t            snd_una;
+    uint32_t            snd_nxt;
+    uint32_t            snd_wnd;
+
+    /* receive sequence space */
+    uint32_t            irs;
+    uint32_t            rcv_nxt;
+    uint32_t            rcv_adv;    /* right edge of the advertised window */
+};
+
+#define INTOTCPCB(inp) ((struct tcpcb*)(inp)->inp_ppcb)
+
+extern struct inpcbtable tcbtable;
+
+struct tcpcb *  tcp_close(struct tcpcb *);
+struct tcpcb *  tcp_drop(struct tcpcb *, int);
+void            tcp_input(struct mbuf *, in_addr_t, in_addr_t);
+size_t          tcp_mss(struct inpcb *);
+uint32_t        tcp_newiss();
+struct tcpcb *  tcp_newtcpcb(struct inpcb *);
+int             tcp_output(struct tcpcb *);
+void            tcp_respond(in_addr_t, in_port_t, in_addr_t, in_port_t, uint32_t, uint32_t, int);
+
+#endif /* _NET_TCP_H */
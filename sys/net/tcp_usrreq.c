@@ -0,0 +1,600 @@
+/*
+ * tcp_usrreq.c - TCP socket interface
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <ds/list.h>
+#include <net/if.h>
+#include <net/inet.h>
+#include <net/mbuf.h>
+#include <net/tcp.h>
+#include <sys/errno.h>
+#include <sys/fcntl.h>
+#include <sys/in.h>
+#include <sys/ioctl.h>
+#include <sys/malloc.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+static int tcp_usr_accept(struct socket *, struct socket **, void *, size_t *, int);
+static int tcp_usr_bind(struct socket *, void *, size_t);
+static int tcp_usr_close(struct socket *);
+static int tcp_usr_connect(struct socket *, void *, size_t, int);
+static int tcp_usr_duplicate(struct socket *);
+static int tcp_usr_getsockopt(struct socket *, int, int, void *, size_t *);
+static int tcp_usr_init(struct socket *, int, int);
+static int tcp_usr_ioctl(struct socket *, uint64_t, void *);
+static int tcp_usr_listen(struct socket *, int);
+static size_t tcp_usr_recv(struct socket *, const struct iovec *, int, int);
+static size_t tcp_usr_send(struct socket *, const struct iovec *, int, int);
+static int tcp_usr_setsockopt(struct socket *, int, int, const void *, size_t);
+
+struct socket_ops tcp_ops = {
+    .accept     = tcp_usr_accept,
+    .bind       = tcp_usr_bind,
+    .close      = tcp_usr_close,
+    .connect    = tcp_usr_connect,
+    .duplicate  = tcp_usr_duplicate,
+    .getsockopt = tcp_usr_getsockopt,
+    .init       = tcp_usr_init,
+    .ioctl      = tcp_usr_ioctl,
+    .listen     = tcp_usr_listen,
+    .recv       = tcp_usr_recv,
+    .send       = tcp_usr_send,
+    .setsockopt = tcp_usr_setsockopt
+};
+
+struct protocol tcp_protocol = {
+    .address_family = AF_INET,
+    .ops            = &tcp_ops
+};
+
+static struct tcpcb *
+tcp_first_completed(struct tcpcb *head)
+{
+    list_iter_t iter;
+    struct tcpcb *tp;
+    struct tcpcb *match;
+
+    match = NULL;
+
+    list_get_iter(&head->t_queue, &iter);
+
+    while (iter_move_next(&iter, (void**)&tp)) {
+        if (tp->t_state != TCPS_SYN_RECEIVED) {
+            match = tp;
+            break;
+        }
+    }
+
+    iter_close(&iter);
+
+    return match;
+}
+
+static int
+tcp_usr_accept(struct socket *sock, struct socket **result, void *address, size_t *address_len, int flags)
+{
+    int res;
+    struct inpcb *inp;
+    struct socket *client;
+    struct tcpcb *head;
+    struct tcpcb *tp;
+
+    head = INTOTCPCB((struct inpcb*)sock->state);
+
+    net_lock();
+
+    if (head->t_state != TCPS_LISTEN) {
+        res = -(EINVAL);
+        goto out;
+    }
+
+    while (!(tp = tcp_first_completed(head))) {
+        res = net_wait(flags);
+
+        if (res != 0) {
+            goto out;
+        }
+    }
+
+    /* allocated first so that on failure the connection stays queued */
+    client = calloc(1, sizeof(struct socket));
+
+    if (!client) {
+        res = -(ENOBUFS);
+        goto out;
+    }
+
+    list_remove(&head->t_queue, tp);
+
+    tp->t_head = NULL;
+    inp = tp->t_inpcb;
+
+    client->protocol = &tcp_protocol;
+    client->type = SOCK_STREAM;
+    client->state = inp;
+
+    in_setsockaddr(inp->inp_faddr, inp->inp_fport, address, address_len);
+
+    *result = client;
+    res = 0;
+
+out:
+    net_unlock();
+
+    return res;
+}
+
+static int
+tcp_usr_bind(struct socket *sock, void *address, size_t address_len)
+{
+    int res;
+    struct inpcb *inp;
+    struct sockaddr_in sin;
+
+    inp = sock->state;
+
+    res = in_getsockaddr(&sin, address, address_len);
+
+    if (res != 0) {
+        return res;
+    }
+
+    net_lock();
+
+    res = in_pcbbind(&tcbtable, inp, &sin);
+
+    net_unlock();
+
+    return res;
+}
+
+static int
+tcp_usr_close(struct socket *sock)
+{
+    struct inpcb *inp;
+    struct tcpcb *tp;
+
+    if (--sock->refs > 0) {
+        return 0;
+    }
+
+    inp = sock->state;
+    tp = INTOTCPCB(inp);
+
+    net_lock();
+
+    inp->inp_flags |= INP_DETACHED;
+
+    switch (tp->t_state) {
+        case TCPS_ESTABLISHED:
+        case TCPS_CLOSE_WAIT:
+            /* unread data is lost; let the peer know instead of a FIN */
+            if (inp->inp_rcv.sb_cc > 0) {
+                tcp_drop(tp, 0);
+                break;
+            }
+
+            if (tp->t_state == TCPS_ESTABLISHED) {
+                tp->t_state = TCPS_FIN_WAIT_1;
+            } else {
+                tp->t_state = TCPS_LAST_ACK;
+            }
+
+            tcp_output(tp);
+            break;
+        default:
+            tcp_close(tp);
+            break;
+    }
+
+    net_unlock();
+
+    free(sock);
+
+    return 0;
+}
+
+static int
+tcp_usr_connect(struct socket *sock, void *address, size_t address_len, int flags)
+{
+    int res;
+    struct inpcb *inp;
+    struct sockaddr_in sin;
+    struct tcpcb *tp;
+
+    inp = sock->state;
+    tp = INTOTCPCB(inp);
+
+    res = in_getsockaddr(&sin, address, address_len);
+
+    if (res != 0) {
+        return res;
+    }
+
+    net_lock();
+
+    if (tp->t_state == TCPS_SYN_SENT) {
+        res = -(EALREADY);
+        goto out;
+    }
+
+    if (tp->t_state != TCPS_CLOSED || inp->inp_faddr != INADDR_ANY) {
+        res = tp->t_state == TCPS_LISTEN ? -(EOPNOTSUPP) : -(EISCONN);
+        goto out;
+    }
+
+    res = in_pcbconnect(&tcbtable, inp, &sin);
+
+    if (res != 0) {
+        goto out;
+    }
+
+    tp->t_state = TCPS_SYN_SENT;
+    tp->iss = tcp_newiss();
+    tp->snd_una = tp->iss;
+    tp->snd_nxt = tp->iss;
+
+    tcp_output(tp);
+
+    /* on loopback this runs the entire handshake */
+    lo_dispatch();
+
+    while (tp->t_state == TCPS_SYN_SENT) {
+        if ((flags & O_NONBLOCK)) {
+            res = -(EINPROGRESS);
+            goto out;
+        }
+
+        res = net_wait(flags);
+
+        if (res != 0) {
+            goto out;
+        }
+    }
+
+    if (tp->t_state == TCPS_CLOSED) {
+        res = inp->inp_error ? -(inp->inp_error) : -(ECONNREFUSED);
+        inp->inp_error = 0;
+    }
+
+out:
+    net_unlock();
+
+    return res;
+}
+
+static int
+tcp_usr_duplicate(struct socket *sock)
+{
+    sock->refs++;
+
+    return 0;
+}
+
+static int
+tcp_usr_getsockopt(struct socket *sock, int level, int name, void *val, size_t *len)
+{
+    int res;
+    struct inpcb *inp;
+    struct tcpcb *tp;
+
+    inp = sock->state;
+    tp = INTOTCPCB(inp);
+
+    if (level != IPPROTO_TCP) {
+        return in_getopt(inp, level, name, val, len);
+    }
+
+    if (*len < sizeof(int)) {
+        return -(EINVAL);
+    }
+
+    switch (name) {
+        case TCP_MAXSEG:
+            res = tp->t_maxseg;
+            break;
+        case TCP_NODELAY:
+            res = (tp->t_flags & TF_NODELAY) != 0;
+            break;
+        case TCP_QUICKACK:
+            res = (tp->t_flags & TF_QUICKACK) != 0;
+            break;
+        default:
+            return -(ENOPROTOOPT);
+    }
+
+    *(int*)val = res;
+    *len = sizeof(int);
+
+    return 0;
+}
+
+static int
+tcp_usr_init(struct socket *sock, int type, int protocol)
+{
+    struct inpcb *inp;
+
+    inp = in_pcballoc();
+
+    if (!inp) {
+        return -(ENOBUFS);
+    }
+
+    inp->inp_rcv.sb_hiwat = TCP_RECVSPACE;
+    inp->inp_snd.sb_hiwat = TCP_SENDSPACE;
+
+    if (!tcp_newtcpcb(inp)) {
+        free(inp);
+        return -(ENOBUFS);
+    }
+
+    sock->state = inp;
+
+    return 0;
+}
+
+static int
+tcp_usr_ioctl(struct socket *sock, uint64_t request, void *argp)
+{
+    struct inpcb *inp;
+
+    inp = sock->state;
+
+    switch (request) {
+        case FIONREAD:
+            *((uint32_t*)argp) = inp->inp_rcv.sb_cc;
+            return 0;
+        case FIONSPACE:
+            *((uint32_t*)argp) = SB_SPACE(&inp->inp_snd);
+            return 0;
+    }
+
+    return -(ENOTSUP);
+}
+
+static int
+tcp_usr_listen(struct socket *sock, int backlog)
+{
+    int res;
+    struct inpcb *inp;
+    struct tcpcb *tp;
+
+    inp = sock->state;
+    tp = INTOTCPCB(inp);
+
+    net_lock();
+
+    res = 0;
+
+    if (tp->t_state != TCPS_CLOSED && tp->t_state != TCPS_LISTEN) {
+        res = -(EINVAL);
+        goto out;
+    }
+
+    if (inp->inp_lport == 0) {
+        res = in_pcbbind(&tcbtable, inp, NULL);
+
+        if (res != 0) {
+            goto out;
+        }
+    }
+
+    if (backlog < 1) {
+        backlog = 1;
+    }
+
+    if (backlog > SOMAXCONN) {
+        backlog = SOMAXCONN;
+    }
+
+    tp->t_qlimit = backlog;
+    tp->t_state = TCPS_LISTEN;
+
+out:
+    net_unlock();
+
+    return res;
+}
+
+static size_t
+tcp_usr_recv(struct socket *sock, const struct iovec *iov, int iovcnt, int flags)
+{
+    int res;
+    size_t len;
+    size_t total;
+    struct inpcb *inp;
+    struct tcpcb *tp;
+
+    inp = sock->state;
+    tp = INTOTCPCB(inp);
+    total = iov_length(iov, iovcnt);
+
+    net_lock();
+
+    while (inp->inp_rcv.sb_cc == 0) {
+        if (total == 0) {
+            res = 0;
+            goto out;
+        }
+
+        if (inp->inp_error) {
+            res = -(inp->inp_error);
+            inp->inp_error = 0;
+            goto out;
+        }
+
+        if (tp->t_state == TCPS_CLOSED || TCPS_HAVERCVDFIN(tp->t_state)) {
+            res = 0;
+            goto out;
+        }
+
+        if (tp->t_state < TCPS_ESTABLISHED) {
+            res = -(ENOTCONN);
+            goto out;
+        }
+
+        res = net_wait(flags);
+
+        if (res != 0) {
+            goto out;
+        }
+    }
+
+    len = inp->inp_rcv.sb_cc < total ? inp->inp_rcv.sb_cc : total;
+    len = m_toiov(inp->inp_rcv.sb_mb, 0, iov, iovcnt, 0, len);
+
+    sb_drop(&inp->inp_rcv, len);
+
+    res = len;
+
+    /* the window may have opened up enough to be worth announcing */
+    tcp_output(tp);
+
+out:
+    net_unlock();
+
+    return res;
+}
+
+static size_t
+tcp_usr_send(struct socket *sock, const struct iovec *iov, int iovcnt, int flags)
+{
+    int res;
+    size_t chunk;
+    size_t sent;
+    size_t space;
+    size_t total;
+    struct inpcb *inp;
+    struct tcpcb *tp;
+
+    inp = sock->state;
+    tp = INTOTCPCB(inp);
+    total = iov_length(iov, iovcnt);
+    sent = 0;
+
+    net_lock();
+
+    for (;;) {
+        if (tp->t_state != TCPS_ESTABLISHED && tp->t_state != TCPS_CLOSE_WAIT) {
+            if (sent > 0) {
+                res = sent;
+            } else if (inp->inp_error) {
+                res = -(inp->inp_error);
+                inp->inp_error = 0;
+            } else {
+                res = tp->t_state < TCPS_ESTABLISHED ? -(ENOTCONN) : -(EPIPE);
+            }
+
+            break;
+        }
+
+        if (sent == total) {
+            res = sent;
+            break;
+        }
+
+        space = SB_SPACE(&inp->inp_snd);
+
+        if (space == 0) {
+            if (sent > 0 && (flags & O_NONBLOCK)) {
+                res = sent;
+                break;
+            }
+
+            res = net_wait(flags);
+
+            if (res != 0) {
+                res = sent > 0 ? (int)sent : res;
+                break;
+            }
+
+            continue;
+        }
+
+        chunk = total - sent < space ? total - sent : space;
+
+        sb_append(&inp->inp_snd, m_fromiov(iov, iovcnt, sent, chunk));
+
+        sent += chunk;
+
+        tcp_output(tp);
+    }
+
+    net_unlock();
+
+    return res;
+}
+
+static int
+tcp_usr_setsockopt(struct socket *sock, int level, int name, const void *val, size_t len)
+{
+    int arg;
+    int flag;
+    struct inpcb *inp;
+    struct tcpcb *tp;
+
+    inp = sock->state;
+    tp = INTOTCPCB(inp);
+
+    if (level != IPPROTO_TCP) {
+        return in_setopt(inp, level, name, val, len);
+    }
+
+    if (len < sizeof(int)) {
+        return -(EINVAL);
+    }
+
+    arg = *(const int*)val;
+
+    switch (name) {
+        case TCP_MAXSEG:
+            if (arg < 64 || arg > (int)tcp_mss(inp)) {
+                return -(EINVAL);
+            }
+
+            tp->t_maxseg = arg;
+            return 0;
+        case TCP_NODELAY:
+            flag = TF_NODELAY;
+            break;
+        case TCP_QUICKACK:
+            flag = TF_QUICKACK;
+            break;
+        default:
+            return -(ENOPROTOOPT);
+    }
+
+    net_lock();
+
+    if (arg) {
+        tp->t_flags |= flag;
+
+        /* push out whatever the option was holding back */
+        if ((tp->t_flags & TF_DELACK) && flag == TF_QUICKACK) {
+            tp->t_flags |= TF_ACKNOW;
+        }
+
+        tcp_output(tp);
+    } else {
+        tp->t_flags &= ~flag;
+    }
+
+    net_unlock();
+
+    return 0;
+}
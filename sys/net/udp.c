@@ -0,0 +1,388 @@
+/*
+ * udp.c - User Datagram Protocol
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <net/if.h>
+#include <net/inet.h>
+#include <net/mbuf.h>
+#include <net/udp.h>
+#include <sys/errno.h>
+#include <sys/in.h>
+#include <sys/ioctl.h>
+#include <sys/malloc.h>
+#include <sys/socket.h>
+#include <sys/string.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+static int udp_bind(struct socket *, void *, size_t);
+static int udp_close(struct socket *);
+static int udp_connect(struct socket *, void *, size_t, int);
+static int udp_duplicate(struct socket *);
+static int udp_getsockopt(struct socket *, int, int, void *, size_t *);
+static int udp_init(struct socket *, int, int);
+static int udp_ioctl(struct socket *, uint64_t, void *);
+static size_t udp_recv(struct socket *, const struct iovec *, int, int);
+static size_t udp_recvfrom(struct socket *, const struct iovec *, int, int, void *, size_t *);
+static size_t udp_send(struct socket *, const struct iovec *, int, int);
+static size_t udp_sendto(struct socket *, const struct iovec *, int, int, void *, size_t);
+static int udp_setsockopt(struct socket *, int, int, const void *, size_t);
+
+struct socket_ops udp_ops = {
+    .bind       = udp_bind,
+    .close      = udp_close,
+    .connect    = udp_connect,
+    .duplicate  = udp_duplicate,
+    .getsockopt = udp_getsockopt,
+    .init       = udp_init,
+    .ioctl      = udp_ioctl,
+    .recv       = udp_recv,
+    .recvfrom   = udp_recvfrom,
+    .send       = udp_send,
+    .sendto     = udp_sendto,
+    .setsockopt = udp_setsockopt
+};
+
+struct protocol udp_protocol = {
+    .address_family = AF_INET,
+    .ops            = &udp_ops
+};
+
+struct inpcbtable udbtable;
+
+void
+udp_input(struct mbuf *m, in_addr_t src, in_addr_t dst)
+{
+    size_t len;
+    struct inpcb *inp;
+    struct mbuf *addr;
+    struct udphdr *uh;
+
+    m = m_pullup(m, sizeof(struct udphdr));
+
+    if (!m) {
+        return;
+    }
+
+    uh = MTOD(m, struct udphdr*);
+    len = ntohs(uh->uh_ulen);
+
+    if (len < sizeof(struct udphdr) || len > m->m_pktlen) {
+        goto drop;
+    }
+
+    inp = in_pcblookup(&udbtable, src, uh->uh_sport, dst, uh->uh_dport, true);
+
+    if (!inp) {
+        goto drop;
+    }
+
+    addr = m_get(M_ADDR);
+    len = sizeof(struct sockaddr_in);
+
+    in_setsockaddr(src, uh->uh_sport, addr->m_data, &len);
+
+    addr->m_len = len;
+
+    m_adj(m, sizeof(struct udphdr));
+
+    /* datagrams that don't fit are dropped, not truncated */
+    if (m->m_pktlen > SB_SPACE(&inp->inp_rcv)) {
+        m_free(addr);
+        goto drop;
+    }
+
+    addr->m_next = m;
+
+    sb_appendpkt(&inp->inp_rcv, addr);
+
+    return;
+
+drop:
+    m_freem(m);
+}
+
+static int
+udp_bind(struct socket *sock, void *address, size_t address_len)
+{
+    int res;
+    struct sockaddr_in sin;
+
+    res = in_getsockaddr(&sin, address, address_len);
+
+    if (res != 0) {
+        return res;
+    }
+
+    net_lock();
+
+    res = in_pcbbind(&udbtable, sock->state, &sin);
+
+    net_unlock();
+
+    return res;
+}
+
+static int
+udp_close(struct socket *sock)
+{
+    if (--sock->refs > 0) {
+        return 0;
+    }
+
+    net_lock();
+
+    in_pcbfree(&udbtable, sock->state);
+
+    net_unlock();
+
+    free(sock);
+
+    return 0;
+}
+
+static int
+udp_connect(struct socket *sock, void *address, size_t address_len, int flags)
+{
+    int res;
+    struct sockaddr_in sin;
+
+    res = in_getsockaddr(&sin, address, address_len);
+
+    if (res != 0) {
+        return res;
+    }
+
+    net_lock();
+
+    res = in_pcbconnect(&udbtable, sock->state, &sin);
+
+    net_unlock();
+
+    return res;
+}
+
+static int
+udp_duplicate(struct socket *sock)
+{
+    sock->refs++;
+
+    return 0;
+}
+
+static int
+udp_getsockopt(struct socket *sock, int level, int name, void *val, size_t *len)
+{
+    return in_getopt(sock->state, level, name, val, len);
+}
+
+static int
+udp_init(struct socket *sock, int type, int protocol)
+{
+    struct inpcb *inp;
+
+    inp = in_pcballoc();
+    inp->inp_rcv.sb_hiwat = UDP_RECVSPACE;
+    inp->inp_snd.sb_hiwat = UDP_SENDSPACE;
+
+    sock->state = inp;
+
+    return 0;
+}
+
+static int
+udp_ioctl(struct socket *sock, uint64_t request, void *argp)
+{
+    size_t len;
+    struct inpcb *inp;
+    struct mbuf *m;
+
+    inp = sock->state;
+
+    switch (request) {
+        case FIONREAD:
+            /* size of the next datagram */
+            net_lock();
+
+            len = 0;
+
+            if ((m = inp->inp_rcv.sb_mb)) {
+                for (m = m->m_next; m; m = m->m_next) {
+                    len += m->m_len;
+                }
+            }
+
+            net_unlock();
+
+            *((uint32_t*)argp) = len;
+            return 0;
+        case FIONSPACE:
+            *((uint32_t*)argp) = inp->inp_snd.sb_hiwat;
+            return 0;
+    }
+
+    return -(ENOTSUP);
+}
+
+static size_t
+udp_recv(struct socket *sock, const struct iovec *iov, int iovcnt, int flags)
+{
+    return udp_recvfrom(sock, iov, iovcnt, flags, NULL, NULL);
+}
+
+/* receives one datagram; whatever doesn't fit into iov is discarded */
+static size_t
+udp_recvfrom(struct socket *sock, const struct iovec *iov, int iovcnt, int flags, void *address, size_t *address_len)
+{
+    int res;
+    size_t len;
+    struct inpcb *inp;
+    struct mbuf *addr;
+
+    inp = sock->state;
+
+    net_lock();
+
+    while (!inp->inp_rcv.sb_mb) {
+        res = net_wait(flags);
+
+        if (res != 0) {
+            net_unlock();
+            return res;
+        }
+    }
+
+    addr = sb_dequeuepkt(&inp->inp_rcv);
+
+    net_unlock();
+
+    if (address && address_len) {
+        len = *address_len < addr->m_len ? *address_len : addr->m_len;
+
+        memcpy(address, addr->m_data, len);
+
+        *address_len = addr->m_len;
+    }
+
+    len = m_toiov(addr->m_next, 0, iov, iovcnt, 0, iov_length(iov, iovcnt));
+
+    m_freem(addr);
+
+    return len;
+}
+
+static size_t
+udp_send(struct socket *sock, const struct iovec *iov, int iovcnt, int flags)
+{
+    return udp_sendto(sock, iov, iovcnt, flags, NULL, 0);
+}
+
+static size_t
+udp_sendto(struct socket *sock, const struct iovec *iov, int iovcnt, int flags, void *address, size_t address_len)
+{
+    int res;
+    size_t len;
+    in_addr_t dst;
+    in_addr_t src;
+    in_port_t dport;
+    struct ifnet *ifp;
+    struct inpcb *inp;
+    struct mbuf *m;
+    struct sockaddr_in sin;
+    struct udphdr *uh;
+
+    inp = sock->state;
+    len = iov_length(iov, iovcnt);
+
+    if (address) {
+        res = in_getsockaddr(&sin, address, address_len);
+
+        if (res != 0) {
+            return res;
+        }
+    }
+
+    net_lock();
+
+    if (address) {
+        if (inp->inp_faddr != INADDR_ANY) {
+            res = -(EISCONN);
+            goto out;
+        }
+
+        dst = sin.sin_addr.s_addr ? sin.sin_addr.s_addr : loif.if_addr;
+        dport = sin.sin_port;
+    } else {
+        if (inp->inp_faddr == INADDR_ANY) {
+            res = -(EDESTADDRREQ);
+            goto out;
+        }
+
+        dst = inp->inp_faddr;
+        dport = inp->inp_fport;
+    }
+
+    ifp = if_route(dst);
+
+    if (!ifp) {
+        res = -(ENETUNREACH);
+        goto out;
+    }
+
+    if (len > inp->inp_snd.sb_hiwat ||
+        len + sizeof(struct udphdr) + sizeof(struct ip) > ifp->if_mtu) {
+        res = -(EMSGSIZE);
+        goto out;
+    }
+
+    if (inp->inp_lport == 0) {
+        res = in_pcbbind(&udbtable, inp, NULL);
+
+        if (res != 0) {
+            goto out;
+        }
+    }
+
+    src = inp->inp_laddr != INADDR_ANY ? inp->inp_laddr : ifp->if_addr;
+
+    m = m_fromiov(iov, iovcnt, 0, len);
+    m = m_prepend(m, sizeof(struct udphdr));
+
+    uh = MTOD(m, struct udphdr*);
+    uh->uh_sport = inp->inp_lport;
+    uh->uh_dport = dport;
+    uh->uh_ulen = htons(len + sizeof(struct udphdr));
+
+    /* optional for UDP over IPv4; lo is the only interface */
+    uh->uh_sum = 0;
+
+    res = ip_output(m, src, dst, IPPROTO_UDP);
+
+    if (res == 0) {
+        res = len;
+    }
+
+out:
+    net_unlock();
+
+    return res;
+}
+
+static int
+udp_setsockopt(struct socket *sock, int level, int name, const void *val, size_t len)
+{
+    return in_setopt(sock->state, level, name, val, len);
+}
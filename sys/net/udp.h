@@ -0,0 +1,40 @@
+/*
+ * udp.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _NET_UDP_H
+#define _NET_UDP_H
+
+#include <net/inet.h>
+#include <net/mbuf.h>
+#include <sys/in.h>
+#include <sys/types.h>
+
+struct udphdr {
+    in_port_t           uh_sport;
+    in_port_t           uh_dport;
+    uint16_t            uh_ulen;
+    uint16_t            uh_sum;
+} __attribute__((packed));
+
+#define UDP_SENDSPACE   9216        /* largest datagram that may be sent */
+#define UDP_RECVSPACE   (64*1024)
+
+extern struct inpcbtable udbtable;
+
+void    udp_input(struct mbuf *, in_addr_t, in_addr_t);
+
+#endif /* _NET_UDP_H */
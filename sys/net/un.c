@@ -21,6 +21,8 @@
  */
 #include <ds/list.h>
 #include <sys/errno.h>
+#include <sys/fcntl.h>
+#include <sys/ioctl.h>
 #include <sys/pipe.h>
 #include <sys/proc.h>
 #include <sys/malloc.h>
@@ -32,16 +34,18 @@
 #include <sys/un.h>
 #include <sys/vnode.h>
 
-static int un_accept(struct socket *socket, struct socket **result, void *address, size_t *address_len);
+static int un_accept(struct socket *socket, struct socket **result, void *address, size_t *address_len, int flags);
 static int un_bind(struct socket *socket, void *address, size_t address_len);
 static int un_close(struct socket *sock);
-static int un_connect(struct socket *socket, void *address, size_t address_len);
+static int un_connect(struct socket *socket, void *address, size_t address_len, int flags);
 static int un_destroy(struct socket *sock);
 static int un_duplicate(struct socket *sock);
 static int un_getvn(struct socket *, struct vnode **);
 static int un_init(struct socket *socket, int type, int protocol);
-static size_t un_recv(struct socket *sock, void *buf, size_t size);
-static size_t un_send(struct socket *sock, const void *buf, size_t size);
+static int un_ioctl(struct socket *sock, uint64_t request, void *argp);
+static int un_listen(struct socket *sock, int backlog);
+static size_t un_recv(struct socket *sock, const struct iovec *iov, int iovcnt, int flags);
+static size_t un_send(struct socket *sock, const struct iovec *iov, int iovcnt, int flags);
 
 struct socket_ops un_ops = {
     .accept     = un_accept,
@@ -52,6 +56,8 @@ struct socket_ops un_ops = {
     .duplicate  = un_duplicate,
     .getvn      = un_getvn,
     .init       = un_init,
+    .ioctl      = un_ioctl,
+    .listen     = un_listen,
     .recv       = un_recv,
     .send       = un_send
 };
@@ -73,7 +79,21 @@ struct un_conn {
 };
 
 static int
-un_accept(struct socket *socket, struct socket **result, void *address, size_t *address_len)
+un_wait_accepted(struct un_conn *conn, int flags)
+{
+    while (!conn->accepted) {
+        if ((flags & O_NONBLOCK)) {
+            return -(EAGAIN);
+        }
+
+        thread_yield();
+    }
+
+    return 0;
+}
+
+static int
+un_accept(struct socket *socket, struct socket **result, void *address, size_t *address_len, int flags)
 {
     struct socket *client;
     struct un_conn *client_conn;
@@ -95,18 +115,23 @@ un_accept(struct socket *socket, struct socket **result, void *address, size_t *
     host = server_state->host;
 
     while (LIST_SIZE(&host->un.un_connections) == 0) {
+        if ((flags & O_NONBLOCK)) {
+            return -(EAGAIN);
+        }
+
         thread_yield();
     }
 
     list_remove_back(&host->un.un_connections, (void**)&client_conn);
 
-    client = calloc(1, sizeof(struct socket*));
+    client = calloc(1, sizeof(struct socket));
     server_conn = calloc(1, sizeof(struct un_conn));
 
     server_conn->refs = 1;
     server_conn->rx_pipe[0] = client_conn->tx_pipe[0];
     server_conn->tx_pipe[1] = client_conn->rx_pipe[1];
     server_conn->peer = client_conn;
+    server_conn->accepted = true;
     client_conn->peer = server_conn;
     client_conn->accepted = true;
     client->state = server_conn;
@@ -203,7 +228,7 @@ un_close(struct socket *sock)
 }
 
 static int
-un_connect(struct socket *socket, void *address, size_t address_len)
+un_connect(struct socket *socket, void *address, size_t address_len, int flags)
 {
     struct sockaddr_un *addr_un;
     struct un_conn *conn;
@@ -227,11 +252,12 @@ un_connect(struct socket *socket, void *address, size_t address_len)
 
     list_append(&host->un.un_connections, conn);
 
-    while (!conn->accepted) {
-        thread_yield();
+    if ((flags & O_NONBLOCK)) {
+        /* the connection completes once the server accepts it */
+        return -(EINPROGRESS);
     }
 
-    return 0;
+    return un_wait_accepted(conn, flags);
 }
 
 static int
@@ -254,19 +280,61 @@ un_getvn(struct socket *socket, struct vnode **vn)
     return 0;
 }
 
+static int
+un_ioctl(struct socket *sock, uint64_t request, void *argp)
+{
+    struct un_conn *conn;
+
+    conn = sock->state;
+
+    if (!conn || !conn->accepted) {
+        return -(ENOTSUP);
+    }
+
+    switch (request) {
+        case FIONREAD:
+            return FOP_IOCTL(conn->rx_pipe[0], request, argp);
+        case FIONSPACE:
+            return FOP_IOCTL(conn->tx_pipe[1], request, argp);
+    }
+
+    return -(ENOTSUP);
+}
+
+/* bind() already made the socket reachable; this only checks for that */
+static int
+un_listen(struct socket *sock, int backlog)
+{
+    struct un_conn *conn;
+
+    conn = sock->state;
+
+    if (!conn || !conn->host) {
+        return -(EINVAL);
+    }
+
+    return 0;
+}
+
 static size_t
-un_recv(struct socket *sock, void *buf, size_t size)
+un_recv(struct socket *sock, const struct iovec *iov, int iovcnt, int flags)
 {
     int ret;
     struct un_conn *conn;
     
     conn = sock->state;
 
+    ret = un_wait_accepted(conn, flags);
+
+    if (ret != 0) {
+        return ret;
+    }
+
     if (conn->peer->closed) {
         return -(ECONNRESET);
     }
 
-    ret = FOP_READ(conn->rx_pipe[0], buf, size);
+    ret = pipe_readv(conn->rx_pipe[0], iov, iovcnt, flags);
     
     if (ret == -(EPIPE)) {
         return -(ECONNRESET);
@@ -276,20 +344,26 @@ un_recv(struct socket *sock, void *buf, size_t size)
 }
 
 static size_t
-un_send(struct socket *sock, const void *buf, size_t size)
+un_send(struct socket *sock, const struct iovec *iov, int iovcnt, int flags)
 {
     int ret;
     struct un_conn *conn;
     
     conn = sock->state;
 
+    ret = un_wait_accepted(conn, flags);
+
+    if (ret != 0) {
+        return ret;
+    }
+
     if (conn->peer->closed) {
         return -(ECONNRESET);
     }
 
-    ret = FOP_WRITE(conn->tx_pipe[1], buf, size);
+    ret = pipe_writev(conn->tx_pipe[1], iov, iovcnt, flags);
     
-    if (ret == -(ESPIPE)) {
+    if (ret == -(EPIPE)) {
         return -(ECONNRESET);
     }
 
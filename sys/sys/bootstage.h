@@ -0,0 +1,38 @@
+/*
+ * bootstage.h - when the system reached each stage of booting
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _ELYSIUM_SYS_BOOTSTAGE_H
+#define _ELYSIUM_SYS_BOOTSTAGE_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#ifdef __KERNEL__
+
+#include <sys/types.h>
+
+#define BOOTSTAGE_MAX   32
+
+void    bootstage(const char *);
+void    bootstage_calibrate(uint64_t, uint32_t);
+void    bootstage_report();
+int     bootstage_sysctl(int *, int, void *, size_t *, void *, size_t);
+
+#endif /* __KERNEL__ */
+#ifdef __cplusplus
+}
+#endif
+#endif /* _ELYSIUM_SYS_BOOTSTAGE_H */
@@ -23,7 +23,9 @@ extern "C" {
 #endif
 
 #include <sys/errno.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #define minor(n) (n & 0xFF)
 #define major(n) ((n >> 8) & 0xFF)
@@ -40,7 +42,9 @@ typedef int (*cdev_isatty_t)(struct cdev *);
 typedef int (*cdev_mmap_t)(struct cdev *, uintptr_t, size_t, int, off_t);
 typedef int (*cdev_open_t)(struct cdev *);
 typedef int (*cdev_read_t)(struct cdev *, char *, size_t, uint64_t);
+typedef int (*cdev_readv_t)(struct cdev *, const struct iovec *, int, uint64_t);
 typedef int (*cdev_write_t)(struct cdev *, const char *, size_t, uint64_t);
+typedef int (*cdev_writev_t)(struct cdev *, const struct iovec *, int, uint64_t);
 
 /* character device methods */
 struct cdev_ops {
@@ -51,7 +55,9 @@ struct cdev_ops {
     cdev_mmap_t     mmap;
     cdev_open_t     open;
     cdev_read_t     read;
+    cdev_readv_t    readv;
     cdev_write_t    write;
+    cdev_writev_t   writev;
 };
 
 
@@ -141,6 +147,55 @@ CDEVOPS_READ(struct cdev *dev, char *buf, size_t nbyte, uint64_t pos)
     return -(ENOTSUP);
 }
 
+/*
+ * vectored read; drivers without a native readv are entered once per segment.
+ * After the first segment we only continue while the device reports pending
+ * data so that a partially satisfied request never blocks
+ */
+__attribute__((always_inline))
+static inline int
+CDEVOPS_READV(struct cdev *dev, const struct iovec *iov, int iovcnt, uint64_t pos)
+{
+    int i;
+    int res;
+    int total;
+    uint32_t avail;
+
+    if (dev->ops.readv) {
+        return dev->ops.readv(dev, iov, iovcnt, pos);
+    }
+
+    if (!dev->ops.read) {
+        return -(ENOTSUP);
+    }
+
+    total = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+
+        if (total > 0 && CDEVOPS_IOCTL(dev, FIONREAD, (uintptr_t)&avail) == 0 && avail == 0) {
+            break;
+        }
+
+        res = dev->ops.read(dev, iov[i].iov_base, iov[i].iov_len, pos + total);
+
+        if (res < 0) {
+            return total > 0 ? total : res;
+        }
+
+        total += res;
+
+        if (res < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    return total;
+}
+
 __attribute__((always_inline))
 static inline int
 CDEVOPS_WRITE(struct cdev *dev, const char *buf, size_t nbyte, uint64_t pos)
@@ -152,6 +207,45 @@ CDEVOPS_WRITE(struct cdev *dev, const char *buf, size_t nbyte, uint64_t pos)
     return -(ENOTSUP);
 }
 
+__attribute__((always_inline))
+static inline int
+CDEVOPS_WRITEV(struct cdev *dev, const struct iovec *iov, int iovcnt, uint64_t pos)
+{
+    int i;
+    int res;
+    int total;
+
+    if (dev->ops.writev) {
+        return dev->ops.writev(dev, iov, iovcnt, pos);
+    }
+
+    if (!dev->ops.write) {
+        return -(ENOTSUP);
+    }
+
+    total = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+
+        res = dev->ops.write(dev, iov[i].iov_base, iov[i].iov_len, pos + total);
+
+        if (res < 0) {
+            return total > 0 ? total : res;
+        }
+
+        total += res;
+
+        if (res < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    return total;
+}
+
 #endif /* __KERNEL__ */
 #ifdef __cplusplus
 }
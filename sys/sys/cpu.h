@@ -0,0 +1,100 @@
+/*
+ * cpu.h - per-CPU state
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _ELYSIUM_SYS_CPU_H
+#define _ELYSIUM_SYS_CPU_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#ifdef __KERNEL__
+
+#include <ds/list.h>
+#include <machine/cpu.h>
+#include <sys/types.h>
+
+#define MAXCPU      16
+
+/* affinity mask allowing every CPU */
+#define CPU_MASK_ALL    0xFFFFFFFF
+
+struct proc;
+struct thread;
+struct vm_space;
+struct work;
+
+/*
+ * everything that used to be a global of the scheduler. ci_self and
+ * ci_page_dir are read from assembly and must stay the first two fields
+ */
+struct cpu {
+    struct cpu *        ci_self;        /* what curcpu() returns */
+    uintptr_t           ci_page_dir;    /* physical address of the loaded page directory */
+    int                 ci_id;          /* index into cpus[] */
+    volatile bool       ci_running;     /* set once the CPU is taking interrupts */
+    volatile bool       ci_tlb_flush;   /* another CPU changed a mapping we may have cached */
+    bool                ci_crit_if;     /* interrupt flag before critical_enter() */
+    int                 ci_giant_depth; /* how many times this CPU holds the giant lock */
+    struct thread *     ci_thread;      /* thread running on this CPU */
+    struct thread *     ci_idle;        /* runs when nothing else can */
+    struct proc *       ci_proc;        /* process owning ci_thread */
+    struct vm_space *   ci_space;       /* address space of ci_thread */
+    struct thread *     ci_fpu_owner;   /* thread whose state is in the FPU registers */
+    struct list         ci_runq;        /* threads waiting for this CPU */
+    uint32_t            ci_switches;    /* context switches */
+    uint32_t            ci_steals;      /* threads taken from other queues while idle */
+    uint32_t            ci_migrations;  /* threads the balancer moved here */
+    volatile uint32_t   ci_softirq_pending; /* bit n set if softirq n was raised */
+    bool                ci_softirq_active;  /* running softirqs; don't switch threads */
+    struct work *       ci_work_head;   /* queued for ci_worker */
+    struct work *       ci_work_tail;
+    struct thread *     ci_worker;      /* runs work items queued on this CPU */
+    struct cpu_md       ci_md;
+};
+
+extern struct cpu   cpus[MAXCPU];
+extern int          ncpus;
+
+/*
+ * the running thread and what it belongs to. These read the current CPU's
+ * fields in a single instruction and can be used anywhere; only the
+ * scheduler changes them
+ */
+#define current_proc                CPU_LOAD(ci_proc)
+#define sched_curr_thread           CPU_LOAD(ci_thread)
+#define sched_curr_address_space    CPU_LOAD(ci_space)
+
+/*
+ * the giant lock serializes everything that runs in kernel mode. A CPU takes
+ * it when it enters the kernel and drops it when it returns to userland or
+ * waits in thread_yield(). It belongs to the CPU rather than to a thread, so
+ * a thread switched out while holding it hands its share to the next one
+ */
+void    giant_enter();
+void    giant_exit();
+void    giant_reacquire(int);
+int     giant_release_all();
+
+void    smp_resched(struct cpu *);
+void    smp_start(int);
+void    smp_tlb_flush();
+void    smp_tlb_shootdown(uintptr_t);
+
+#endif /* __KERNEL__ */
+#ifdef __cplusplus
+}
+#endif
+#endif /* _ELYSIUM_SYS_CPU_H */
@@ -27,5 +27,6 @@
 #define DEV_MAJOR_RTC       0x07
 #define DEV_MAJOR_RAW_DISK  0x08
 #define DEV_MAJOR_KMSG      0x09
+#define DEV_MAJOR_TRACE     0x0A
 
 #endif
@@ -25,6 +25,7 @@
 #define EIO         5
 #define ENXIO       6
 #define EBADF       9
+#define EAGAIN      11
 #define ENOMEM      12
 #define EACCES      13
 #define EFAULT      14
@@ -36,13 +37,33 @@
 #define ENFILE      23
 #define EMFILE      24
 #define ENOTTY      25
+#define EFBIG       27
 #define ENOSPC      28
 #define ESPIPE      29
 #define EROFS       30
 #define EPIPE       32
 #define ENOTEMPTY   39
 
-#define ECONNRESET  104
+#define EWOULDBLOCK EAGAIN
+
+#define EOPNOTSUPP      95
+#define ECONNRESET      104
+#define ENOBUFS         105
+#define EAFNOSUPPORT    106
+#define EPROTOTYPE      107
+#define ENOPROTOOPT     109
+#define ECONNREFUSED    111
+#define EADDRINUSE      112
+#define ECONNABORTED    113
+#define ENETUNREACH     114
+#define EINPROGRESS     119
+#define EALREADY        120
+#define EDESTADDRREQ    121
+#define EMSGSIZE        122
+#define EPROTONOSUPPORT 123
+#define EADDRNOTAVAIL   125
+#define EISCONN         127
+#define ENOTCONN        128
 
 #define ENOTSUP     129
 
@@ -29,6 +29,7 @@ extern "C" {
 #include <sys/proc.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/vnode.h>
 
 struct file;
@@ -44,10 +45,12 @@ typedef int (*f_ioctl_t)(struct file *, uint64_t, void *);
 typedef int (*f_mmap_t)(struct file *, uintptr_t, size_t, int, off_t);
 typedef int (*f_readdirent_t)(struct file *, struct dirent *, uint64_t);
 typedef int (*f_read_t)(struct file *, void *, size_t);
+typedef int (*f_readv_t)(struct file *, const struct iovec *, int, off_t);
 typedef int (*f_seek_t)(struct file *, off_t *, off_t, int);
 typedef int (*f_stat_t)(struct file *, struct stat *);
 typedef int (*f_truncate_t)(struct file *, off_t);
 typedef int (*f_write_t)(struct file *, const void *, size_t);
+typedef int (*f_writev_t)(struct file *, const struct iovec *, int, off_t);
 
 
 /* file operations */
@@ -63,10 +66,12 @@ struct fops {
     f_mmap_t        mmap;
     f_readdirent_t  readdirent;
     f_read_t        read;
+    f_readv_t       readv;
     f_seek_t        seek;
     f_stat_t        stat;
     f_truncate_t    truncate;
     f_write_t       write;
+    f_writev_t      writev;
 };
 
 /* 
@@ -84,11 +89,14 @@ struct file {
 extern struct pool  file_pool;
 
 #define FILE_POSITION(fp) ((fp)->position)
+#define FILE_NONBLOCK(fp) ((fp)->flags & O_NONBLOCK)
 
 struct file *file_new(struct fops *, void *);
 struct file *file_duplicate(struct file *);
 
 int         file_close(struct file *);
+int         file_readv(struct file *, const struct iovec *, int, off_t);
+int         file_writev(struct file *, const struct iovec *, int, off_t);
 int         fop_creat(struct proc *, struct file **, const char *, mode_t);
 
 __attribute__((always_inline))
@@ -201,7 +209,7 @@ FOP_READ(struct file *fp, char *buf, size_t nbyte)
     int read;
     struct fops *ops;
 
-    if (fp->flags == O_WRONLY) {
+    if ((fp->flags & O_ACCMODE) == O_WRONLY) {
         return -(EPERM);
     }
 
@@ -220,6 +228,45 @@ FOP_READ(struct file *fp, char *buf, size_t nbyte)
     return -(EPERM);
 }
 
+__attribute__((always_inline))
+static inline int
+FOP_READV(struct file *fp, const struct iovec *iov, int iovcnt)
+{
+    int read;
+
+    if ((fp->flags & O_ACCMODE) == O_WRONLY) {
+        return -(EPERM);
+    }
+
+    read = file_readv(fp, iov, iovcnt, fp->position);
+
+    if (read > 0) {
+        fp->position += read;
+    }
+
+    return read;
+}
+
+/* positional read; the file offset is neither used nor updated */
+__attribute__((always_inline))
+static inline int
+FOP_PREADV(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    if ((fp->flags & O_ACCMODE) == O_WRONLY) {
+        return -(EPERM);
+    }
+
+    if (!fp->ops->seek) {
+        return -(ESPIPE);
+    }
+
+    if (offset < 0) {
+        return -(EINVAL);
+    }
+
+    return file_readv(fp, iov, iovcnt, offset);
+}
+
 __attribute__((always_inline))
 static inline int
 FOP_READDIRENT(struct file *fp, struct dirent *dirent)
@@ -286,7 +333,7 @@ FOP_WRITE(struct file *fp, const char *buf, size_t nbyte)
     ssize_t written;
     struct fops *ops;
 
-    if (fp->flags == O_RDONLY) {
+    if ((fp->flags & O_ACCMODE) == O_RDONLY) {
         return -(EPERM);
     }
 
@@ -305,6 +352,45 @@ FOP_WRITE(struct file *fp, const char *buf, size_t nbyte)
     return -(EPERM);
 }
 
+__attribute__((always_inline))
+static inline int
+FOP_WRITEV(struct file *fp, const struct iovec *iov, int iovcnt)
+{
+    int written;
+
+    if ((fp->flags & O_ACCMODE) == O_RDONLY) {
+        return -(EPERM);
+    }
+
+    written = file_writev(fp, iov, iovcnt, fp->position);
+
+    if (written > 0) {
+        fp->position += written;
+    }
+
+    return written;
+}
+
+/* positional write; the file offset is neither used nor updated */
+__attribute__((always_inline))
+static inline int
+FOP_PWRITEV(struct file *fp, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    if ((fp->flags & O_ACCMODE) == O_RDONLY) {
+        return -(EPERM);
+    }
+
+    if (!fp->ops->seek) {
+        return -(ESPIPE);
+    }
+
+    if (offset < 0) {
+        return -(EINVAL);
+    }
+
+    return file_writev(fp, iov, iovcnt, offset);
+}
+
 #endif /* __KERNEL__ */
 #ifdef __cplusplus
 }
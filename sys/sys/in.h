@@ -0,0 +1,75 @@
+/*
+ * in.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _ELYSIUM_SYS_IN_H
+#define _ELYSIUM_SYS_IN_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+
+#define IPPROTO_IP          0
+#define IPPROTO_ICMP        1
+#define IPPROTO_TCP         6
+#define IPPROTO_UDP         17
+
+#define INADDR_ANY          0x00000000
+#define INADDR_LOOPBACK     0x7F000001
+#define INADDR_BROADCAST    0xFFFFFFFF
+
+#define IN_LOOPBACKNET      127
+
+/* IPPROTO_TCP level socket options */
+#define TCP_NODELAY         1   /* don't delay small segments (disables Nagle) */
+#define TCP_MAXSEG          2   /* maximum segment size */
+#define TCP_QUICKACK        12  /* acknowledge every segment immediately */
+
+typedef uint16_t    in_port_t;
+typedef uint32_t    in_addr_t;
+
+struct in_addr {
+    in_addr_t       s_addr;
+};
+
+struct sockaddr_in {
+    uint16_t        sin_family;
+    in_port_t       sin_port;
+    struct in_addr  sin_addr;
+    uint8_t         sin_zero[8];
+};
+
+/* i686 is little endian; everything on the wire is big endian */
+static inline uint16_t
+htons(uint16_t x)
+{
+    return (uint16_t)((x << 8) | (x >> 8));
+}
+
+static inline uint32_t
+htonl(uint32_t x)
+{
+    return __builtin_bswap32(x);
+}
+
+#define ntohs(x) htons(x)
+#define ntohl(x) htonl(x)
+
+#ifdef __cplusplus
+}
+#endif
+#endif /* _ELYSIUM_SYS_IN_H */
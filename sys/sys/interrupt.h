@@ -23,6 +23,7 @@ extern "C" {
 #ifdef __KERNEL__
 
 #include <machine/interrupt.h>
+#include <sys/types.h>
 
 struct device;
 struct regs;
@@ -35,6 +36,10 @@ typedef int (*dev_intr_t)(struct device *, int);
 
 int swi_register(int, intr_handler_t);
 int	irq_register(struct device *, int, dev_intr_t);
+int intr_alloc_vector();
+int intr_register(struct device *, int, dev_intr_t);
+void intr_release_vector(int);
+int intr_sysctl(int *, int, void *, size_t *, void *, size_t);
 
 #endif /* __KERNEL__ */
 #ifdef __cplusplus
@@ -43,6 +43,7 @@ extern "C" {
 
 /* generic file descriptor ioctl's */
 #define FIONREAD          0x80
+#define FIONSPACE         0x81
 
 struct curpos {
     unsigned short  c_row;
@@ -0,0 +1,72 @@
+/*
+ * ktrace.h - per-process system call tracing
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _ELYSIUM_SYS_KTRACE_H
+#define _ELYSIUM_SYS_KTRACE_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+
+#define KTR_NARGS       5
+
+/*
+ * a system call, recorded once it returned. Records are numbered from 1 in
+ * the order their calls returned, so a gap in seq means the reader fell
+ * behind and records were overwritten
+ */
+struct ktr_syscall {
+    uint32_t    seq;
+    pid_t       tid;
+    int         num;
+    int         argc;
+    uintptr_t   args[KTR_NARGS];
+    int         ret;
+    uint64_t    entry;          /* TSC when the call was made, 0 without one */
+    uint64_t    exit;           /* TSC when it returned */
+};
+
+#ifdef __KERNEL__
+
+#define KTRACE_NRECORDS 256
+
+/*
+ * allocated the first time a process is traced and kept until it's freed,
+ * since a call that was traced when it began may return after tracing was
+ * turned off again
+ */
+struct ktrace {
+    struct ktr_syscall  records[KTRACE_NRECORDS];
+    volatile uint32_t   head;   /* records handed out to writers */
+    uint32_t            tail;   /* next record KERN_KTRACE_RECORDS returns */
+};
+
+struct proc;
+struct syscall;
+struct syscall_args;
+struct thread;
+
+void    ktrace_record(struct thread *, struct syscall *, int, struct syscall_args *, int, uint64_t, uint64_t);
+void    ktrace_free(struct proc *);
+int     ktrace_sysctl(int *, int, void *, size_t *, void *, size_t);
+
+#endif /* __KERNEL__ */
+#ifdef __cplusplus
+}
+#endif
+#endif /* _ELYSIUM_SYS_KTRACE_H */
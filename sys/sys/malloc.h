@@ -35,6 +35,31 @@ void    free(void *);
 int     brk(void *);
 void *  sbrk(size_t);
 void *  sbrk_a(size_t, uintptr_t);
+int     malloc_sysctl(int *, int, void *, size_t *, void *, size_t);
+
+#ifdef MALLOC_PROFILE
+
+/* the address the calling function will return to */
+#define MALLOC_CALLER() ((uintptr_t)__builtin_return_address(0))
+
+/*
+ * with MALLOC_PROFILE, the heap charges every block to a call site. Code that
+ * allocates on behalf of its callers uses these to charge the caller instead
+ */
+void *  calloc_at(int, size_t, uintptr_t);
+void *  malloc_at(size_t, uintptr_t);
+void    malloc_charge(size_t, uintptr_t);
+
+#else
+
+/* lets code that passes a call site along build without MALLOC_PROFILE */
+#define MALLOC_CALLER()             ((uintptr_t)0)
+
+#define calloc_at(num, size, site)  calloc(num, size)
+#define malloc_at(size, site)       malloc(size)
+#define malloc_charge(size, site)   do { } while (0)
+
+#endif /* MALLOC_PROFILE */
 
 #endif /* __KERNEL__ */
 #ifdef __cplusplus
@@ -57,6 +57,7 @@ void    fs_register(char *, struct fs_ops *);
 void    devfs_init();
 void    tmpfs_init();
 void    ext2_init();
+void    procfs_init();
 
 #endif /* __KERNEL__ */
 
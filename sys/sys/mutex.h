@@ -23,7 +23,62 @@ extern "C" {
 #endif
 #ifdef __KERNEL__
 
-typedef unsigned char spinlock_t;
+#include <sys/types.h>
+
+#ifdef LOCK_STATS
+#include <sys/kstat.h>
+
+/*
+ * what every lock of one kind has added up to. The counters are exported as
+ * kstats named lock.<class>.*; locks nobody gave a class count as "other"
+ */
+struct lock_class {
+    const char *        lc_name;
+    bool                lc_registered;
+    uint32_t            lc_acquired;
+    uint32_t            lc_contended;   /* acquisitions that had to wait */
+    uint64_t            lc_spin_cycles;
+    uint32_t            lc_max_hold;    /* in TSC cycles */
+    struct kstat        lc_kstats[4];
+};
+
+#define LOCK_CLASS(var, name) struct lock_class var = { \
+    .lc_name    =   name, \
+    .lc_kstats  =   { \
+        { "lock." name ".acquired",     KSTAT_TYPE_UINT32,  &var.lc_acquired }, \
+        { "lock." name ".contended",    KSTAT_TYPE_UINT32,  &var.lc_contended }, \
+        { "lock." name ".spin_cycles",  KSTAT_TYPE_UINT64,  &var.lc_spin_cycles }, \
+        { "lock." name ".max_hold",     KSTAT_TYPE_UINT32,  &var.lc_max_hold }, \
+    } \
+}
+
+#define spinlock_set_class(lock, cls)   ((lock)->class = (cls))
+
+void lock_class_register(struct lock_class *);
+void lock_stats_init();
+
+#else
+
+/* without LOCK_STATS none of this leaves anything behind */
+#define LOCK_CLASS(var, name)           struct lock_class
+#define spinlock_set_class(lock, cls)   do { } while (0)
+#define lock_class_register(cls)        do { } while (0)
+#define lock_stats_init()               do { } while (0)
+
+#endif /* LOCK_STATS */
+
+/*
+ * ticket lock; waiters are served in the order they arrived and each one
+ * only spins on reading the lock. All zeroes is an unlocked lock
+ */
+typedef struct {
+    volatile uint16_t   owner;  /* ticket being served */
+    volatile uint16_t   next;   /* next ticket to hand out */
+#ifdef LOCK_STATS
+    struct lock_class * class;
+    uint64_t            acquired_at;    /* TSC when the holder got it */
+#endif
+} spinlock_t;
 
 void spinlock_lock(spinlock_t volatile *);
 void spinlock_unlock(spinlock_t volatile *);
@@ -23,10 +23,13 @@ extern "C" {
 #ifdef __KERNEL__
 
 #include <sys/file.h>
+#include <sys/uio.h>
 #include <sys/vnode.h>
 
 void            create_pipe(struct file **, struct vnode *);
 struct file *   fifo_to_file(struct vnode *, mode_t);
+int             pipe_readv(struct file *, const struct iovec *, int, int);
+int             pipe_writev(struct file *, const struct iovec *, int, int);
 
 #endif /* __KERNEL__ */
 #ifdef __cplusplus
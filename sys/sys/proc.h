@@ -22,6 +22,7 @@ extern "C" {
 #endif
 #ifdef __KERNEL__
 #include <ds/list.h>
+#include <sys/cpu.h>
 #include <sys/types.h>
 #include <sys/pool.h>
 #include <sys/proc.h>
@@ -48,6 +49,7 @@ extern "C" {
 
 typedef int (*kthread_entry_t)(void *);
 
+struct fpu_state;
 struct regs;
 struct proc;
 struct sighandler;
@@ -93,6 +95,8 @@ struct proc {
     struct pgrp *       group;              /* process group this process is a member of*/
     struct world *      world;              /* world this process is a member of */
     struct sighandler * sighandlers[64];
+    struct ktrace *     ktrace;             /* system call records, once it was traced */
+    struct syscall_stats *syscall_stats;    /* per-call statistics, if they're kept */
     mode_t              umask;
     char                name[256];
     time_t              start_time;         /* epoch time this process started at */
@@ -101,6 +105,7 @@ struct proc {
     pid_t               pid;
     int                 status;             /* process exit code */
     bool                exited;
+    bool                traced;             /* record system calls into ktrace */
 };
 
 /*
@@ -118,6 +123,13 @@ struct thread {
     uint8_t             terminated;             /* has this thread been terminated */
     uint8_t             interrupt_in_progress;  /* is this thread currently in kernel space*/
     uint8_t             state;
+    int                 giant_depth;            /* giant lock nesting while switched out */
+    struct cpu *        cpu;                    /* CPU running this thread, if any */
+    struct cpu *        last_cpu;               /* CPU that ran it last, whose cache is warm */
+    struct cpu *        runq;                   /* run queue holding this thread, if any */
+    uint32_t            affinity;               /* cpus[] indices it may run on, one bit each */
+    struct fpu_state *  fpu;                    /* saved FPU/SSE state, allocated on first use */
+    struct cpu *        fpu_cpu;                /* CPU last loaded with that state */
     uintptr_t           stack;
     uintptr_t           stack_base;             /* bottom of kernel mode stack */
     uintptr_t           stack_top;              /* top of kernel mode stack */
@@ -128,8 +140,6 @@ struct thread {
 static inline bool
 thread_exit_requested()
 {
-    extern struct thread *sched_curr_thread;
-     
     return sched_curr_thread->exit_requested;
 }
 
@@ -146,10 +156,6 @@ PROC_COUNT_FILEDESC(struct proc *p)
     return r;
 }
 
-/*
- * Pointer to the currently running process, defined in architecture specific scheduler implementation 
- */
-extern struct proc *current_proc;
 extern struct pool  proc_pool;
 extern struct pool  thread_pool;
 
@@ -170,11 +176,13 @@ void            proc_leave_world(struct proc *, struct world *);
 struct proc *   proc_find(int);
 struct proc *   proc_new();
 int             proc_signal(struct proc *, int, struct signal_args *);
-int             proc_sysctl(int *, int, void *, size_t *, void *, size_t);
 
 struct session *    session_new(struct proc *);
 
+struct thread * sched_idle_thread(struct cpu *, uintptr_t, uintptr_t);
 uintptr_t       sched_init_thread(struct vm_space *, uintptr_t, kthread_entry_t, void *);
+int             sched_setaffinity(struct thread *, uint32_t);
+int             sched_sysctl(int *, int, void *, size_t *, void *, size_t);
 
 void            thread_call_sa_handler(struct thread *, struct sigcontext *);
 
@@ -0,0 +1,42 @@
+/*
+ * prof.h - sampling profiler
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _ELYSIUM_SYS_PROF_H
+#define _ELYSIUM_SYS_PROF_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#ifdef __KERNEL__
+
+#include <sys/types.h>
+
+/* samples each CPU holds until they're read through KERN_PROF_SAMPLES */
+#define PROF_NSAMPLES   2048
+
+struct cpu;
+
+/* checked by the timer interrupt before it bothers to unwind anything */
+extern volatile bool prof_enabled;
+
+void    prof_record(struct cpu *, uintptr_t *, int, bool);
+int     prof_sysctl(int *, int, void *, size_t *, void *, size_t);
+
+#endif /* __KERNEL__ */
+#ifdef __cplusplus
+}
+#endif
+#endif /* _ELYSIUM_SYS_PROF_H */
@@ -22,6 +22,9 @@ extern "C" {
 #endif
 #ifdef __KERNEL__
 
+#define MFD_CLOEXEC     0x0001
+
+int shm_memfd_create(struct proc *, struct file **, const char *, int);
 int shm_open(struct proc *, struct file **, const char *, int, mode_t);
 int shm_unlink(struct proc *, const char *);
 
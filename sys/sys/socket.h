@@ -23,6 +23,7 @@ extern "C" {
 
 #include <sys/errno.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/vnode.h>
 
 typedef unsigned int socklen_t;
@@ -40,7 +41,6 @@ typedef unsigned int socklen_t;
 #define PF_INET     2
 #define PF_INET6    10
 #define PF_PACKET   17
-#define PF_KLINK    40
 
 #define AF_UNSPEC   PF_UNSPEC
 #define AF_LOCAL    PF_LOCAL
@@ -49,27 +49,54 @@ typedef unsigned int socklen_t;
 #define AF_INET     PF_INET
 #define AF_INET6    PF_INET6
 #define AF_PACKET   PF_PACKET
-#define AF_KLINK    PF_KLINK
+
+#define SOL_SOCKET      1
+
+#define SO_REUSEADDR    2
+#define SO_TYPE         3
+#define SO_ERROR        4
+#define SO_SNDBUF       7
+#define SO_RCVBUF       8
+
+#define MSG_DONTWAIT    0x40
+
+#define SOMAXCONN       128
 
 struct sockaddr {
     uint16_t            sa_family;
     uint8_t             sa_data[14];
 };
 
+struct msghdr {
+    void *              msg_name;
+    socklen_t           msg_namelen;
+    struct iovec *      msg_iov;
+    int                 msg_iovlen;
+    void *              msg_control;
+    socklen_t           msg_controllen;
+    int                 msg_flags;
+};
+
 #ifdef __KERNEL__
 struct socket;
 struct socket_ops;
 
-typedef int (*sock_accept_t)(struct socket *, struct socket **, void *, size_t *);
+typedef int (*sock_accept_t)(struct socket *, struct socket **, void *, size_t *, int);
 typedef int (*sock_bind_t)(struct socket *, void *, size_t);
 typedef int (*sock_close_t)(struct socket *);
 typedef int (*sock_getvn_t)(struct socket *, struct vnode **);
-typedef int (*sock_connect_t)(struct socket *, void *, size_t);
+typedef int (*sock_connect_t)(struct socket *, void *, size_t, int);
 typedef int (*sock_destroy_t)(struct socket *);
 typedef int (*sock_duplicate_t)(struct socket *);
+typedef int (*sock_getopt_t)(struct socket *, int, int, void *, size_t *);
 typedef int (*sock_init_t)(struct socket *, int, int);
-typedef size_t (*sock_recv_t)(struct socket *, void *, size_t);
-typedef size_t (*sock_send_t)(struct socket *, const void *, size_t);
+typedef int (*sock_ioctl_t)(struct socket *, uint64_t, void *);
+typedef int (*sock_listen_t)(struct socket *, int);
+typedef size_t (*sock_recv_t)(struct socket *, const struct iovec *, int, int);
+typedef size_t (*sock_recvfrom_t)(struct socket *, const struct iovec *, int, int, void *, size_t *);
+typedef size_t (*sock_send_t)(struct socket *, const struct iovec *, int, int);
+typedef size_t (*sock_sendto_t)(struct socket *, const struct iovec *, int, int, void *, size_t);
+typedef int (*sock_setopt_t)(struct socket *, int, int, const void *, size_t);
 
 struct protocol {
     uint32_t            address_family;
@@ -90,10 +117,16 @@ struct socket_ops {
     sock_connect_t      connect;
     sock_destroy_t      destroy;
     sock_duplicate_t    duplicate;
+    sock_getopt_t       getsockopt;
     sock_init_t         init;
+    sock_ioctl_t        ioctl;
     sock_getvn_t        getvn;
+    sock_listen_t       listen;
     sock_recv_t         recv;
+    sock_recvfrom_t     recvfrom;   /* optional; falls back to recv */
     sock_send_t         send;
+    sock_sendto_t       sendto;     /* optional; falls back to send */
+    sock_setopt_t       setsockopt;
 };
 
 void            register_protocol(struct protocol *);
@@ -105,7 +138,7 @@ void            sock_init();
 /* in line function definitions for socket operations */
 __attribute__((always_inline))
 static inline int
-SOCK_ACCEPT(struct socket *sock, struct socket **result, void *address, size_t *address_len)
+SOCK_ACCEPT(struct socket *sock, struct socket **result, void *address, size_t *address_len, int flags)
 {
     struct protocol *prot;
 
@@ -119,7 +152,7 @@ SOCK_ACCEPT(struct socket *sock, struct socket **result, void *address, size_t *
         return -(ENOTSUP);
     }
 
-    return prot->ops->accept(sock, result, address, address_len);
+    return prot->ops->accept(sock, result, address, address_len, flags);
 }
 
 __attribute__((always_inline))
@@ -161,7 +194,7 @@ SOCK_CLOSE(struct socket *sock)
 
 __attribute__((always_inline))
 static inline int
-SOCK_CONNECT(struct socket *sock, void *address, size_t address_size)
+SOCK_CONNECT(struct socket *sock, void *address, size_t address_size, int flags)
 {
     struct protocol *prot;
 
@@ -175,7 +208,7 @@ SOCK_CONNECT(struct socket *sock, void *address, size_t address_size)
         return -(ENOTSUP);
     }
 
-    return prot->ops->connect(sock, address, address_size);
+    return prot->ops->connect(sock, address, address_size, flags);
 }
 
 __attribute__((always_inline))
@@ -232,9 +265,92 @@ SOCK_GETVN(struct socket *sock, struct vnode **vn)
     return ret;
 }
 
+__attribute__((always_inline))
+static inline int
+SOCK_GETSOCKOPT(struct socket *sock, int level, int name, void *val, size_t *len)
+{
+    struct protocol *prot;
+
+    if (!sock) {
+        return -(EINVAL);
+    }
+
+    prot = sock->protocol;
+
+    if (!prot->ops || !prot->ops->getsockopt) {
+        return -(ENOPROTOOPT);
+    }
+
+    return prot->ops->getsockopt(sock, level, name, val, len);
+}
+
+__attribute__((always_inline))
+static inline int
+SOCK_IOCTL(struct socket *sock, uint64_t request, void *argp)
+{
+    struct protocol *prot;
+
+    if (!sock) {
+        return -(EINVAL);
+    }
+
+    prot = sock->protocol;
+
+    if (!prot->ops || !prot->ops->ioctl) {
+        return -(ENOTSUP);
+    }
+
+    return prot->ops->ioctl(sock, request, argp);
+}
+
+__attribute__((always_inline))
+static inline int
+SOCK_LISTEN(struct socket *sock, int backlog)
+{
+    struct protocol *prot;
+
+    if (!sock) {
+        return -(EINVAL);
+    }
+
+    prot = sock->protocol;
+
+    if (!prot->ops || !prot->ops->listen) {
+        return -(EOPNOTSUPP);
+    }
+
+    return prot->ops->listen(sock, backlog);
+}
+
+__attribute__((always_inline))
+static inline size_t
+SOCK_RECVFROM(struct socket *sock, const struct iovec *iov, int iovcnt, int flags, void *address, size_t *address_len)
+{
+    struct protocol *prot;
+
+    if (!sock) {
+        return -(EINVAL);
+    }
+
+    prot = sock->protocol;
+
+    if (!prot->ops || (!prot->ops->recvfrom && !prot->ops->recv)) {
+        return -(ENOTSUP);
+    }
+
+    if (!prot->ops->recvfrom) {
+        /* connection oriented; there is no per message address */
+        if (address_len) *address_len = 0;
+
+        return prot->ops->recv(sock, iov, iovcnt, flags);
+    }
+
+    return prot->ops->recvfrom(sock, iov, iovcnt, flags, address, address_len);
+}
+
 __attribute__((always_inline))
 static inline size_t
-SOCK_RECV(struct socket *sock, void *buf, size_t nbyte)
+SOCK_RECVV(struct socket *sock, const struct iovec *iov, int iovcnt, int flags)
 {
     struct protocol *prot;
 
@@ -248,12 +364,47 @@ SOCK_RECV(struct socket *sock, void *buf, size_t nbyte)
         return -(ENOTSUP);
     }
 
-    return prot->ops->recv(sock, buf, nbyte);
+    return prot->ops->recv(sock, iov, iovcnt, flags);
+}
+
+__attribute__((always_inline))
+static inline size_t
+SOCK_RECV(struct socket *sock, void *buf, size_t nbyte, int flags)
+{
+    struct iovec iov;
+
+    iov.iov_base = buf;
+    iov.iov_len = nbyte;
+
+    return SOCK_RECVV(sock, &iov, 1, flags);
 }
 
 __attribute__((always_inline))
 static inline size_t
-SOCK_SEND(struct socket *sock, const void *buf, size_t nbyte)
+SOCK_SENDTO(struct socket *sock, const struct iovec *iov, int iovcnt, int flags, void *address, size_t address_len)
+{
+    struct protocol *prot;
+
+    if (!sock) {
+        return -(EINVAL);
+    }
+
+    prot = sock->protocol;
+
+    if (!prot->ops || (!prot->ops->sendto && !prot->ops->send)) {
+        return -(ENOTSUP);
+    }
+
+    if (!prot->ops->sendto) {
+        return prot->ops->send(sock, iov, iovcnt, flags);
+    }
+
+    return prot->ops->sendto(sock, iov, iovcnt, flags, address, address_len);
+}
+
+__attribute__((always_inline))
+static inline size_t
+SOCK_SENDV(struct socket *sock, const struct iovec *iov, int iovcnt, int flags)
 {
     struct protocol *prot;
 
@@ -267,13 +418,53 @@ SOCK_SEND(struct socket *sock, const void *buf, size_t nbyte)
         return -(ENOTSUP);
     }
 
-    return prot->ops->send(sock, buf, nbyte);
+    return prot->ops->send(sock, iov, iovcnt, flags);
+}
+
+__attribute__((always_inline))
+static inline size_t
+SOCK_SEND(struct socket *sock, const void *buf, size_t nbyte, int flags)
+{
+    struct iovec iov;
+
+    iov.iov_base = (void*)buf;
+    iov.iov_len = nbyte;
+
+    return SOCK_SENDV(sock, &iov, 1, flags);
+}
+
+__attribute__((always_inline))
+static inline int
+SOCK_SETSOCKOPT(struct socket *sock, int level, int name, const void *val, size_t len)
+{
+    struct protocol *prot;
+
+    if (!sock) {
+        return -(EINVAL);
+    }
+
+    prot = sock->protocol;
+
+    if (!prot->ops || !prot->ops->setsockopt) {
+        return -(ENOPROTOOPT);
+    }
+
+    return prot->ops->setsockopt(sock, level, name, val, len);
 }
 
 #else /* __KERNEL__ */
 int             accept(int, struct sockaddr *, socklen_t *);
 int             bind(int, const struct sockaddr *, socklen_t);
 int             connect(int, const struct sockaddr *, socklen_t);
+int             getsockopt(int, int, int, void *, socklen_t *);
+int             listen(int, int);
+ssize_t         recv(int, void *, size_t, int);
+ssize_t         recvfrom(int, void *, size_t, int, struct sockaddr *, socklen_t *);
+ssize_t         recvmsg(int, struct msghdr *, int);
+ssize_t         send(int, const void *, size_t, int);
+ssize_t         sendmsg(int, const struct msghdr *, int);
+ssize_t         sendto(int, const void *, size_t, int, const struct sockaddr *, socklen_t);
+int             setsockopt(int, int, int, const void *, socklen_t);
 int             socket(int, int, int);
 #endif /* __KERNEL__ */
 #ifdef __cplusplus
@@ -0,0 +1,62 @@
+/*
+ * softirq.h - deferred interrupt work
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _ELYSIUM_SYS_SOFTIRQ_H
+#define _ELYSIUM_SYS_SOFTIRQ_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#ifdef __KERNEL__
+#include <sys/types.h>
+
+/* softirqs run in this order, lowest number first */
+#define SOFTIRQ_TIMER   0
+#define SOFTIRQ_BLOCK   1
+#define SOFTIRQ_TTY     2
+#define NSOFTIRQ        8
+
+struct work;
+
+/*
+ * softirq handlers run with interrupts enabled but must not sleep; anything
+ * that might belongs in a work item
+ */
+typedef void (*softirq_handler_t)();
+
+typedef void (*work_func_t)(struct work *, void *);
+
+/* embedded in whatever needs deferring; queued at most once at a time */
+struct work {
+    struct work *   next;
+    work_func_t     func;
+    void *          argp;
+    volatile bool   queued;
+};
+
+void    softirq_raise(int);
+void    softirq_register(int, softirq_handler_t);
+void    softirq_run();
+
+void    work_init(struct work *, work_func_t, void *);
+bool    work_queue(struct work *);
+void    workers_init();
+
+#endif /* __KERNEL__ */
+#ifdef __cplusplus
+}
+#endif
+#endif /* _ELYSIUM_SYS_SOFTIRQ_H */
@@ -12,8 +12,13 @@ char    *   itoa_u(unsigned int, char *, int);
 
 int         memcmp(const void *, const void *, size_t);
 void    *   memcpy(void *, const void *, size_t);
+void    *   memmove(void *, const void *, size_t);
 void    *   memset(void *, int, size_t);
 
+/* whole pages; both must be page aligned */
+void        page_copy(void *, const void *);
+void        page_zero(void *);
+
 void        sprintf(char *, const char *, ...);
 char    *   strchr(const char *, char);
 char    *   strcpy(char *, const char *);
@@ -99,6 +99,20 @@
 #define SYS_MOUNT           0x4C
 #define SYS_LSEEK64         0x4D
 #define SYS_WORLDCTL        0x4E
+#define SYS_READV           0x4F
+#define SYS_WRITEV          0x50
+#define SYS_PREAD           0x51
+#define SYS_PWRITE          0x52
+#define SYS_PREADV          0x53
+#define SYS_PWRITEV         0x54
+#define SYS_MEMFD_CREATE    0x55
+#define SYS_LISTEN          0x56
+#define SYS_RECVMSG         0x57
+#define SYS_SENDMSG         0x58
+#define SYS_GETSOCKOPT      0x59
+#define SYS_SETSOCKOPT      0x5A
+#define SYS_SCHED_SETAFFINITY 0x5B
+#define SYS_SCHED_GETAFFINITY 0x5C
 
 #define DEFINE_SYSCALL_PARAM(type, name, num, argp) type name = ((type)argp->args[num])
 #define DECLARE_SYSCALL_PARAM(type, num, argp) (type)(argp->args[num])
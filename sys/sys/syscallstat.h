@@ -0,0 +1,52 @@
+/*
+ * syscallstat.h - system call counters and latency histograms
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _ELYSIUM_SYS_SYSCALLSTAT_H
+#define _ELYSIUM_SYS_SYSCALLSTAT_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#ifdef __KERNEL__
+
+#include <sys/sysctl.h>
+#include <sys/types.h>
+
+#define SYSCALLSTAT_NCALLS  256
+
+struct syscall_stat {
+    uint32_t    calls;
+    uint32_t    errors;
+    uint64_t    cycles;
+    uint32_t    hist[KSYSCALLSTAT_NBUCKETS];
+};
+
+/* one for every system call number */
+struct syscall_stats {
+    struct syscall_stat calls[SYSCALLSTAT_NCALLS];
+};
+
+struct proc;
+
+void    syscall_stat_account(struct proc *, int, int, uint64_t);
+void    syscall_stat_free(struct proc *);
+int     syscall_stat_sysctl(int *, int, void *, size_t *, void *, size_t);
+
+#endif /* __KERNEL__ */
+#ifdef __cplusplus
+}
+#endif
+#endif /* _ELYSIUM_SYS_SYSCALLSTAT_H */
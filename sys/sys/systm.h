@@ -52,6 +52,10 @@ int     get_kmsgs_size();
 void    ksym_declare(const char *, uintptr_t);
 int     ksym_find_nearest(uintptr_t, uintptr_t *, char *, size_t);
 int     ksym_resolve(const char *, uintptr_t *);
+void    ksym_sort();
+int     ksym_sysctl(int *, int, void *, size_t *, void *, size_t);
+
+int     stack_unwind(uintptr_t, uintptr_t, uintptr_t, uintptr_t *, int);
 
 #endif /* __KERNEL__ */
 #ifdef __cplusplus
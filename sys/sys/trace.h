@@ -0,0 +1,85 @@
+/*
+ * trace.h - static kernel tracepoints
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _ELYSIUM_SYS_TRACE_H
+#define _ELYSIUM_SYS_TRACE_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+
+/* tracepoints; bit n of KERN_TRACE_MASK enables event n */
+#define TRACE_SCHED_SWITCH      1   /* prev tid, next tid, prev state */
+#define TRACE_SCHED_WAKEUP      2   /* tid, previous state */
+#define TRACE_PAGE_FAULT        3   /* address, error code, eip */
+#define TRACE_BLOCK_SUBMIT      4   /* sector, write */
+#define TRACE_BLOCK_COMPLETE    5   /* sector, write, status */
+#define TRACE_VFS_LOOKUP        6   /* parent inode, result, child inode */
+#define TRACE_SYSCALL_ENTER     7   /* number, first two arguments */
+#define TRACE_SYSCALL_EXIT      8   /* number, return value */
+#define TRACE_NEVENTS           9
+
+#define TRACE_NARGS             3
+
+/*
+ * each CPU has a buffer of TRACE_BUF_SIZE bytes at offset cpu*TRACE_BUF_SIZE
+ * in /dev/trace; a page holding the header followed by the records
+ */
+#define TRACE_NPAGES            16
+#define TRACE_BUF_SIZE          ((TRACE_NPAGES + 1) * 4096)
+#define TRACE_NRECORDS          (TRACE_NPAGES * 4096 / sizeof(struct trace_record))
+
+struct trace_header {
+    volatile uint32_t   head;       /* records ever written, lost ones included */
+    uint32_t            cpu;
+};
+
+/*
+ * slot n holds record n % TRACE_NRECORDS, and its seq is set to n + 1 after
+ * everything else, so a reader can tell a record that was overwritten or is
+ * being written from the one it expected
+ */
+struct trace_record {
+    volatile uint32_t   seq;
+    uint16_t            event;
+    uint16_t            cpu;
+    uint64_t            tsc;
+    pid_t               tid;
+    uint32_t            args[TRACE_NARGS];
+};
+
+#ifdef __KERNEL__
+
+extern volatile uint32_t trace_mask;
+
+void    trace_init();
+void    trace_record(int, uint32_t, uint32_t, uint32_t);
+int     trace_sysctl(int *, int, void *, size_t *, void *, size_t);
+
+/* costs a load and a branch not taken while the event is off */
+#define TRACE(event, a0, a1, a2) do { \
+    if (__builtin_expect(trace_mask & (1 << (event)), 0)) { \
+        trace_record((event), (uint32_t)(a0), (uint32_t)(a1), (uint32_t)(a2)); \
+    } \
+} while (0)
+
+#endif /* __KERNEL__ */
+#ifdef __cplusplus
+}
+#endif
+#endif /* _ELYSIUM_SYS_TRACE_H */
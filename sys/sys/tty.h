@@ -0,0 +1,83 @@
+/*
+ * tty.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _ELYSIUM_SYS_TTY_H
+#define _ELYSIUM_SYS_TTY_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+#ifdef __KERNEL__
+
+#include <sys/cdev.h>
+#include <sys/ioctl.h>
+#include <sys/mutex.h>
+#include <sys/termios.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define TTY_INQ_SIZE        4096    /* input ready to be read by the slave */
+#define TTY_LINEBUF_SIZE    4096    /* canonical line being edited */
+#define TTY_OUTQ_SIZE       8192    /* translated output of one write */
+
+struct tty;
+
+/*
+ * transmits already processed output to the device. The flags are O_* file
+ * flags; with O_NONBLOCK the driver may write less than asked rather than wait
+ */
+typedef int (*tty_output_t)(struct tty *, const struct iovec *, int, int);
+
+/* optional; lets polled hardware feed pending input through tty_input() */
+typedef void (*tty_poll_t)(struct tty *);
+
+/*
+ * line discipline state shared by every terminal device. Drivers embed this
+ * in their own state, feed received bytes through tty_input() and implement
+ * their read/write methods with tty_read() and tty_write()
+ */
+struct tty {
+    struct termios      termios;
+    struct winsize      winsize;
+    pid_t               foreground;
+    struct cdev *       cdev;       /* device used when becoming a ctty */
+    tty_output_t        output;
+    tty_poll_t          poll;
+    void *              state;      /* driver private data */
+    spinlock_t          lock;       /* protects the input queue */
+    spinlock_t          olock;      /* protects outq_busy */
+    bool                outq_busy;  /* a writer owns the output queue */
+    int                 inq_head;
+    int                 inq_count;
+    int                 line_pos;
+    char                inq[TTY_INQ_SIZE];
+    char                line_buf[TTY_LINEBUF_SIZE];
+    char                outq[TTY_OUTQ_SIZE];
+};
+
+#define TTY_INQ_SPACE(tty) (TTY_INQ_SIZE - (tty)->inq_count)
+
+void    tty_init(struct tty *, tty_output_t, tty_poll_t, void *);
+int     tty_input(struct tty *, const char *, size_t);
+int     tty_ioctl(struct tty *, uint64_t, uintptr_t);
+int     tty_read(struct tty *, const struct iovec *, int);
+int     tty_write(struct tty *, const struct iovec *, int);
+
+#endif /* __KERNEL__ */
+#ifdef __cplusplus
+}
+#endif
+#endif /* _ELYSIUM_SYS_TTY_H */
@@ -0,0 +1,66 @@
+/*
+ * uio.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _ELYSIUM_SYS_UIO_H
+#define _ELYSIUM_SYS_UIO_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+
+#define IOV_MAX     1024
+
+struct iovec {
+    void *      iov_base;
+    size_t      iov_len;
+};
+
+#ifdef __KERNEL__
+
+/* vectors up to this size are copied onto the stack rather than the heap */
+#define UIO_SMALLIOV    8
+
+struct thread;
+
+int     iov_copyin(struct thread *, const struct iovec *, int, int, struct iovec *, struct iovec **);
+void    iov_free(struct iovec *, struct iovec *);
+
+/* total number of bytes described by an iovec array */
+static inline size_t
+iov_length(const struct iovec *iov, int iovcnt)
+{
+    int i;
+    size_t len;
+
+    for (i = 0, len = 0; i < iovcnt; i++) {
+        len += iov[i].iov_len;
+    }
+
+    return len;
+}
+
+#else /* __KERNEL__ */
+ssize_t     readv(int, const struct iovec *, int);
+ssize_t     writev(int, const struct iovec *, int);
+ssize_t     preadv(int, const struct iovec *, int, off_t);
+ssize_t     pwritev(int, const struct iovec *, int, off_t);
+#endif /* __KERNEL__ */
+#ifdef __cplusplus
+}
+#endif
+#endif /* _ELYSIUM_SYS_UIO_H */
@@ -0,0 +1,73 @@
+/*
+ * vdso.h
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _ELYSIUM_SYS_VDSO_H
+#define _ELYSIUM_SYS_VDSO_H
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+
+/*
+ * read-only pages the kernel maps into every address space so that libc can
+ * answer time and identity queries without entering the kernel. The layout
+ * is an ABI; fields may only ever be appended
+ */
+#define VDSO_BASE       0xBFF00000
+#define VDSO_SIZE       0x2000
+#define VDSO_TIME_ADDR  VDSO_BASE
+#define VDSO_PROC_ADDR  (VDSO_BASE + 0x1000)
+
+#define VDSO_CONTAINS(addr, len) ((uintptr_t)(addr) < VDSO_BASE + VDSO_SIZE && \
+                                  (uintptr_t)(addr) + (len) > VDSO_BASE)
+
+/*
+ * shared by every address space and updated on each timer tick. Readers
+ * retry while vt_seq is odd or changed underneath them
+ */
+struct vdso_time {
+    volatile uint32_t   vt_seq;
+    uint32_t            vt_hz;          /* ticks per second; 0 if not published */
+    uint32_t            vt_ticks;       /* ticks since boot */
+    uint32_t            vt_tsc_mult;    /* microseconds per TSC cycle as 0.32 fixed point; 0 if unknown */
+    uint64_t            vt_tsc;         /* TSC when vt_ticks last changed */
+    int32_t             vt_delta_sec;   /* wall clock minus uptime, see adjtime() */
+    int32_t             vt_delta_usec;
+};
+
+/* private to each address space */
+struct vdso_proc {
+    pid_t               vp_pid;
+    pid_t               vp_tid;         /* 0 unless the process has a single thread */
+};
+
+#ifdef __KERNEL__
+
+struct vm_space;
+
+void    vdso_adjtime();
+void    vdso_map(struct vm_space *);
+void    vdso_setids(struct vm_space *, pid_t, pid_t);
+void    vdso_tick();
+void    vdso_unmap(struct vm_space *);
+
+#endif /* __KERNEL__ */
+#ifdef __cplusplus
+}
+#endif
+#endif /* _ELYSIUM_SYS_VDSO_H */
@@ -36,6 +36,7 @@ struct vm_space {
     uintptr_t   stack;
     struct va_map * uva_map; /* usermode virtual address map */
     struct va_map * kva_map; /* kernel mode virtual address map*/
+    void *      vdso;        /* page holding this space's struct vdso_proc */
 
     /* used for the architecture specific virtual memory implementation */
     void *      state_physical;
@@ -80,6 +81,7 @@ int                 vm_access(struct vm_space *, const void *, size_t, int);
 struct vm_block *   vm_find_block(struct vm_space *, uintptr_t);
 
 void *              vm_map(struct vm_space *, void *, size_t, int);
+void *              vm_map_pages(struct vm_space *, void *, void **, int, int);
 void *              vm_map_physical(struct vm_space *, void *, uintptr_t, size_t, int);
 void *              vm_share(struct vm_space *, struct vm_space *, void *, void *, size_t, int);
 void                vm_clone(struct vm_space *, struct vm_space *);
@@ -87,4 +89,15 @@ void                vm_space_destroy(struct vm_space *);
 struct              vm_space *vm_space_new();
 void                vm_unmap(struct vm_space *, void *, size_t);
 
+/* pages owned by kernel objects instead of an address space */
+/* frames vm_page_alloc() leaves for the kernel's own use (16 MiB) */
+#define VM_PAGE_RESERVE     4096
+
+void *              vm_page_alloc();
+void *              vm_page_alloc_kernel();
+bool                vm_page_available(int);
+void                vm_page_hold(void *);
+void *              vm_page_kva(void *);
+void                vm_page_release(void *);
+
 #endif
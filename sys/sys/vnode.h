@@ -29,6 +29,7 @@ extern "C" {
 #include <sys/stat.h>
 #include <sys/time.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 #include <sys/limits.h>
 #include <sys/pool.h>
 #include <sys/proc.h>
@@ -60,6 +61,7 @@ typedef int (*vn_mknod_t)(struct vnode *, const char *, mode_t, dev_t);
 typedef int (*vn_mmap_t)(struct vnode *, uintptr_t, size_t size, int, off_t);
 typedef int (*vn_readdirent_t)(struct vnode *, struct dirent *, uint64_t);
 typedef int (*vn_read_t)(struct vnode *, void *, size_t, uint64_t);
+typedef int (*vn_readv_t)(struct vnode *, const struct iovec *, int, uint64_t);
 typedef int (*vn_rmdir_t)(struct vnode *, const char *);
 typedef int (*vn_seek_t)(struct vnode *, off_t *, off_t, int);
 typedef int (*vn_stat_t)(struct vnode *, struct stat *);
@@ -67,6 +69,7 @@ typedef int (*vn_truncate_t)(struct vnode *, off_t);
 typedef int (*vn_unlink_t)(struct vnode *, const char *);
 typedef int (*vn_utimes_t)(struct vnode *, struct timeval[2]);
 typedef int (*vn_write_t)(struct vnode *, const void *, size_t, uint64_t);
+typedef int (*vn_writev_t)(struct vnode *, const struct iovec *, int, uint64_t);
 
 /* vnode methods */
 struct vops {
@@ -79,6 +82,7 @@ struct vops {
     vn_ioctl_t               ioctl;
     vn_lookup_t              lookup;
     vn_read_t                read;
+    vn_readv_t               readv;
     vn_readdirent_t          readdirent;
     vn_rmdir_t               rmdir;
     vn_mkdir_t               mkdir;
@@ -90,6 +94,7 @@ struct vops {
     vn_unlink_t              unlink;
     vn_utimes_t              utimes;
     vn_write_t               write;
+    vn_writev_t              writev;
 };
 
 /*
@@ -207,6 +212,52 @@ VOP_READ(struct vnode *vn, char *buf, size_t nbyte, off_t offset)
     return -(EPERM);
 }
 
+/*
+ * vectored read; filesystems without a native readv are called once per
+ * segment and the transfer stops at the first short read
+ */
+__attribute__((always_inline))
+static inline int
+VOP_READV(struct vnode *vn, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    int i;
+    int res;
+    int total;
+    struct vops *ops;
+    
+    ops = vn->ops;
+
+    if (ops && ops->readv) {
+        return ops->readv(vn, iov, iovcnt, offset);
+    }
+
+    if (!ops || !ops->read) {
+        return -(EPERM);
+    }
+
+    total = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+
+        res = ops->read(vn, iov[i].iov_base, iov[i].iov_len, offset + total);
+
+        if (res < 0) {
+            return total > 0 ? total : res;
+        }
+
+        total += res;
+
+        if (res < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    return total;
+}
+
 __attribute__((always_inline))
 static inline int
 VOP_READDIRENT(struct vnode *vn, struct dirent *dirent, int dirno)
@@ -254,6 +305,47 @@ VOP_WRITE(struct vnode *vn, const char *buf, size_t nbyte, off_t offset)
 
     return -(EPERM);
 }
+__attribute__((always_inline))
+static inline int
+VOP_WRITEV(struct vnode *vn, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    int i;
+    int res;
+    int total;
+    struct vops *ops;
+    
+    ops = vn->ops;
+
+    if (ops->writev) {
+        return ops->writev(vn, iov, iovcnt, offset);
+    }
+
+    if (!ops->write) {
+        return -(EPERM);
+    }
+
+    total = 0;
+
+    for (i = 0; i < iovcnt; i++) {
+        if (iov[i].iov_len == 0) {
+            continue;
+        }
+
+        res = ops->write(vn, iov[i].iov_base, iov[i].iov_len, offset + total);
+
+        if (res < 0) {
+            return total > 0 ? total : res;
+        }
+
+        total += res;
+
+        if (res < iov[i].iov_len) {
+            break;
+        }
+    }
+
+    return total;
+}
 #endif /* __KERNEL__ */
 #ifdef __cplusplus
 }
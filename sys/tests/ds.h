@@ -0,0 +1,78 @@
+/*
+ * ds.h - sys/ds as seen by the host-side tests
+ *
+ * The structures themselves are laid out by the kernel's headers, which the
+ * test programs can't include alongside the host's, so they are only handled
+ * through pointers here. ds_glue.c is built with the kernel's headers and
+ * provides what the tests need beyond the sys/ds interface: allocating the
+ * structures and looking inside them. Everything is renamed with a libk_
+ * prefix like the rest of the kernel code built for the host
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _TESTS_DS_H
+#define _TESTS_DS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+struct dict;
+struct fifo;
+struct list;
+struct membuf;
+
+/* sys/ds/list.c */
+void    libk_list_append(struct list *, void *);
+void *  libk_list_peek_back(struct list *);
+bool    libk_list_remove(struct list *, void *);
+bool    libk_list_remove_front(struct list *, void **);
+bool    libk_list_remove_back(struct list *, void **);
+
+/* sys/ds/dict.c */
+void    libk_dict_clear(struct dict *);
+int     libk_dict_count(struct dict *);
+bool    libk_dict_get(struct dict *, const char *, void **);
+bool    libk_dict_remove(struct dict *, const char *);
+void    libk_dict_set(struct dict *, const char *, void *);
+
+/* sys/ds/fifo.c */
+struct fifo *   libk_fifo_new(uint32_t);
+uint32_t        libk_fifo_read(struct fifo *, void *, uint32_t);
+uint32_t        libk_fifo_write(struct fifo *, void *, uint32_t);
+
+/* sys/ds/membuf.c */
+void            libk_membuf_clear(struct membuf *);
+void            libk_membuf_destroy(struct membuf *);
+struct membuf * libk_membuf_new();
+uint32_t        libk_membuf_read(struct membuf *, void *, uint32_t, int64_t);
+void            libk_membuf_write(struct membuf *, const void *, uint32_t, int64_t);
+
+/* ds_glue.c */
+struct dict *   libk_dict_alloc();
+void            libk_dict_free(struct dict *);
+int             libk_dict_keys(struct dict *, const char **, int);
+int             libk_fifo_count(struct fifo *);
+void            libk_fifo_free(struct fifo *);
+struct list *   libk_list_alloc();
+int             libk_list_count(struct list *);
+void            libk_list_free(struct list *);
+int             libk_list_items(struct list *, void **, int);
+uint32_t        libk_membuf_size(struct membuf *);
+
+/* shim.c */
+extern int shim_blocks;
+extern int shim_locks_held;
+
+#endif
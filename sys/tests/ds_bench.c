@@ -0,0 +1,270 @@
+/*
+ * ds_bench.c - measures how fast sys/ds is on the host
+ *
+ * Rates rather than absolute times are what carry over to the kernel, so
+ * the interesting numbers are how they compare between two builds of the
+ * same structure, and how they fall off as the structures grow
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "ds.h"
+
+/* how many operations each dict and list measurement makes in total */
+#define BENCH_OPS       (1024 * 1024)
+
+/* how many bytes each fifo and membuf measurement moves in total */
+#define BENCH_BYTES     (64 * 1024 * 1024)
+
+#define FIFO_CAPACITY   4096
+
+/* keeps the compiler from discarding results */
+static volatile int sink;
+
+static char (*key_names)[16];
+
+static uint64_t
+now_nsec()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+report(const char *name, int size, double amount, const char *unit, uint64_t nsec)
+{
+    printf("%-16s %8d %12.1f %s\n", name, size, amount * 1000000000 / nsec, unit);
+}
+
+static void
+bench_dict(int size)
+{
+    int i;
+    int round;
+    int rounds;
+    uint64_t get_nsec;
+    uint64_t remove_nsec;
+    uint64_t set_nsec;
+    uint64_t start;
+    void *value;
+    struct dict *dict;
+
+    rounds = BENCH_OPS / size / 8 + 1;
+    get_nsec = 0;
+    remove_nsec = 0;
+    set_nsec = 0;
+
+    dict = libk_dict_alloc();
+
+    for (round = 0; round < rounds; round++) {
+        start = now_nsec();
+
+        for (i = 0; i < size; i++) {
+            libk_dict_set(dict, key_names[i], key_names[i]);
+        }
+
+        set_nsec += now_nsec() - start;
+        start = now_nsec();
+
+        for (i = 0; i < size; i++) {
+            sink += libk_dict_get(dict, key_names[(i * 7) % size], &value);
+        }
+
+        get_nsec += now_nsec() - start;
+        start = now_nsec();
+
+        for (i = 0; i < size; i++) {
+            sink += libk_dict_remove(dict, key_names[i]);
+        }
+
+        remove_nsec += now_nsec() - start;
+    }
+
+    libk_dict_free(dict);
+
+    report("dict_set", size, (double)rounds * size, "ops/s", set_nsec);
+    report("dict_get", size, (double)rounds * size, "ops/s", get_nsec);
+    report("dict_remove", size, (double)rounds * size, "ops/s", remove_nsec);
+}
+
+/* appending to the back and taking from the front, as a queue */
+static void
+bench_list(int size)
+{
+    int i;
+    int round;
+    int rounds;
+    uint64_t start;
+    void *item;
+    struct list *list;
+
+    rounds = BENCH_OPS / size + 1;
+    list = libk_list_alloc();
+
+    start = now_nsec();
+
+    for (round = 0; round < rounds; round++) {
+        for (i = 0; i < size; i++) {
+            libk_list_append(list, key_names[i]);
+        }
+
+        for (i = 0; i < size; i++) {
+            libk_list_remove_front(list, &item);
+        }
+    }
+
+    report("list_queue", size, (double)rounds * size * 2, "ops/s", now_nsec() - start);
+
+    /* removing by value has to find the item first */
+    for (i = 0; i < size; i++) {
+        libk_list_append(list, key_names[i]);
+    }
+
+    rounds = BENCH_OPS / size / 8 + 1;
+    start = now_nsec();
+
+    for (round = 0; round < rounds; round++) {
+        for (i = 0; i < size; i++) {
+            libk_list_remove(list, key_names[(i * 7) % size]);
+            libk_list_append(list, key_names[(i * 7) % size]);
+        }
+    }
+
+    report("list_remove", size, (double)rounds * size, "ops/s", now_nsec() - start);
+
+    libk_list_free(list);
+}
+
+/* moves BENCH_BYTES through the fifo, chunk bytes at a time */
+static void
+bench_fifo(int chunk)
+{
+    int i;
+    int iterations;
+    uint64_t start;
+    unsigned char *buf;
+    struct fifo *fifo;
+
+    buf = calloc(1, chunk);
+    fifo = libk_fifo_new(FIFO_CAPACITY);
+
+    iterations = BENCH_BYTES / chunk;
+    start = now_nsec();
+
+    for (i = 0; i < iterations; i++) {
+        libk_fifo_write(fifo, buf, chunk);
+        sink += libk_fifo_read(fifo, buf, chunk);
+    }
+
+    report("fifo", chunk, BENCH_BYTES / (1024.0 * 1024.0), "MB/s", now_nsec() - start);
+
+    libk_fifo_free(fifo);
+    free(buf);
+}
+
+/* writes a file of size bytes front to back in chunk sized writes, then reads it at random */
+static void
+bench_membuf(int size, int chunk)
+{
+    char name[32];
+    int i;
+    int iterations;
+    int pos;
+    uint32_t rand_state;
+    uint64_t start;
+    unsigned char *buf;
+    struct membuf *mb;
+
+    buf = calloc(1, chunk);
+    iterations = BENCH_BYTES / size;
+
+    start = now_nsec();
+
+    for (i = 0; i < iterations; i++) {
+        mb = libk_membuf_new();
+
+        for (pos = 0; pos < size; pos += chunk) {
+            libk_membuf_write(mb, buf, chunk, pos);
+        }
+
+        libk_membuf_destroy(mb);
+    }
+
+    sprintf(name, "membuf_write%d", chunk);
+    report(name, size, BENCH_BYTES / (1024.0 * 1024.0), "MB/s", now_nsec() - start);
+
+    mb = libk_membuf_new();
+
+    for (pos = 0; pos < size; pos += chunk) {
+        libk_membuf_write(mb, buf, chunk, pos);
+    }
+
+    iterations = BENCH_BYTES / chunk / 16;
+    rand_state = 1;
+    start = now_nsec();
+
+    for (i = 0; i < iterations; i++) {
+        rand_state = rand_state * 1103515245 + 12345;
+        pos = (rand_state >> 8) % (size - chunk + 1);
+        sink += libk_membuf_read(mb, buf, chunk, pos);
+    }
+
+    sprintf(name, "membuf_read%d", chunk);
+    report(name, size, iterations, "ops/s", now_nsec() - start);
+
+    libk_membuf_destroy(mb);
+    free(buf);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int i;
+
+    key_names = calloc(65536, sizeof(key_names[0]));
+
+    for (i = 0; i < 65536; i++) {
+        sprintf(key_names[i], "name%d", i);
+    }
+
+    printf("%-16s %8s %12s\n", "test", "size", "rate");
+
+    bench_dict(16);
+    bench_dict(256);
+    bench_dict(4096);
+    bench_dict(65536);
+
+    bench_list(16);
+    bench_list(1024);
+
+    bench_fifo(1);
+    bench_fifo(64);
+    bench_fifo(1024);
+
+    bench_membuf(16 * 1024, 512);
+    bench_membuf(1024 * 1024, 512);
+    bench_membuf(1024 * 1024, 4096);
+
+    free(key_names);
+
+    return 0;
+}
@@ -0,0 +1,115 @@
+/*
+ * ds_glue.c - what the host-side tests need to get at sys/ds
+ *
+ * Built like the kernel sources, with the kernel's headers, so that it can
+ * allocate the structures and read the fields the tests check
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <ds/dict.h>
+#include <ds/fifo.h>
+#include <ds/list.h>
+#include <ds/membuf.h>
+#include <sys/malloc.h>
+#include <sys/types.h>
+
+struct dict *
+dict_alloc()
+{
+    return calloc(1, sizeof(struct dict));
+}
+
+void
+dict_free(struct dict *dict)
+{
+    dict_clear(dict);
+    free(dict);
+}
+
+/* copies up to max keys, in the order they were added */
+int
+dict_keys(struct dict *dict, const char **keys, int max)
+{
+    int i;
+    list_iter_t iter;
+    char *key;
+
+    dict_get_keys(dict, &iter);
+
+    for (i = 0; i < max && iter_move_next(&iter, (void**)&key); i++) {
+        keys[i] = key;
+    }
+
+    iter_close(&iter);
+
+    return i;
+}
+
+int
+fifo_count(struct fifo *fifo)
+{
+    return FIFO_SIZE(fifo);
+}
+
+void
+fifo_free(struct fifo *fifo)
+{
+    free(fifo->buf);
+    free(fifo);
+}
+
+struct list *
+list_alloc()
+{
+    return calloc(1, sizeof(struct list));
+}
+
+int
+list_count(struct list *listp)
+{
+    return LIST_SIZE(listp);
+}
+
+void
+list_free(struct list *listp)
+{
+    list_destroy(listp, false);
+    free(listp);
+}
+
+/* copies up to max items from head to tail */
+int
+list_items(struct list *listp, void **items, int max)
+{
+    int i;
+    list_iter_t iter;
+    void *item;
+
+    list_get_iter(listp, &iter);
+
+    for (i = 0; i < max && iter_move_next(&iter, &item); i++) {
+        items[i] = item;
+    }
+
+    iter_close(&iter);
+
+    return i;
+}
+
+uint32_t
+membuf_size(struct membuf *mb)
+{
+    return MEMBUF_SIZE(mb);
+}
@@ -0,0 +1,497 @@
+/*
+ * ds_test.c - checks sys/ds against simple reference models
+ *
+ * Each structure gets a few directed checks for the corners it has had bugs
+ * in, then a long run of random operations applied both to it and to a
+ * model that is obviously right, comparing the two after every step. When
+ * a structure is destroyed every block it allocated must have been freed,
+ * and no operation may return with a lock still held
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ds.h"
+
+#define STEPS           20000
+
+#define LIST_MAX        256
+#define DICT_KEYS       400
+#define FIFO_CAPACITY   61
+#define MEMBUF_MAX      (20 * 1024)
+
+#define CHECK(cond, ...) do {                       \
+    if (!(cond)) {                                  \
+        failures++;                                 \
+        if (failures <= 20) {                       \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                    \
+            printf("\n");                           \
+        }                                           \
+    }                                               \
+} while (0)
+
+static int failures;
+static int checks;
+
+static uint32_t rand_state = 0x2545F491;
+
+/* xorshift32; the same sequence on every host so failures can be replayed */
+static uint32_t
+next_rand(uint32_t limit)
+{
+    rand_state ^= rand_state << 13;
+    rand_state ^= rand_state >> 17;
+    rand_state ^= rand_state << 5;
+
+    return rand_state % limit;
+}
+
+/* list items are never dereferenced, so small integers will do */
+static void *
+item(int value)
+{
+    return (void*)(uintptr_t)(value + 1);
+}
+
+static void
+check_list(struct list *list, void **model, int count, int step)
+{
+    int i;
+    int n;
+    void *items[LIST_MAX];
+
+    checks++;
+
+    n = libk_list_items(list, items, LIST_MAX);
+
+    CHECK(libk_list_count(list) == count, "step %d: list has %d items, expected %d", step,
+            libk_list_count(list), count);
+    CHECK(n == count, "step %d: iterated over %d items, expected %d", step, n, count);
+    CHECK(libk_list_peek_back(list) == (count ? model[count - 1] : NULL),
+            "step %d: peek_back returned the wrong item", step);
+
+    for (i = 0; i < n && i < count; i++) {
+        CHECK(items[i] == model[i], "step %d: item %d is %p, expected %p", step, i, items[i], model[i]);
+    }
+
+    CHECK(shim_locks_held == 0, "step %d: list lock left held", step);
+}
+
+static void
+test_list()
+{
+    bool res;
+    int blocks;
+    int count;
+    int i;
+    int step;
+    int next_value;
+    void *model[LIST_MAX];
+    void *removed;
+    struct list *list;
+
+    blocks = shim_blocks;
+    list = libk_list_alloc();
+
+    /* removing from an empty list */
+    removed = NULL;
+
+    checks++;
+    CHECK(!libk_list_remove_front(list, &removed) && removed == NULL, "remove_front on empty list");
+    CHECK(!libk_list_remove_back(list, &removed) && removed == NULL, "remove_back on empty list");
+    CHECK(!libk_list_remove(list, item(0)), "remove on empty list");
+
+    count = 0;
+    next_value = 0;
+
+    for (step = 0; step < STEPS; step++) {
+        switch (next_rand(5)) {
+            case 0:
+            case 1:
+                if (count == LIST_MAX) {
+                    break;
+                }
+
+                model[count++] = item(next_value);
+                libk_list_append(list, item(next_value++));
+                break;
+            case 2:
+                res = libk_list_remove_front(list, &removed);
+
+                CHECK(res == (count > 0), "step %d: remove_front returned %d", step, res);
+
+                if (res && count > 0) {
+                    CHECK(removed == model[0], "step %d: remove_front removed the wrong item", step);
+                    memmove(&model[0], &model[1], sizeof(model[0]) * --count);
+                }
+                break;
+            case 3:
+                res = libk_list_remove_back(list, &removed);
+
+                CHECK(res == (count > 0), "step %d: remove_back returned %d", step, res);
+
+                if (res && count > 0) {
+                    CHECK(removed == model[count - 1], "step %d: remove_back removed the wrong item",
+                            step);
+                    count--;
+                }
+                break;
+            case 4:
+                /* one time in four something that isn't there */
+                if (count == 0 || next_rand(4) == 0) {
+                    CHECK(!libk_list_remove(list, item(next_value)),
+                            "step %d: removed an item that was never added", step);
+                    break;
+                }
+
+                i = next_rand(count);
+
+                CHECK(libk_list_remove(list, model[i]), "step %d: couldn't remove item %d", step, i);
+                memmove(&model[i], &model[i + 1], sizeof(model[0]) * (count - i - 1));
+                count--;
+                break;
+        }
+
+        check_list(list, model, count, step);
+    }
+
+    libk_list_free(list);
+
+    checks++;
+    CHECK(shim_blocks == blocks, "list leaked %d blocks", shim_blocks - blocks);
+}
+
+static void
+key_name(char *buf, int key)
+{
+    sprintf(buf, "key%d", key);
+}
+
+static void
+check_dict(struct dict *dict, int *model, int step)
+{
+    bool found;
+    bool seen[DICT_KEYS];
+    char name[32];
+    const char *keys[DICT_KEYS + 1];
+    int count;
+    int i;
+    int key;
+    int n;
+    void *value;
+
+    checks++;
+
+    count = 0;
+
+    for (i = 0; i < DICT_KEYS; i++) {
+        key_name(name, i);
+        value = NULL;
+        found = libk_dict_get(dict, name, &value);
+
+        if (model[i]) {
+            count++;
+            CHECK(found && value == item(model[i]), "step %d: %s has the wrong value", step, name);
+        } else {
+            CHECK(!found, "step %d: found %s after it was removed", step, name);
+        }
+    }
+
+    CHECK(libk_dict_count(dict) == count, "step %d: dict has %d keys, expected %d", step,
+            libk_dict_count(dict), count);
+
+    /* every key present once, and nothing else */
+    memset(seen, 0, sizeof(seen));
+
+    n = libk_dict_keys(dict, keys, DICT_KEYS + 1);
+
+    CHECK(n == count, "step %d: dict lists %d keys, expected %d", step, n, count);
+
+    for (i = 0; i < n; i++) {
+        if (sscanf(keys[i], "key%d", &key) != 1 || key < 0 || key >= DICT_KEYS) {
+            CHECK(0, "step %d: unexpected key \"%s\"", step, keys[i]);
+            continue;
+        }
+
+        CHECK(model[key] && !seen[key], "step %d: %s listed wrongly", step, keys[i]);
+        seen[key] = true;
+    }
+
+    CHECK(shim_locks_held == 0, "step %d: dict lock left held", step);
+}
+
+static void
+test_dict()
+{
+    bool res;
+    char name[32];
+    int blocks;
+    int key;
+    int model[DICT_KEYS];
+    int step;
+    void *value;
+    struct dict *dict;
+
+    blocks = shim_blocks;
+    dict = libk_dict_alloc();
+
+    memset(model, 0, sizeof(model));
+
+    /* nothing is in an empty dict */
+    checks++;
+    CHECK(!libk_dict_get(dict, "key0", &value), "found a key in an empty dict");
+    CHECK(!libk_dict_remove(dict, "key0"), "removed a key from an empty dict");
+
+    /* the bucket outlives the only key that was in it */
+    libk_dict_set(dict, "key0", item(1));
+    libk_dict_remove(dict, "key0");
+
+    checks++;
+    CHECK(!libk_dict_get(dict, "key0", &value), "found a key after it was removed");
+
+    /* setting a key twice keeps one copy */
+    libk_dict_set(dict, "key0", item(1));
+    libk_dict_set(dict, "key0", item(2));
+    model[0] = 2;
+
+    check_dict(dict, model, -1);
+
+    for (step = 0; step < STEPS / 10; step++) {
+        key = next_rand(DICT_KEYS);
+        key_name(name, key);
+
+        if (next_rand(3) != 0) {
+            model[key] = step + 1;
+            libk_dict_set(dict, name, item(step + 1));
+        } else {
+            res = libk_dict_remove(dict, name);
+
+            CHECK(res == (model[key] != 0), "step %d: removing %s returned %d", step, name, res);
+
+            model[key] = 0;
+        }
+
+        /* comparing everything is slow; every step near the start, then now and then */
+        if (step < 200 || (step % 97) == 0) {
+            check_dict(dict, model, step);
+        }
+    }
+
+    check_dict(dict, model, step);
+
+    /* clearing leaves an empty dict that can be used again */
+    libk_dict_clear(dict);
+    memset(model, 0, sizeof(model));
+
+    check_dict(dict, model, step);
+
+    libk_dict_set(dict, "key1", item(1));
+    model[1] = 1;
+
+    check_dict(dict, model, step);
+
+    libk_dict_free(dict);
+
+    checks++;
+    CHECK(shim_blocks == blocks, "dict leaked %d blocks", shim_blocks - blocks);
+}
+
+static void
+test_fifo()
+{
+    int blocks;
+    int head;
+    int i;
+    int nbyte;
+    int model_size;
+    int step;
+    uint32_t res;
+    unsigned char buf[FIFO_CAPACITY * 2];
+    unsigned char model[FIFO_CAPACITY];
+    unsigned char next_byte;
+    struct fifo *fifo;
+
+    blocks = shim_blocks;
+    fifo = libk_fifo_new(FIFO_CAPACITY);
+
+    /* the model is a ring of its own; head is where the oldest byte is */
+    head = 0;
+    model_size = 0;
+    next_byte = 0;
+
+    for (step = 0; step < STEPS; step++) {
+        nbyte = next_rand(FIFO_CAPACITY * 2);
+
+        checks++;
+
+        if (next_rand(2)) {
+            for (i = 0; i < nbyte; i++) {
+                buf[i] = next_byte + i;
+            }
+
+            res = libk_fifo_write(fifo, buf, nbyte);
+
+            /* a full fifo takes what fits and drops the rest */
+            if (nbyte > FIFO_CAPACITY - model_size) {
+                nbyte = FIFO_CAPACITY - model_size;
+            }
+
+            CHECK(res == nbyte, "step %d: wrote %u bytes, expected %d", step, res, nbyte);
+
+            for (i = 0; i < nbyte; i++) {
+                model[(head + model_size++) % FIFO_CAPACITY] = next_byte++;
+            }
+        } else {
+            memset(buf, 0, sizeof(buf));
+
+            res = libk_fifo_read(fifo, buf, nbyte);
+
+            if (nbyte > model_size) {
+                nbyte = model_size;
+            }
+
+            CHECK(res == nbyte, "step %d: read %u bytes, expected %d", step, res, nbyte);
+
+            for (i = 0; i < nbyte; i++) {
+                CHECK(buf[i] == model[head], "step %d: byte %d read as %d, expected %d", step, i,
+                        buf[i], model[head]);
+
+                head = (head + 1) % FIFO_CAPACITY;
+                model_size--;
+            }
+        }
+
+        CHECK(libk_fifo_count(fifo) == model_size, "step %d: fifo holds %d bytes, expected %d", step,
+                libk_fifo_count(fifo), model_size);
+        CHECK(shim_locks_held == 0, "step %d: fifo lock left held", step);
+    }
+
+    libk_fifo_free(fifo);
+
+    checks++;
+    CHECK(shim_blocks == blocks, "fifo leaked %d blocks", shim_blocks - blocks);
+}
+
+static void
+check_membuf(struct membuf *mb, unsigned char *model, int size, int step)
+{
+    int end;
+    int nbyte;
+    int pos;
+    uint32_t res;
+    static unsigned char buf[MEMBUF_MAX + 4096];
+
+    checks++;
+
+    CHECK(libk_membuf_size(mb) == size, "step %d: membuf has %u bytes, expected %d", step,
+            libk_membuf_size(mb), size);
+
+    /* sometimes all of it, otherwise anywhere, including past the end */
+    if (next_rand(8) == 0) {
+        pos = 0;
+        nbyte = size;
+    } else {
+        pos = next_rand(MEMBUF_MAX);
+        nbyte = next_rand(4096 + 1);
+    }
+
+    memset(buf, 0xA5, sizeof(buf));
+
+    res = libk_membuf_read(mb, buf, nbyte, pos);
+
+    end = pos + nbyte > size ? size : pos + nbyte;
+
+    if (end < pos) {
+        end = pos;
+    }
+
+    CHECK(res == end - pos, "step %d: read %u bytes at %d, expected %d", step, res, pos, end - pos);
+    CHECK(memcmp(buf, model + pos, end - pos) == 0, "step %d: read wrong data at %d", step, pos);
+    CHECK(buf[end - pos] == 0xA5, "step %d: read past %d bytes", step, end - pos);
+    CHECK(shim_locks_held == 0, "step %d: membuf lock left held", step);
+}
+
+static void
+test_membuf()
+{
+    int blocks;
+    int i;
+    int nbyte;
+    int pos;
+    int size;
+    int step;
+    static unsigned char buf[4096];
+    static unsigned char model[MEMBUF_MAX + 4096];
+    struct membuf *mb;
+
+    blocks = shim_blocks;
+    mb = libk_membuf_new();
+
+    /* the model is the file it would be; bytes never written read as zeroes */
+    memset(model, 0, sizeof(model));
+    size = 0;
+
+    check_membuf(mb, model, size, -1);
+
+    for (step = 0; step < STEPS / 4; step++) {
+        /* mostly small writes, sometimes long ones spanning several blocks */
+        pos = next_rand(MEMBUF_MAX - 4096);
+        nbyte = next_rand(8) ? next_rand(600) : next_rand(4096);
+
+        for (i = 0; i < nbyte; i++) {
+            buf[i] = (unsigned char)next_rand(256);
+        }
+
+        libk_membuf_write(mb, buf, nbyte, pos);
+
+        memcpy(model + pos, buf, nbyte);
+
+        if (pos + nbyte > size) {
+            size = pos + nbyte;
+        }
+
+        check_membuf(mb, model, size, step);
+
+        /* truncating starts over from an empty file */
+        if (next_rand(500) == 0) {
+            libk_membuf_clear(mb);
+            memset(model, 0, sizeof(model));
+            size = 0;
+
+            check_membuf(mb, model, size, step);
+        }
+    }
+
+    libk_membuf_destroy(mb);
+
+    checks++;
+    CHECK(shim_blocks == blocks, "membuf leaked %d blocks", shim_blocks - blocks);
+}
+
+int
+main(int argc, char *argv[])
+{
+    test_list();
+    test_dict();
+    test_fifo();
+    test_membuf();
+
+    printf("%d checks, %d failures\n", checks, failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,38 @@
+/*
+ * libk.h - sys/libk as seen by the host-side tests
+ *
+ * Everything from sys/libk is renamed with a libk_ prefix when it's built for
+ * the host. The kernel's size_t is 32 bits wide, so lengths passed to these
+ * must stay below 4GB
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#ifndef _TESTS_LIBK_H
+#define _TESTS_LIBK_H
+
+#include <stdint.h>
+
+#define LIBK_PAGE_SIZE  4096
+
+int     libk_memcmp(const void *, const void *, uint32_t);
+void *  libk_memcpy(void *, const void *, uint32_t);
+void *  libk_memmove(void *, const void *, uint32_t);
+void *  libk_memset(void *, int, uint32_t);
+void    libk_page_copy(void *, const void *);
+void    libk_page_zero(void *);
+int     libk_strcmp(const char *, const char *);
+int     libk_strlen(const char *);
+
+#endif
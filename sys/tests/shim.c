@@ -0,0 +1,102 @@
+/*
+ * shim.c - the parts of the kernel sys/ds relies on, for the host
+ *
+ * Allocations go to the host's heap and are counted, so the tests can tell
+ * when a data structure leaks. There's only ever one thread, so a lock that
+ * is taken while it's held would never be released in the kernel either;
+ * that, and releasing a lock nobody holds, aborts the test
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "ds.h"
+
+/* must match spinlock_t in sys/sys/mutex.h without LOCK_STATS */
+struct shim_lock {
+    volatile uint16_t   owner;
+    volatile uint16_t   next;
+};
+
+/* blocks allocated and not yet freed */
+int shim_blocks;
+
+int shim_locks_held;
+
+void
+libk_panic(const char *fmt, ...)
+{
+    va_list args;
+
+    va_start(args, fmt);
+    fprintf(stderr, "panic: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+
+    abort();
+}
+
+void *
+libk_malloc(uint32_t size)
+{
+    shim_blocks++;
+
+    return malloc(size);
+}
+
+void *
+libk_calloc(int num, uint32_t size)
+{
+    shim_blocks++;
+
+    return calloc(num, size);
+}
+
+void
+libk_free(void *ptr)
+{
+    /* like the kernel's, which finds nothing to free */
+    if (!ptr) {
+        libk_panic("double free (0x%p)", ptr);
+    }
+
+    shim_blocks--;
+    free(ptr);
+}
+
+void
+libk_spinlock_lock(struct shim_lock *lock)
+{
+    if (lock->owner != lock->next) {
+        libk_panic("spinlock %p taken while held", (void*)lock);
+    }
+
+    lock->next++;
+    shim_locks_held++;
+}
+
+void
+libk_spinlock_unlock(struct shim_lock *lock)
+{
+    if (lock->owner == lock->next) {
+        libk_panic("spinlock %p released while free", (void*)lock);
+    }
+
+    lock->owner++;
+    shim_locks_held--;
+}
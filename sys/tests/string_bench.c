@@ -0,0 +1,266 @@
+/*
+ * string_bench.c - throughput of sys/libk/string.c on the host
+ *
+ * Each routine is timed against a plain byte loop, which is what libk used to
+ * do, and against the host's C library. Output is one line per measurement:
+ *
+ *     <routine> <size> <implementation> <MB/s>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "libk.h"
+
+/* how many bytes each measurement moves in total */
+#define BENCH_BYTES     (256 * 1024 * 1024)
+
+static unsigned char *buf1;
+static unsigned char *buf2;
+
+/* keeps the compiler from discarding results */
+static volatile int sink;
+
+static uint64_t
+now_nsec()
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void
+report(const char *name, size_t size, const char *impl, uint64_t nsec)
+{
+    printf("%-8s %8zu %-6s %10.1f\n", name, size, impl, (double)BENCH_BYTES * 1000 / nsec);
+}
+
+static void *
+byte_memcpy(void *dest, const void *src, uint32_t nbyte)
+{
+    volatile unsigned char *d = dest;
+    const unsigned char *s = src;
+
+    while (nbyte--) {
+        *d++ = *s++;
+    }
+
+    return dest;
+}
+
+static void *
+byte_memset(void *ptr, int value, uint32_t nbyte)
+{
+    volatile unsigned char *p = ptr;
+
+    while (nbyte--) {
+        *p++ = (unsigned char)value;
+    }
+
+    return ptr;
+}
+
+static int
+byte_memcmp(const void *buf1, const void *buf2, uint32_t nbyte)
+{
+    const volatile unsigned char *s1 = buf1;
+    const volatile unsigned char *s2 = buf2;
+
+    for (; nbyte > 0; nbyte--, s1++, s2++) {
+        if (*s1 != *s2) {
+            return *s1 - *s2;
+        }
+    }
+
+    return 0;
+}
+
+static int
+byte_strlen(const char *str)
+{
+    const volatile char *s = str;
+
+    while (*s) {
+        s++;
+    }
+
+    return s - str;
+}
+
+static void
+bench_memcpy(size_t size, const char *impl, void *(*fn)(void *, const void *, uint32_t))
+{
+    size_t i;
+    size_t iterations;
+    uint64_t start;
+
+    iterations = BENCH_BYTES / size;
+    start = now_nsec();
+
+    for (i = 0; i < iterations; i++) {
+        fn(buf2, buf1, size);
+    }
+
+    report("memcpy", size, impl, now_nsec() - start);
+}
+
+static void
+bench_memset(size_t size, const char *impl, void *(*fn)(void *, int, uint32_t))
+{
+    size_t i;
+    size_t iterations;
+    uint64_t start;
+
+    iterations = BENCH_BYTES / size;
+    start = now_nsec();
+
+    for (i = 0; i < iterations; i++) {
+        fn(buf2, (int)i, size);
+    }
+
+    report("memset", size, impl, now_nsec() - start);
+}
+
+static void
+bench_memcmp(size_t size, const char *impl, int (*fn)(const void *, const void *, uint32_t))
+{
+    size_t i;
+    size_t iterations;
+    uint64_t start;
+
+    memcpy(buf2, buf1, size);
+
+    iterations = BENCH_BYTES / size;
+    start = now_nsec();
+
+    for (i = 0; i < iterations; i++) {
+        sink += fn(buf1, buf2, size);
+    }
+
+    report("memcmp", size, impl, now_nsec() - start);
+}
+
+static void
+bench_strlen(size_t size, const char *impl, int (*fn)(const char *))
+{
+    size_t i;
+    size_t iterations;
+    uint64_t start;
+
+    memset(buf1, 'x', size);
+    buf1[size - 1] = 0;
+
+    iterations = BENCH_BYTES / size;
+    start = now_nsec();
+
+    for (i = 0; i < iterations; i++) {
+        sink += fn((char*)buf1);
+    }
+
+    report("strlen", size, impl, now_nsec() - start);
+}
+
+static void
+bench_page(const char *impl, int zero)
+{
+    size_t i;
+    size_t iterations;
+    uint64_t start;
+
+    iterations = BENCH_BYTES / LIBK_PAGE_SIZE;
+    start = now_nsec();
+
+    for (i = 0; i < iterations; i++) {
+        if (zero) {
+            libk_page_zero(buf2);
+        } else {
+            libk_page_copy(buf2, buf1);
+        }
+    }
+
+    report(zero ? "pagezero" : "pagecopy", LIBK_PAGE_SIZE, impl, now_nsec() - start);
+}
+
+static int
+host_memcmp(const void *buf1, const void *buf2, uint32_t nbyte)
+{
+    return memcmp(buf1, buf2, nbyte);
+}
+
+static void *
+host_memcpy(void *dest, const void *src, uint32_t nbyte)
+{
+    return memcpy(dest, src, nbyte);
+}
+
+static void *
+host_memset(void *ptr, int value, uint32_t nbyte)
+{
+    return memset(ptr, value, nbyte);
+}
+
+static int
+host_strlen(const char *str)
+{
+    return strlen(str);
+}
+
+int
+main(int argc, char *argv[])
+{
+    static const size_t sizes[] = { 16, 64, 256, 1024, 4096, 65536 };
+
+    int i;
+    size_t size;
+
+    buf1 = aligned_alloc(LIBK_PAGE_SIZE, 65536);
+    buf2 = aligned_alloc(LIBK_PAGE_SIZE, 65536);
+
+    memset(buf1, 0x5A, 65536);
+    memset(buf2, 0, 65536);
+
+    for (i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        size = sizes[i];
+
+        bench_memcpy(size, "byte", byte_memcpy);
+        bench_memcpy(size, "libk", libk_memcpy);
+        bench_memcpy(size, "host", host_memcpy);
+
+        bench_memset(size, "byte", byte_memset);
+        bench_memset(size, "libk", libk_memset);
+        bench_memset(size, "host", host_memset);
+
+        bench_memcmp(size, "byte", byte_memcmp);
+        bench_memcmp(size, "libk", libk_memcmp);
+        bench_memcmp(size, "host", host_memcmp);
+
+        bench_strlen(size, "byte", byte_strlen);
+        bench_strlen(size, "libk", libk_strlen);
+        bench_strlen(size, "host", host_strlen);
+    }
+
+    bench_page("libk", 0);
+    bench_page("libk", 1);
+
+    free(buf1);
+    free(buf2);
+
+    return 0;
+}
@@ -0,0 +1,267 @@
+/*
+ * string_test.c - checks sys/libk/string.c against the host's C library
+ *
+ * Every routine is run over all combinations of source and destination
+ * alignment and a range of lengths, inside guard bytes that must come out
+ * untouched
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libk.h"
+
+#define BUF_SIZE    256
+#define MAX_LEN     160
+#define GUARD       0xA5
+
+#define SIGN(x)     (((x) > 0) - ((x) < 0))
+
+#define CHECK(cond, ...) do {                       \
+    if (!(cond)) {                                  \
+        failures++;                                 \
+        if (failures <= 20) {                       \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__);                    \
+            printf("\n");                           \
+        }                                           \
+    }                                               \
+} while (0)
+
+static int failures;
+static int checks;
+
+static unsigned char src_buf[BUF_SIZE];
+static unsigned char dst_buf[BUF_SIZE];
+static unsigned char ref_buf[BUF_SIZE];
+
+static void
+fill_pattern(unsigned char *buf, size_t size, unsigned int seed)
+{
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        buf[i] = (unsigned char)(seed + i * 7 + 1);
+    }
+}
+
+static void
+test_memcpy()
+{
+    int dst_off;
+    int src_off;
+    int len;
+    void *ret;
+
+    for (dst_off = 0; dst_off < 8; dst_off++)
+    for (src_off = 0; src_off < 8; src_off++)
+    for (len = 0; len <= MAX_LEN; len++) {
+        fill_pattern(src_buf, BUF_SIZE, len);
+        memset(dst_buf, GUARD, BUF_SIZE);
+        memset(ref_buf, GUARD, BUF_SIZE);
+
+        ret = libk_memcpy(dst_buf + dst_off, src_buf + src_off, len);
+        memcpy(ref_buf + dst_off, src_buf + src_off, len);
+
+        checks++;
+        CHECK(ret == dst_buf + dst_off, "memcpy returned the wrong pointer");
+        CHECK(memcmp(dst_buf, ref_buf, BUF_SIZE) == 0,
+                "memcpy dst+%d src+%d len %d", dst_off, src_off, len);
+    }
+}
+
+static void
+test_memmove()
+{
+    int dst_off;
+    int src_off;
+    int len;
+    void *ret;
+
+    /* both regions inside one buffer, so every kind of overlap is covered */
+    for (dst_off = 0; dst_off < 24; dst_off++)
+    for (src_off = 0; src_off < 24; src_off++)
+    for (len = 0; len <= MAX_LEN; len += (len < 40) ? 1 : 7) {
+        fill_pattern(dst_buf, BUF_SIZE, len);
+        fill_pattern(ref_buf, BUF_SIZE, len);
+
+        ret = libk_memmove(dst_buf + dst_off, dst_buf + src_off, len);
+        memmove(ref_buf + dst_off, ref_buf + src_off, len);
+
+        checks++;
+        CHECK(ret == dst_buf + dst_off, "memmove returned the wrong pointer");
+        CHECK(memcmp(dst_buf, ref_buf, BUF_SIZE) == 0,
+                "memmove dst+%d src+%d len %d", dst_off, src_off, len);
+    }
+}
+
+static void
+test_memset()
+{
+    static const int values[] = { 0, 1, 0x7F, 0x80, 0xFF, 0x1234, -1 };
+
+    int off;
+    int len;
+    int v;
+    void *ret;
+
+    for (v = 0; v < sizeof(values) / sizeof(values[0]); v++)
+    for (off = 0; off < 8; off++)
+    for (len = 0; len <= MAX_LEN; len++) {
+        memset(dst_buf, GUARD, BUF_SIZE);
+        memset(ref_buf, GUARD, BUF_SIZE);
+
+        ret = libk_memset(dst_buf + off, values[v], len);
+        memset(ref_buf + off, values[v], len);
+
+        checks++;
+        CHECK(ret == dst_buf + off, "memset returned the wrong pointer");
+        CHECK(memcmp(dst_buf, ref_buf, BUF_SIZE) == 0,
+                "memset value %x off %d len %d", values[v], off, len);
+    }
+}
+
+static void
+test_memcmp()
+{
+    int off1;
+    int off2;
+    int len;
+    int diff;
+    unsigned char *buf1;
+    unsigned char *buf2;
+
+    buf1 = src_buf;
+    buf2 = dst_buf;
+
+    for (off1 = 0; off1 < 4; off1++)
+    for (off2 = 0; off2 < 4; off2++)
+    for (len = 0; len <= 64; len++)
+    for (diff = -1; diff < len; diff++) {
+        fill_pattern(buf1, BUF_SIZE, 0);
+        fill_pattern(buf2, BUF_SIZE, 0);
+        memcpy(buf2 + off2, buf1 + off1, len);
+
+        /* a high bit difference catches comparisons done on signed chars */
+        if (diff >= 0) {
+            buf2[off2 + diff] ^= (diff & 1) ? 0x80 : 0x01;
+        }
+
+        checks++;
+        CHECK(SIGN(libk_memcmp(buf1 + off1, buf2 + off2, len)) ==
+                SIGN(memcmp(buf1 + off1, buf2 + off2, len)),
+                "memcmp off %d/%d len %d diff at %d", off1, off2, len, diff);
+    }
+}
+
+static void
+test_strlen()
+{
+    int off;
+    int len;
+
+    for (off = 0; off < 8; off++)
+    for (len = 0; len <= MAX_LEN; len++) {
+        memset(src_buf, 'x', BUF_SIZE);
+        src_buf[off + len] = 0;
+
+        checks++;
+        CHECK(libk_strlen((char*)src_buf + off) == len, "strlen off %d len %d", off, len);
+    }
+}
+
+static void
+test_strcmp()
+{
+    int off1;
+    int off2;
+    int len;
+    int diff;
+    char *str1;
+    char *str2;
+
+    str1 = (char*)src_buf;
+    str2 = (char*)dst_buf;
+
+    for (off1 = 0; off1 < 4; off1++)
+    for (off2 = 0; off2 < 4; off2++)
+    for (len = 0; len <= 40; len++)
+    for (diff = -2; diff <= len; diff++) {
+        memset(src_buf, 'a', BUF_SIZE);
+        memset(dst_buf, 'a', BUF_SIZE);
+        str1[off1 + len] = 0;
+        str2[off2 + len] = 0;
+
+        if (diff == -2) {
+            /* str2 is a prefix of str1 */
+            str2[off2 + len / 2] = 0;
+        } else if (diff >= 0) {
+            str2[off2 + diff] = (diff & 1) ? (char)0xE1 : 'b';
+        }
+
+        checks++;
+        CHECK(SIGN(libk_strcmp(str1 + off1, str2 + off2)) == SIGN(strcmp(str1 + off1, str2 + off2)),
+                "strcmp off %d/%d len %d diff at %d", off1, off2, len, diff);
+        CHECK(SIGN(libk_strcmp(str2 + off2, str1 + off1)) == SIGN(strcmp(str2 + off2, str1 + off1)),
+                "strcmp (reversed) off %d/%d len %d diff at %d", off1, off2, len, diff);
+    }
+}
+
+static void
+test_pages()
+{
+    unsigned char *page1;
+    unsigned char *page2;
+
+    page1 = aligned_alloc(LIBK_PAGE_SIZE, LIBK_PAGE_SIZE * 2);
+    page2 = aligned_alloc(LIBK_PAGE_SIZE, LIBK_PAGE_SIZE * 2);
+
+    fill_pattern(page1, LIBK_PAGE_SIZE * 2, 3);
+    fill_pattern(page2, LIBK_PAGE_SIZE * 2, 5);
+
+    libk_page_copy(page2, page1);
+
+    checks++;
+    CHECK(memcmp(page1, page2, LIBK_PAGE_SIZE) == 0, "page_copy left differences");
+    CHECK(page2[LIBK_PAGE_SIZE] == (unsigned char)(5 + LIBK_PAGE_SIZE * 7 + 1), "page_copy overran");
+
+    libk_page_zero(page1);
+
+    memset(page2, 0, LIBK_PAGE_SIZE);
+
+    checks++;
+    CHECK(memcmp(page1, page2, LIBK_PAGE_SIZE) == 0, "page_zero left bytes set");
+    CHECK(page1[LIBK_PAGE_SIZE] == (unsigned char)(3 + LIBK_PAGE_SIZE * 7 + 1), "page_zero overran");
+
+    free(page1);
+    free(page2);
+}
+
+int
+main(int argc, char *argv[])
+{
+    test_memcpy();
+    test_memmove();
+    test_memset();
+    test_memcmp();
+    test_strlen();
+    test_strcmp();
+    test_pages();
+
+    printf("%d checks, %d failures\n", checks, failures);
+
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,153 @@
+/*
+ * bootchart - shows where the time to boot went
+ *
+ * Prints every stage the kernel and init recorded on the way up, when it
+ * started relative to the first one and how long it lasted, with a bar
+ * scaled to the longest stage. The kernel records TSC values; they are
+ * converted with the calibration it publishes in the vDSO
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/sysctl.h>
+#include <sys/vdso.h>
+
+#define MAX_WIDTH   72
+
+static uint32_t tsc_mult;
+
+/* in microseconds, or in thousands of cycles if the TSC's rate isn't known yet */
+static uint64_t
+to_usec(uint64_t cycles)
+{
+    if (tsc_mult) {
+        return (cycles * tsc_mult) >> 32;
+    }
+
+    return cycles / 1000;
+}
+
+/* returns the number of stages, or -1 */
+static int
+fetch_stages(struct kinfo_bootstage **stages)
+{
+    int mib[3];
+    size_t len;
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_BOOT;
+    mib[2] = KERN_BOOT_STAGES;
+
+    if (sysctl(mib, 3, NULL, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    *stages = malloc(len);
+
+    if (!*stages || sysctl(mib, 3, *stages, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    return len / sizeof(struct kinfo_bootstage);
+}
+
+static void
+print_bar(uint64_t length, uint64_t longest, int width)
+{
+    int i;
+    int n;
+
+    n = longest ? (int)(length * width / longest) : 0;
+
+    for (i = 0; i < n; i++) {
+        putchar('#');
+    }
+}
+
+int
+main(int argc, char *argv[])
+{
+    int c;
+    int i;
+    int nstages;
+    int width;
+    uint64_t length;
+    uint64_t longest;
+    uint64_t start;
+    struct kinfo_bootstage *stages;
+    struct vdso_time *vt;
+
+    width = 40;
+
+    while ((c = getopt(argc, argv, "w:")) != -1) {
+        switch (c) {
+            case 'w':
+                width = atoi(optarg);
+                break;
+            default:
+                goto usage;
+        }
+    }
+
+    if (optind != argc || width < 0 || width > MAX_WIDTH) {
+        goto usage;
+    }
+
+    nstages = fetch_stages(&stages);
+
+    if (nstages < 0) {
+        perror("bootchart");
+        return -1;
+    }
+
+    if (nstages == 0 || stages[0].tsc == 0) {
+        fprintf(stderr, "bootchart: no boot stages were recorded\n");
+        return -1;
+    }
+
+    vt = (struct vdso_time*)VDSO_TIME_ADDR;
+    tsc_mult = vt->vt_tsc_mult;
+
+    longest = 0;
+
+    for (i = 0; i + 1 < nstages; i++) {
+        length = stages[i + 1].tsc - stages[i].tsc;
+
+        if (length > longest) {
+            longest = length;
+        }
+    }
+
+    start = stages[0].tsc;
+
+    /* the TSC starts counting at reset, so this is how long firmware and the loader took */
+    printf("%s since %s, which started %llu after reset\n\n", tsc_mult ? "microseconds" : "kilocycles",
+            stages[0].name, (unsigned long long)to_usec(start));
+
+    printf("%-16s %10s %10s\n", "STAGE", "START", "TIME");
+
+    for (i = 0; i < nstages; i++) {
+        printf("%-16s %10llu ", stages[i].name, (unsigned long long)to_usec(stages[i].tsc - start));
+
+        /* the last stage hasn't ended as far as anything recorded goes */
+        if (i + 1 == nstages) {
+            printf("%10s\n", "-");
+            continue;
+        }
+
+        length = stages[i + 1].tsc - stages[i].tsc;
+
+        printf("%10llu  ", (unsigned long long)to_usec(length));
+        print_bar(length, longest, width);
+        printf("\n");
+    }
+
+    printf("\n%-16s %10llu\n", "total", (unsigned long long)to_usec(stages[nstages - 1].tsc - start));
+
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: bootchart [-w WIDTH]\n");
+    return -1;
+}
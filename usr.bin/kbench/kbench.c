@@ -0,0 +1,865 @@
+/*
+ * kbench - microbenchmarks of the kernel's basic operations
+ *
+ * Measures system call entry, process creation, context switches, pipe and
+ * unix socket bandwidth, file system operations and memory mapping, in the
+ * spirit of lmbench. Each benchmark runs a few times and the best run is
+ * reported, one result per line as "name value unit", so that the output of
+ * two kernels can be compared with build/kbench_compare.sh. File system
+ * benchmarks run in every directory given, /tmp by default
+ */
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscalls.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+/* execed by the fork+exec benchmark with -X, which exits right away */
+#define KBENCH_PATH     "/usr/bin/kbench"
+#define KBENCH_SOCKET   "/tmp/.kbench"
+
+/* not registered by the kernel; measures entry and exit alone */
+#define SYS_NULL        0xFF
+
+#define CHUNK_SIZE      65536
+#define FILE_SIZE       (4 * 1024 * 1024)
+#define IO_SIZE         4096
+#define MAP_SIZE        (256 * 1024)
+#ifndef PAGE_SIZE
+#define PAGE_SIZE       4096
+#endif
+#define STREAM_SIZE     (16 * 1024 * 1024)
+
+struct bench {
+    const char *    name;
+    const char *    unit;
+    bool            higher_better;
+    bool            per_dir;        /* runs once for each directory */
+    double          (*fn)(const char *);
+};
+
+static char chunk[CHUNK_SIZE];
+
+static uint64_t
+now_usec()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static uint32_t
+next_random(uint32_t *state)
+{
+    *state = *state * 1103515245 + 12345;
+
+    return *state >> 8;
+}
+
+static int
+read_full(int fd, void *buf, size_t len)
+{
+    ssize_t n;
+    size_t done;
+
+    for (done = 0; done < len; done += n) {
+        n = read(fd, (char*)buf + done, len - done);
+
+        if (n <= 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+write_full(int fd, const void *buf, size_t len)
+{
+    ssize_t n;
+    size_t done;
+
+    for (done = 0; done < len; done += n) {
+        n = write(fd, (const char*)buf + done, len - done);
+
+        if (n <= 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* writes STREAM_SIZE bytes to fd; runs in a child */
+static int
+stream_out(int fd)
+{
+    size_t sent;
+
+    for (sent = 0; sent < STREAM_SIZE; sent += CHUNK_SIZE) {
+        if (write_full(fd, chunk, CHUNK_SIZE)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* reads what stream_out() writes; returns MB/s */
+static double
+stream_in(int fd)
+{
+    ssize_t n;
+    size_t received;
+    uint64_t start;
+    uint64_t elapsed;
+
+    start = now_usec();
+
+    for (received = 0; received < STREAM_SIZE; received += n) {
+        n = read(fd, chunk, CHUNK_SIZE);
+
+        if (n <= 0) {
+            return -1;
+        }
+    }
+
+    elapsed = now_usec() - start;
+
+    return elapsed ? (double)STREAM_SIZE / elapsed : 0;
+}
+
+/* ns per call */
+static double
+bench_null_syscall(const char *dir)
+{
+    int i;
+    int iterations;
+    uint64_t start;
+
+    iterations = 100000;
+
+    for (i = 0; i < 1000; i++) {
+        _SYSCALL0(void, SYS_NULL);
+    }
+
+    start = now_usec();
+
+    for (i = 0; i < iterations; i++) {
+        _SYSCALL0(void, SYS_NULL);
+    }
+
+    return (double)(now_usec() - start) * 1000 / iterations;
+}
+
+/* us per fork, exit and wait */
+static double
+bench_fork_exit(const char *dir)
+{
+    int i;
+    int iterations;
+    int status;
+    pid_t pid;
+    uint64_t start;
+
+    iterations = 200;
+    start = now_usec();
+
+    for (i = 0; i < iterations; i++) {
+        pid = fork();
+
+        if (pid == 0) {
+            _exit(0);
+        }
+
+        if (pid < 0) {
+            return -1;
+        }
+
+        waitpid(pid, &status, 0);
+    }
+
+    return (double)(now_usec() - start) / iterations;
+}
+
+/* us per fork, exec, exit and wait */
+static double
+bench_fork_exec(const char *dir)
+{
+    int i;
+    int iterations;
+    int status;
+    pid_t pid;
+    uint64_t start;
+    char *argv[] = { "kbench", "-X", NULL };
+    char *envp[] = { NULL };
+
+    iterations = 100;
+    start = now_usec();
+
+    for (i = 0; i < iterations; i++) {
+        pid = fork();
+
+        if (pid == 0) {
+            execve(KBENCH_PATH, argv, envp);
+            _exit(1);
+        }
+
+        if (pid < 0) {
+            return -1;
+        }
+
+        waitpid(pid, &status, 0);
+
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            return -1;
+        }
+    }
+
+    return (double)(now_usec() - start) / iterations;
+}
+
+/* us per switch, bouncing a byte between two processes through pipes */
+static double
+bench_ctxsw(const char *dir)
+{
+    int i;
+    int iterations;
+    int status;
+    int to_child[2];
+    int to_parent[2];
+    char c;
+    pid_t pid;
+    uint64_t start;
+
+    iterations = 10000;
+
+    if (pipe(to_child) || pipe(to_parent)) {
+        return -1;
+    }
+
+    pid = fork();
+
+    if (pid == 0) {
+        for (i = 0; i < iterations; i++) {
+            if (read_full(to_child[0], &c, 1) || write_full(to_parent[1], &c, 1)) {
+                _exit(1);
+            }
+        }
+
+        _exit(0);
+    }
+
+    c = 0;
+    start = now_usec();
+
+    for (i = 0; i < iterations; i++) {
+        if (write_full(to_child[1], &c, 1) || read_full(to_parent[0], &c, 1)) {
+            break;
+        }
+    }
+
+    start = now_usec() - start;
+
+    close(to_child[0]);
+    close(to_child[1]);
+    close(to_parent[0]);
+    close(to_parent[1]);
+    waitpid(pid, &status, 0);
+
+    return i == iterations ? (double)start / (2 * iterations) : -1;
+}
+
+/* MB/s */
+static double
+bench_pipe_bw(const char *dir)
+{
+    int fds[2];
+    int status;
+    pid_t pid;
+    double res;
+
+    if (pipe(fds)) {
+        return -1;
+    }
+
+    pid = fork();
+
+    if (pid == 0) {
+        close(fds[0]);
+        _exit(stream_out(fds[1]));
+    }
+
+    close(fds[1]);
+
+    res = stream_in(fds[0]);
+
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+
+    return res;
+}
+
+/* MB/s */
+static double
+bench_unix_bw(const char *dir)
+{
+    int cfd;
+    int lfd;
+    int status;
+    pid_t pid;
+    double res;
+    struct sockaddr_un addr;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, KBENCH_SOCKET);
+
+    unlink(KBENCH_SOCKET);
+
+    lfd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+    if (lfd < 0 || bind(lfd, (struct sockaddr*)&addr, sizeof(addr)) || listen(lfd, 1)) {
+        return -1;
+    }
+
+    pid = fork();
+
+    if (pid == 0) {
+        close(lfd);
+
+        cfd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        if (cfd < 0 || connect(cfd, (struct sockaddr*)&addr, sizeof(addr))) {
+            _exit(1);
+        }
+
+        _exit(stream_out(cfd));
+    }
+
+    cfd = accept(lfd, NULL, NULL);
+
+    close(lfd);
+
+    res = cfd < 0 ? -1 : stream_in(cfd);
+
+    close(cfd);
+    waitpid(pid, &status, 0);
+    unlink(KBENCH_SOCKET);
+
+    return res;
+}
+
+static void
+file_path(char *buf, size_t size, const char *dir, int n)
+{
+    snprintf(buf, size, "%s/.kbench.%d", dir, n);
+}
+
+/* files created per second */
+static double
+bench_file_create(const char *dir)
+{
+    char path[256];
+    int fd;
+    int i;
+    int nfiles;
+    uint64_t elapsed;
+
+    nfiles = 500;
+    elapsed = now_usec();
+
+    for (i = 0; i < nfiles; i++) {
+        file_path(path, sizeof(path), dir, i);
+
+        fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+
+        if (fd < 0) {
+            return -1;
+        }
+
+        close(fd);
+    }
+
+    elapsed = now_usec() - elapsed;
+
+    for (i = 0; i < nfiles; i++) {
+        file_path(path, sizeof(path), dir, i);
+        unlink(path);
+    }
+
+    return elapsed ? (double)nfiles * 1000000 / elapsed : 0;
+}
+
+/* files deleted per second */
+static double
+bench_file_delete(const char *dir)
+{
+    char path[256];
+    int fd;
+    int i;
+    int nfiles;
+    uint64_t elapsed;
+
+    nfiles = 500;
+
+    for (i = 0; i < nfiles; i++) {
+        file_path(path, sizeof(path), dir, i);
+
+        fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+
+        if (fd < 0) {
+            return -1;
+        }
+
+        close(fd);
+    }
+
+    elapsed = now_usec();
+
+    for (i = 0; i < nfiles; i++) {
+        file_path(path, sizeof(path), dir, i);
+
+        if (unlink(path)) {
+            return -1;
+        }
+    }
+
+    elapsed = now_usec() - elapsed;
+
+    return elapsed ? (double)nfiles * 1000000 / elapsed : 0;
+}
+
+/* creates the file the I/O benchmarks work on; returns an open descriptor */
+static int
+make_file(const char *dir, char *path, size_t size)
+{
+    int fd;
+    size_t written;
+
+    file_path(path, size, dir, 0);
+
+    fd = open(path, O_CREAT | O_RDWR | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    for (written = 0; written < FILE_SIZE; written += CHUNK_SIZE) {
+        if (write_full(fd, chunk, CHUNK_SIZE)) {
+            close(fd);
+            unlink(path);
+            return -1;
+        }
+    }
+
+    return fd;
+}
+
+/* MB/s */
+static double
+bench_seq_write(const char *dir)
+{
+    char path[256];
+    int fd;
+    size_t written;
+    uint64_t elapsed;
+
+    file_path(path, sizeof(path), dir, 0);
+
+    fd = open(path, O_CREAT | O_WRONLY | O_TRUNC, 0644);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    elapsed = now_usec();
+
+    for (written = 0; written < FILE_SIZE; written += CHUNK_SIZE) {
+        if (write_full(fd, chunk, CHUNK_SIZE)) {
+            break;
+        }
+    }
+
+    elapsed = now_usec() - elapsed;
+
+    close(fd);
+    unlink(path);
+
+    if (written < FILE_SIZE) {
+        return -1;
+    }
+
+    return elapsed ? (double)FILE_SIZE / elapsed : 0;
+}
+
+/* MB/s */
+static double
+bench_seq_read(const char *dir)
+{
+    char path[256];
+    int fd;
+    size_t nread;
+    uint64_t elapsed;
+
+    fd = make_file(dir, path, sizeof(path));
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    lseek(fd, 0, SEEK_SET);
+
+    elapsed = now_usec();
+
+    for (nread = 0; nread < FILE_SIZE; nread += CHUNK_SIZE) {
+        if (read_full(fd, chunk, CHUNK_SIZE)) {
+            break;
+        }
+    }
+
+    elapsed = now_usec() - elapsed;
+
+    close(fd);
+    unlink(path);
+
+    if (nread < FILE_SIZE) {
+        return -1;
+    }
+
+    return elapsed ? (double)FILE_SIZE / elapsed : 0;
+}
+
+/* IO_SIZE operations at random aligned offsets per second */
+static double
+bench_random_io(const char *dir, bool writing)
+{
+    char path[256];
+    int fd;
+    int i;
+    int iterations;
+    off_t offset;
+    ssize_t n;
+    uint32_t seed;
+    uint64_t elapsed;
+
+    fd = make_file(dir, path, sizeof(path));
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    iterations = 2000;
+    seed = 1;
+    elapsed = now_usec();
+
+    for (i = 0; i < iterations; i++) {
+        offset = (off_t)(next_random(&seed) % (FILE_SIZE / IO_SIZE)) * IO_SIZE;
+
+        if (writing) {
+            n = pwrite(fd, chunk, IO_SIZE, offset);
+        } else {
+            n = pread(fd, chunk, IO_SIZE, offset);
+        }
+
+        if (n != IO_SIZE) {
+            break;
+        }
+    }
+
+    elapsed = now_usec() - elapsed;
+
+    close(fd);
+    unlink(path);
+
+    if (i < iterations) {
+        return -1;
+    }
+
+    return elapsed ? (double)iterations * 1000000 / elapsed : 0;
+}
+
+static double
+bench_rand_read(const char *dir)
+{
+    return bench_random_io(dir, false);
+}
+
+static double
+bench_rand_write(const char *dir)
+{
+    return bench_random_io(dir, true);
+}
+
+/* a memory file of MAP_SIZE bytes to map */
+static int
+make_memfd()
+{
+    int fd;
+
+    fd = memfd_create("kbench", 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    if (ftruncate(fd, MAP_SIZE)) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/* us per mmap and munmap of MAP_SIZE bytes */
+static double
+bench_mmap(const char *dir)
+{
+    int fd;
+    int i;
+    int iterations;
+    void *addr;
+    uint64_t elapsed;
+
+    fd = make_memfd();
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    iterations = 200;
+    elapsed = now_usec();
+
+    for (i = 0; i < iterations; i++) {
+        addr = mmap(NULL, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (!addr) {
+            break;
+        }
+
+        _SYSCALL2(void, SYS_MUNMAP, addr, MAP_SIZE);
+    }
+
+    elapsed = now_usec() - elapsed;
+
+    close(fd);
+
+    return i == iterations ? (double)elapsed / iterations : -1;
+}
+
+/* ns per page for the first write to each page of a fresh mapping */
+static double
+bench_page_touch(const char *dir)
+{
+    int fd;
+    int i;
+    int iterations;
+    size_t off;
+    uint8_t *addr;
+    uint64_t elapsed;
+    uint64_t start;
+
+    fd = make_memfd();
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    iterations = 50;
+    elapsed = 0;
+
+    for (i = 0; i < iterations; i++) {
+        addr = mmap(NULL, MAP_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+
+        if (!addr) {
+            break;
+        }
+
+        start = now_usec();
+
+        for (off = 0; off < MAP_SIZE; off += PAGE_SIZE) {
+            addr[off] = (uint8_t)i;
+        }
+
+        elapsed += now_usec() - start;
+
+        _SYSCALL2(void, SYS_MUNMAP, addr, MAP_SIZE);
+    }
+
+    close(fd);
+
+    if (i < iterations) {
+        return -1;
+    }
+
+    return (double)elapsed * 1000 / (iterations * (MAP_SIZE / PAGE_SIZE));
+}
+
+/* us per CHUNK_SIZE the heap grows by, including touching every new page */
+static double
+bench_sbrk(const char *dir)
+{
+    int i;
+    int iterations;
+    size_t off;
+    uint8_t *addr;
+    uint64_t elapsed;
+
+    iterations = 32;
+    elapsed = now_usec();
+
+    for (i = 0; i < iterations; i++) {
+        addr = sbrk(CHUNK_SIZE);
+
+        if (addr == (void*)-1) {
+            return -1;
+        }
+
+        for (off = 0; off < CHUNK_SIZE; off += PAGE_SIZE) {
+            addr[off] = 1;
+        }
+    }
+
+    elapsed = now_usec() - elapsed;
+
+    return (double)elapsed / iterations;
+}
+
+static struct bench benches[] = {
+    { "null_syscall",   "ns",       false,  false,  bench_null_syscall },
+    { "fork_exit",      "us",       false,  false,  bench_fork_exit },
+    { "fork_exec",      "us",       false,  false,  bench_fork_exec },
+    { "ctxsw_pipe",     "us",       false,  false,  bench_ctxsw },
+    { "pipe_bw",        "MB/s",     true,   false,  bench_pipe_bw },
+    { "unix_bw",        "MB/s",     true,   false,  bench_unix_bw },
+    { "file_create",    "ops/s",    true,   true,   bench_file_create },
+    { "file_delete",    "ops/s",    true,   true,   bench_file_delete },
+    { "seq_write",      "MB/s",     true,   true,   bench_seq_write },
+    { "seq_read",       "MB/s",     true,   true,   bench_seq_read },
+    { "rand_write",     "ops/s",    true,   true,   bench_rand_write },
+    { "rand_read",      "ops/s",    true,   true,   bench_rand_read },
+    { "mmap_256k",      "us",       false,  false,  bench_mmap },
+    { "page_touch",     "ns",       false,  false,  bench_page_touch },
+    { "sbrk_64k",       "us",       false,  false,  bench_sbrk },
+};
+
+static void
+run_bench(struct bench *bench, const char *dir, int repeat)
+{
+    int i;
+    bool have_best;
+    double best;
+    double res;
+
+    have_best = false;
+    best = 0;
+
+    for (i = 0; i < repeat; i++) {
+        res = bench->fn(dir);
+
+        if (res < 0) {
+            continue;
+        }
+
+        if (!have_best || (bench->higher_better ? res > best : res < best)) {
+            best = res;
+            have_best = true;
+        }
+    }
+
+    if (dir) {
+        printf("%s:%s ", bench->name, dir);
+    } else {
+        printf("%s ", bench->name);
+    }
+
+    if (have_best) {
+        printf("%.2f %s\n", best, bench->unit);
+    } else {
+        printf("failed %s\n", bench->unit);
+    }
+
+    fflush(stdout);
+}
+
+int
+main(int argc, char *argv[])
+{
+    char *default_dirs[] = { "/tmp" };
+    char **dirs;
+    int c;
+    int i;
+    int j;
+    int ndirs;
+    int repeat;
+    const char *only;
+
+    /* the child of the fork+exec benchmark */
+    if (argc == 2 && strcmp(argv[1], "-X") == 0) {
+        return 0;
+    }
+
+    only = NULL;
+    repeat = 3;
+
+    while ((c = getopt(argc, argv, "r:t:")) != -1) {
+        switch (c) {
+            case 'r':
+                repeat = atoi(optarg);
+                break;
+            case 't':
+                only = optarg;
+                break;
+            default:
+                goto usage;
+        }
+    }
+
+    if (repeat <= 0) {
+        goto usage;
+    }
+
+    if (optind < argc) {
+        dirs = &argv[optind];
+        ndirs = argc - optind;
+    } else {
+        dirs = default_dirs;
+        ndirs = 1;
+    }
+
+    memset(chunk, 0x5A, sizeof(chunk));
+
+    printf("# kbench 1\n");
+    printf("# best of %d runs\n", repeat);
+
+    for (i = 0; i < sizeof(benches) / sizeof(benches[0]); i++) {
+        if (only && strncmp(benches[i].name, only, strlen(only)) != 0) {
+            continue;
+        }
+
+        if (!benches[i].per_dir) {
+            run_bench(&benches[i], NULL, repeat);
+            continue;
+        }
+
+        for (j = 0; j < ndirs; j++) {
+            run_bench(&benches[i], dirs[j], repeat);
+        }
+    }
+
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: kbench [-r REPEAT] [-t NAME] [DIR ...]\n");
+    return -1;
+}
@@ -0,0 +1,261 @@
+/*
+ * kmemstat - shows which parts of the kernel own the kernel heap
+ *
+ * Reads what every call site has allocated from a kernel built with
+ * MALLOC_PROFILE, names the sites with the kernel's symbol table and prints
+ * the biggest consumers. With -w it takes a second snapshot after a while
+ * and prints the sites whose share grew the most in between instead
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/sysctl.h>
+
+struct site {
+    uintptr_t   addr;
+    uint32_t    count;
+    uint32_t    bytes;
+    uint32_t    allocs;
+    int32_t     delta_count;
+    int32_t     delta_bytes;
+};
+
+static struct kinfo_ksym *  ksyms;
+static int                  nksyms;
+
+/* fetches the kernel's symbol table, which comes sorted by address */
+static int
+load_symbols()
+{
+    int mib[3];
+    size_t len;
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_KSYM;
+    mib[2] = KERN_KSYM_ALL;
+
+    if (sysctl(mib, 3, NULL, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    ksyms = malloc(len);
+
+    if (sysctl(mib, 3, ksyms, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    nksyms = len / sizeof(struct kinfo_ksym);
+
+    return 0;
+}
+
+/* names addr as function+offset */
+static void
+resolve(uintptr_t addr, char *buf, size_t size)
+{
+    int high;
+    int low;
+    int mid;
+
+    low = 0;
+    high = nksyms;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+
+        if (ksyms[mid].value <= addr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (addr == 0) {
+        snprintf(buf, size, "[untracked]");
+    } else if (low > 0) {
+        snprintf(buf, size, "%s+0x%x", ksyms[low - 1].name, (unsigned int)(addr - ksyms[low - 1].value));
+    } else {
+        snprintf(buf, size, "0x%08x", (unsigned int)addr);
+    }
+}
+
+/* returns the number of sites, or -1 */
+static int
+snapshot(struct kinfo_mallocsite **sites)
+{
+    int mib[3];
+    size_t len;
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_MALLOC;
+    mib[2] = KERN_MALLOC_SITES;
+
+    if (sysctl(mib, 3, NULL, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    *sites = malloc(len);
+
+    if (!*sites || sysctl(mib, 3, *sites, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    return len / sizeof(struct kinfo_mallocsite);
+}
+
+static int
+compare_bytes(const void *a, const void *b)
+{
+    const struct site *sa;
+    const struct site *sb;
+
+    sa = a;
+    sb = b;
+
+    if (sa->bytes != sb->bytes) {
+        return sa->bytes < sb->bytes ? 1 : -1;
+    }
+
+    return 0;
+}
+
+static int
+compare_growth(const void *a, const void *b)
+{
+    const struct site *sa;
+    const struct site *sb;
+
+    sa = a;
+    sb = b;
+
+    if (sa->delta_bytes != sb->delta_bytes) {
+        return sa->delta_bytes < sb->delta_bytes ? 1 : -1;
+    }
+
+    return sb->delta_count - sa->delta_count;
+}
+
+int
+main(int argc, char *argv[])
+{
+    char name[96];
+    int c;
+    int i;
+    int j;
+    int nbefore;
+    int nafter;
+    int top;
+    int wait;
+    uint32_t total_bytes;
+    uint32_t total_count;
+    struct kinfo_mallocsite *before;
+    struct kinfo_mallocsite *after;
+    struct site *sites;
+
+    top = 20;
+    wait = 0;
+
+    while ((c = getopt(argc, argv, "n:w:")) != -1) {
+        switch (c) {
+            case 'n':
+                top = atoi(optarg);
+                break;
+            case 'w':
+                wait = atoi(optarg);
+                break;
+            default:
+                goto usage;
+        }
+    }
+
+    if (optind != argc || top < 0 || wait < 0) {
+        goto usage;
+    }
+
+    if (load_symbols() != 0) {
+        perror("kmemstat: symbols");
+        return -1;
+    }
+
+    nbefore = snapshot(&before);
+
+    if (nbefore < 0) {
+        if (errno == EOPNOTSUPP) {
+            fprintf(stderr, "kmemstat: kernel was built without MALLOC_PROFILE\n");
+        } else {
+            perror("kmemstat");
+        }
+        return -1;
+    }
+
+    after = before;
+    nafter = nbefore;
+
+    if (wait) {
+        sleep(wait);
+
+        nafter = snapshot(&after);
+
+        if (nafter < 0) {
+            perror("kmemstat");
+            return -1;
+        }
+    }
+
+    sites = calloc(nafter + 1, sizeof(struct site));
+    total_bytes = 0;
+    total_count = 0;
+
+    for (i = 0; i < nafter; i++) {
+        sites[i].addr = after[i].site;
+        sites[i].count = after[i].count;
+        sites[i].bytes = after[i].bytes;
+        sites[i].allocs = after[i].allocs;
+        sites[i].delta_count = after[i].count;
+        sites[i].delta_bytes = after[i].bytes;
+
+        /* sites are never dropped, so everything in before is also in after */
+        for (j = 0; wait && j < nbefore; j++) {
+            if (before[j].site == after[i].site) {
+                sites[i].delta_count -= before[j].count;
+                sites[i].delta_bytes -= before[j].bytes;
+                break;
+            }
+        }
+
+        total_bytes += after[i].bytes;
+        total_count += after[i].count;
+    }
+
+    qsort(sites, nafter, sizeof(struct site), wait ? compare_growth : compare_bytes);
+
+    printf("%u bytes in %u blocks from %d call sites\n\n", (unsigned int)total_bytes,
+            (unsigned int)total_count, nafter);
+
+    if (wait) {
+        printf("%10s %8s %10s %8s  %s\n", "+BYTES", "+BLOCKS", "BYTES", "BLOCKS", "SITE");
+    } else {
+        printf("%10s %8s %10s  %s\n", "BYTES", "BLOCKS", "ALLOCS", "SITE");
+    }
+
+    for (i = 0; i < nafter && i < top; i++) {
+        resolve(sites[i].addr, name, sizeof(name));
+
+        if (wait) {
+            printf("%10d %8d %10u %8u  %s\n", (int)sites[i].delta_bytes, (int)sites[i].delta_count,
+                    (unsigned int)sites[i].bytes, (unsigned int)sites[i].count, name);
+        } else {
+            printf("%10u %8u %10u  %s\n", (unsigned int)sites[i].bytes, (unsigned int)sites[i].count,
+                    (unsigned int)sites[i].allocs, name);
+        }
+    }
+
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: kmemstat [-n TOP] [-w SECONDS]\n");
+    return -1;
+}
@@ -0,0 +1,355 @@
+/*
+ * kprof - samples where the kernel spends its time
+ *
+ * Turns on the kernel's sampling profiler for a while, drains the samples it
+ * collects and prints either a flat profile of the functions that were
+ * interrupted, or folded stacks that flamegraph.pl can turn into a graph
+ */
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/sysctl.h>
+
+#define NBUCKETS    4096
+
+/* a resolved address or a stack, and how often it was seen */
+struct entry {
+    char *          key;
+    uintptr_t       addr;
+    unsigned int    count;
+    struct entry *  next;
+};
+
+struct table {
+    struct entry *  buckets[NBUCKETS];
+    int             nentries;
+};
+
+static struct table functions;
+static struct table stacks;
+
+/* addresses below the first symbol, named by their value */
+static struct table unknown;
+
+static struct kinfo_ksym *  ksyms;
+static int                  nksyms;
+
+static unsigned int
+hash_string(const char *str)
+{
+    unsigned int hash;
+
+    hash = 5381;
+
+    while (*str) {
+        hash = hash * 33 + (unsigned char)*str++;
+    }
+
+    return hash;
+}
+
+static struct entry *
+table_lookup(struct table *table, const char *key, uintptr_t addr)
+{
+    unsigned int bucket;
+    struct entry *entry;
+
+    bucket = (key ? hash_string(key) : (addr >> 2)) % NBUCKETS;
+
+    for (entry = table->buckets[bucket]; entry; entry = entry->next) {
+        if (key ? strcmp(entry->key, key) == 0 : entry->addr == addr) {
+            return entry;
+        }
+    }
+
+    entry = calloc(1, sizeof(struct entry));
+    entry->key = key ? strdup(key) : NULL;
+    entry->addr = addr;
+    entry->next = table->buckets[bucket];
+
+    table->buckets[bucket] = entry;
+    table->nentries++;
+
+    return entry;
+}
+
+/* fetches the kernel's symbol table, which comes sorted by address */
+static int
+load_symbols()
+{
+    int mib[3];
+    size_t len;
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_KSYM;
+    mib[2] = KERN_KSYM_ALL;
+
+    if (sysctl(mib, 3, NULL, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    ksyms = malloc(len);
+
+    if (sysctl(mib, 3, ksyms, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    nksyms = len / sizeof(struct kinfo_ksym);
+
+    return 0;
+}
+
+/* the function containing addr */
+static const char *
+resolve(uintptr_t addr)
+{
+    char name[16];
+    int high;
+    int low;
+    int mid;
+    struct entry *entry;
+
+    low = 0;
+    high = nksyms;
+
+    while (low < high) {
+        mid = low + (high - low) / 2;
+
+        if (ksyms[mid].value <= addr) {
+            low = mid + 1;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (low > 0) {
+        return ksyms[low - 1].name;
+    }
+
+    entry = table_lookup(&unknown, NULL, addr);
+
+    if (!entry->key) {
+        snprintf(name, sizeof(name), "0x%08x", (unsigned int)addr);
+        entry->key = strdup(name);
+    }
+
+    return entry->key;
+}
+
+static void
+account(struct kinfo_prof_sample *sample)
+{
+    char stack[KPROF_DEPTH*80];
+    int i;
+    const char *leaf;
+
+    if (sample->user) {
+        leaf = "[user]";
+        snprintf(stack, sizeof(stack), "%s", leaf);
+    } else {
+        leaf = resolve(sample->pc[0]);
+        stack[0] = '\0';
+
+        /* folded stacks list the outermost frame first */
+        for (i = sample->depth - 1; i >= 0; i--) {
+            strncat(stack, resolve(sample->pc[i]), sizeof(stack) - strlen(stack) - 1);
+
+            if (i > 0) {
+                strncat(stack, ";", sizeof(stack) - strlen(stack) - 1);
+            }
+        }
+    }
+
+    table_lookup(&functions, leaf, 0)->count++;
+    table_lookup(&stacks, stack, 0)->count++;
+}
+
+static int
+prof_enable(int enable)
+{
+    int mib[3];
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_PROF;
+    mib[2] = KERN_PROF_ENABLE;
+
+    return sysctl(mib, 3, NULL, NULL, &enable, sizeof(enable));
+}
+
+/* reads whatever the kernel collected so far; returns the number of samples */
+static int
+prof_drain()
+{
+    int i;
+    int mib[3];
+    int nsamples;
+    size_t len;
+    struct kinfo_prof_sample *samples;
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_PROF;
+    mib[2] = KERN_PROF_SAMPLES;
+
+    if (sysctl(mib, 3, NULL, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    samples = malloc(len);
+
+    if (sysctl(mib, 3, samples, &len, NULL, 0) != 0) {
+        free(samples);
+        return -1;
+    }
+
+    nsamples = len / sizeof(struct kinfo_prof_sample);
+
+    for (i = 0; i < nsamples; i++) {
+        account(&samples[i]);
+    }
+
+    free(samples);
+
+    return nsamples;
+}
+
+static struct entry **
+table_sorted(struct table *table)
+{
+    int i;
+    int j;
+    struct entry **sorted;
+    struct entry *entry;
+    struct entry *tmp;
+
+    sorted = calloc(table->nentries, sizeof(struct entry*));
+
+    for (i = 0, j = 0; i < NBUCKETS; i++) {
+        for (entry = table->buckets[i]; entry; entry = entry->next) {
+            sorted[j++] = entry;
+        }
+    }
+
+    /* insertion sort; there are rarely more than a few hundred */
+    for (i = 1; i < table->nentries; i++) {
+        tmp = sorted[i];
+
+        for (j = i; j > 0 && sorted[j-1]->count < tmp->count; j--) {
+            sorted[j] = sorted[j-1];
+        }
+
+        sorted[j] = tmp;
+    }
+
+    return sorted;
+}
+
+int
+main(int argc, char *argv[])
+{
+    bool folded;
+    int c;
+    int i;
+    int limit;
+    int seconds;
+    int mib[3];
+    int n;
+    size_t len;
+    uint32_t dropped;
+    unsigned int total;
+    struct entry **sorted;
+
+    folded = false;
+    limit = 30;
+    seconds = 5;
+
+    while ((c = getopt(argc, argv, "d:fn:")) != -1) {
+        switch (c) {
+            case 'd':
+                seconds = atoi(optarg);
+                break;
+            case 'f':
+                folded = true;
+                break;
+            case 'n':
+                limit = atoi(optarg);
+                break;
+            default:
+                fprintf(stderr, "usage: kprof [-f] [-d seconds] [-n functions]\n");
+                return -1;
+        }
+    }
+
+    if (load_symbols() != 0) {
+        perror("kprof: symbols");
+        return -1;
+    }
+
+    if (prof_enable(1) != 0) {
+        perror("kprof");
+        return -1;
+    }
+
+    total = 0;
+
+    /* each CPU buffers a couple of seconds worth of samples */
+    for (i = 0; i < seconds; i++) {
+        sleep(1);
+
+        if ((n = prof_drain()) > 0) {
+            total += n;
+        }
+    }
+
+    prof_enable(0);
+
+    if ((n = prof_drain()) > 0) {
+        total += n;
+    }
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_PROF;
+    mib[2] = KERN_PROF_DROPPED;
+
+    len = sizeof(dropped);
+
+    if (sysctl(mib, 3, &dropped, &len, NULL, 0) != 0) {
+        dropped = 0;
+    }
+
+    if (folded) {
+        sorted = table_sorted(&stacks);
+
+        for (i = 0; i < stacks.nentries; i++) {
+            printf("%s %u\n", sorted[i]->key, sorted[i]->count);
+        }
+
+        free(sorted);
+
+        return 0;
+    }
+
+    printf("%u samples, %u dropped\n\n", total, (unsigned int)dropped);
+
+    if (total == 0) {
+        return 0;
+    }
+
+    printf("%-10s %-8s %s\n", "SAMPLES", "PERCENT", "FUNCTION");
+
+    sorted = table_sorted(&functions);
+
+    for (i = 0; i < functions.nentries && i < limit; i++) {
+        printf("%-10u %-8.1f %s\n", sorted[i]->count, sorted[i]->count * 100.0 / total, sorted[i]->key);
+    }
+
+    free(sorted);
+
+    return 0;
+}
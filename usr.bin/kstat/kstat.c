@@ -1,82 +1,240 @@
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <sys/kernlink.h>
-#include <sys/socket.h>
+#include <sys/sysctl.h>
 
+/* reads every counter the kernel has; returns how many there are */
 static int
-klink_query(int sfd, int what, int item, struct klink_dgram *resp, size_t len)
+read_kstats(struct kinfo_kstat **stats)
 {
-    struct klink_dgram req;
+    int mib[2];
+    size_t len;
 
-    req.opcode = KLINK_QUERY;
-    req.what = what;
-    req.item = item;
-    req.size = 0;
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_KSTAT;
 
-    if (write(sfd, &req, sizeof(struct klink_dgram)) < 0) {
+    if (sysctl(mib, 2, NULL, &len, NULL, 0) != 0) {
         return -1;
     }
 
-    int ret = read(sfd, resp, len);
+    *stats = malloc(len);
 
-    if (ret < sizeof(struct klink_dgram)) {
+    if (!*stats || sysctl(mib, 2, *stats, &len, NULL, 0) != 0) {
+        free(*stats);
         return -1;
     }
 
-    if (resp->what == KWHAT_ERROR) {
-        return -1;
+    return len / sizeof(struct kinfo_kstat);
+}
+
+static bool
+kstat_selected(struct kinfo_kstat *stat, int nprefixes, char *prefixes[])
+{
+    int i;
+
+    if (nprefixes == 0) {
+        return true;
+    }
+
+    for (i = 0; i < nprefixes; i++) {
+        if (strncmp(stat->name, prefixes[i], strlen(prefixes[i])) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static void
+print_value(struct kinfo_kstat *stat)
+{
+    switch (stat->type) {
+        case KSTAT_TYPE_INT:
+            printf("%16lld", (long long)stat->value);
+            break;
+        case KSTAT_TYPE_ADDR:
+            printf("%16p", (void*)(uintptr_t)stat->value);
+            break;
+        default:
+            printf("%16llu", (unsigned long long)stat->value);
+            break;
+    }
+}
+
+/*
+ * prints the counters once or, given an interval, over and over along with
+ * how much they changed. Counters are never unregistered, so the same index
+ * is the same counter in every snapshot
+ */
+static int
+print_kstats(int interval, int count, int nprefixes, char *prefixes[])
+{
+    int i;
+    int nlast;
+    int nstats;
+    int64_t delta;
+    struct kinfo_kstat *last;
+    struct kinfo_kstat *stats;
+
+    last = NULL;
+    nlast = 0;
+
+    for (;;) {
+        nstats = read_kstats(&stats);
+
+        if (nstats < 0) {
+            free(last);
+            return -1;
+        }
+
+        if (interval) {
+            printf("%-24s %16s %12s %12s\n", "NAME", "VALUE", "DELTA", "RATE/s");
+        }
+
+        for (i = 0; i < nstats; i++) {
+            if (!kstat_selected(&stats[i], nprefixes, prefixes)) {
+                continue;
+            }
+
+            printf("%-24s ", stats[i].name);
+            print_value(&stats[i]);
+
+            if (interval && i < nlast && stats[i].type != KSTAT_TYPE_ADDR) {
+                delta = (int64_t)(stats[i].value - last[i].value);
+                printf(" %12lld %12lld", (long long)delta, (long long)(delta / interval));
+            }
+
+            printf("\n");
+        }
+
+        free(last);
+        last = stats;
+        nlast = nstats;
+
+        if (!interval || (count && --count == 0)) {
+            break;
+        }
+
+        printf("\n");
+        fflush(stdout);
+        sleep(interval);
     }
 
+    free(last);
+
     return 0;
 }
 
 static int
-print_heap_info()
+print_sched_info()
 {
-    int sfd = socket(AF_KLINK, 0, SOCK_SEQPACKET);
+    int i;
+    int mib[3];
+    size_t len;
+    struct kinfo_cpu *cpus;
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_SCHED;
+    mib[2] = KERN_SCHED_CPUS;
 
-    if (sfd < 0) {
+    if (sysctl(mib, 3, NULL, &len, NULL, 0) != 0) {
         return -1;
     }
 
-    if (connect(sfd, 0, 0)) {
+    cpus = malloc(len);
+
+    if (sysctl(mib, 3, cpus, &len, NULL, 0) != 0) {
+        free(cpus);
         return -1;
     }
 
-    struct klink_dgram *resp = (struct klink_dgram*)malloc(65535);
+    printf("%-4s %-8s %-8s %-10s %-8s %-10s\n", "CPU", "RUNNING", "RUNQ", "SWITCHES", "STEALS", "MIGRATIONS");
 
-    klink_query(sfd, KWHAT_HEAPSTAT, 0, resp, 65535);
+    for (i = 0; i < len / sizeof(struct kinfo_cpu); i++) {
+        printf("%-4d %-8s %-8d %-10d %-8d %-10d\n", cpus[i].id, cpus[i].running ? "yes" : "no",
+            cpus[i].runq_len, cpus[i].switches, cpus[i].steals, cpus[i].migrations);
+    }
 
-    struct klink_heap_stat *heapinfo = (struct klink_heap_stat*)(resp + 1);
+    free(cpus);
 
-    printf("heap_start       : %p\n", (void*)heapinfo->heap_start);
-    printf("heap_break       : %p\n", (void*)heapinfo->heap_break);
-    printf("heap_end         : %p\n", (void*)heapinfo->heap_end);
-    printf("allocated_blocks : %d\n", heapinfo->blocks_allocated);
-    printf("free_blocks      : %d\n", heapinfo->blocks_free);
-    printf("vfs_nodes        : %d\n", heapinfo->node_count);
-    printf("files            : %d\n", heapinfo->file_count);
-    printf("procs            : %d\n", heapinfo->proc_count);
-    printf("list_elems       : %d\n", heapinfo->list_elem_count);
-    printf("page_block_count : %d\n", heapinfo->page_block_count);
-    printf("page_table_count : %d\n", heapinfo->page_table_count);
-    printf("vm_block_count   : %d\n", heapinfo->vm_block_count);
-    printf("vm_space_count   : %d\n", heapinfo->vm_space_count);
+    return 0;
+}
+
+static int
+print_intr_info()
+{
+    int i;
+    int mib[2];
+    size_t len;
+    struct kinfo_intr *intrs;
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_INTR;
 
-    free(resp);
+    if (sysctl(mib, 2, NULL, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    intrs = malloc(len);
+
+    if (sysctl(mib, 2, intrs, &len, NULL, 0) != 0) {
+        free(intrs);
+        return -1;
+    }
+
+    printf("%-8s %-12s %-8s\n", "VECTOR", "COUNT", "HANDLERS");
+
+    for (i = 0; i < len / sizeof(struct kinfo_intr); i++) {
+        printf("%-8d %-12u %-8d\n", intrs[i].vector, intrs[i].count, intrs[i].nhandlers);
+    }
+
+    free(intrs);
 
-    close(sfd);
-    
     return 0;
 }
 
 int
 main(int argc, char *argv[])
 {
-    print_heap_info();
+    int c;
+    int count;
+    int interval;
+
+    count = 0;
+    interval = 0;
+
+    while ((c = getopt(argc, argv, "c:isw:")) != -1) {
+        switch (c) {
+            case 'c':
+                count = atoi(optarg);
+                break;
+            case 'i':
+                return print_intr_info() == 0 ? 0 : 1;
+            case 's':
+                return print_sched_info() == 0 ? 0 : 1;
+            case 'w':
+                interval = atoi(optarg);
+                break;
+            default:
+                goto usage;
+        }
+    }
+
+    if (interval < 0 || count < 0) {
+        goto usage;
+    }
+
+    if (print_kstats(interval, count, argc - optind, &argv[optind]) != 0) {
+        perror("kstat");
+        return 1;
+    }
 
     return 0;
+
+usage:
+    fprintf(stderr, "usage: kstat [-c COUNT] [-w SECONDS] [PREFIX...]\n       kstat -i | -s\n");
+    return 1;
 }
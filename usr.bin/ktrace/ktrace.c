@@ -0,0 +1,337 @@
+/*
+ * ktrace - follows the system calls of a process
+ *
+ * Either attaches to a running process or starts a command with tracing
+ * already on, then prints the calls the kernel records for it until it
+ * exits or ktrace is interrupted. Durations are measured with the TSC and
+ * converted with the calibration the kernel publishes in the vDSO
+ */
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ktrace.h>
+#include <sys/syscalls.h>
+#include <sys/sysctl.h>
+#include <sys/vdso.h>
+#include <sys/wait.h>
+
+#define POLL_MSEC   50
+
+static const char *syscall_names[256] = {
+    [SYS_READ]              = "read",
+    [SYS_WRITE]             = "write",
+    [SYS_OPEN]              = "open",
+    [SYS_CLOSE]             = "close",
+    [SYS_STAT]              = "stat",
+    [SYS_FSTAT]             = "fstat",
+    [SYS_LSEEK]             = "lseek",
+    [SYS_FCNTL]             = "fcntl",
+    [SYS_IOCTL]             = "ioctl",
+    [SYS_SBRK]              = "sbrk",
+    [SYS_ACCESS]            = "access",
+    [SYS_EXECVE]            = "execve",
+    [SYS_FORK]              = "fork",
+    [SYS_EXIT]              = "exit",
+    [SYS_UNAME]             = "uname",
+    [SYS_CHROOT]            = "chroot",
+    [SYS_WAITPID]           = "waitpid",
+    [SYS_WAIT]              = "wait",
+    [SYS_READDIR]           = "readdir",
+    [SYS_CHDIR]             = "chdir",
+    [SYS_PIPE]              = "pipe",
+    [SYS_SOCKET]            = "socket",
+    [SYS_CONNECT]           = "connect",
+    [SYS_DUP]               = "dup",
+    [SYS_DUP2]              = "dup2",
+    [SYS_MKDIR]             = "mkdir",
+    [SYS_RMDIR]             = "rmdir",
+    [SYS_CREAT]             = "creat",
+    [SYS_UNLINK]            = "unlink",
+    [SYS_UMASK]             = "umask",
+    [SYS_FCHMOD]            = "fchmod",
+    [SYS_CHMOD]             = "chmod",
+    [SYS_MKPTY]             = "mkpty",
+    [SYS_ISATTY]            = "isatty",
+    [SYS_TTYNAME]           = "ttyname",
+    [SYS_TIME]              = "time",
+    [SYS_PAUSE]             = "pause",
+    [SYS_SETPGID]           = "setpgid",
+    [SYS_GETPGRP]           = "getpgrp",
+    [SYS_GETPID]            = "getpid",
+    [SYS_GETPPID]           = "getppid",
+    [SYS_GETGID]            = "getgid",
+    [SYS_GETEGID]           = "getegid",
+    [SYS_GETUID]            = "getuid",
+    [SYS_GETEUID]           = "geteuid",
+    [SYS_SETGID]            = "setgid",
+    [SYS_SETEGID]           = "setegid",
+    [SYS_SETUID]            = "setuid",
+    [SYS_SETEUID]           = "seteuid",
+    [SYS_SETSID]            = "setsid",
+    [SYS_GETSID]            = "getsid",
+    [SYS_CHOWN]             = "chown",
+    [SYS_FCHOWN]            = "fchown",
+    [SYS_TRUNCATE]          = "truncate",
+    [SYS_FTRUNCATE]         = "ftruncate",
+    [SYS_SLEEP]             = "sleep",
+    [SYS_GETCWD]            = "getcwd",
+    [SYS_KILL]              = "kill",
+    [SYS_SIGACTION]         = "sigaction",
+    [SYS_SIGRESTORE]        = "sigrestore",
+    [SYS_MKNOD]             = "mknod",
+    [SYS_ACCEPT]            = "accept",
+    [SYS_BIND]              = "bind",
+    [SYS_MMAP]              = "mmap",
+    [SYS_MUNMAP]            = "munmap",
+    [SYS_UTIMES]            = "utimes",
+    [SYS_CLONE]             = "clone",
+    [SYS_THREAD_SLEEP]      = "thread_sleep",
+    [SYS_THREAD_WAKE]       = "thread_wake",
+    [SYS_GETTID]            = "gettid",
+    [SYS_SHM_OPEN]          = "shm_open",
+    [SYS_SHM_UNLINK]        = "shm_unlink",
+    [SYS_SYSCTL]            = "sysctl",
+    [SYS_ADJTIME]           = "adjtime",
+    [SYS_MOUNT]             = "mount",
+    [SYS_LSEEK64]           = "lseek64",
+    [SYS_WORLDCTL]          = "worldctl",
+    [SYS_READV]             = "readv",
+    [SYS_WRITEV]            = "writev",
+    [SYS_PREAD]             = "pread",
+    [SYS_PWRITE]            = "pwrite",
+    [SYS_PREADV]            = "preadv",
+    [SYS_PWRITEV]           = "pwritev",
+    [SYS_MEMFD_CREATE]      = "memfd_create",
+    [SYS_LISTEN]            = "listen",
+    [SYS_RECVMSG]           = "recvmsg",
+    [SYS_SENDMSG]           = "sendmsg",
+    [SYS_GETSOCKOPT]        = "getsockopt",
+    [SYS_SETSOCKOPT]        = "setsockopt",
+    [SYS_SCHED_SETAFFINITY] = "sched_setaffinity",
+    [SYS_SCHED_GETAFFINITY] = "sched_getaffinity",
+};
+
+static volatile bool interrupted;
+
+static int
+ktrace_enable(pid_t pid, int enable)
+{
+    int mib[4];
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_KTRACE;
+    mib[2] = KERN_KTRACE_ENABLE;
+    mib[3] = pid;
+
+    return sysctl(mib, 4, NULL, NULL, &enable, sizeof(enable));
+}
+
+static void
+print_arg(uintptr_t arg)
+{
+    /* small values are more likely counts and descriptors than pointers */
+    if ((int)arg >= -4096 && (int)arg <= 0xFFFF) {
+        printf("%d", (int)arg);
+    } else {
+        printf("0x%x", (unsigned int)arg);
+    }
+}
+
+static void
+print_record(struct ktr_syscall *rec)
+{
+    int i;
+    uint32_t mult;
+    uint64_t cycles;
+    struct vdso_time *vt;
+
+    printf("[%d] ", rec->tid);
+
+    if (rec->num >= 0 && rec->num < 256 && syscall_names[rec->num]) {
+        printf("%s(", syscall_names[rec->num]);
+    } else {
+        printf("syscall_%d(", rec->num);
+    }
+
+    for (i = 0; i < rec->argc && i < KTR_NARGS; i++) {
+        if (i > 0) {
+            printf(", ");
+        }
+
+        print_arg(rec->args[i]);
+    }
+
+    printf(") = %d", rec->ret);
+
+    if (rec->ret < 0 && rec->ret > -4096) {
+        printf(" (%s)", strerror(-rec->ret));
+    }
+
+    vt = (struct vdso_time*)VDSO_TIME_ADDR;
+    mult = vt->vt_tsc_mult;
+    cycles = rec->exit - rec->entry;
+
+    if (rec->entry == 0) {
+        printf("\n");
+    } else if (mult) {
+        printf(" <%llu us>\n", (unsigned long long)((cycles * mult) >> 32));
+    } else {
+        printf(" <%llu cycles>\n", (unsigned long long)cycles);
+    }
+}
+
+/* prints what was recorded since the last call; returns -1 once the process is gone */
+static int
+drain(pid_t pid, uint32_t *last_seq)
+{
+    int i;
+    int mib[4];
+    int nrecords;
+    size_t len;
+    struct ktr_syscall *records;
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_KTRACE;
+    mib[2] = KERN_KTRACE_RECORDS;
+    mib[3] = pid;
+
+    if (sysctl(mib, 4, NULL, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    if (len == 0) {
+        return 0;
+    }
+
+    records = malloc(len);
+
+    if (sysctl(mib, 4, records, &len, NULL, 0) != 0) {
+        free(records);
+        return -1;
+    }
+
+    nrecords = len / sizeof(struct ktr_syscall);
+
+    for (i = 0; i < nrecords; i++) {
+        if (*last_seq && records[i].seq != *last_seq + 1) {
+            printf("... %u calls lost\n", records[i].seq - *last_seq - 1);
+        }
+
+        print_record(&records[i]);
+
+        *last_seq = records[i].seq;
+    }
+
+    fflush(stdout);
+    free(records);
+
+    return 0;
+}
+
+static void
+handle_sigint(int signo)
+{
+    interrupted = true;
+}
+
+/*
+ * the child waits for a byte on the pipe, so tracing is on before it
+ * executes anything
+ */
+static pid_t
+start_command(char *argv[])
+{
+    char c;
+    int fds[2];
+    pid_t pid;
+
+    if (pipe(fds) != 0) {
+        return -1;
+    }
+
+    pid = fork();
+
+    if (pid == 0) {
+        close(fds[1]);
+        read(fds[0], &c, 1);
+        close(fds[0]);
+
+        execvp(argv[0], argv);
+        perror(argv[0]);
+        exit(-1);
+    }
+
+    close(fds[0]);
+
+    if (pid > 0 && ktrace_enable(pid, 1) != 0) {
+        perror("ktrace");
+        kill(pid, SIGKILL);
+        pid = -1;
+    }
+
+    write(fds[1], "", 1);
+    close(fds[1]);
+
+    return pid;
+}
+
+int
+main(int argc, char *argv[])
+{
+    bool started;
+    int c;
+    pid_t pid;
+    uint32_t last_seq;
+
+    pid = 0;
+
+    while ((c = getopt(argc, argv, "p:")) != -1) {
+        switch (c) {
+            case 'p':
+                pid = atoi(optarg);
+                break;
+            default:
+                goto usage;
+        }
+    }
+
+    started = pid == 0;
+
+    if (started && optind < argc) {
+        pid = start_command(&argv[optind]);
+    } else if (started || optind != argc) {
+        goto usage;
+    } else if (ktrace_enable(pid, 1) != 0) {
+        perror("ktrace");
+        return -1;
+    }
+
+    if (pid <= 0) {
+        return -1;
+    }
+
+    signal(SIGINT, handle_sigint);
+
+    last_seq = 0;
+
+    while (!interrupted && drain(pid, &last_seq) == 0) {
+        _SYSCALL1(void, SYS_SLEEP, POLL_MSEC);
+    }
+
+    if (started) {
+        waitpid(pid, NULL, 0);
+    } else {
+        ktrace_enable(pid, 0);
+    }
+
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: ktrace -p PID\n       ktrace COMMAND [ARGS...]\n");
+    return -1;
+}
@@ -1,8 +1,10 @@
+#include <dirent.h>
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 #include <sys/stat.h>
-#include <elysium/sys/sysctl.h>
 
 #define minor(n) (n & 0xFF)
 #define major(n) ((n >> 8) & 0xFF)
@@ -26,16 +28,61 @@ get_file_type(int mode)
     }
 }
 
+/* each /proc/<pid>/fd/<n> reads "mode dev path" */
+static int
+print_file(int pid, int fd)
+{
+    char buf[512];
+    char path[64];
+    char *file_path;
+    int dev;
+    int len;
+    int pfd;
+    unsigned int mode;
+
+    sprintf(path, "/proc/%d/fd/%d", pid, fd);
+
+    pfd = open(path, O_RDONLY);
+
+    if (pfd < 0) {
+        return -1;
+    }
+
+    len = read(pfd, buf, sizeof(buf) - 1);
+
+    close(pfd);
+
+    if (len <= 0) {
+        return -1;
+    }
+
+    buf[len] = 0;
+    buf[strcspn(buf, "\n")] = 0;
+
+    if (sscanf(buf, "%o %d", &mode, &dev) != 2) {
+        return -1;
+    }
+
+    file_path = strchr(buf, ' ');
+    file_path = file_path ? strchr(file_path + 1, ' ') : NULL;
+
+    printf("%d: %s mode: %o dev: %d,%d\n", fd,
+            get_file_type(mode), (mode & ~S_IFMT),
+            major(dev), minor(dev)
+    );
+    printf("    %s\n", file_path ? file_path + 1 : "");
+
+    return 0;
+}
+
 int
 main(int argc, char *argv[])
 {
-    int i;
-    int nentries;
+    char path[32];
+    int fd;
     int pid;
-    size_t bufsize;
-    int oid[4];
-    struct kinfo_ofile *cur;
-    struct kinfo_ofile *entries;
+    DIR *dirp;
+    struct dirent *dirent;
 
     if (argc != 2) {
         fprintf(stderr, "usage: pfiles PID\n");
@@ -44,37 +91,23 @@ main(int argc, char *argv[])
 
     pid = atoi(argv[1]);
 
-    oid[0] = CTL_KERN;
-    oid[1] = KERN_PROC;
-    oid[2] = KERN_PROC_FILES;
-    oid[3] = pid;
-
-    bufsize = 0;
-
-    if (sysctl(oid, 4, NULL, &bufsize, NULL, 0)) {
-        perror("sysctl");
-        return -1;
-    }
+    sprintf(path, "/proc/%d/fd", pid);
 
-    entries = calloc(1, bufsize);
+    dirp = opendir(path);
 
-    if (sysctl(oid, 4, entries, &bufsize, NULL, 0)) {
-        perror("sysctl");
+    if (!dirp) {
+        perror(path);
         return -1;
     }
 
-    nentries = bufsize / sizeof(struct kinfo_ofile);
+    while ((dirent = readdir(dirp))) {
+        fd = atoi(dirent->d_name);
 
-    for (i = 0; i < nentries; i++) {
-        cur = &entries[i];
-        printf("%d: %s mode: %o dev: %d,%d\n", cur->fd,
-                get_file_type(cur->type), (cur->type & ~S_IFMT),
-                major(cur->dev), minor(cur->dev)
-        );
-        printf("    %s\n", cur->path);
+        /* fails quietly if it was closed since the directory was read */
+        print_file(pid, fd);
     }
 
-    free(entries);
+    closedir(dirp);
 
     return 0;
 }
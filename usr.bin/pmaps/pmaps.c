@@ -1,52 +1,39 @@
+#include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <elysium/sys/sysctl.h>
+#include <unistd.h>
 
 int
 main(int argc, char *argv[])
 {
-    int i;
-    int nentries;
-    int pid;
-    size_t bufsize;
-    int oid[4];
-    struct kinfo_vmentry *cur;
-    struct kinfo_vmentry *entries;
+    char buf[512];
+    char path[32];
+    int fd;
+    int len;
 
     if (argc != 2) {
         fprintf(stderr, "usage: pmaps PID\n");
         return -1;
     }
 
-    pid = atoi(argv[1]);
+    sprintf(path, "/proc/%d/maps", atoi(argv[1]));
 
-    oid[0] = CTL_KERN;
-    oid[1] = KERN_PROC;
-    oid[2] = KERN_PROC_VMMAP;
-    oid[3] = pid;
+    fd = open(path, O_RDONLY);
 
-    bufsize = 0;
-
-    if (sysctl(oid, 4, NULL, &bufsize, NULL, 0)) {
-        perror("sysctl");
+    if (fd < 0) {
+        perror(path);
         return -1;
     }
 
-    entries = calloc(1, bufsize);
-
-    if (sysctl(oid, 4, entries, &bufsize, NULL, 0)) {
-        perror("sysctl");
-        return -1;
+    while ((len = read(fd, buf, sizeof(buf))) > 0) {
+        fwrite(buf, 1, len, stdout);
     }
 
-    nentries = bufsize / sizeof(struct kinfo_vmentry);
-
-    for (i = 0; i < nentries; i++) {
-        cur = &entries[i];
-        printf("%p-%p rwx\n", cur->start, cur->end);
+    if (len < 0) {
+        perror(path);
     }
 
-    free(entries);
+    close(fd);
 
-    return 0;
+    return len < 0 ? -1 : 0;
 }
@@ -0,0 +1,376 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define SOCKBENCH_PATH  "/tmp/.sockbench"
+#define SOCKBENCH_PORT  7777
+
+union sockbench_addr {
+    struct sockaddr     sa;
+    struct sockaddr_in  sin;
+    struct sockaddr_un  sun;
+};
+
+static socklen_t
+fill_addr(int family, union sockbench_addr *addr)
+{
+    memset(addr, 0, sizeof(*addr));
+
+    if (family == AF_INET) {
+        addr->sin.sin_family = AF_INET;
+        addr->sin.sin_port = htons(SOCKBENCH_PORT);
+        addr->sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        return sizeof(struct sockaddr_in);
+    }
+
+    addr->sun.sun_family = AF_UNIX;
+    strcpy(addr->sun.sun_path, SOCKBENCH_PATH);
+
+    return sizeof(struct sockaddr_un);
+}
+
+static uint64_t
+now_usec()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static int
+read_full(int fd, void *buf, size_t len)
+{
+    ssize_t n;
+    size_t done;
+
+    for (done = 0; done < len; done += n) {
+        n = read(fd, (char*)buf + done, len - done);
+
+        if (n <= 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static int
+write_full(int fd, const void *buf, size_t len)
+{
+    ssize_t n;
+    size_t done;
+
+    for (done = 0; done < len; done += n) {
+        n = write(fd, (const char*)buf + done, len - done);
+
+        if (n <= 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static void
+set_nodelay(int fd, int family, bool nodelay)
+{
+    int val;
+
+    if (family != AF_INET) {
+        return;
+    }
+
+    val = nodelay;
+
+    if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &val, sizeof(val))) {
+        perror("setsockopt");
+    }
+}
+
+static int
+open_listener(int family)
+{
+    int fd;
+    int one;
+    socklen_t len;
+    union sockbench_addr addr;
+
+    fd = socket(family, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        perror("socket");
+        return -1;
+    }
+
+    one = 1;
+
+    if (family == AF_INET) {
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    } else {
+        unlink(SOCKBENCH_PATH);
+    }
+
+    len = fill_addr(family, &addr);
+
+    if (bind(fd, &addr.sa, len) || listen(fd, 1)) {
+        perror("bind");
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static int
+open_client(int family, bool nodelay)
+{
+    int fd;
+    socklen_t len;
+    union sockbench_addr addr;
+
+    fd = socket(family, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    set_nodelay(fd, family, nodelay);
+
+    len = fill_addr(family, &addr);
+
+    if (connect(fd, &addr.sa, len)) {
+        close(fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+/*
+ * forks a peer that connects back to us and runs peer_fn, then accepts the
+ * connection and hands it to self_fn. Returns whatever self_fn measured
+ */
+static double
+run_pair(int family, bool nodelay, int (*peer_fn)(int, void*), double (*self_fn)(int, void*), void *arg)
+{
+    int cfd;
+    int lfd;
+    int pfd;
+    int status;
+    pid_t pid;
+    socklen_t len;
+    double res;
+    union sockbench_addr addr;
+
+    lfd = open_listener(family);
+
+    if (lfd < 0) {
+        return -1;
+    }
+
+    pid = fork();
+
+    if (pid == 0) {
+        close(lfd);
+
+        pfd = open_client(family, nodelay);
+
+        if (pfd < 0) {
+            perror("connect");
+            _exit(1);
+        }
+
+        status = peer_fn(pfd, arg);
+
+        close(pfd);
+        _exit(status);
+    }
+
+    len = sizeof(addr);
+    cfd = accept(lfd, &addr.sa, &len);
+
+    close(lfd);
+
+    if (cfd < 0) {
+        perror("accept");
+        waitpid(pid, &status, 0);
+        return -1;
+    }
+
+    set_nodelay(cfd, family, nodelay);
+
+    res = self_fn(cfd, arg);
+
+    close(cfd);
+    waitpid(pid, &status, 0);
+
+    if (family == AF_UNIX) {
+        unlink(SOCKBENCH_PATH);
+    }
+
+    return res;
+}
+
+struct bulk_args {
+    size_t  total;
+    size_t  chunk;
+    char *  buf;
+};
+
+static int
+bulk_send(int fd, void *argp)
+{
+    size_t len;
+    size_t sent;
+    struct bulk_args *args;
+
+    args = argp;
+
+    for (sent = 0; sent < args->total; sent += len) {
+        len = args->total - sent < args->chunk ? args->total - sent : args->chunk;
+
+        if (write_full(fd, args->buf, len)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* returns MB/s */
+static double
+bulk_recv(int fd, void *argp)
+{
+    ssize_t n;
+    size_t received;
+    uint64_t start;
+    uint64_t elapsed;
+    struct bulk_args *args;
+
+    args = argp;
+    start = now_usec();
+
+    for (received = 0; received < args->total; received += n) {
+        n = read(fd, args->buf, args->chunk);
+
+        if (n <= 0) {
+            return -1;
+        }
+    }
+
+    elapsed = now_usec() - start;
+
+    return elapsed ? (double)args->total / elapsed : 0;
+}
+
+static int
+echo_loop(int fd, void *argp)
+{
+    int i;
+    int rounds;
+    char c;
+
+    rounds = *(int*)argp;
+
+    for (i = 0; i < rounds; i++) {
+        if (read_full(fd, &c, 1) || write_full(fd, &c, 1)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* returns the mean round trip time in microseconds */
+static double
+ping_loop(int fd, void *argp)
+{
+    int i;
+    int rounds;
+    char c;
+    uint64_t start;
+
+    rounds = *(int*)argp;
+    start = now_usec();
+
+    for (i = 0; i < rounds; i++) {
+        c = (char)i;
+
+        if (write_full(fd, &c, 1) || read_full(fd, &c, 1)) {
+            return -1;
+        }
+    }
+
+    return (double)(now_usec() - start) / rounds;
+}
+
+static void
+run_bench(const char *name, int family, bool nodelay, struct bulk_args *bulk, int rounds)
+{
+    double lat;
+    double tput;
+
+    tput = run_pair(family, nodelay, bulk_send, bulk_recv, bulk);
+    lat = run_pair(family, nodelay, echo_loop, ping_loop, &rounds);
+
+    printf("%-12s %10.2f MB/s %10.2f us/rtt\n", name, tput, lat);
+}
+
+int
+main(int argc, char *argv[])
+{
+    int c;
+    int rounds;
+    struct bulk_args bulk;
+
+    bulk.total = 16 * 1024 * 1024;
+    bulk.chunk = 8192;
+    rounds = 10000;
+
+    while ((c = getopt(argc, argv, "b:r:s:")) != -1) {
+        switch (c) {
+            case 'b':
+                bulk.total = strtoul(optarg, NULL, 0);
+                break;
+            case 'r':
+                rounds = atoi(optarg);
+                break;
+            case 's':
+                bulk.chunk = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                fprintf(stderr, "usage: sockbench [-b bytes] [-r roundtrips] [-s writesize]\n");
+                return -1;
+        }
+    }
+
+    if (bulk.chunk == 0 || rounds <= 0) {
+        fprintf(stderr, "sockbench: write size and round trips must be positive\n");
+        return -1;
+    }
+
+    bulk.buf = calloc(1, bulk.chunk);
+
+    printf("%zu bytes in %zu byte writes, %d 1 byte round trips\n\n", bulk.total, bulk.chunk, rounds);
+    printf("%-12s %15s %15s\n", "SOCKET", "THROUGHPUT", "LATENCY");
+
+    run_bench("unix", AF_UNIX, false, &bulk, rounds);
+    run_bench("tcp", AF_INET, false, &bulk, rounds);
+    run_bench("tcp-nodelay", AF_INET, true, &bulk, rounds);
+
+    free(bulk.buf);
+
+    return 0;
+}
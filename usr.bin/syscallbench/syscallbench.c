@@ -0,0 +1,101 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/syscalls.h>
+#include <sys/time.h>
+
+/* not registered by the kernel; measures entry and exit alone */
+#define SYS_NULL    0xFF
+
+static inline uint64_t
+rdtsc()
+{
+    uint32_t lo;
+    uint32_t hi;
+
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+
+    return ((uint64_t)hi << 32) | lo;
+}
+
+static uint64_t
+now_usec()
+{
+    struct timeval tv;
+
+    gettimeofday(&tv, NULL);
+
+    return (uint64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+static void
+bench(const char *name, int sysenter, int syscall, int iterations)
+{
+    int i;
+    int saved;
+    uint64_t cycles;
+    uint64_t usec;
+
+    saved = _syscall_sysenter;
+    _syscall_sysenter = sysenter;
+
+    /* warm up the caches and TLB before measuring */
+    for (i = 0; i < 1000; i++) {
+        _SYSCALL0(int, syscall);
+    }
+
+    usec = now_usec();
+    cycles = rdtsc();
+
+    for (i = 0; i < iterations; i++) {
+        _SYSCALL0(int, syscall);
+    }
+
+    cycles = rdtsc() - cycles;
+    usec = now_usec() - usec;
+
+    _syscall_sysenter = saved;
+
+    printf("%-10s %-10s %10llu %10llu\n", name, sysenter ? "sysenter" : "int 0x80",
+            (unsigned long long)(cycles / iterations),
+            (unsigned long long)(usec * 1000 / iterations));
+}
+
+int
+main(int argc, char *argv[])
+{
+    int iterations;
+
+    iterations = 1000000;
+
+    if (argc == 2) {
+        iterations = atoi(argv[1]);
+    } else if (argc > 2) {
+        fprintf(stderr, "usage: syscallbench [ITERATIONS]\n");
+        return -1;
+    }
+
+    if (iterations <= 0) {
+        fprintf(stderr, "syscallbench: iterations must be positive\n");
+        return -1;
+    }
+
+    printf("%-10s %-10s %10s %10s\n", "SYSCALL", "ENTRY", "CYCLES", "NSEC");
+
+    bench("null", 0, SYS_NULL, iterations);
+
+    if (_syscall_sysenter) {
+        bench("null", 1, SYS_NULL, iterations);
+    }
+
+    bench("getpid", 0, SYS_GETPID, iterations);
+
+    if (_syscall_sysenter) {
+        bench("getpid", 1, SYS_GETPID, iterations);
+    } else {
+        printf("SYSENTER is not supported on this CPU\n");
+    }
+
+    return 0;
+}
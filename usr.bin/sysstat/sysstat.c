@@ -0,0 +1,401 @@
+/*
+ * sysstat - shows which system calls are being made and how long they take
+ *
+ * Polls the kernel's per-call counters and latency histograms, either for
+ * the whole system or for one process, and prints the busiest calls of each
+ * interval with their rate and the 50th and 99th percentile of their
+ * duration. Percentiles are only as precise as the histogram's power of two
+ * buckets, so each is the upper bound of the bucket it falls in
+ */
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscalls.h>
+#include <sys/sysctl.h>
+#include <sys/vdso.h>
+
+static const char *syscall_names[256] = {
+    [SYS_READ]              = "read",
+    [SYS_WRITE]             = "write",
+    [SYS_OPEN]              = "open",
+    [SYS_CLOSE]             = "close",
+    [SYS_STAT]              = "stat",
+    [SYS_FSTAT]             = "fstat",
+    [SYS_LSEEK]             = "lseek",
+    [SYS_FCNTL]             = "fcntl",
+    [SYS_IOCTL]             = "ioctl",
+    [SYS_SBRK]              = "sbrk",
+    [SYS_ACCESS]            = "access",
+    [SYS_EXECVE]            = "execve",
+    [SYS_FORK]              = "fork",
+    [SYS_EXIT]              = "exit",
+    [SYS_UNAME]             = "uname",
+    [SYS_CHROOT]            = "chroot",
+    [SYS_WAITPID]           = "waitpid",
+    [SYS_WAIT]              = "wait",
+    [SYS_READDIR]           = "readdir",
+    [SYS_CHDIR]             = "chdir",
+    [SYS_PIPE]              = "pipe",
+    [SYS_SOCKET]            = "socket",
+    [SYS_CONNECT]           = "connect",
+    [SYS_DUP]               = "dup",
+    [SYS_DUP2]              = "dup2",
+    [SYS_MKDIR]             = "mkdir",
+    [SYS_RMDIR]             = "rmdir",
+    [SYS_CREAT]             = "creat",
+    [SYS_UNLINK]            = "unlink",
+    [SYS_UMASK]             = "umask",
+    [SYS_FCHMOD]            = "fchmod",
+    [SYS_CHMOD]             = "chmod",
+    [SYS_MKPTY]             = "mkpty",
+    [SYS_ISATTY]            = "isatty",
+    [SYS_TTYNAME]           = "ttyname",
+    [SYS_TIME]              = "time",
+    [SYS_PAUSE]             = "pause",
+    [SYS_SETPGID]           = "setpgid",
+    [SYS_GETPGRP]           = "getpgrp",
+    [SYS_GETPID]            = "getpid",
+    [SYS_GETPPID]           = "getppid",
+    [SYS_GETGID]            = "getgid",
+    [SYS_GETEGID]           = "getegid",
+    [SYS_GETUID]            = "getuid",
+    [SYS_GETEUID]           = "geteuid",
+    [SYS_SETGID]            = "setgid",
+    [SYS_SETEGID]           = "setegid",
+    [SYS_SETUID]            = "setuid",
+    [SYS_SETEUID]           = "seteuid",
+    [SYS_SETSID]            = "setsid",
+    [SYS_GETSID]            = "getsid",
+    [SYS_CHOWN]             = "chown",
+    [SYS_FCHOWN]            = "fchown",
+    [SYS_TRUNCATE]          = "truncate",
+    [SYS_FTRUNCATE]         = "ftruncate",
+    [SYS_SLEEP]             = "sleep",
+    [SYS_GETCWD]            = "getcwd",
+    [SYS_KILL]              = "kill",
+    [SYS_SIGACTION]         = "sigaction",
+    [SYS_SIGRESTORE]        = "sigrestore",
+    [SYS_MKNOD]             = "mknod",
+    [SYS_ACCEPT]            = "accept",
+    [SYS_BIND]              = "bind",
+    [SYS_MMAP]              = "mmap",
+    [SYS_MUNMAP]            = "munmap",
+    [SYS_UTIMES]            = "utimes",
+    [SYS_CLONE]             = "clone",
+    [SYS_THREAD_SLEEP]      = "thread_sleep",
+    [SYS_THREAD_WAKE]       = "thread_wake",
+    [SYS_GETTID]            = "gettid",
+    [SYS_SHM_OPEN]          = "shm_open",
+    [SYS_SHM_UNLINK]        = "shm_unlink",
+    [SYS_SYSCTL]            = "sysctl",
+    [SYS_ADJTIME]           = "adjtime",
+    [SYS_MOUNT]             = "mount",
+    [SYS_LSEEK64]           = "lseek64",
+    [SYS_WORLDCTL]          = "worldctl",
+    [SYS_READV]             = "readv",
+    [SYS_WRITEV]            = "writev",
+    [SYS_PREAD]             = "pread",
+    [SYS_PWRITE]            = "pwrite",
+    [SYS_PREADV]            = "preadv",
+    [SYS_PWRITEV]           = "pwritev",
+    [SYS_MEMFD_CREATE]      = "memfd_create",
+    [SYS_LISTEN]            = "listen",
+    [SYS_RECVMSG]           = "recvmsg",
+    [SYS_SENDMSG]           = "sendmsg",
+    [SYS_GETSOCKOPT]        = "getsockopt",
+    [SYS_SETSOCKOPT]        = "setsockopt",
+    [SYS_SCHED_SETAFFINITY] = "sched_setaffinity",
+    [SYS_SCHED_GETAFFINITY] = "sched_getaffinity",
+};
+
+struct sample {
+    int         num;
+    uint32_t    calls;
+    uint32_t    errors;
+    uint64_t    cycles;
+    uint32_t    hist[KSYSCALLSTAT_NBUCKETS];
+};
+
+/* what the previous snapshot said about every call */
+static struct kinfo_syscallstat last[256];
+
+static volatile bool interrupted;
+
+static int
+proc_enable(pid_t pid, int enable)
+{
+    int mib[4];
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_SYSCALLSTAT;
+    mib[2] = KERN_SYSCALLSTAT_PROC;
+    mib[3] = pid;
+
+    return sysctl(mib, 4, NULL, NULL, &enable, sizeof(enable));
+}
+
+/* replaces *entries with the current counters; returns how many there are */
+static int
+snapshot(pid_t pid, struct kinfo_syscallstat **entries)
+{
+    int mib[4];
+    int miblen;
+    size_t len;
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_SYSCALLSTAT;
+
+    if (pid) {
+        mib[2] = KERN_SYSCALLSTAT_PROC;
+        mib[3] = pid;
+        miblen = 4;
+    } else {
+        mib[2] = KERN_SYSCALLSTAT_ALL;
+        miblen = 3;
+    }
+
+    if (sysctl(mib, miblen, NULL, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    /* room for calls made for the first time in between */
+    len += 16*sizeof(struct kinfo_syscallstat);
+
+    free(*entries);
+    *entries = malloc(len);
+
+    if (!*entries || sysctl(mib, miblen, *entries, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    return len / sizeof(struct kinfo_syscallstat);
+}
+
+static int
+compare_samples(const void *a, const void *b)
+{
+    const struct sample *sa = a;
+    const struct sample *sb = b;
+
+    if (sa->calls != sb->calls) {
+        return sa->calls < sb->calls ? 1 : -1;
+    }
+
+    return sa->num - sb->num;
+}
+
+/* upper bound of the bucket the given fraction of calls falls into, in cycles */
+static uint64_t
+percentile(struct sample *sample, int permille)
+{
+    int i;
+    uint64_t seen;
+    uint64_t want;
+
+    want = ((uint64_t)sample->calls * permille + 999) / 1000;
+    seen = 0;
+
+    for (i = 0; i < KSYSCALLSTAT_NBUCKETS; i++) {
+        seen += sample->hist[i];
+
+        if (seen >= want) {
+            break;
+        }
+    }
+
+    return i == 0 ? 1 : (uint64_t)1 << i;
+}
+
+static void
+print_duration(uint64_t cycles)
+{
+    uint32_t mult;
+    struct vdso_time *vt;
+
+    vt = (struct vdso_time*)VDSO_TIME_ADDR;
+    mult = vt->vt_tsc_mult;
+
+    if (mult) {
+        printf(" %10llu", (unsigned long long)((cycles * mult) >> 32));
+    } else {
+        printf(" %10llu", (unsigned long long)cycles);
+    }
+}
+
+static void
+print_interval(struct kinfo_syscallstat *entries, int nentries, int interval, int top, bool clear)
+{
+    int i;
+    int j;
+    int nsamples;
+    uint32_t total;
+    struct kinfo_syscallstat *prev;
+    struct sample samples[256];
+    struct vdso_time *vt;
+
+    nsamples = 0;
+    total = 0;
+
+    for (i = 0; i < nentries; i++) {
+        if (entries[i].num < 0 || entries[i].num >= 256) {
+            continue;
+        }
+
+        prev = &last[entries[i].num];
+
+        samples[nsamples].num = entries[i].num;
+        samples[nsamples].calls = entries[i].calls - prev->calls;
+        samples[nsamples].errors = entries[i].errors - prev->errors;
+        samples[nsamples].cycles = entries[i].cycles - prev->cycles;
+
+        for (j = 0; j < KSYSCALLSTAT_NBUCKETS; j++) {
+            samples[nsamples].hist[j] = entries[i].hist[j] - prev->hist[j];
+        }
+
+        total += samples[nsamples].calls;
+
+        memcpy(prev, &entries[i], sizeof(*prev));
+
+        if (samples[nsamples].calls) {
+            nsamples++;
+        }
+    }
+
+    qsort(samples, nsamples, sizeof(struct sample), compare_samples);
+
+    if (clear) {
+        printf("\033[H\033[2J");
+    }
+
+    vt = (struct vdso_time*)VDSO_TIME_ADDR;
+
+    printf("%u calls, %u/s\n\n", total, total / interval);
+    printf("%-20s %10s %10s %8s %10s %10s %10s\n", "SYSCALL", "CALLS", "RATE/s", "ERRORS",
+            vt->vt_tsc_mult ? "AVG(us)" : "AVG(cyc)", "P50", "P99");
+
+    for (i = 0; i < nsamples && (top == 0 || i < top); i++) {
+        if (syscall_names[samples[i].num]) {
+            printf("%-20s", syscall_names[samples[i].num]);
+        } else {
+            printf("syscall_%-12d", samples[i].num);
+        }
+
+        printf(" %10u %10u %8u", samples[i].calls, samples[i].calls / interval, samples[i].errors);
+
+        print_duration(samples[i].cycles / samples[i].calls);
+        print_duration(percentile(&samples[i], 500));
+        print_duration(percentile(&samples[i], 990));
+
+        printf("\n");
+    }
+
+    fflush(stdout);
+}
+
+static void
+handle_sigint(int signo)
+{
+    interrupted = true;
+}
+
+int
+main(int argc, char *argv[])
+{
+    bool clear;
+    int c;
+    int count;
+    int interval;
+    int nentries;
+    int top;
+    pid_t pid;
+    struct kinfo_syscallstat *entries;
+
+    clear = isatty(STDOUT_FILENO);
+    count = 0;
+    interval = 1;
+    pid = 0;
+    top = 20;
+
+    while ((c = getopt(argc, argv, "c:i:n:p:")) != -1) {
+        switch (c) {
+            case 'c':
+                top = atoi(optarg);
+                break;
+            case 'i':
+                interval = atoi(optarg);
+                break;
+            case 'n':
+                count = atoi(optarg);
+                break;
+            case 'p':
+                pid = atoi(optarg);
+                break;
+            default:
+                goto usage;
+        }
+    }
+
+    if (optind != argc || interval <= 0 || top < 0 || count < 0 || pid < 0) {
+        goto usage;
+    }
+
+    if (pid && proc_enable(pid, 1) != 0) {
+        perror("sysstat");
+        return -1;
+    }
+
+    entries = NULL;
+
+    nentries = snapshot(pid, &entries);
+
+    if (nentries < 0) {
+        perror("sysstat");
+        return -1;
+    }
+
+    /* the first interval only shows what happened during it */
+    for (c = 0; c < nentries; c++) {
+        if (entries[c].num >= 0 && entries[c].num < 256) {
+            memcpy(&last[entries[c].num], &entries[c], sizeof(last[0]));
+        }
+    }
+
+    signal(SIGINT, handle_sigint);
+
+    while (!interrupted) {
+        sleep(interval);
+
+        if (interrupted) {
+            break;
+        }
+
+        nentries = snapshot(pid, &entries);
+
+        if (nentries < 0) {
+            break;
+        }
+
+        print_interval(entries, nentries, interval, top, clear);
+
+        if (count && --count == 0) {
+            break;
+        }
+    }
+
+    /* stop the process paying for statistics nobody reads anymore */
+    if (pid) {
+        proc_enable(pid, 0);
+    }
+
+    free(entries);
+
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: sysstat [-c TOP] [-i SECONDS] [-n COUNT] [-p PID]\n");
+    return -1;
+}
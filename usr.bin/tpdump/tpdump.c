@@ -0,0 +1,391 @@
+/*
+ * tpdump - prints the records of the kernel's static tracepoints
+ *
+ * Maps every CPU's trace buffer from /dev/trace, enables the requested
+ * events and prints what they record, merging the CPUs' records by
+ * timestamp, until interrupted. With -d it instead prints what the buffers
+ * currently hold and leaves the enabled events alone. Timestamps are
+ * relative to the first record printed and converted with the calibration
+ * the kernel publishes in the vDSO
+ */
+#include <fcntl.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscalls.h>
+#include <sys/sysctl.h>
+#include <sys/trace.h>
+#include <sys/vdso.h>
+
+#define POLL_MSEC   50
+#define MAXCPU      16
+
+static const char *event_names[TRACE_NEVENTS] = {
+    [TRACE_SCHED_SWITCH]    = "switch",
+    [TRACE_SCHED_WAKEUP]    = "wakeup",
+    [TRACE_PAGE_FAULT]      = "fault",
+    [TRACE_BLOCK_SUBMIT]    = "blk_submit",
+    [TRACE_BLOCK_COMPLETE]  = "blk_complete",
+    [TRACE_VFS_LOOKUP]      = "lookup",
+    [TRACE_SYSCALL_ENTER]   = "sys_enter",
+    [TRACE_SYSCALL_EXIT]    = "sys_exit",
+};
+
+struct trace_cpu {
+    struct trace_header *   header;
+    struct trace_record *   records;
+    uint32_t                tail;   /* next slot to read */
+};
+
+static struct trace_cpu trace_cpus[MAXCPU];
+static int ncpus;
+
+/* records drained in one poll, sorted before they are printed */
+static struct trace_record *batch;
+static int batch_size;
+
+static uint64_t first_tsc;
+static uint32_t lost;
+
+static volatile bool interrupted;
+
+static int
+trace_get_mask(uint32_t *mask)
+{
+    int mib[3];
+    size_t len;
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_TRACE;
+    mib[2] = KERN_TRACE_MASK;
+
+    len = sizeof(*mask);
+
+    return sysctl(mib, 3, mask, &len, NULL, 0);
+}
+
+static int
+trace_set_mask(uint32_t mask)
+{
+    int mib[3];
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_TRACE;
+    mib[2] = KERN_TRACE_MASK;
+
+    return sysctl(mib, 3, NULL, NULL, &mask, sizeof(mask));
+}
+
+static int
+trace_get_ncpus()
+{
+    int mib[3];
+    int res;
+    size_t len;
+
+    mib[0] = CTL_KERN;
+    mib[1] = KERN_TRACE;
+    mib[2] = KERN_TRACE_NCPUS;
+
+    len = sizeof(res);
+
+    if (sysctl(mib, 3, &res, &len, NULL, 0) != 0) {
+        return -1;
+    }
+
+    return res;
+}
+
+static int
+parse_events(char *list, uint32_t *mask)
+{
+    int i;
+    char *name;
+
+    *mask = 0;
+
+    for (name = strtok(list, ","); name; name = strtok(NULL, ",")) {
+        for (i = 1; i < TRACE_NEVENTS; i++) {
+            if (strcmp(name, event_names[i]) == 0) {
+                break;
+            }
+        }
+
+        if (i == TRACE_NEVENTS) {
+            fprintf(stderr, "tpdump: unknown event %s\n", name);
+            return -1;
+        }
+
+        *mask |= (1 << i);
+    }
+
+    return 0;
+}
+
+static int
+map_buffers(bool from_oldest)
+{
+    int i;
+    int fd;
+    void *buf;
+    struct trace_cpu *tc;
+
+    fd = open("/dev/trace", O_RDONLY);
+
+    if (fd == -1) {
+        return -1;
+    }
+
+    for (i = 0; i < ncpus; i++) {
+        buf = mmap(NULL, TRACE_BUF_SIZE, PROT_READ, MAP_SHARED, fd, (off_t)i * TRACE_BUF_SIZE);
+
+        if (!buf) {
+            close(fd);
+            return -1;
+        }
+
+        tc = &trace_cpus[i];
+        tc->header = buf;
+        tc->records = (struct trace_record*)((uint8_t*)buf + 4096);
+        tc->tail = tc->header->head;
+
+        if (from_oldest) {
+            tc->tail = tc->tail > TRACE_NRECORDS ? tc->tail - TRACE_NRECORDS : 0;
+        }
+    }
+
+    close(fd);
+
+    return 0;
+}
+
+/*
+ * copies what one CPU recorded since the last call into the batch. The
+ * kernel doesn't wait for us, so a record is only trusted if its sequence
+ * number still matches its slot after it was copied
+ */
+static void
+drain_cpu(struct trace_cpu *tc)
+{
+    uint32_t head;
+    uint32_t seq;
+    struct trace_record *rec;
+    struct trace_record *copy;
+
+    head = tc->header->head;
+
+    if (head - tc->tail > TRACE_NRECORDS) {
+        lost += head - tc->tail - TRACE_NRECORDS;
+        tc->tail = head - TRACE_NRECORDS;
+    }
+
+    while (tc->tail != head) {
+        rec = &tc->records[tc->tail % TRACE_NRECORDS];
+        copy = &batch[batch_size];
+
+        memcpy(copy, rec, sizeof(*copy));
+        __sync_synchronize();
+        seq = rec->seq;
+
+        if (seq != tc->tail + 1 || copy->seq != seq) {
+            /* still being written; pick it up next time */
+            if ((int32_t)(seq - (tc->tail + 1)) < 0) {
+                break;
+            }
+
+            lost++;
+        } else {
+            batch_size++;
+        }
+
+        tc->tail++;
+    }
+}
+
+static int
+compare_records(const void *a, const void *b)
+{
+    const struct trace_record *ra;
+    const struct trace_record *rb;
+
+    ra = a;
+    rb = b;
+
+    if (ra->tsc != rb->tsc) {
+        return ra->tsc < rb->tsc ? -1 : 1;
+    }
+
+    return ra->cpu - rb->cpu;
+}
+
+static void
+print_record(struct trace_record *rec)
+{
+    uint32_t mult;
+    uint64_t delta;
+    struct vdso_time *vt;
+
+    vt = (struct vdso_time*)VDSO_TIME_ADDR;
+    mult = vt->vt_tsc_mult;
+
+    if (first_tsc == 0) {
+        first_tsc = rec->tsc;
+    }
+
+    delta = rec->tsc - first_tsc;
+
+    if (mult) {
+        printf("%12llu ", (unsigned long long)((delta * mult) >> 32));
+    } else {
+        printf("%12llu ", (unsigned long long)delta);
+    }
+
+    printf("%2d %5d %-12s ", rec->cpu, rec->tid,
+            rec->event < TRACE_NEVENTS && event_names[rec->event] ? event_names[rec->event] : "?");
+
+    switch (rec->event) {
+        case TRACE_SCHED_SWITCH:
+            printf("prev=%d next=%d prev_state=%d\n", rec->args[0], rec->args[1], rec->args[2]);
+            break;
+        case TRACE_SCHED_WAKEUP:
+            printf("tid=%d from_state=%d\n", rec->args[0], rec->args[1]);
+            break;
+        case TRACE_PAGE_FAULT:
+            printf("addr=0x%08x err=0x%x eip=0x%08x\n", rec->args[0], rec->args[1], rec->args[2]);
+            break;
+        case TRACE_BLOCK_SUBMIT:
+            printf("sector=%u %s\n", rec->args[0], rec->args[1] ? "write" : "read");
+            break;
+        case TRACE_BLOCK_COMPLETE:
+            printf("sector=%u %s status=%d\n", rec->args[0], rec->args[1] ? "write" : "read",
+                    rec->args[2]);
+            break;
+        case TRACE_VFS_LOOKUP:
+            printf("dir=%u res=%d inode=%u\n", rec->args[0], rec->args[1], rec->args[2]);
+            break;
+        case TRACE_SYSCALL_ENTER:
+            printf("num=%u arg0=0x%x arg1=0x%x\n", rec->args[0], rec->args[1], rec->args[2]);
+            break;
+        case TRACE_SYSCALL_EXIT:
+            printf("num=%u ret=%d\n", rec->args[0], (int)rec->args[1]);
+            break;
+        default:
+            printf("0x%x 0x%x 0x%x\n", rec->args[0], rec->args[1], rec->args[2]);
+            break;
+    }
+}
+
+static void
+drain()
+{
+    int i;
+
+    batch_size = 0;
+
+    for (i = 0; i < ncpus; i++) {
+        drain_cpu(&trace_cpus[i]);
+    }
+
+    qsort(batch, batch_size, sizeof(batch[0]), compare_records);
+
+    for (i = 0; i < batch_size; i++) {
+        print_record(&batch[i]);
+    }
+
+    fflush(stdout);
+}
+
+static void
+handle_sigint(int signo)
+{
+    interrupted = true;
+}
+
+int
+main(int argc, char *argv[])
+{
+    bool dump;
+    int c;
+    uint32_t mask;
+    uint32_t old_mask;
+
+    dump = false;
+    mask = (1 << TRACE_NEVENTS) - 2;
+
+    while ((c = getopt(argc, argv, "de:")) != -1) {
+        switch (c) {
+            case 'd':
+                dump = true;
+                break;
+            case 'e':
+                if (parse_events(optarg, &mask) != 0) {
+                    return -1;
+                }
+                break;
+            default:
+                goto usage;
+        }
+    }
+
+    if (optind != argc) {
+        goto usage;
+    }
+
+    ncpus = trace_get_ncpus();
+
+    if (ncpus <= 0 || trace_get_mask(&old_mask) != 0) {
+        perror("tpdump");
+        return -1;
+    }
+
+    if (ncpus > MAXCPU) {
+        ncpus = MAXCPU;
+    }
+
+    /* the buffers only exist once something has been traced */
+    if (!dump && trace_set_mask(mask | old_mask) != 0) {
+        perror("tpdump");
+        return -1;
+    }
+
+    batch = calloc(ncpus * TRACE_NRECORDS, sizeof(batch[0]));
+
+    if (!batch || map_buffers(dump) != 0) {
+        perror("tpdump");
+
+        if (!dump) {
+            trace_set_mask(old_mask);
+        }
+
+        return -1;
+    }
+
+    if (dump) {
+        drain();
+    } else {
+        signal(SIGINT, handle_sigint);
+
+        while (!interrupted) {
+            drain();
+            _SYSCALL1(void, SYS_SLEEP, POLL_MSEC);
+        }
+
+        trace_set_mask(old_mask);
+        drain();
+    }
+
+    if (lost) {
+        fprintf(stderr, "tpdump: %u records lost\n", lost);
+    }
+
+    return 0;
+
+usage:
+    fprintf(stderr, "usage: tpdump [-d] [-e EVENT[,EVENT...]]\n");
+    return -1;
+}
@@ -343,7 +343,6 @@ canvas_putcanvas(canvas_t *canvas, int x1, int y1, int x2, int y2, int width, in
 void
 canvas_putpixels(canvas_t *canvas, int x, int y, int width, int height, color_t *pixels)
 {
-    int a_x;
     int a_y;
     int max_width;
     int max_height;
@@ -370,17 +369,15 @@ canvas_putpixels(canvas_t *canvas, int x, int y, int width, int height, color_t
 
     dstpixels = canvas->pixels->pixels;
 
-    for (a_x = 0; a_x < width; a_x++)
     for (a_y = 0; a_y < height; a_y++) {
         int bitmap_pos;
         int buf_pos;
 
-        buf_pos = (canvas->width * (a_y + y)) + (a_x + x);
-        bitmap_pos = height * a_y + a_x;
+        buf_pos = (canvas->width * (a_y + y)) + x;
+        bitmap_pos = height * a_y;
 
-        if (pixels[bitmap_pos] != 0xFFFFFFFF) {
-            dstpixels[buf_pos] = pixels[bitmap_pos];
-        }
+        /* 0xFFFFFFFF is transparent */
+        fast_maskcpy_d(&dstpixels[buf_pos], &pixels[bitmap_pos], width, 0xFFFFFFFF);
     }
 }
 
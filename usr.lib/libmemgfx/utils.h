@@ -4,6 +4,10 @@
 #include <stdint.h>
 #include <stdlib.h>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 #define MIN(a,b) (((a)<(b))?(a):(b))
 
 #define POINT_LESS_THAN(x1,y1,x2,y2) (y1 < y2 && x1 < x2)
@@ -27,4 +31,31 @@ fast_memset_d(void *dst, uint32_t val, size_t nbyte)
             : "memory");
 }   
 
+/* copies every pixel that isn't the transparent key, four at a time with SSE2 */
+static inline void
+fast_maskcpy_d(uint32_t *dst, const uint32_t *src, size_t count, uint32_t key)
+{
+    size_t i;
+
+    i = 0;
+
+#ifdef __SSE2__
+    __m128i keys = _mm_set1_epi32(key);
+
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i*)&src[i]);
+        __m128i d = _mm_loadu_si128((const __m128i*)&dst[i]);
+        __m128i m = _mm_cmpeq_epi32(s, keys);
+
+        _mm_storeu_si128((__m128i*)&dst[i], _mm_or_si128(_mm_and_si128(m, d), _mm_andnot_si128(m, s)));
+    }
+#endif
+
+    for (; i < count; i++) {
+        if (src[i] != key) {
+            dst[i] = src[i];
+        }
+    }
+}
+
 #endif
@@ -21,3 +21,31 @@ thread_signal(pid_t tid)
 
     return ret;
 }
+
+int
+thread_getaffinity(pid_t tid)
+{
+    int ret;
+
+    asm volatile("int $0x80" : "=a"(ret) : "a"(SYS_SCHED_GETAFFINITY), "b"(tid));
+
+    if (ret < 0) {
+        return -1;
+    }
+
+    return ret;
+}
+
+int
+thread_setaffinity(pid_t tid, unsigned int mask)
+{
+    int ret;
+
+    asm volatile("int $0x80" : "=a"(ret) : "a"(SYS_SCHED_SETAFFINITY), "b"(tid), "c"(mask));
+
+    if (ret < 0) {
+        return -1;
+    }
+
+    return ret;
+}
@@ -24,6 +24,10 @@ void thread_spin_unlock(thread_spinlock_t volatile *lock);
 int thread_signal(pid_t tid);
 void thread_pause();
 
+/* one bit per CPU; a tid of 0 is the calling thread */
+int thread_getaffinity(pid_t tid);
+int thread_setaffinity(pid_t tid, unsigned int mask);
+
 void thread_cond_init(thread_cond_t *cond);
 void thread_cond_wait(thread_cond_t *cond);
 void thread_cond_signal(thread_cond_t *cond);
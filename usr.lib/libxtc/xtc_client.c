@@ -6,6 +6,7 @@
 #include <libmemgfx/canvas.h>
 #include <sys/mman.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 
 #include "libxtc.h"
@@ -13,6 +14,20 @@
 
 static int xtc_sock_fd = 0;
 
+/* sends a message header and its payload as one atomic write */
+static int
+xtc_send_msg(struct xtc_msg_hdr *msg, const void *payload)
+{
+    struct iovec iov[2];
+
+    iov[0].iov_base = msg;
+    iov[0].iov_len = sizeof(*msg);
+    iov[1].iov_base = (void*)payload;
+    iov[1].iov_len = msg->payload_size;
+
+    return writev(xtc_sock_fd, iov, 2);
+}
+
 int
 xtc_connect()
 {
@@ -175,8 +190,7 @@ xtc_put_string(xtc_win_t win, int x, int y, const char *str, int col)
     
     msg.payload_size = strlen(str);
 
-    write(xtc_sock_fd, &msg, sizeof(msg));
-    write(xtc_sock_fd, str, msg.payload_size);
+    xtc_send_msg(&msg, str);
     read(xtc_sock_fd, &msg, sizeof(msg));
 
     return 0;
@@ -192,8 +206,7 @@ xtc_set_window_title(xtc_win_t win, const char *title)
     msg.parameters[0] = win;
     msg.payload_size = strlen(title);
 
-    write(xtc_sock_fd, &msg, sizeof(msg));
-    write(xtc_sock_fd, title, msg.payload_size);
+    xtc_send_msg(&msg, title);
     read(xtc_sock_fd, &msg, sizeof(msg));
 
     return 0;
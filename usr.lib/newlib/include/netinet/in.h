@@ -0,0 +1,47 @@
+#ifndef _NETINET_IN_H
+#define _NETINET_IN_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#define IPPROTO_IP          0
+#define IPPROTO_ICMP        1
+#define IPPROTO_TCP         6
+#define IPPROTO_UDP         17
+
+#define INADDR_ANY          ((in_addr_t)0x00000000)
+#define INADDR_BROADCAST    ((in_addr_t)0xFFFFFFFF)
+#define INADDR_LOOPBACK     ((in_addr_t)0x7F000001)
+
+#define IN_LOOPBACKNET      127
+
+typedef uint16_t in_port_t;
+typedef uint32_t in_addr_t;
+
+struct in_addr {
+    in_addr_t   s_addr;
+};
+
+struct sockaddr_in {
+    uint16_t        sin_family;
+    in_port_t       sin_port;
+    struct in_addr  sin_addr;
+    uint8_t         sin_zero[8];
+};
+
+static inline uint16_t
+htons(uint16_t x)
+{
+    return (x << 8) | (x >> 8);
+}
+
+static inline uint32_t
+htonl(uint32_t x)
+{
+    return ((x & 0xFF) << 24) | ((x & 0xFF00) << 8) | ((x >> 8) & 0xFF00) | (x >> 24);
+}
+
+#define ntohs(x)    htons(x)
+#define ntohl(x)    htonl(x)
+
+#endif
@@ -0,0 +1,8 @@
+#ifndef _NETINET_TCP_H
+#define _NETINET_TCP_H
+
+#define TCP_NODELAY     1
+#define TCP_MAXSEG      2
+#define TCP_QUICKACK    12
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef _SYS_KTRACE_H
+#define _SYS_KTRACE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* must match sys/sys/ktrace.h */
+#define KTR_NARGS       5
+
+struct ktr_syscall {
+    uint32_t    seq;
+    pid_t       tid;
+    int         num;
+    int         argc;
+    uintptr_t   args[KTR_NARGS];
+    int         ret;
+    uint64_t    entry;
+    uint64_t    exit;
+};
+
+#endif
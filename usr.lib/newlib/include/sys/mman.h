@@ -8,7 +8,10 @@
 #define MAP_SHARED  0x02
 #define MAP_PRIVATE 0x01
 
+#define MFD_CLOEXEC 0x0001
+
 void *mmap(void *addr, size_t length, int prot, int flags, int fd, off_t offset);
+int memfd_create(const char *name, unsigned int flags);
 int shm_open(const char *path, int oflag, mode_t mode);
 int shm_unlink(const char *path);
 
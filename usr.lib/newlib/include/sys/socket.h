@@ -2,6 +2,8 @@
 #define _SYS_SOCKET_H
 
 #include <stdint.h>
+#include <sys/types.h>
+#include <sys/uio.h>
 
 typedef unsigned int socklen_t;
 
@@ -18,7 +20,6 @@ typedef unsigned int socklen_t;
 #define PF_INET     2
 #define PF_INET6    10
 #define PF_PACKET   17
-#define PF_KLINK    40
 
 #define AF_UNSPEC   PF_UNSPEC
 #define AF_LOCAL    PF_LOCAL
@@ -27,16 +28,46 @@ typedef unsigned int socklen_t;
 #define AF_INET     PF_INET
 #define AF_INET6    PF_INET6
 #define AF_PACKET   PF_PACKET
-#define AF_KLINK    PF_KLINK
+
+#define SOL_SOCKET      1
+
+#define SO_REUSEADDR    2
+#define SO_TYPE         3
+#define SO_ERROR        4
+#define SO_SNDBUF       7
+#define SO_RCVBUF       8
+
+#define MSG_DONTWAIT    0x40
+
+#define SOMAXCONN       128
 
 struct sockaddr {
     uint16_t    sa_family;
     uint8_t     sa_data[14];
 };
 
-int accept(int, struct sockaddr *, socklen_t *);
-int bind(int, const struct sockaddr *, socklen_t);
-int connect(int, const struct sockaddr *, socklen_t);
-int socket(int, int, int);
+struct msghdr {
+    void *          msg_name;
+    socklen_t       msg_namelen;
+    struct iovec *  msg_iov;
+    int             msg_iovlen;
+    void *          msg_control;
+    socklen_t       msg_controllen;
+    int             msg_flags;
+};
+
+int     accept(int, struct sockaddr *, socklen_t *);
+int     bind(int, const struct sockaddr *, socklen_t);
+int     connect(int, const struct sockaddr *, socklen_t);
+int     getsockopt(int, int, int, void *, socklen_t *);
+int     listen(int, int);
+ssize_t recv(int, void *, size_t, int);
+ssize_t recvfrom(int, void *, size_t, int, struct sockaddr *, socklen_t *);
+ssize_t recvmsg(int, struct msghdr *, int);
+ssize_t send(int, const void *, size_t, int);
+ssize_t sendmsg(int, const struct msghdr *, int);
+ssize_t sendto(int, const void *, size_t, int, const struct sockaddr *, socklen_t);
+int     setsockopt(int, int, int, const void *, socklen_t);
+int     socket(int, int, int);
 
 #endif
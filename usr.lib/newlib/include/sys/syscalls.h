@@ -67,6 +67,8 @@
 #define SYS_ACCEPT          0x3F
 #define SYS_BIND            0x40
 #define SYS_MMAP            0x41
+#define SYS_MUNMAP          0x42
+#define SYS_UTIMES          0x43
 #define SYS_CLONE           0x44
 #define SYS_THREAD_SLEEP    0x45
 #define SYS_THREAD_WAKE     0x46
@@ -78,6 +80,20 @@
 #define SYS_MOUNT           0x4C
 #define SYS_LSEEK64         0x4D
 #define SYS_WORLDCTL        0x4E
+#define SYS_READV           0x4F
+#define SYS_WRITEV          0x50
+#define SYS_PREAD           0x51
+#define SYS_PWRITE          0x52
+#define SYS_PREADV          0x53
+#define SYS_PWRITEV         0x54
+#define SYS_MEMFD_CREATE    0x55
+#define SYS_LISTEN          0x56
+#define SYS_RECVMSG         0x57
+#define SYS_SENDMSG         0x58
+#define SYS_GETSOCKOPT      0x59
+#define SYS_SETSOCKOPT      0x5A
+#define SYS_SCHED_SETAFFINITY 0x5B
+#define SYS_SCHED_GETAFFINITY 0x5C
 
 struct mmap_args {
     uintptr_t   addr;
@@ -97,11 +113,46 @@ struct sysctl_args {
     size_t      newlen;
 };
 
+/* set by _syscall_probe() when SYSENTER can be used instead of int 0x80 */
+extern int _syscall_sysenter;
+
+void _syscall_probe();
+
+/*
+ * SYSENTER takes the user stack pointer in ECX and the return address in
+ * EDX, so the second argument travels in EBP and the third on the stack
+ */
+static inline uintptr_t
+sysenter5(int syscall, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t arg4, uintptr_t arg5)
+{
+    uintptr_t ret;
+
+    asm volatile(
+        "push %%ebp\n\t"
+        "push %%edx\n\t"
+        "mov %%ecx, %%ebp\n\t"
+        "mov %%esp, %%ecx\n\t"
+        "mov $1f, %%edx\n\t"
+        "sysenter\n"
+        "1:\n\t"
+        "add $4, %%esp\n\t"
+        "pop %%ebp"
+        : "=a"(ret), "+c"(arg2), "+d"(arg3)
+        : "0"(syscall), "b"(arg1), "S"(arg4), "D"(arg5)
+        : "memory", "cc");
+
+    return ret;
+}
+
 static inline uintptr_t
 syscall0(int syscall)
 {
     uintptr_t ret;
 
+    if (_syscall_sysenter) {
+        return sysenter5(syscall, 0, 0, 0, 0, 0);
+    }
+
     asm volatile("int $0x80" : "=a"(ret) : "A"(syscall));
 
     return ret;
@@ -109,9 +160,13 @@ syscall0(int syscall)
 
 static inline uintptr_t
 syscall1(int syscall, uintptr_t arg1)
-{   
+{
     uintptr_t ret;
-    
+
+    if (_syscall_sysenter) {
+        return sysenter5(syscall, arg1, 0, 0, 0, 0);
+    }
+
     asm volatile("int $0x80" : "=a"(ret) : "A"(syscall), "b"(arg1));
     
     return ret;
@@ -122,6 +177,10 @@ syscall2(int syscall, uintptr_t arg1, uintptr_t arg2)
 {
     uintptr_t ret;
 
+    if (_syscall_sysenter) {
+        return sysenter5(syscall, arg1, arg2, 0, 0, 0);
+    }
+
     asm volatile("int $0x80" : "=a"(ret) : "A"(syscall), "b"(arg1), "c"(arg2));
     
     return ret;
@@ -132,6 +191,10 @@ syscall3(int syscall, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3)
 {
     uintptr_t ret;
 
+    if (_syscall_sysenter) {
+        return sysenter5(syscall, arg1, arg2, arg3, 0, 0);
+    }
+
     asm volatile("int $0x80" : "=a"(ret) : "A"(syscall), "b"(arg1), "c"(arg2), "d"(arg3));
     
     return ret;
@@ -142,15 +205,34 @@ syscall4(int syscall, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t
 {
     uintptr_t ret;
 
+    if (_syscall_sysenter) {
+        return sysenter5(syscall, arg1, arg2, arg3, arg4, 0);
+    }
+
     asm volatile("int $0x80" : "=a"(ret) : "A"(syscall), "b"(arg1), "c"(arg2), "d"(arg3), "S"(arg4));
 
     return ret;
 }
 
+static inline uintptr_t
+syscall5(int syscall, uintptr_t arg1, uintptr_t arg2, uintptr_t arg3, uintptr_t arg4, uintptr_t arg5)
+{
+    uintptr_t ret;
+
+    if (_syscall_sysenter) {
+        return sysenter5(syscall, arg1, arg2, arg3, arg4, arg5);
+    }
+
+    asm volatile("int $0x80" : "=a"(ret) : "A"(syscall), "b"(arg1), "c"(arg2), "d"(arg3), "S"(arg4), "D"(arg5));
+
+    return ret;
+}
+
 #define _SYSCALL0(type, syscall) (type)(syscall0(syscall))
 #define _SYSCALL1(type, syscall, arg) (type)(syscall1(syscall, (uintptr_t)arg))
 #define _SYSCALL2(type, syscall, arg1, arg2) (type)(syscall2(syscall, (uintptr_t)arg1, (uintptr_t)arg2))
 #define _SYSCALL3(type, syscall, arg1, arg2, arg3) (type)(syscall3(syscall, (uintptr_t)arg1, (uintptr_t)arg2, (uintptr_t)arg3))
 #define _SYSCALL4(type, syscall, arg1, arg2, arg3, arg4) (type)(syscall4(syscall, (uintptr_t)arg1, (uintptr_t)arg2, (uintptr_t)arg3, (uintptr_t)arg4))
+#define _SYSCALL5(type, syscall, arg1, arg2, arg3, arg4, arg5) (type)(syscall5(syscall, (uintptr_t)arg1, (uintptr_t)arg2, (uintptr_t)arg3, (uintptr_t)arg4, (uintptr_t)arg5))
 
 #endif
@@ -1,23 +1,126 @@
 #ifndef _SYS_SYSCTL_H
 #define _SYS_SYSCTL_H
 
+#include <stdint.h>
 #include <sys/types.h>
 
 #define CTL_KERN            0x01
 
-#define KERN_PROC           1
-#define KERN_PROC_ALL       1
-
-struct kinfo_proc {
-    pid_t   pid;
-    pid_t   ppid;
-    uid_t   uid;
-    uid_t   sid;
-    uid_t   pgid;
-    gid_t   gid;
-    char    cmd[256];
-    char    tty[32];
-    time_t  stime;
+#define KERN_SCHED          2
+#define KERN_SCHED_CPUS     1
+
+#define KERN_INTR           3
+
+#define KERN_PROF           4
+#define KERN_PROF_ENABLE    1
+#define KERN_PROF_SAMPLES   2
+#define KERN_PROF_DROPPED   3
+
+#define KERN_KSYM           5
+#define KERN_KSYM_LOOKUP    1
+#define KERN_KSYM_ALL       2
+
+/* followed by a pid; records are struct ktr_syscall from sys/ktrace.h */
+#define KERN_KTRACE         6
+#define KERN_KTRACE_ENABLE  1
+#define KERN_KTRACE_RECORDS 2
+
+#define KERN_SYSCALLSTAT        7
+#define KERN_SYSCALLSTAT_ALL    1
+#define KERN_SYSCALLSTAT_PROC   2   /* followed by a pid */
+
+/* bucket n counts calls that took less than 2^n TSC cycles */
+#define KSYSCALLSTAT_NBUCKETS   32
+
+#define KERN_KSTAT          8
+
+/* how to read kinfo_kstat.value */
+#define KSTAT_TYPE_INT      1   /* signed */
+#define KSTAT_TYPE_UINT32   2
+#define KSTAT_TYPE_UINT64   3
+#define KSTAT_TYPE_ADDR     4   /* a kernel address; a delta means nothing */
+
+#define KSTAT_NAMELEN       32
+
+/* the records themselves are mapped from /dev/trace; see sys/trace.h */
+#define KERN_TRACE          9
+#define KERN_TRACE_MASK     1   /* uint32_t, bit n enables event n */
+#define KERN_TRACE_NCPUS    2   /* int, buffers in /dev/trace */
+
+/* live kernel heap blocks by call site; only a MALLOC_PROFILE kernel keeps them */
+#define KERN_MALLOC         10
+#define KERN_MALLOC_SITES   1
+
+/* when each stage of booting started; root can add stages of its own */
+#define KERN_BOOT           11
+#define KERN_BOOT_STAGES    1
+
+#define BOOTSTAGE_NAMELEN   24
+
+/* return addresses kept per profiler sample, including the interrupted one */
+#define KPROF_DEPTH         8
+
+/* run queue statistics of one CPU */
+struct kinfo_cpu {
+    int         id;
+    int         running;
+    uint32_t    runq_len;       /* threads waiting to run */
+    uint32_t    switches;       /* context switches */
+    uint32_t    steals;         /* threads taken from other CPUs while idle */
+    uint32_t    migrations;     /* threads moved here by the load balancer */
+};
+
+/* an interrupt vector that has handlers or was taken at least once */
+struct kinfo_intr {
+    int         vector;
+    uint32_t    count;          /* times taken since boot */
+    int         nhandlers;      /* devices sharing it */
+};
+
+/* where a CPU was when the timer interrupted it; pc[0] is innermost */
+struct kinfo_prof_sample {
+    int         cpu;
+    pid_t       pid;            /* 0 for kernel threads and idle */
+    int         user;           /* in userland; pc[0] is all there is */
+    int         depth;
+    uintptr_t   pc[KPROF_DEPTH];
+};
+
+/* a named kernel counter */
+struct kinfo_kstat {
+    char        name[KSTAT_NAMELEN];    /* subsystem.counter */
+    int         type;
+    uint64_t    value;
+};
+
+/* a system call that was made at least once */
+struct kinfo_syscallstat {
+    int         num;
+    uint32_t    calls;
+    uint32_t    errors;         /* calls that returned a negative value */
+    uint64_t    cycles;         /* TSC cycles spent in all of them */
+    uint32_t    hist[KSYSCALLSTAT_NBUCKETS];
+};
+
+/* a kernel symbol; for KERN_KSYM_LOOKUP, the one at or below the address asked for */
+struct kinfo_ksym {
+    uintptr_t   value;
+    uintptr_t   offset;         /* of the address from value */
+    char        name[64];
+};
+
+/* a stage of booting and the TSC when it started */
+struct kinfo_bootstage {
+    char        name[BOOTSTAGE_NAMELEN];
+    uint64_t    tsc;
+};
+
+/* what one call site has allocated from the kernel heap */
+struct kinfo_mallocsite {
+    uintptr_t   site;           /* return address of the allocation */
+    uint32_t    count;          /* live blocks */
+    uint32_t    bytes;          /* their size, as rounded up by the heap */
+    uint32_t    allocs;         /* blocks ever allocated */
 };
 
 int sysctl(int *name, int namelen, void *oldp, size_t *oldlenp, void *newp, size_t newlen);
@@ -0,0 +1,38 @@
+#ifndef _SYS_TRACE_H
+#define _SYS_TRACE_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* must match sys/sys/trace.h */
+#define TRACE_SCHED_SWITCH      1
+#define TRACE_SCHED_WAKEUP      2
+#define TRACE_PAGE_FAULT        3
+#define TRACE_BLOCK_SUBMIT      4
+#define TRACE_BLOCK_COMPLETE    5
+#define TRACE_VFS_LOOKUP        6
+#define TRACE_SYSCALL_ENTER     7
+#define TRACE_SYSCALL_EXIT      8
+#define TRACE_NEVENTS           9
+
+#define TRACE_NARGS             3
+
+#define TRACE_NPAGES            16
+#define TRACE_BUF_SIZE          ((TRACE_NPAGES + 1) * 4096)
+#define TRACE_NRECORDS          (TRACE_NPAGES * 4096 / sizeof(struct trace_record))
+
+struct trace_header {
+    volatile uint32_t   head;
+    uint32_t            cpu;
+};
+
+struct trace_record {
+    volatile uint32_t   seq;
+    uint16_t            event;
+    uint16_t            cpu;
+    uint64_t            tsc;
+    pid_t               tid;
+    uint32_t            args[TRACE_NARGS];
+};
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef _SYS_VDSO_H
+#define _SYS_VDSO_H
+
+#include <stdint.h>
+#include <sys/types.h>
+
+/* must match sys/sys/vdso.h */
+#define VDSO_BASE       0xBFF00000
+#define VDSO_TIME_ADDR  VDSO_BASE
+#define VDSO_PROC_ADDR  (VDSO_BASE + 0x1000)
+
+struct vdso_time {
+    volatile uint32_t   vt_seq;
+    uint32_t            vt_hz;
+    uint32_t            vt_ticks;
+    uint32_t            vt_tsc_mult;
+    uint64_t            vt_tsc;
+    int32_t             vt_delta_sec;
+    int32_t             vt_delta_usec;
+};
+
+struct vdso_proc {
+    pid_t               vp_pid;
+    pid_t               vp_tid;
+};
+
+#endif
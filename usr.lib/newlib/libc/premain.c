@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/syscalls.h>
 
 extern void exit(int code);
 extern int main(int argc, const char *argv[], int envc, const char *envp[]);
@@ -15,7 +16,9 @@ _premain(int argc, const char **argv, int envc, const char **envp)
     extern char **environ;
     extern void _init();
     extern void _fini();
-    
+
+    _syscall_probe();
+
     environ = (char**)calloc(1, sizeof(char*) * 128);
 
     for (i = 0; i < envc; i++) {
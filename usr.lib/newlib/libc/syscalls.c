@@ -9,13 +9,47 @@
 #include <sys/signal.h>
 #include <sys/socket.h>
 #include <sys/syscalls.h>
+#include <sys/uio.h>
 #include <sys/utsname.h>
+#include <sys/vdso.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <utime.h>
 
 char **environ;
 
+int _syscall_sysenter;
+
+/* mirrors sysenter_init() in sys/i686/kern/syscall_dispatch.c */
+void
+_syscall_probe()
+{
+    uint32_t eax;
+    uint32_t ebx;
+    uint32_t ecx;
+    uint32_t edx;
+    uint32_t family;
+    uint32_t model;
+    uint32_t stepping;
+
+    asm volatile("cpuid" : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx) : "a"(1), "c"(0));
+
+    if (!(edx & 0x800)) {
+        return;
+    }
+
+    family = (eax >> 8) & 0x0F;
+    model = (eax >> 4) & 0x0F;
+    stepping = eax & 0x0F;
+
+    /* the Pentium Pro sets SEP without actually implementing SYSENTER */
+    if (family == 6 && model < 3 && stepping < 3) {
+        return;
+    }
+
+    _syscall_sysenter = 1;
+}
+
 void
 _exit(int status)
 {
@@ -252,7 +286,7 @@ fchown(int file, uid_t owner, gid_t group)
 int
 fcntl(int fd, int cmd, ...)
 {
-    if (cmd != F_GETFD && cmd != F_SETFD) {
+    if (cmd != F_GETFD && cmd != F_SETFD && cmd != F_GETFL && cmd != F_SETFL) {
         return -1;
     }
 
@@ -268,7 +302,7 @@ fcntl(int fd, int cmd, ...)
         return -1;
     }
 
-    return 0;
+    return ret;
 }
 
 int
@@ -408,6 +442,12 @@ getpgrp(pid_t pid)
 int
 getpid()
 {
+    const volatile struct vdso_proc *vp = (struct vdso_proc*)VDSO_PROC_ADDR;
+
+    if (vp->vp_pid) {
+        return vp->vp_pid;
+    }
+
     int ret = _SYSCALL0(int, SYS_GETPID);
 
     if (ret < 0) {
@@ -447,6 +487,12 @@ getsid()
 int
 gettid()
 {
+    const volatile struct vdso_proc *vp = (struct vdso_proc*)VDSO_PROC_ADDR;
+
+    if (vp->vp_tid) {
+        return vp->vp_tid;
+    }
+
     int ret = _SYSCALL0(int, SYS_GETTID);
 
     if (ret < 0) {
@@ -457,9 +503,100 @@ gettid()
     return ret;
 }
 
+int
+getsockopt(int fd, int level, int name, void *val, socklen_t *val_len)
+{
+    int ret = _SYSCALL5(int, SYS_GETSOCKOPT, fd, level, name, val, val_len);
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
+/* reads the clock the kernel publishes in the vDSO page; see sys/i686/kern/vdso.c */
+static int
+vdso_gettimeofday(struct timeval *p)
+{
+    const volatile struct vdso_time *vt = (struct vdso_time*)VDSO_TIME_ADDR;
+
+    uint32_t seq;
+    uint32_t hz;
+    uint32_t ticks;
+    uint32_t mult;
+    uint32_t lo;
+    uint32_t hi;
+    uint32_t tick_usec;
+    uint64_t tsc;
+    uint64_t cycles;
+    int32_t delta_sec;
+    int32_t delta_usec;
+    time_t sec;
+    long usec;
+
+    do {
+        seq = vt->vt_seq;
+
+        asm volatile("" ::: "memory");
+
+        hz = vt->vt_hz;
+        ticks = vt->vt_ticks;
+        mult = vt->vt_tsc_mult;
+        tsc = vt->vt_tsc;
+        delta_sec = vt->vt_delta_sec;
+        delta_usec = vt->vt_delta_usec;
+
+        asm volatile("" ::: "memory");
+    } while ((seq & 1) || seq != vt->vt_seq);
+
+    if (hz == 0) {
+        return -1;
+    }
+
+    tick_usec = 1000000 / hz;
+    sec = ticks / hz;
+    usec = (ticks % hz) * tick_usec;
+
+    if (mult) {
+        asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+
+        cycles = (((uint64_t)hi << 32) | lo) - tsc;
+
+        /* both factors fit in 32 bits, so the product can't overflow */
+        cycles = (cycles >> 32) ? tick_usec : (cycles * mult) >> 32;
+
+        /* never run past the next tick, so time doesn't go backwards */
+        usec += cycles < tick_usec ? cycles : tick_usec - 1;
+    }
+
+    sec += delta_sec;
+    usec += delta_usec;
+
+    while (usec >= 1000000) {
+        usec -= 1000000;
+        sec++;
+    }
+
+    while (usec < 0) {
+        usec += 1000000;
+        sec--;
+    }
+
+    p->tv_sec = sec;
+    p->tv_usec = usec;
+
+    return 0;
+}
+
 int
 gettimeofday(struct timeval *p, void *z)
 {
+    if (vdso_gettimeofday(p) == 0) {
+        return 0;
+    }
+
     int ret = _SYSCALL1(int, SYS_TIME, 0);
 
     if (ret < 0) {
@@ -531,6 +668,19 @@ link(char *old, char *new)
     return -1;
 }
 
+int
+listen(int fd, int backlog)
+{
+    int ret = _SYSCALL2(int, SYS_LISTEN, fd, backlog);
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
 int
 lseek(int file, int ptr, int dir)
 {
@@ -572,6 +722,19 @@ lstat(const char *file, struct stat *st)
     return ret;
 }
 
+int
+memfd_create(const char *name, unsigned int flags)
+{
+    int ret = _SYSCALL2(int, SYS_MEMFD_CREATE, name, flags);
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
 int
 mkdir(const char *path, mode_t mode)
 {
@@ -632,7 +795,8 @@ mmap(void *addr, size_t length, int prot, int flags,
 
     int ret = _SYSCALL1(int, SYS_MMAP, &args);
 
-    if (ret < 0) {
+    /* mappings may live above 2GB, so only the errno range is an error */
+    if (ret < 0 && ret > -4096) {
         errno = -ret;
         return NULL;
     }
@@ -708,6 +872,58 @@ pipe(int pipefd[2])
     return ret;
 }
 
+ssize_t
+pread(int fd, void *buf, size_t nbyte, off_t offset)
+{
+    int ret = _SYSCALL5(int, SYS_PREAD, fd, buf, nbyte, (uint32_t)(offset & 0xFFFFFFFF), (uint32_t)((uint64_t)offset >> 32));
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
+ssize_t
+preadv(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    int ret = _SYSCALL5(int, SYS_PREADV, fd, iov, iovcnt, (uint32_t)(offset & 0xFFFFFFFF), (uint32_t)((uint64_t)offset >> 32));
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
+ssize_t
+pwrite(int fd, const void *buf, size_t nbyte, off_t offset)
+{
+    int ret = _SYSCALL5(int, SYS_PWRITE, fd, buf, nbyte, (uint32_t)(offset & 0xFFFFFFFF), (uint32_t)((uint64_t)offset >> 32));
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
+ssize_t
+pwritev(int fd, const struct iovec *iov, int iovcnt, off_t offset)
+{
+    int ret = _SYSCALL5(int, SYS_PWRITEV, fd, iov, iovcnt, (uint32_t)(offset & 0xFFFFFFFF), (uint32_t)((uint64_t)offset >> 32));
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
 int
 read(int file, char *ptr, int len)
 {
@@ -721,6 +937,65 @@ read(int file, char *ptr, int len)
     return ret;
 }
 
+ssize_t
+readv(int fd, const struct iovec *iov, int iovcnt)
+{
+    int ret = _SYSCALL3(int, SYS_READV, fd, iov, iovcnt);
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
+ssize_t
+recv(int fd, void *buf, size_t len, int flags)
+{
+    return recvfrom(fd, buf, len, flags, NULL, NULL);
+}
+
+ssize_t
+recvfrom(int fd, void *buf, size_t len, int flags, struct sockaddr *address, socklen_t *address_size)
+{
+    ssize_t ret;
+    struct iovec iov;
+    struct msghdr msg;
+
+    iov.iov_base = buf;
+    iov.iov_len = len;
+
+    msg.msg_name = address;
+    msg.msg_namelen = address_size ? *address_size : 0;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = NULL;
+    msg.msg_controllen = 0;
+    msg.msg_flags = 0;
+
+    ret = recvmsg(fd, &msg, flags);
+
+    if (ret >= 0 && address_size) {
+        *address_size = msg.msg_namelen;
+    }
+
+    return ret;
+}
+
+ssize_t
+recvmsg(int fd, struct msghdr *msg, int flags)
+{
+    int ret = _SYSCALL3(int, SYS_RECVMSG, fd, msg, flags);
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
 int
 rmdir(const char *path)
 {
@@ -747,6 +1022,45 @@ sbrk(int incr)
     return (caddr_t)ret;
 }
 
+ssize_t
+send(int fd, const void *buf, size_t len, int flags)
+{
+    return sendto(fd, buf, len, flags, NULL, 0);
+}
+
+ssize_t
+sendmsg(int fd, const struct msghdr *msg, int flags)
+{
+    int ret = _SYSCALL3(int, SYS_SENDMSG, fd, msg, flags);
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
+ssize_t
+sendto(int fd, const void *buf, size_t len, int flags, const struct sockaddr *address, socklen_t address_size)
+{
+    struct iovec iov;
+    struct msghdr msg;
+
+    iov.iov_base = (void*)buf;
+    iov.iov_len = len;
+
+    msg.msg_name = (void*)address;
+    msg.msg_namelen = address_size;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = NULL;
+    msg.msg_controllen = 0;
+    msg.msg_flags = 0;
+
+    return sendmsg(fd, &msg, flags);
+}
+
 int
 setegid(gid_t gid)
 {
@@ -834,6 +1148,19 @@ settimeofday(const struct timeval *tv, const struct timezone *tz)
     return adjtime(&newtv, NULL);
 }
 
+int
+setsockopt(int fd, int level, int name, const void *val, socklen_t val_len)
+{
+    int ret = _SYSCALL5(int, SYS_SETSOCKOPT, fd, level, name, val, val_len);
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}
+
 int
 setuid(uid_t uid)
 {
@@ -1086,3 +1413,16 @@ write(int file, char *ptr, int len)
 
     return ret;
 }
+
+ssize_t
+writev(int fd, const struct iovec *iov, int iovcnt)
+{
+    int ret = _SYSCALL3(int, SYS_WRITEV, fd, iov, iovcnt);
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+
+    return ret;
+}